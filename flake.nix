@@ -40,6 +40,7 @@
           buildInputs = with pkgs; [
             wayland
             gtk-layer-shell
+            json-glib
           ];
 
           disallowedReferences = with pkgs; [
@@ -63,6 +64,7 @@
             wayland
             libxkbcommon
             gtk-layer-shell
+            json-glib
             flutter
             pkg-config
           ];
@@ -3,7 +3,12 @@ import 'package:shared_preferences/shared_preferences.dart';
 
 enum KeebieSettings<T> {
   optInErrorReporting(false),
-  colorScheme(ColorScheme.night);
+  colorScheme(ColorScheme.night),
+  languages('en,ja'),
+  autocorrect(true),
+  commitOnPress(true),
+  rollover(150),
+  swipeTyping(true);
 
   const KeebieSettings(this.defaultValue);
 
@@ -1,3 +1,5 @@
+export 'logic/composer.dart';
 export 'logic/error.dart';
 export 'logic/keebie.dart';
-export 'logic/keyboard.dart';
\ No newline at end of file
+export 'logic/keyboard.dart';
+export 'logic/native.dart';
\ No newline at end of file
@@ -0,0 +1,72 @@
+import 'dart:math';
+import 'package:keebie/logic/native.dart';
+
+/// Keeps the text being composed in sync with the runner's composition,
+/// which the focused client shows as preedit. Every update only sends what
+/// changed, so long compositions cost no more than short ones. Keys and
+/// deletes sent around the composer end or edit the composition in the
+/// runner, whoever sends them calls [reset] afterwards.
+class KeebieComposer {
+  String _text = '';
+  int _cursor = 0;
+
+  String get text => _text;
+  bool get isComposing => _text.isNotEmpty;
+
+  /// Makes [text] the composition, [cursor] defaults to its end. Returns
+  /// false when there is no input method to show a preedit.
+  bool update(String text, {int? cursor}) {
+    final native = KeebieNative.instance;
+    if (native == null) return false;
+
+    final length = min(_text.length, text.length);
+    var prefix = 0;
+    while (prefix < length && _text.codeUnitAt(prefix) == text.codeUnitAt(prefix)) {
+      prefix++;
+    }
+
+    var suffix = 0;
+    while (suffix < length - prefix && _text.codeUnitAt(_text.length - suffix - 1) == text.codeUnitAt(text.length - suffix - 1)) {
+      suffix++;
+    }
+
+    // The runner puts its cursor after whatever was inserted.
+    if (prefix + suffix < max(_text.length, text.length)) {
+      if (!native.compose(prefix, _text.length - suffix, text.substring(prefix, text.length - suffix))) {
+        return false;
+      }
+      _cursor = text.length - suffix;
+    }
+
+    _text = text;
+    cursor ??= text.length;
+    if (cursor != _cursor) {
+      native.setComposingCursor(cursor, cursor);
+      _cursor = cursor;
+    }
+    return true;
+  }
+
+  /// Highlights part of the composition, like the segment being converted.
+  bool select(int begin, int end) {
+    _cursor = -1;
+    return KeebieNative.instance?.setComposingCursor(begin, end) ?? false;
+  }
+
+  /// Commits the composition, or [text] in its place.
+  bool finish([String? text]) {
+    _text = '';
+    _cursor = 0;
+    return KeebieNative.instance?.finishComposing(text) ?? false;
+  }
+
+  /// Drops the composition without committing anything.
+  bool cancel() => finish('');
+
+  /// Forgets the composition without telling the runner, for when it already
+  /// ended there.
+  void reset() {
+    _text = '';
+    _cursor = 0;
+  }
+}
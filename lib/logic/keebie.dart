@@ -1,12 +1,142 @@
+import 'dart:async';
+import 'dart:developer';
 import 'package:bitsdojo_window/bitsdojo_window.dart';
 import 'package:flutter/foundation.dart';
 import 'package:flutter/services.dart' hide KeyboardKey;
 import 'package:keebie/logic.dart';
 
+/// What the input method last reported about the focused text field.
+class KeebieInputMethodState {
+  const KeebieInputMethodState({
+    this.isActive = false,
+    this.contentType = KeyboardContentType.text,
+    this.contentHint = 0,
+    this.contentPurpose = 0,
+    this.textChangeCause = 0,
+    this.surroundingText,
+    this.cursor = 0,
+    this.anchor = 0,
+  });
+
+  factory KeebieInputMethodState.fromMap(Map<dynamic, dynamic> map) =>
+    KeebieInputMethodState(
+      isActive: map['active'] as bool,
+      contentType: KeyboardContentType.values[map['contentType'] as int],
+      contentHint: map['contentHint'] as int,
+      contentPurpose: map['contentPurpose'] as int,
+      textChangeCause: map['textChangeCause'] as int,
+      surroundingText: map['surroundingText'] as String?,
+      cursor: map['cursor'] as int,
+      anchor: map['anchor'] as int,
+    );
+
+  final bool isActive;
+  final KeyboardContentType contentType;
+
+  /// The raw zwp_text_input_v3 content hint and purpose.
+  final int contentHint;
+  final int contentPurpose;
+  final int textChangeCause;
+
+  /// Null when the text field does not share its text, [cursor] and [anchor]
+  /// index into it like any other Dart string.
+  final String? surroundingText;
+  final int cursor;
+  final int anchor;
+}
+
+/// A key the runner handled a touch on by itself, without the touch ever
+/// reaching Flutter.
+class KeebieKeyFeedback {
+  const KeebieKeyFeedback({
+    required this.plane,
+    required this.rowNo,
+    required this.keyNo,
+    this.isPressed = false,
+    this.isCommitted = false,
+  });
+
+  factory KeebieKeyFeedback.fromMap(Map<dynamic, dynamic> map) =>
+    KeebieKeyFeedback(
+      plane: map['plane'] as int,
+      rowNo: map['rowNo'] as int,
+      keyNo: map['keyNo'] as int,
+      isPressed: map['isPressed'] as bool,
+      isCommitted: map['isCommitted'] as bool,
+    );
+
+  final int plane;
+  final int rowNo;
+  final int keyNo;
+
+  /// Whether the key is to be drawn held down.
+  final bool isPressed;
+
+  /// Whether the key was typed with this change, which ends a one-shot shift.
+  final bool isCommitted;
+}
+
+/// Words the runner decoded from a swipe across the letters, best first.
+class KeebieSwipeCandidates {
+  const KeebieSwipeCandidates({
+    this.words = const [],
+    this.isFinal = false,
+  });
+
+  factory KeebieSwipeCandidates.fromMap(Map<dynamic, dynamic> map) =>
+    KeebieSwipeCandidates(
+      words: (map['words'] as List<dynamic>).cast<String>(),
+      isFinal: map['isFinal'] as bool,
+    );
+
+  final List<String> words;
+
+  /// Whether the finger lifted, the first word was typed then.
+  final bool isFinal;
+}
+
+/// Characters the runner recognized from the strokes on the handwriting pad,
+/// best first.
+class KeebieHandwritingCandidates {
+  const KeebieHandwritingCandidates({
+    this.characters = const [],
+    this.strokes = 0,
+  });
+
+  factory KeebieHandwritingCandidates.fromMap(Map<dynamic, dynamic> map) =>
+    KeebieHandwritingCandidates(
+      characters: (map['characters'] as List<dynamic>).cast<String>(),
+      strokes: map['strokes'] as int,
+    );
+
+  final List<String> characters;
+
+  /// How many strokes the characters were recognized from, none means the
+  /// pad was cleared.
+  final int strokes;
+}
+
 class Keebie {
   static const _methodChannel = MethodChannel('keebie');
+  static const _inputMethodChannel = EventChannel('keebie/input_method');
+  static final _inputMethodState = _inputMethodChannel.receiveBroadcastStream()
+    .map((value) => KeebieInputMethodState.fromMap(value as Map<dynamic, dynamic>));
+  static const _monitorChannel = EventChannel('keebie/monitor');
+  static final _layoutChanged = StreamController<String>.broadcast();
+  static final _monitorChanged = StreamController<Rect>.broadcast();
+  static final _keyFeedback = StreamController<KeebieKeyFeedback>.broadcast();
+  static final _swipeCandidates = StreamController<KeebieSwipeCandidates>.broadcast();
+  static final _handwritingCandidates = StreamController<KeebieHandwritingCandidates>.broadcast();
+  static Rect? _monitorGeometry;
 
   static void init() {
+    _monitorChannel.receiveBroadcastStream().listen((value) {
+      _monitorGeometry = _rectFromMap(value as Map<dynamic, dynamic>);
+      _monitorChanged.add(_monitorGeometry!);
+    }, onError: (error, trace) {
+      handleError(error, trace: trace);
+    });
+
     _methodChannel.setMethodCallHandler((call) async {
       switch (call.method) {
         case 'onSettingsChange':
@@ -14,12 +144,40 @@ class Keebie {
             return await onSettingsChange!();
           }
           break;
+        case 'onLayoutChanged':
+          _layoutChanged.add(call.arguments as String);
+          break;
+        case 'onKeyFeedback':
+          _keyFeedback.add(KeebieKeyFeedback.fromMap(call.arguments as Map<dynamic, dynamic>));
+          break;
+        case 'onSwipeCandidates':
+          _swipeCandidates.add(KeebieSwipeCandidates.fromMap(call.arguments as Map<dynamic, dynamic>));
+          break;
+        case 'onHandwritingCandidates':
+          _handwritingCandidates.add(KeebieHandwritingCandidates.fromMap(call.arguments as Map<dynamic, dynamic>));
+          break;
         default:
           return null;
       }
     });
   }
 
+  /// Names of layouts the runner recompiled because their source changed.
+  static Stream<String> get onLayoutChanged => _layoutChanged.stream;
+
+  /// Keys the runner typed straight from a touch, Flutter only draws them.
+  static Stream<KeebieKeyFeedback> get onKeyFeedback => _keyFeedback.stream;
+
+  /// Words a swipe could be, while the finger moves and once it lifted.
+  static Stream<KeebieSwipeCandidates> get onSwipeCandidates => _swipeCandidates.stream;
+
+  /// Characters the strokes on the handwriting pad could be, after each one.
+  static Stream<KeebieHandwritingCandidates> get onHandwritingCandidates => _handwritingCandidates.stream;
+
+  /// Pushed by the runner whenever the focused text field changes, starting
+  /// with the current state.
+  static Stream<KeebieInputMethodState> get onInputMethodState => _inputMethodState;
+
   static Future<void> announceSettingsChange() =>
     _methodChannel.invokeMethod('announceSettingsChange');
 
@@ -32,37 +190,166 @@ class Keebie {
 
   static Future<void> sendKey(KeyboardKey key, {
     required bool isShifted,
+    required int plane,
     required int rowNo,
     required int keyNo,
-  }) => _methodChannel.invokeMethod('sendKey', {
-    'name': key.name,
-    'shiftedName': key.shiftedName,
-    'type': key.type.name,
-    'isShifted': isShifted,
-    'rowNo': rowNo,
-    'keyNo': keyNo,
-  });
+  }) {
+    final task = TimelineTask()..start('Keebie.sendKey');
+    final native = KeebieNative.instance;
+
+    // Only runners without the native library take keys over the channel.
+    // The Linux handler resolves them through the same table, so a key the
+    // runner has no action for would only fail there as well.
+    if (native != null) {
+      native.activateKey(plane, rowNo, keyNo, isShifted);
+      task.finish();
+      return Future.value();
+    }
 
-  static Future<void> announceLayout(KeyboardLayout layout) =>
-    _methodChannel.invokeMethod('announceLayout', layout.toJson());
+    return _methodChannel.invokeMethod('sendKey', {
+      'name': key.name,
+      'shiftedName': key.shiftedName,
+      'type': key.type.name,
+      'isShifted': isShifted,
+      'plane': plane,
+      'rowNo': rowNo,
+      'keyNo': keyNo,
+    }).whenComplete(task.finish);
+  }
+
+  /// Deletes back from the cursor by [unit], false when the runner could not.
+  static bool delete(KeebieDeleteUnit unit, {int count = 1}) =>
+    KeebieNative.instance?.delete(unit, count: count) ?? false;
+
+  /// Starts holding a key down, the runner performs it right away and then
+  /// repeats it natively. Returns false when this has to go through [sendKey].
+  static bool pressKey({
+    required bool isShifted,
+    required int plane,
+    required int rowNo,
+    required int keyNo,
+  }) => KeebieNative.instance?.pressKey(plane, rowNo, keyNo, isShifted) ?? false;
+
+  /// Stops the key repeating, unless a later [pressKey] took over already.
+  static void releaseKey({
+    required int plane,
+    required int rowNo,
+    required int keyNo,
+  }) {
+    KeebieNative.instance?.releaseKey(plane, rowNo, keyNo);
+  }
 
-  static Future<List<KeyboardKeyConstraint>> get constraints async {
+  /// Up to [k] completions of the word at the cursor, empty when the current
+  /// language has no dictionary.
+  static List<String> completions({int k = 3}) =>
+    KeebieNative.instance?.getCompletions(k) ?? const [];
+
+  /// Swaps the word at the cursor for a completion and moves past it.
+  static bool acceptCompletion(String word) =>
+    KeebieNative.instance?.replaceWord('$word ') ?? false;
+
+  /// Up to [k] emoji and symbols matching [query], the ones picked most and
+  /// lately first. An empty query lists those picks and then the catalog.
+  /// Empty when the current language has no catalog.
+  static List<String> searchEmoji(String query, {int k = 64}) =>
+    KeebieNative.instance?.searchEmoji(query, k) ?? const [];
+
+  /// Types a picked emoji or symbol.
+  static bool commitEmoji(String text) =>
+    KeebieNative.instance?.commitEmoji(text) ?? false;
+
+  /// Whether the runner fixes the word just typed as it is ended, a backspace
+  /// right after takes the fix back.
+  static set autocorrect(bool value) {
+    KeebieNative.instance?.setAutocorrect(value);
+  }
+
+  /// Whether touched keys type on the way down rather than the way up, keys
+  /// which repeat always act on the way down.
+  static set commitOnPress(bool value) {
+    KeebieNative.instance?.setCommitOnPress(value);
+  }
+
+  /// How many milliseconds a released key waits on keys touched before it
+  /// which are still held, so overlapping touches type in order.
+  static set rollover(int value) {
+    KeebieNative.instance?.setRollover(value);
+  }
+
+  /// Whether dragging across the letters types the word they spell.
+  static set swipeTyping(bool value) {
+    KeebieNative.instance?.setSwipeTyping(value);
+  }
+
+  /// Tells the runner where the keys of [plane] are laid out within the
+  /// window, so it can resolve and type touches on them itself. Null hands
+  /// every touch back to Flutter.
+  static Future<void> announceTouchSurface(Rect? rect, {
+    int plane = 0,
+    int constraints = 0,
+    double childSize = 0,
+    double padding = 0,
+    Size monitorSize = Size.zero,
+    bool isShifted = false,
+  }) =>
+    _methodChannel.invokeMethod('announceTouchSurface', rect == null ? null : {
+      'plane': plane,
+      'constraints': constraints,
+      'childSize': childSize,
+      'padding': padding,
+      'monitorWidth': monitorSize.width,
+      'monitorHeight': monitorSize.height,
+      'x': rect.left,
+      'y': rect.top,
+      'width': rect.width,
+      'height': rect.height,
+      'isShifted': isShifted,
+    });
+
+  /// Tells the runner where the handwriting pad is laid out within the
+  /// window, so it recognizes the strokes written on it. Null puts the pad
+  /// away. Completes with whether the current language can be handwritten.
+  static Future<bool> announceHandwritingSurface(Rect? rect) async =>
+    await _methodChannel.invokeMethod<bool>('announceHandwritingSurface', rect == null ? null : {
+      'x': rect.left,
+      'y': rect.top,
+      'width': rect.width,
+      'height': rect.height,
+    }) ?? false;
+
+  /// Types a recognized character and clears the pad for the next one.
+  static Future<void> acceptHandwriting(String character) =>
+    _methodChannel.invokeMethod('acceptHandwriting', character);
+
+  static Future<void> undoHandwritingStroke() =>
+    _methodChannel.invokeMethod('undoHandwritingStroke');
+
+  static Future<void> clearHandwriting() =>
+    _methodChannel.invokeMethod('clearHandwriting');
+
+  /// The layouts changeLang cycles through, the runner preloads every one of
+  /// them together with its keymap.
+  static set languages(List<String> names) {
+    KeebieNative.instance?.setLanguages(names);
+  }
+
+  /// Makes the next enabled language active in the runner and returns its
+  /// layout name, null when this has to go through sendKey instead.
+  static String? changeLanguage() {
+    final task = TimelineTask()..start('Keebie.changeLanguage');
     try {
-      return (await _methodChannel.invokeMethod('getConstraints') as List<dynamic>)
-        .map((value) => KeyboardKeyConstraint.values.firstWhere((e) => e.name == value))
-        .toList();
-    } catch (e) {
-      return [];
+      return KeebieNative.instance?.changeLanguage();
+    } finally {
+      task.finish();
     }
   }
 
-  static Future<KeyboardContentType?> get contentType async {
-    try {
-      final value = await _methodChannel.invokeMethod('getContentType');
-      return KeyboardContentType.values.firstWhere((e) => e.name == value);
-    } catch (e) {
-      return null;
+  static Future<void> announceLayout(KeyboardLayout layout) {
+    final name = layout.name;
+    if (name != null && (KeebieNative.instance?.activateLayout(name) ?? false)) {
+      return Future.value();
     }
+    return _methodChannel.invokeMethod('announceLayout', layout.toJson());
   }
 
   static Future<bool> get isKeyboard async {
@@ -73,11 +360,20 @@ class Keebie {
     }
   }
 
-  static Future<Rect> get monitorGeometry async {
-    final value = await _methodChannel.invokeMethod('getMonitorGeometry');
-    return Offset(value['x']!.toDouble(), value['y']!.toDouble())
+  static Rect _rectFromMap(Map<dynamic, dynamic> value) =>
+    Offset(value['x']!.toDouble(), value['y']!.toDouble())
       & Size(value['width']!.toDouble(), value['height']!.toDouble());
-  }
+
+  /// The geometry of the window's monitor, only asked for until the runner
+  /// has pushed it once.
+  static Future<Rect> get monitorGeometry async =>
+    _monitorGeometry ??= _rectFromMap(await _methodChannel.invokeMethod('getMonitorGeometry'));
+
+  static Rect? get cachedMonitorGeometry => _monitorGeometry;
+
+  /// Pushed by the runner when the window's monitor moves, resizes or
+  /// changes its scale.
+  static Stream<Rect> get onMonitorGeometry => _monitorChanged.stream;
 
   static set windowSize(Future<Size> size) {
     size.then((value) async {
@@ -1,6 +1,9 @@
 import 'dart:convert';
 import 'dart:math';
+import 'dart:typed_data';
 import 'package:keebie/main.dart';
+import 'package:keebie/logic/keebie.dart';
+import 'package:keebie/logic/native.dart';
 import 'package:libtokyo_flutter/libtokyo.dart';
 
 enum KeyboardKeyType {
@@ -17,6 +20,12 @@ enum KeyboardKeyConstraint {
   canChangeLanguage
 }
 
+enum KeyboardPlaneType {
+  keys,
+  handwriting,
+  emoji
+}
+
 enum KeyboardContentType {
   dateTime,
   number,
@@ -49,7 +58,7 @@ class KeyboardKey {
   final List<KeyboardKeyConstraint> constrains;
   final int? plane;
 
-  Size getChildSize(BuildContext context, bool isShifted, Rect monitorGeometry) {
+  static Size getChildSize(BuildContext context, Rect monitorGeometry) {
     final textStyle = Theme.of(context).textTheme.labelLarge!;
 
     final pixelRatio = monitorGeometry.size.aspectRatio > MediaQuery.devicePixelRatioOf(context) ? monitorGeometry.size.aspectRatio : MediaQuery.devicePixelRatioOf(context);
@@ -59,43 +68,6 @@ class KeyboardKey {
     return scale < 1.0 ? (value / scale) * 0.85 : value * scale;
   }
 
-  Size getContainerSize({
-    required Rect monitorGeometry,
-    required BuildContext context,
-    required KeyboardRow row,
-    required bool isShifted,
-    List<KeyboardKeyConstraint> constraints = const [],
-  }) {
-    final keys = row.getKeys(constraints: constraints);
-    final childSize = getChildSize(context, isShifted, monitorGeometry);
-
-    var height = (childSize.height * 1.5) + (KeyboardKey.padding.vertical * 2);
-    var width = ((childSize.width * 1.5) + (KeyboardKey.padding.horizontal * 2));
-
-    if (expands) {
-      final usedSpace = keys.map((key) => key.expands ? Size.zero : key.getContainerSize(context: context, row: row, isShifted: isShifted, monitorGeometry: monitorGeometry))
-        .reduce((v, e) => Size(v.width + e.width, e.height > v.height ? e.height : v.height));
-
-      final largestRow = row.plane.findRowByLargest(context, constraints: constraints, isShifted: isShifted, monitorGeometry: monitorGeometry);
-      final expandedWidth = largestRow.getSize(context, isShifted: isShifted, monitorGeometry: monitorGeometry).width - usedSpace.width;
-
-      width = expandedWidth;
-    }
-
-    height = height.clamp(monitorGeometry.height / (height * row.plane.length), height);
-    width = width.clamp(monitorGeometry.width / (width * keys.length), width);
-    return Size(width, height);
-  }
-
-  Size getTotalSize({
-    required Rect monitorGeometry,
-    required BuildContext context,
-    required KeyboardRow row,
-    required bool isShifted,
-    List<KeyboardKeyConstraint> constraints = const [],
-  }) => getContainerSize(context: context, row: row, constraints: constraints, isShifted: isShifted, monitorGeometry: monitorGeometry)
-    + Offset(padding.horizontal * 1.5, padding.vertical * 2);
-
   dynamic toJson() {
     return {
       'type': type.name,
@@ -107,6 +79,7 @@ class KeyboardKey {
       'shiftedIconFontFamily': shiftedIcon == null ? null : shiftedIcon!.fontFamily,
       'expands': expands,
       'secondaryColors': secondaryColors,
+      'constraints': constrains.map((e) => e.name).toList(),
       'plane': plane,
     };
   }
@@ -132,54 +105,154 @@ class KeyboardRow {
     return entries;
   }
 
-  Size getSize(BuildContext context, {
-    required bool isShifted,
-    required Rect monitorGeometry,
-    List<KeyboardKeyConstraint> constraints = const [],
-  }) => getKeys(constraints: constraints)
-    .map((key) => key.getTotalSize(context: context, row: this, isShifted: isShifted, monitorGeometry: monitorGeometry))
-    .reduce((v, e) => Size(v.width + e.width, e.height > v.height ? e.height : v.height));
+  /// The position of the key within the row before constraints are applied,
+  /// which is how the runner's action table addresses it.
+  int indexOf(KeyboardKey key) => _keys.indexOf(key);
+
+  KeyboardKey keyAt(int index) => _keys[index];
 }
 
 class KeyboardPlane {
-  const KeyboardPlane(this._rows);
+  const KeyboardPlane(this._rows, { this.type = KeyboardPlaneType.keys });
 
   final List<List<KeyboardKey>> _rows;
 
+  /// Handwriting planes have a pad for writing characters on above their keys.
+  final KeyboardPlaneType type;
+
   int get length => _rows.length;
 
   List<KeyboardRow> get rows =>
     _rows.asMap().map((rowNo, row) =>
       MapEntry(rowNo, KeyboardRow(this, row, rowNo))
     ).values.toList();
+}
+
+class KeyboardKeyRect {
+  const KeyboardKeyRect(this.rect, {
+    required this.rowNo,
+    required this.keyNo,
+  });
+
+  final Rect rect;
+  final int rowNo;
+  final int keyNo;
+}
+
+/// The size of a plane and the rect of each of its visible keys, the key
+/// number is the index within the row before constraints are applied.
+class KeyboardGeometry {
+  const KeyboardGeometry(this.size, this.keys);
+
+  final Size size;
+  final List<KeyboardKeyRect> keys;
 
-  List<KeyboardRow> getFixedSizeRows({
+  /// Solves the geometry using the runner when it already has the layout,
+  /// otherwise falls back to doing the same work in Dart.
+  static KeyboardGeometry solve(KeyboardPlane plane, {
+    required int planeNo,
+    required double childSize,
+    required Rect monitorGeometry,
     List<KeyboardKeyConstraint> constraints = const [],
-  }) =>
-    rows..removeWhere((row) {
-      for (final key in row.getKeys(constraints: constraints)) {
-        if (key.expands) return true;
+    bool isAnnounced = false,
+  }) {
+    if (isAnnounced) {
+      final geometry = KeebieNative.instance?.getGeometry(
+        planeNo,
+        _constraintMask(constraints),
+        childSize,
+        KeyboardKey.padding.left,
+        monitorGeometry.size,
+      );
+      if (geometry != null) return geometry;
+    }
+
+    final padding = KeyboardKey.padding.left;
+    final keySize = childSize * 1.5 + padding * 4;
+    final rowHeight = keySize + padding * 4;
+    final planeRows = plane.rows;
+    final rows = planeRows.map((row) => row.getKeys(constraints: constraints)).toList();
+
+    var widestFixed = 0.0;
+    for (final keys in rows) {
+      if (keys.any((key) => key.expands)) continue;
+      widestFixed = max(widestFixed, keys.length * (keySize + padding * 3));
+    }
+
+    final widths = rows.map((keys) {
+      final fixed = keys.where((key) => !key.expands).length * keySize;
+      return keys.map((key) => key.expands ? max(widestFixed - fixed, keySize) : keySize).toList();
+    }).toList();
+
+    final width = widths.fold(0.0, (value, row) => max(value, row.fold(0.0, (total, w) => total + w + padding * 3)));
+    final scale = monitorGeometry.width > 0 && width > monitorGeometry.width ? monitorGeometry.width / width : 1.0;
+
+    final keys = <KeyboardKeyRect>[];
+    var y = 0.0;
+    for (var rowNo = 0; rowNo < rows.length; rowNo++) {
+      if (rows[rowNo].isEmpty) continue;
+
+      final slots = widths[rowNo].fold(0.0, (total, w) => total + w + padding * 2);
+      final gap = max(width - slots, 0.0) / rows[rowNo].length;
+
+      var x = gap / 2;
+      for (var i = 0; i < rows[rowNo].length; i++) {
+        keys.add(KeyboardKeyRect(
+          Rect.fromLTWH((x + padding) * scale, y + padding * 2, widths[rowNo][i] * scale, keySize),
+          rowNo: rowNo,
+          keyNo: planeRows[rowNo].indexOf(rows[rowNo][i]),
+        ));
+        x += widths[rowNo][i] + padding * 2 + gap;
       }
-      return false;
-    });
 
-  KeyboardRow findRowByLargest(BuildContext context, {
-    required bool isShifted,
+      y += rowHeight;
+    }
+    return KeyboardGeometry(Size(width * scale, y), keys);
+  }
+
+  /// The key a touch at [position] within the plane was meant for, the
+  /// runner weighs where it landed against what is likely typed next. Until
+  /// it has the layout that is simply the key it [landed] on.
+  KeyboardKeyRect resolveTouch(Offset position, KeyboardKeyRect landed, {
+    required int planeNo,
+    required double childSize,
     required Rect monitorGeometry,
     List<KeyboardKeyConstraint> constraints = const [],
-    bool allowExpanded = false,
+    bool isAnnounced = false,
   }) {
-    final r = allowExpanded ? rows : getFixedSizeRows(constraints: constraints);
-    return rows[r.asMap().map((i, row) => MapEntry(row.number, row.getSize(context, constraints: constraints, isShifted: isShifted, monitorGeometry: monitorGeometry)))
-        .entries.reduce((v, e) => e.value > v.value ? e : v).key];
+    if (!isAnnounced) return landed;
+
+    final index = KeebieNative.instance?.resolveTouch(
+      planeNo,
+      _constraintMask(constraints),
+      childSize,
+      KeyboardKey.padding.left,
+      monitorGeometry.size,
+      position,
+    );
+    return index != null && index < keys.length ? keys[index] : landed;
   }
 
-  Size getSize(BuildContext context, {
-    required bool isShifted,
+  /// Hands touches on this plane, laid out at [origin] within the window, to
+  /// the runner so they are typed without going through the gesture arena.
+  Future<void> announceTouchSurface(Offset origin, {
+    required int planeNo,
+    required double childSize,
     required Rect monitorGeometry,
     List<KeyboardKeyConstraint> constraints = const [],
-  }) => rows.map((row) => row.getSize(context, constraints: constraints, isShifted: isShifted, monitorGeometry: monitorGeometry))
-    .reduce((v, e) => Size(e.width > v.width ? e.width : v.width, v.height + e.height));
+    bool isShifted = false,
+  }) =>
+    Keebie.announceTouchSurface(origin & size,
+      plane: planeNo,
+      constraints: _constraintMask(constraints),
+      childSize: childSize,
+      padding: KeyboardKey.padding.left,
+      monitorSize: monitorGeometry.size,
+      isShifted: isShifted,
+    );
+
+  static int _constraintMask(List<KeyboardKeyConstraint> constraints) =>
+    constraints.fold(0, (mask, constraint) => mask | (1 << constraint.index));
 }
 
 class KeyboardLayout {
@@ -187,44 +260,150 @@ class KeyboardLayout {
     required this.locale,
     required this.contentPlaneMap,
     required this.planes,
+    this.planeTypes = const [],
+    this.name,
   });
 
+  /// The name of the compiled layout the runner can activate on its own.
+  final String? name;
   final String locale;
   final Map<KeyboardContentType, int> contentPlaneMap;
   final List<List<List<KeyboardKey>>> planes;
 
-  KeyboardPlane getPlane(int wanted, {
+  /// The type of each plane, planes past the end only have keys.
+  final List<KeyboardPlaneType> planeTypes;
+
+  KeyboardPlaneType planeType(int index) =>
+    index >= 0 && index < planeTypes.length ? planeTypes[index] : KeyboardPlaneType.keys;
+
+  int resolvePlane(int wanted, {
     KeyboardContentType? contentType,
   }) {
     if (contentType != null) {
-      if (contentPlaneMap.containsKey(contentType)) {
-        return getPlane(contentPlaneMap[contentType]!);
-      }
-      return const KeyboardPlane([]);
+      return contentPlaneMap[contentType] ?? -1;
     }
+    return wanted;
+  }
 
-    final rows = wanted < 0 || wanted > planes.length ? <List<KeyboardKey>>[] : planes[wanted];
-    return KeyboardPlane(rows);
+  KeyboardPlane getPlane(int wanted, {
+    KeyboardContentType? contentType,
+  }) {
+    final index = resolvePlane(wanted, contentType: contentType);
+    final rows = index < 0 || index >= planes.length ? <List<KeyboardKey>>[] : planes[index];
+    return KeyboardPlane(rows, type: planeType(index));
   }
 
   dynamic toJson() {
     return {
       'locale': locale,
       'contentPlaneMap': contentPlaneMap.map((key, value) => MapEntry(key.name, value)),
-      'planes': planes.map((plane) => plane.map((row) => row.map((key) => key.toJson()).toList()).toList()).toList(),
+      'planes': List.generate(planes.length, (planeNo) {
+        final rows = planes[planeNo].map((row) => row.map((key) => key.toJson()).toList()).toList();
+        final type = planeType(planeNo);
+        return type == KeyboardPlaneType.keys ? rows : {
+          'type': type.name,
+          'rows': rows,
+        };
+      }),
     };
   }
 
-  static KeyboardLayout fromJson(String source) {
+  /// Decodes a layout compiled by keebie-layout-compiler, the format is
+  /// described in linux/layout.h. Strings are decoded once per distinct offset.
+  static KeyboardLayout fromBinary(ByteData data, { String? name }) {
+    const magic = 0x594c424b;
+    const version = 2;
+    const headerSize = 68;
+
+    int u32(int offset) => data.getUint32(offset, Endian.host);
+    int i32(int offset) => data.getInt32(offset, Endian.host);
+
+    if (data.lengthInBytes < headerSize || u32(0) != magic || u32(4) != version || u32(8) != data.lengthInBytes) {
+      throw const FormatException('Not a compiled keyboard layout');
+    }
+
+    final planesOffset = u32(36);
+    final rowsOffset = u32(44);
+    final actionsOffset = u32(52);
+    final keysOffset = u32(56);
+    final stringsOffset = u32(60);
+    final stringsEnd = stringsOffset + u32(64);
+
+    final strings = <int, String>{};
+    String string(int offset) => strings.putIfAbsent(offset, () {
+      final start = stringsOffset + offset;
+      var end = start;
+      while (end < stringsEnd && data.getUint8(end) != 0) {
+        end++;
+      }
+      return utf8.decode(Uint8List.sublistView(data, start, end));
+    });
+
+    IconData? icon(int codePoint, int fontFamily) {
+      if (codePoint == 0) return null;
+      final family = string(fontFamily);
+      return IconData(codePoint, fontFamily: family.isEmpty ? null : family);
+    }
+
+    KeyboardKey key(int index) {
+      final action = actionsOffset + index * 16;
+      final key = keysOffset + index * 28;
+      final constraints = data.getUint8(action + 3);
+      final flags = data.getUint8(action + 2);
+      final plane = i32(key + 24);
+
+      return KeyboardKey(
+        type: KeyboardKeyType.values[data.getUint8(action + 1)],
+        name: string(u32(key)),
+        shiftedName: string(u32(key + 4)),
+        icon: icon(u32(key + 8), u32(key + 16)),
+        shiftedIcon: icon(u32(key + 12), u32(key + 20)),
+        expands: flags & 1 != 0,
+        secondaryColors: flags & 2 != 0,
+        constrains: KeyboardKeyConstraint.values.where((e) => constraints & (1 << e.index) != 0).toList(),
+        plane: plane < 0 ? null : plane,
+      );
+    }
+
+    final contentPlaneMap = <KeyboardContentType, int>{};
+    for (final type in KeyboardContentType.values) {
+      final plane = i32(16 + type.index * 4);
+      if (plane >= 0) contentPlaneMap[type] = plane;
+    }
+
+    return KeyboardLayout(
+      name: name,
+      locale: string(u32(12)),
+      contentPlaneMap: contentPlaneMap,
+      planeTypes: List.generate(u32(32), (planeNo) => KeyboardPlaneType.values[u32(planesOffset + planeNo * 12 + 8)]),
+      planes: List.generate(u32(32), (planeNo) {
+        final plane = planesOffset + planeNo * 12;
+        return List.generate(u32(plane + 4), (rowNo) {
+          final row = rowsOffset + (u32(plane) + rowNo) * 8;
+          return List.generate(u32(row + 4), (keyNo) => key(u32(row) + keyNo));
+        });
+      }),
+    );
+  }
+
+  static KeyboardLayout fromJson(String source, { String? name }) {
     final data = json.decode(source) as Map<String, dynamic>;
+
+    // A plane is either its rows of keys, or an object with a type and rows.
+    final planes = data['planes'] as List<dynamic>;
+    final planeTypes = planes.map((plane) => plane is Map<String, dynamic> && plane.containsKey('type') ?
+      KeyboardPlaneType.values.firstWhere((e) => e.name == plane['type']) : KeyboardPlaneType.keys).toList();
+
     return KeyboardLayout(
+      name: name,
       locale: data['locale'],
       contentPlaneMap: data.containsKey('contentPlaneMap') ? (data['contentPlaneMap'] as Map<String, dynamic>).map((key, value) =>
         MapEntry(
           KeyboardContentType.values.firstWhere((e) => e.name == key),
           value
         )) : {},
-      planes: (data['planes'] as List<dynamic>).map((plane) => (plane as List<dynamic>).map((row) => (row as List<dynamic>).map((keyDynamic) {
+      planeTypes: planeTypes,
+      planes: planes.map((plane) => (plane is Map<String, dynamic> ? plane['rows'] as List<dynamic> : plane as List<dynamic>).map((row) => (row as List<dynamic>).map((keyDynamic) {
         final data = keyDynamic as Map<String, dynamic>;
         return KeyboardKey(
           type: data.containsKey('type') ? KeyboardKeyType.values.firstWhere((e) => e.name == data['type']) : KeyboardKeyType.regular,
@@ -0,0 +1,383 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'package:flutter/foundation.dart';
+import 'package:flutter/painting.dart';
+import 'package:keebie/logic/keyboard.dart';
+
+typedef _CommitTextNative = Bool Function(Pointer<Utf8> text);
+typedef _CommitText = bool Function(Pointer<Utf8> text);
+
+typedef _SendKeyNative = Bool Function(Uint32 key);
+typedef _SendKey = bool Function(int key);
+
+typedef _ActivateKeyNative = Int32 Function(Uint32 plane, Uint32 row, Uint32 key, Bool isShifted);
+typedef _ActivateKey = int Function(int plane, int row, int key, bool isShifted);
+
+typedef _ReleaseKeyNative = Void Function(Uint32 plane, Uint32 row, Uint32 key);
+typedef _ReleaseKey = void Function(int plane, int row, int key);
+
+typedef _GetGeometryNative = Int32 Function(Uint32 plane, Uint32 constraints, Float childSize, Float padding, Float monitorWidth, Float monitorHeight, Pointer<Float> out, Uint32 capacity);
+typedef _GetGeometry = int Function(int plane, int constraints, double childSize, double padding, double monitorWidth, double monitorHeight, Pointer<Float> out, int capacity);
+
+typedef _ResolveTouchNative = Int32 Function(Uint32 plane, Uint32 constraints, Float childSize, Float padding, Float monitorWidth, Float monitorHeight, Float x, Float y);
+typedef _ResolveTouch = int Function(int plane, int constraints, double childSize, double padding, double monitorWidth, double monitorHeight, double x, double y);
+
+typedef _LayoutRefNative = Pointer<Void> Function(Pointer<Utf8> name);
+typedef _LayoutRef = Pointer<Void> Function(Pointer<Utf8> name);
+
+typedef _LayoutGetDataNative = Pointer<Uint8> Function(Pointer<Void> layout, Pointer<Uint32> size);
+typedef _LayoutGetData = Pointer<Uint8> Function(Pointer<Void> layout, Pointer<Uint32> size);
+
+typedef _LayoutUnrefNative = Void Function(Pointer<Void> layout);
+typedef _LayoutUnref = void Function(Pointer<Void> layout);
+
+typedef _ActivateLayoutNative = Bool Function(Pointer<Utf8> name);
+typedef _ActivateLayout = bool Function(Pointer<Utf8> name);
+
+typedef _SetLanguagesNative = Bool Function(Pointer<Utf8> names);
+typedef _SetLanguages = bool Function(Pointer<Utf8> names);
+
+typedef _ChangeLanguageNative = Int32 Function(Pointer<Utf8> out, Uint32 capacity);
+typedef _ChangeLanguage = int Function(Pointer<Utf8> out, int capacity);
+
+typedef _DeleteNative = Bool Function(Uint32 unit, Uint32 count);
+typedef _Delete = bool Function(int unit, int count);
+
+typedef _DeleteSurroundingNative = Bool Function(Uint32 before, Uint32 after);
+typedef _DeleteSurrounding = bool Function(int before, int after);
+
+typedef _ComposeNative = Bool Function(Uint32 start, Uint32 end, Pointer<Utf8> text);
+typedef _Compose = bool Function(int start, int end, Pointer<Utf8> text);
+
+typedef _SetComposingCursorNative = Bool Function(Uint32 begin, Uint32 end);
+typedef _SetComposingCursor = bool Function(int begin, int end);
+
+typedef _FinishComposingNative = Bool Function(Pointer<Utf8> text);
+typedef _FinishComposing = bool Function(Pointer<Utf8> text);
+
+typedef _GetCompletionsNative = Int32 Function(Uint32 k, Pointer<Uint8> out, Uint32 capacity);
+typedef _GetCompletions = int Function(int k, Pointer<Uint8> out, int capacity);
+
+typedef _SearchEmojiNative = Int32 Function(Pointer<Utf8> query, Uint32 k, Pointer<Uint8> out, Uint32 capacity);
+typedef _SearchEmoji = int Function(Pointer<Utf8> query, int k, Pointer<Uint8> out, int capacity);
+
+typedef _ReplaceWordNative = Bool Function(Pointer<Utf8> text);
+typedef _ReplaceWord = bool Function(Pointer<Utf8> text);
+
+typedef _SetAutocorrectNative = Void Function(Bool autocorrect);
+typedef _SetAutocorrect = void Function(bool autocorrect);
+
+typedef _SetCommitOnPressNative = Void Function(Bool commitOnPress);
+typedef _SetCommitOnPress = void Function(bool commitOnPress);
+
+typedef _SetRolloverNative = Void Function(Uint32 rollover);
+typedef _SetRollover = void Function(int rollover);
+
+typedef _SetSwipeTypingNative = Void Function(Bool swipeTyping);
+typedef _SetSwipeTyping = void Function(bool swipeTyping);
+
+/// Mirrors KeebieDeleteUnit in linux/surrounding.h.
+enum KeebieDeleteUnit {
+  char,
+  word,
+  sentence,
+  selection
+}
+
+/// Direct bindings to the keebie_ffi_* symbols exported by the Linux runner.
+class KeebieNative {
+  KeebieNative._(DynamicLibrary lib)
+    : _commitText = lib.lookupFunction<_CommitTextNative, _CommitText>('keebie_ffi_commit_text'),
+      _sendKey = lib.lookupFunction<_SendKeyNative, _SendKey>('keebie_ffi_send_key'),
+      _deleteSurrounding = lib.lookupFunction<_DeleteSurroundingNative, _DeleteSurrounding>('keebie_ffi_delete_surrounding'),
+      _delete = lib.lookupFunction<_DeleteNative, _Delete>('keebie_ffi_delete'),
+      _compose = lib.lookupFunction<_ComposeNative, _Compose>('keebie_ffi_compose'),
+      _setComposingCursor = lib.lookupFunction<_SetComposingCursorNative, _SetComposingCursor>('keebie_ffi_set_composing_cursor'),
+      _finishComposing = lib.lookupFunction<_FinishComposingNative, _FinishComposing>('keebie_ffi_finish_composing'),
+      _getCompletions = lib.lookupFunction<_GetCompletionsNative, _GetCompletions>('keebie_ffi_get_completions'),
+      _searchEmoji = lib.lookupFunction<_SearchEmojiNative, _SearchEmoji>('keebie_ffi_search_emoji'),
+      _commitEmoji = lib.lookupFunction<_CommitTextNative, _CommitText>('keebie_ffi_commit_emoji'),
+      _replaceWord = lib.lookupFunction<_ReplaceWordNative, _ReplaceWord>('keebie_ffi_replace_word'),
+      _setAutocorrect = lib.lookupFunction<_SetAutocorrectNative, _SetAutocorrect>('keebie_ffi_set_autocorrect'),
+      _setCommitOnPress = lib.lookupFunction<_SetCommitOnPressNative, _SetCommitOnPress>('keebie_ffi_set_commit_on_press'),
+      _setRollover = lib.lookupFunction<_SetRolloverNative, _SetRollover>('keebie_ffi_set_rollover'),
+      _setSwipeTyping = lib.lookupFunction<_SetSwipeTypingNative, _SetSwipeTyping>('keebie_ffi_set_swipe_typing'),
+      _activateKey = lib.lookupFunction<_ActivateKeyNative, _ActivateKey>('keebie_ffi_activate_key'),
+      _pressKey = lib.lookupFunction<_ActivateKeyNative, _ActivateKey>('keebie_ffi_press_key'),
+      _releaseKey = lib.lookupFunction<_ReleaseKeyNative, _ReleaseKey>('keebie_ffi_release_key'),
+      _getGeometry = lib.lookupFunction<_GetGeometryNative, _GetGeometry>('keebie_ffi_get_geometry'),
+      _resolveTouch = lib.lookupFunction<_ResolveTouchNative, _ResolveTouch>('keebie_ffi_resolve_touch'),
+      _layoutRef = lib.lookupFunction<_LayoutRefNative, _LayoutRef>('keebie_ffi_layout_ref'),
+      _layoutGetData = lib.lookupFunction<_LayoutGetDataNative, _LayoutGetData>('keebie_ffi_layout_get_data'),
+      _layoutUnref = lib.lookupFunction<_LayoutUnrefNative, _LayoutUnref>('keebie_ffi_layout_unref'),
+      _activateLayout = lib.lookupFunction<_ActivateLayoutNative, _ActivateLayout>('keebie_ffi_activate_layout'),
+      _setLanguages = lib.lookupFunction<_SetLanguagesNative, _SetLanguages>('keebie_ffi_set_languages'),
+      _changeLanguage = lib.lookupFunction<_ChangeLanguageNative, _ChangeLanguage>('keebie_ffi_change_language');
+
+  final _CommitText _commitText;
+  final _SendKey _sendKey;
+  final _DeleteSurrounding _deleteSurrounding;
+  final _Delete _delete;
+  final _Compose _compose;
+  final _SetComposingCursor _setComposingCursor;
+  final _FinishComposing _finishComposing;
+  final _GetCompletions _getCompletions;
+  final _SearchEmoji _searchEmoji;
+  final _CommitText _commitEmoji;
+  final _ReplaceWord _replaceWord;
+  final _SetAutocorrect _setAutocorrect;
+  final _SetCommitOnPress _setCommitOnPress;
+  final _SetRollover _setRollover;
+  final _SetSwipeTyping _setSwipeTyping;
+  final _ActivateKey _activateKey;
+  final _ActivateKey _pressKey;
+  final _ReleaseKey _releaseKey;
+  final _GetGeometry _getGeometry;
+  final _ResolveTouch _resolveTouch;
+  final _LayoutRef _layoutRef;
+  final _LayoutGetData _layoutGetData;
+  final _LayoutUnref _layoutUnref;
+  final _ActivateLayout _activateLayout;
+  final _SetLanguages _setLanguages;
+  final _ChangeLanguage _changeLanguage;
+
+  Pointer<Float> _geometryBuffer = nullptr;
+  int _geometryCapacity = 0;
+
+  static bool _isLoaded = false;
+  static KeebieNative? _instance;
+
+  static KeebieNative? get instance {
+    if (!_isLoaded) {
+      _isLoaded = true;
+
+      if (!kIsWeb && defaultTargetPlatform == TargetPlatform.linux) {
+        try {
+          _instance = KeebieNative._(DynamicLibrary.process());
+        } on ArgumentError {
+          _instance = null;
+        }
+      }
+    }
+    return _instance;
+  }
+
+  bool commitText(String text) {
+    final ptr = text.toNativeUtf8();
+    try {
+      return _commitText(ptr);
+    } finally {
+      malloc.free(ptr);
+    }
+  }
+
+  bool sendKey(int key) => _sendKey(key);
+
+  bool deleteSurrounding(int before, int after) => _deleteSurrounding(before, after);
+
+  /// Deletes whole words, sentences or the selection as one request.
+  bool delete(KeebieDeleteUnit unit, {int count = 1}) => _delete(unit.index, count);
+
+  /// Replaces [start, end) of the composition with [text], offsets are
+  /// indices into the composing string.
+  bool compose(int start, int end, String text) {
+    final ptr = text.toNativeUtf8();
+    try {
+      return _compose(start, end, ptr);
+    } finally {
+      malloc.free(ptr);
+    }
+  }
+
+  bool setComposingCursor(int begin, int end) => _setComposingCursor(begin, end);
+
+  /// Commits [text] in place of the composition, or the composition itself
+  /// when it is null.
+  bool finishComposing([String? text]) {
+    final ptr = text == null ? nullptr : text.toNativeUtf8();
+    try {
+      return _finishComposing(ptr);
+    } finally {
+      if (ptr != nullptr) malloc.free(ptr);
+    }
+  }
+
+  /// Reads the NUL terminated strings [fill] packs into a buffer, growing it
+  /// until they fit. Null when [fill] has nothing to give.
+  static List<String>? _readStrings(int Function(Pointer<Uint8> out, int capacity) fill) {
+    var capacity = 256;
+    while (true) {
+      final out = malloc<Uint8>(capacity);
+      try {
+        final size = fill(out, capacity);
+        if (size < 0) return null;
+        if (size > capacity) {
+          capacity = size;
+          continue;
+        }
+
+        final bytes = out.asTypedList(size);
+        final strings = <String>[];
+        var start = 0;
+        for (var i = 0; i < size; i++) {
+          if (bytes[i] != 0) continue;
+          strings.add(utf8.decode(bytes.sublist(start, i)));
+          start = i + 1;
+        }
+        return strings;
+      } finally {
+        malloc.free(out);
+      }
+    }
+  }
+
+  /// Completes the word being typed from the runner's dictionary for the
+  /// current language, most likely first. Null when there is no dictionary or
+  /// no word at the cursor.
+  List<String>? getCompletions(int k) =>
+    _readStrings((out, capacity) => _getCompletions(k, out, capacity));
+
+  /// Searches the current language's emoji catalog, an empty [query] browses
+  /// it. Null when the language has none.
+  List<String>? searchEmoji(String query, int k) {
+    final ptr = query.toNativeUtf8();
+    try {
+      return _readStrings((out, capacity) => _searchEmoji(ptr, k, out, capacity));
+    } finally {
+      malloc.free(ptr);
+    }
+  }
+
+  /// Commits a picked emoji, the runner remembers it for later searches.
+  bool commitEmoji(String text) {
+    final ptr = text.toNativeUtf8();
+    try {
+      return _commitEmoji(ptr);
+    } finally {
+      malloc.free(ptr);
+    }
+  }
+
+  /// Replaces the word being typed with [text], composing or not.
+  bool replaceWord(String text) {
+    final ptr = text.toNativeUtf8();
+    try {
+      return _replaceWord(ptr);
+    } finally {
+      malloc.free(ptr);
+    }
+  }
+
+  void setAutocorrect(bool autocorrect) => _setAutocorrect(autocorrect);
+
+  void setCommitOnPress(bool commitOnPress) => _setCommitOnPress(commitOnPress);
+
+  void setRollover(int rollover) => _setRollover(rollover);
+
+  void setSwipeTyping(bool swipeTyping) => _setSwipeTyping(swipeTyping);
+
+  /// Queues the key from the announced layout, the runner's action table is
+  /// the single source of truth for what a key does. False when the key does
+  /// nothing there.
+  bool activateKey(int plane, int row, int key, bool isShifted) => _activateKey(plane, row, key, isShifted) >= 0;
+
+  /// Performs the key and keeps repeating it in the runner at the compositor's
+  /// repeat rate until [releaseKey], holding a key costs no calls per repeat.
+  bool pressKey(int plane, int row, int key, bool isShifted) => _pressKey(plane, row, key, isShifted) >= 0;
+
+  /// Stops the repeat if the key is the one still held, a later press already
+  /// stopped it otherwise.
+  void releaseKey(int plane, int row, int key) => _releaseKey(plane, row, key);
+
+  /// Decodes the compiled layout straight out of the runner's mapping, the
+  /// mapping is only referenced while decoding since nothing keeps a view on
+  /// it afterwards.
+  KeyboardLayout? loadLayout(String name) {
+    final namePtr = name.toNativeUtf8();
+    final layout = _layoutRef(namePtr);
+    malloc.free(namePtr);
+    if (layout == nullptr) return null;
+
+    final sizePtr = malloc<Uint32>();
+    try {
+      final data = _layoutGetData(layout, sizePtr);
+      return KeyboardLayout.fromBinary(ByteData.sublistView(data.asTypedList(sizePtr.value)), name: name);
+    } finally {
+      malloc.free(sizePtr);
+      _layoutUnref(layout);
+    }
+  }
+
+  /// Makes a compiled layout the runner's action table by name, this is what
+  /// announcing a layout comes down to when it came from getLayout.
+  bool activateLayout(String name) {
+    final ptr = name.toNativeUtf8();
+    try {
+      return _activateLayout(ptr);
+    } finally {
+      malloc.free(ptr);
+    }
+  }
+
+  bool setLanguages(List<String> names) {
+    final ptr = names.join(',').toNativeUtf8();
+    try {
+      return _setLanguages(ptr);
+    } finally {
+      malloc.free(ptr);
+    }
+  }
+
+  /// Swaps to the next preloaded language and returns its layout name.
+  String? changeLanguage() {
+    const capacity = 256;
+    final out = malloc<Uint8>(capacity);
+    try {
+      final length = _changeLanguage(out.cast(), capacity);
+      if (length < 0 || length >= capacity) return null;
+      return out.cast<Utf8>().toDartString(length: length);
+    } finally {
+      malloc.free(out);
+    }
+  }
+
+  /// Fetches the memoized key rects of the announced layout, null when the
+  /// runner has no layout yet.
+  KeyboardGeometry? getGeometry(int plane, int constraints, double childSize, double padding, Size monitorSize) {
+    var count = _getGeometry(plane, constraints, childSize, padding, monitorSize.width, monitorSize.height, _geometryBuffer, _geometryCapacity);
+    if (count < 0) return null;
+
+    if (2 + count * 6 > _geometryCapacity) {
+      if (_geometryBuffer != nullptr) malloc.free(_geometryBuffer);
+
+      _geometryCapacity = 2 + count * 6;
+      _geometryBuffer = malloc<Float>(_geometryCapacity);
+
+      count = _getGeometry(plane, constraints, childSize, padding, monitorSize.width, monitorSize.height, _geometryBuffer, _geometryCapacity);
+      if (count < 0 || 2 + count * 6 > _geometryCapacity) return null;
+    }
+
+    final values = _geometryBuffer.asTypedList(2 + count * 6);
+    return KeyboardGeometry(
+      Size(values[0], values[1]),
+      List.generate(count, (i) {
+        final offset = 2 + i * 6;
+        return KeyboardKeyRect(
+          Rect.fromLTWH(values[offset], values[offset + 1], values[offset + 2], values[offset + 3]),
+          rowNo: values[offset + 4].toInt(),
+          keyNo: values[offset + 5].toInt(),
+        );
+      }),
+    );
+  }
+
+  /// The index of the key a touch at [position] within the plane was meant
+  /// for among the keys [getGeometry] returns for the same arguments, null
+  /// when the runner has no layout yet.
+  int? resolveTouch(int plane, int constraints, double childSize, double padding, Size monitorSize, Offset position) {
+    final index = _resolveTouch(plane, constraints, childSize, padding, monitorSize.width, monitorSize.height, position.dx, position.dy);
+    return index < 0 ? null : index;
+  }
+}
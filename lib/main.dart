@@ -133,6 +133,10 @@ class _KeebieAppState extends State<KeebieApp> {
 
   void _loadSettings() {
     colorScheme = ColorScheme.values.asNameMap()[preferences.getString(KeebieSettings.colorScheme.name) ?? 'night']!;
+    Keebie.autocorrect = KeebieSettings.autocorrect.valueFor(preferences);
+    Keebie.commitOnPress = KeebieSettings.commitOnPress.valueFor(preferences);
+    Keebie.rollover = KeebieSettings.rollover.valueFor(preferences);
+    Keebie.swipeTyping = KeebieSettings.swipeTyping.valueFor(preferences);
   }
 
   Future<void> reload() async {
@@ -157,11 +161,19 @@ class _KeebieAppState extends State<KeebieApp> {
       ] : null,
       routes: {
         '/settings': (context) => const SettingsView(),
-        '/keyboard/en': (context) => const KeyboardView(name: 'en'),
-        '/keyboard/ja': (context) => const KeyboardView(name: 'ja'),
 
         // TODO: support using method channel to retrieve a "better" name
         '/keyboard': (context) => KeyboardView(name: Localizations.localeOf(context).languageCode),
       },
+      onGenerateRoute: (settings) {
+        // Any installed layout is routable, the runner resolves the name.
+        final name = settings.name ?? '';
+        if (!name.startsWith('/keyboard/') || name.length == '/keyboard/'.length) return null;
+
+        return MaterialPageRoute(
+          settings: settings,
+          builder: (context) => KeyboardView(name: name.substring('/keyboard/'.length)),
+        );
+      },
     );
 }
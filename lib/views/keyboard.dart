@@ -38,7 +38,8 @@ class _KeyboardViewState extends State<KeyboardView> {
                   icon: const Icon(Icons.settings),
                   onPressed: () => Keebie.openWindow(keyboard: false)
                     .catchError((error, trace) => handleError(error, trace: trace)),
-                )
+                ),
+                const Expanded(child: CandidateBar()),
               ],
             ),
           ),
@@ -18,6 +18,10 @@ class SettingsView extends StatefulWidget {
 class _SettingsViewState extends State<SettingsView> {
   late SharedPreferences preferences;
   bool optInErrorReporting = false;
+  bool autocorrect = true;
+  bool commitOnPress = true;
+  int rollover = 150;
+  bool swipeTyping = true;
   ColorScheme colorScheme = ColorScheme.night;
 
   @override
@@ -32,6 +36,10 @@ class _SettingsViewState extends State<SettingsView> {
 
   void _loadSettings() {
     optInErrorReporting = KeebieSettings.optInErrorReporting.valueFor(preferences);
+    autocorrect = KeebieSettings.autocorrect.valueFor(preferences);
+    commitOnPress = KeebieSettings.commitOnPress.valueFor(preferences);
+    rollover = KeebieSettings.rollover.valueFor(preferences);
+    swipeTyping = KeebieSettings.swipeTyping.valueFor(preferences);
     colorScheme = ColorScheme.values.asNameMap()[preferences.getString(KeebieSettings.colorScheme.name) ?? 'night']!;
   }
 
@@ -141,6 +149,64 @@ class _SettingsViewState extends State<SettingsView> {
                       ),
                 ),
             ),
+            SwitchListTile(
+              title: Text(AppLocalizations.of(context)!.settingsAutocorrect),
+              subtitle: Text(AppLocalizations.of(context)!.settingsAutocorrectSubtitle),
+              value: autocorrect,
+              onChanged: (value) => preferences.setBool(KeebieSettings.autocorrect.name, value).then((v) {
+                setState(() {
+                  autocorrect = value;
+                });
+                Keebie.announceSettingsChange();
+              }).catchError((error) {
+                _handleError(context, error);
+              }),
+            ),
+            SwitchListTile(
+              title: Text(AppLocalizations.of(context)!.settingsCommitOnPress),
+              subtitle: Text(AppLocalizations.of(context)!.settingsCommitOnPressSubtitle),
+              value: commitOnPress,
+              onChanged: (value) => preferences.setBool(KeebieSettings.commitOnPress.name, value).then((v) {
+                setState(() {
+                  commitOnPress = value;
+                });
+                Keebie.announceSettingsChange();
+              }).catchError((error) {
+                _handleError(context, error);
+              }),
+            ),
+            ListTile(
+              enabled: !commitOnPress,
+              title: Text(AppLocalizations.of(context)!.settingsRollover),
+              subtitle: Slider(
+                value: rollover.toDouble(),
+                min: 0,
+                max: 300,
+                divisions: 6,
+                label: AppLocalizations.of(context)!.settingsRolloverValue(rollover),
+                onChanged: commitOnPress ? null : (value) => setState(() {
+                  rollover = value.round();
+                }),
+                onChangeEnd: (value) => preferences.setInt(KeebieSettings.rollover.name, value.round()).then((v) {
+                  Keebie.announceSettingsChange();
+                }).catchError((error) {
+                  _handleError(context, error);
+                }),
+              ),
+            ),
+            SwitchListTile(
+              title: Text(AppLocalizations.of(context)!.settingsSwipeTyping),
+              subtitle: Text(AppLocalizations.of(context)!.settingsSwipeTypingSubtitle),
+              value: swipeTyping,
+              onChanged: (value) => preferences.setBool(KeebieSettings.swipeTyping.name, value).then((v) {
+                setState(() {
+                  swipeTyping = value;
+                });
+                Keebie.announceSettingsChange();
+              }).catchError((error) {
+                _handleError(context, error);
+              }),
+            ),
             ...(const String.fromEnvironment('SENTRY_DSN', defaultValue: '').isNotEmpty ? [
               SwitchListTile(
                 title: Text(AppLocalizations.of(context)!.settingsOptInErrorReporting),
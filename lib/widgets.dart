@@ -1 +1,4 @@
-export 'widgets/keyboard.dart';
\ No newline at end of file
+export 'widgets/candidates.dart';
+export 'widgets/emoji.dart';
+export 'widgets/handwriting.dart';
+export 'widgets/keyboard.dart';
@@ -0,0 +1,105 @@
+import 'dart:async';
+import 'package:flutter/foundation.dart';
+import 'package:keebie/logic.dart';
+import 'package:libtokyo_flutter/libtokyo.dart';
+
+/// Completions of the word being typed, or what the kana being converted
+/// convert to, refreshed whenever the client reports new surrounding text.
+/// The words a swipe could be show while it lasts and right after. Tapping
+/// one replaces the word with it. While a character is handwritten, what it
+/// could be shows instead and tapping one types it.
+class CandidateBar extends StatefulWidget {
+  const CandidateBar({ super.key, this.count = 3 });
+
+  final int count;
+
+  @override
+  State<CandidateBar> createState() => _CandidateBarState();
+}
+
+class _CandidateBarState extends State<CandidateBar> {
+  StreamSubscription<KeebieInputMethodState>? _inputMethodState;
+  StreamSubscription<KeebieSwipeCandidates>? _swipeCandidates;
+  StreamSubscription<KeebieHandwritingCandidates>? _handwritingCandidates;
+  List<String> _candidates = const [];
+  bool _isHandwriting = false;
+  bool _isSwiping = false;
+  String? _swiped;
+
+  @override
+  void initState() {
+    super.initState();
+
+    _inputMethodState = Keebie.onInputMethodState.listen((state) {
+      // The other words a swipe could have been stay up until the text moves
+      // past the one it typed.
+      if (_isSwiping || _isHandwriting || (_swiped != null && _endsWith(state, _swiped!))) return;
+      _swiped = null;
+
+      final candidates = state.isActive ? Keebie.completions(k: widget.count) : const <String>[];
+      if (listEquals(candidates, _candidates)) return;
+
+      setState(() {
+        _candidates = candidates;
+      });
+    }, onError: (error, trace) {
+      handleError(error, trace: trace);
+    });
+
+    _swipeCandidates = Keebie.onSwipeCandidates.listen((candidates) {
+      setState(() {
+        _isSwiping = !candidates.isFinal;
+        _swiped = candidates.isFinal && candidates.words.isNotEmpty ? candidates.words.first : null;
+        _candidates = candidates.words.take(widget.count).toList();
+      });
+    }, onError: (error, trace) {
+      handleError(error, trace: trace);
+    });
+
+    // Cleared strokes give the bar back to completions on the next change.
+    _handwritingCandidates = Keebie.onHandwritingCandidates.listen((candidates) {
+      setState(() {
+        _isHandwriting = candidates.strokes > 0;
+        _candidates = candidates.characters.take(widget.count).toList();
+      });
+    }, onError: (error, trace) {
+      handleError(error, trace: trace);
+    });
+  }
+
+  void _accept(String candidate) {
+    if (_isHandwriting) {
+      Keebie.acceptHandwriting(candidate).catchError((error, trace) => handleError(error, trace: trace));
+    } else {
+      Keebie.acceptCompletion(candidate);
+    }
+  }
+
+  static bool _endsWith(KeebieInputMethodState state, String word) {
+    final text = state.surroundingText;
+    if (text == null || state.cursor > text.length) return false;
+    return text.substring(0, state.cursor).toLowerCase().endsWith(word.toLowerCase());
+  }
+
+  @override
+  void dispose() {
+    _inputMethodState?.cancel();
+    _swipeCandidates?.cancel();
+    _handwritingCandidates?.cancel();
+    super.dispose();
+  }
+
+  @override
+  Widget build(BuildContext context) =>
+    Row(
+      children: [
+        for (final candidate in _candidates)
+          Expanded(
+            child: TextButton(
+              onPressed: () => _accept(candidate),
+              child: Text(candidate, overflow: TextOverflow.ellipsis),
+            ),
+          ),
+      ],
+    );
+}
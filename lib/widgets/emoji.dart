@@ -0,0 +1,129 @@
+import 'package:keebie/logic.dart';
+import 'package:libtokyo_flutter/libtokyo.dart';
+
+/// Emoji and symbols of the current language's catalog to pick from, the
+/// ones picked most and lately first. The runner searches the catalog
+/// itself, so every keystroke of a [query] is a synchronous lookup. While
+/// searching only a single row of results shows, the keys below type the
+/// query.
+class EmojiPicker extends StatefulWidget {
+  const EmojiPicker({
+    super.key,
+    required this.size,
+    required this.childSize,
+    this.query,
+    this.onSearch,
+    this.onPicked,
+  });
+
+  final Size size;
+  final double childSize;
+
+  /// What is being searched for, null while browsing.
+  final String? query;
+  final VoidCallback? onSearch;
+  final ValueChanged<String>? onPicked;
+
+  @override
+  State<EmojiPicker> createState() => _EmojiPickerState();
+}
+
+class _EmojiPickerState extends State<EmojiPicker> {
+  List<String> _results = const [];
+
+  @override
+  void initState() {
+    super.initState();
+    _search();
+  }
+
+  @override
+  void didUpdateWidget(EmojiPicker oldWidget) {
+    super.didUpdateWidget(oldWidget);
+    if (oldWidget.query != widget.query) _search();
+  }
+
+  // Browsing lists the whole catalog and keeps its order until the picker
+  // is shown again, picks only move up the next time.
+  void _search() {
+    final query = widget.query?.trim() ?? '';
+    _results = Keebie.searchEmoji(query, k: query.isEmpty ? 1024 : 64);
+  }
+
+  void _pick(String text) {
+    if (!Keebie.commitEmoji(text)) return;
+    widget.onPicked?.call(text);
+  }
+
+  Widget _buildItem(BuildContext context, String text) =>
+    InkWell(
+      borderRadius: BorderRadius.circular(8.0),
+      onTap: () => _pick(text),
+      child: Center(
+        child: Text(
+          text,
+          style: TextStyle(fontSize: widget.childSize * 1.4),
+        ),
+      ),
+    );
+
+  @override
+  Widget build(BuildContext context) {
+    final extent = widget.childSize * 2.5;
+
+    if (widget.query != null) {
+      return SizedBox(
+        width: widget.size.width,
+        height: widget.size.height,
+        child: Column(
+          children: [
+            Row(
+              children: [
+                const Icon(Icons.search),
+                Expanded(
+                  child: Text(
+                    widget.query!,
+                    maxLines: 1,
+                    overflow: TextOverflow.ellipsis,
+                    style: Theme.of(context).textTheme.labelLarge,
+                  ),
+                ),
+              ],
+            ),
+            Expanded(
+              child: ListView(
+                scrollDirection: Axis.horizontal,
+                itemExtent: extent,
+                children: _results.map((text) => _buildItem(context, text)).toList(),
+              ),
+            ),
+          ],
+        ),
+      );
+    }
+
+    return SizedBox(
+      width: widget.size.width,
+      height: widget.size.height,
+      child: Row(
+        children: [
+          Expanded(
+            child: GridView.extent(
+              maxCrossAxisExtent: extent,
+              children: _results.map((text) => _buildItem(context, text)).toList(),
+            ),
+          ),
+          Column(
+            mainAxisAlignment: MainAxisAlignment.start,
+            children: [
+              IconButton(
+                icon: const Icon(Icons.search),
+                onPressed: widget.onSearch,
+              ),
+            ],
+          ),
+        ],
+      ),
+    );
+  }
+}
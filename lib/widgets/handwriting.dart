@@ -0,0 +1,168 @@
+import 'dart:async';
+import 'package:keebie/logic.dart';
+import 'package:libtokyo_flutter/libtokyo.dart';
+
+/// A pad to write a character on, stroke by stroke. The runner sees the same
+/// touches and recognizes them itself, the pad only draws the ink and tells
+/// it where it is laid out. Candidates show in the CandidateBar.
+class HandwritingPad extends StatefulWidget {
+  const HandwritingPad({ super.key, required this.size });
+
+  final Size size;
+
+  @override
+  State<HandwritingPad> createState() => _HandwritingPadState();
+}
+
+class _HandwritingPadState extends State<HandwritingPad> {
+  final _surfaceKey = GlobalKey();
+  Rect? _surface;
+  final _strokes = <List<Offset>>[];
+  bool _isWriting = false;
+  StreamSubscription<KeebieHandwritingCandidates>? _candidates;
+
+  @override
+  void initState() {
+    super.initState();
+
+    // Accepting a character or switching languages clears the strokes.
+    _candidates = Keebie.onHandwritingCandidates.listen((candidates) {
+      if (candidates.strokes > 0 || _isWriting || _strokes.isEmpty) return;
+      setState(() {
+        _strokes.clear();
+      });
+    }, onError: (error, trace) {
+      handleError(error, trace: trace);
+    });
+  }
+
+  @override
+  void dispose() {
+    _candidates?.cancel();
+    if (_surface != null) {
+      Keebie.announceHandwritingSurface(null).catchError((error, trace) {
+        handleError(error, trace: trace);
+        return false;
+      });
+    }
+    super.dispose();
+  }
+
+  /// Tells the runner where the pad is, again whenever it moved.
+  void _announceSurface() {
+    final box = _surfaceKey.currentContext?.findRenderObject() as RenderBox?;
+    if (!mounted || box == null || !box.hasSize) return;
+
+    final surface = box.localToGlobal(Offset.zero) & box.size;
+    if (surface == _surface) return;
+    _surface = surface;
+
+    Keebie.announceHandwritingSurface(surface).catchError((error, trace) {
+      handleError(error, trace: trace);
+      return false;
+    });
+  }
+
+  void _undo() {
+    if (_strokes.isEmpty) return;
+    setState(() {
+      _strokes.removeLast();
+    });
+    Keebie.undoHandwritingStroke().catchError((error, trace) => handleError(error, trace: trace));
+  }
+
+  void _clear() {
+    setState(() {
+      _strokes.clear();
+    });
+    Keebie.clearHandwriting().catchError((error, trace) => handleError(error, trace: trace));
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    WidgetsBinding.instance.addPostFrameCallback((_) => _announceSurface());
+
+    final color = Theme.of(context).colorScheme.primary;
+    return SizedBox(
+      width: widget.size.width,
+      height: widget.size.height,
+      child: Row(
+        children: [
+          Expanded(
+            child: Listener(
+              key: _surfaceKey,
+              behavior: HitTestBehavior.opaque,
+              onPointerDown: (event) => setState(() {
+                _isWriting = true;
+                _strokes.add([event.localPosition]);
+              }),
+              onPointerMove: (event) {
+                if (!_isWriting) return;
+                setState(() {
+                  _strokes.last.add(event.localPosition);
+                });
+              },
+              onPointerUp: (event) => _isWriting = false,
+              // The runner drops cancelled strokes too.
+              onPointerCancel: (event) => setState(() {
+                if (_isWriting) _strokes.removeLast();
+                _isWriting = false;
+              }),
+              child: Material(
+                shape: RoundedRectangleBorder(
+                  borderRadius: BorderRadius.circular(8.0),
+                ),
+                color: ButtonTheme.of(context).colorScheme!.onSurface,
+                child: CustomPaint(
+                  painter: _InkPainter(_strokes, color),
+                ),
+              ),
+            ),
+          ),
+          Column(
+            mainAxisAlignment: MainAxisAlignment.spaceEvenly,
+            children: [
+              IconButton(
+                icon: const Icon(Icons.undo),
+                onPressed: _strokes.isEmpty ? null : _undo,
+              ),
+              IconButton(
+                icon: const Icon(Icons.clear),
+                onPressed: _strokes.isEmpty ? null : _clear,
+              ),
+            ],
+          ),
+        ],
+      ),
+    );
+  }
+}
+
+class _InkPainter extends CustomPainter {
+  const _InkPainter(this.strokes, this.color);
+
+  final List<List<Offset>> strokes;
+  final Color color;
+
+  @override
+  void paint(Canvas canvas, Size size) {
+    final paint = Paint()
+      ..color = color
+      ..style = PaintingStyle.stroke
+      ..strokeWidth = 4.0
+      ..strokeCap = StrokeCap.round
+      ..strokeJoin = StrokeJoin.round;
+
+    for (final stroke in strokes) {
+      if (stroke.length == 1) {
+        canvas.drawCircle(stroke.first, paint.strokeWidth / 2, Paint()..color = color);
+      } else {
+        canvas.drawPath(Path()..addPolygon(stroke, false), paint);
+      }
+    }
+  }
+
+  // The strokes are added to in place, so there is nothing to compare.
+  @override
+  bool shouldRepaint(_InkPainter oldDelegate) => true;
+}
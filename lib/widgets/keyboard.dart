@@ -1,17 +1,26 @@
+import 'dart:async';
 import 'package:flutter/services.dart' hide KeyboardKey;
+import 'package:keebie/constants.dart';
 import 'package:keebie/main.dart';
 import 'package:libtokyo_flutter/libtokyo.dart';
 import 'package:keebie/logic.dart';
+import 'package:keebie/widgets/emoji.dart';
+import 'package:keebie/widgets/handwriting.dart';
 import 'package:flutter_gen/gen_l10n/app_localizations.dart';
 
 Future<KeyboardLayout> Function() onLayoutAsset(String name) =>
-    () async => KeyboardLayout.fromJson(await rootBundle.loadString('assets/keyboards/$name.json'));
+    () async {
+      final layout = KeebieNative.instance?.loadLayout(name);
+      if (layout != null) return layout;
+      return KeyboardLayout.fromJson(await rootBundle.loadString('assets/keyboards/$name.json'), name: name);
+    };
 
 class Keyboard extends StatefulWidget {
   const Keyboard({
     super.key,
     this.layout,
     this.onLayout,
+    this.name,
     this.plane = 0,
     this.contentType,
     this.onSize,
@@ -25,11 +34,11 @@ class Keyboard extends StatefulWidget {
     this.contentType,
     this.onSize,
     this.isShifted = false
-  }) : layout = KeyboardLayout.fromJson(json), onLayout = null;
+  }) : layout = KeyboardLayout.fromJson(json), onLayout = null, name = null;
 
   Keyboard.asset({
     super.key,
-    required String name,
+    required String this.name,
     this.plane = 0,
     this.contentType,
     this.onSize,
@@ -38,6 +47,8 @@ class Keyboard extends StatefulWidget {
     : layout = null,
       onLayout = onLayoutAsset(name);
 
+  /// The layout onLayout loads, reloaded whenever the runner recompiles it.
+  final String? name;
   final int plane;
   final bool isShifted;
   final KeyboardContentType? contentType;
@@ -53,33 +64,277 @@ class _KeyboardState extends State<Keyboard> {
   late int plane;
   late bool isShifted;
   bool isAnnounced = false;
+  /// Per key the touch landed on, the key it was resolved to, whether its
+  /// press already went out natively and whether it is still the one repeating.
+  /// Touches overlap while typing fast.
+  final _touches = <KeyboardKeyRect, ({KeyboardKeyRect touched, bool isPressed, bool isHeld})>{};
+  final _surfaceKey = GlobalKey();
+  Object? _touchSurface;
+  final _pressed = <(int, int, int)>{};
+  StreamSubscription<KeebieKeyFeedback>? _keyFeedback;
+  Future<KeyboardLayout>? _layout;
+  String? _name;
+  KeyboardLayout? _switchedLayout;
+  final _layouts = <String, KeyboardLayout>{};
+  KeyboardLayout? _geometryLayout;
+  final _geometry = <(int, double, Rect, int, bool), KeyboardGeometry>{};
   KeyboardContentType? contentType;
   List<KeyboardKeyConstraint> constraints = <KeyboardKeyConstraint>[];
+  StreamSubscription<String>? _layoutChanged;
+  StreamSubscription<KeebieInputMethodState>? _inputMethodState;
+  KeyboardContentType? _imContentType;
+  StreamSubscription<Rect>? _monitorChanged;
+  Rect? _monitorGeometry;
+  String? _emojiQuery;
 
   @override
   void initState() {
     super.initState();
 
+    _name = widget.name;
+    _layoutChanged = Keebie.onLayoutChanged.listen((name) {
+      _layouts.remove(name);
+      if (name != _name || widget.onLayout == null) return;
+
+      // The runner already swapped its action table, only the keys need rebuilding.
+      setState(() {
+        _switchedLayout = null;
+        _layout = _loadLayout();
+      });
+    });
+
+    if (widget.name != null) {
+      KeebieSettings.languages.value.then((value) {
+        final names = value.split(',').where((name) => name.isNotEmpty).toList();
+        Keebie.languages = names;
+        setState(() {
+          constraints = [
+            if (names.length > 1) KeyboardKeyConstraint.canChangeLanguage,
+          ];
+        });
+      }).catchError((error, trace) {
+        handleError(error, trace: trace);
+      });
+    }
+
+    // Fetched once, after that the runner pushes changes.
+    _monitorGeometry = Keebie.cachedMonitorGeometry;
+    _monitorChanged = Keebie.onMonitorGeometry.listen((value) {
+      setState(() {
+        _monitorGeometry = value;
+      });
+    });
+    if (_monitorGeometry == null) {
+      Keebie.monitorGeometry.then((value) => setState(() {
+        _monitorGeometry = value;
+      })).catchError((error, trace) {
+        handleError(error, trace: trace);
+      });
+    }
+
+    // Touches the runner typed by itself, only the feedback is left to draw.
+    _keyFeedback = Keebie.onKeyFeedback.listen((feedback) {
+      final key = (feedback.plane, feedback.rowNo, feedback.keyNo);
+      setState(() {
+        if (feedback.isPressed) {
+          _pressed.add(key);
+        } else {
+          _pressed.remove(key);
+        }
+        if (feedback.isCommitted) isShifted = false;
+      });
+    });
+
     plane = widget.plane;
     isShifted = widget.isShifted;
     contentType = widget.contentType;
 
-    Keebie.constraints.then((value) => setState(() {
-      constraints = value;
-    })).catchError((error, trace) {
-      handleError(error, trace: trace);
-    });
-
     if (contentType == null) {
-      Keebie.contentType.then((value) => setState(() {
-        contentType = value;
-      })).catchError((error, trace) {
+      _inputMethodState = Keebie.onInputMethodState.listen(_onInputMethodState, onError: (error, trace) {
         handleError(error, trace: trace);
       });
     }
   }
 
-  Widget buildKey(BuildContext context, KeyboardLayout layout, KeyboardKey key, int rowNo, int keyNo, Rect monitorGeometry) {
+  /// Jumps to the plane the layout maps the field's content type to, the
+  /// user can still switch planes away from it afterwards.
+  Future<void> _onInputMethodState(KeebieInputMethodState state) async {
+    if (!state.isActive || state.contentType == _imContentType) return;
+    _imContentType = state.contentType;
+
+    final layout = _switchedLayout ?? await (_layout ??= _loadLayout());
+    if (!mounted || state.contentType != _imContentType) return;
+
+    setState(() {
+      plane = layout.contentPlaneMap[state.contentType] ?? widget.plane;
+      isShifted = false;
+    });
+  }
+
+  Future<KeyboardLayout> _loadLayout() =>
+    _name == null || _name == widget.name ? widget.onLayout!() : onLayoutAsset(_name!)();
+
+  /// Switches to the next enabled language, the runner has every one of them
+  /// preloaded so this is decoding at most once and a rebuild.
+  bool changeLanguage() {
+    final name = Keebie.changeLanguage();
+    if (name == null) return false;
+
+    final layout = _layouts[name] ??= KeebieNative.instance?.loadLayout(name);
+    setState(() {
+      _name = name;
+      plane = widget.plane;
+      isShifted = false;
+      _switchedLayout = layout;
+      _layout = layout == null ? _loadLayout() : null;
+    });
+    return true;
+  }
+
+  @override
+  void dispose() {
+    _layoutChanged?.cancel();
+    _inputMethodState?.cancel();
+    _monitorChanged?.cancel();
+    _keyFeedback?.cancel();
+    _withdrawTouchSurface();
+    super.dispose();
+  }
+
+  KeyboardGeometry getGeometry(KeyboardLayout layout, int planeNo, double childSize, Rect monitorGeometry) {
+    final key = (planeNo, childSize, monitorGeometry, Object.hashAll(constraints), isAnnounced);
+
+    if (!identical(_geometryLayout, layout)) {
+      _geometryLayout = layout;
+      _geometry.clear();
+    }
+
+    return _geometry.putIfAbsent(key, () => KeyboardGeometry.solve(
+      layout.getPlane(planeNo),
+      planeNo: planeNo,
+      childSize: childSize,
+      monitorGeometry: monitorGeometry,
+      constraints: constraints,
+      isAnnounced: isAnnounced,
+    ));
+  }
+
+  // Plane, shift and changeLang are toggles, everything else repeats while held.
+  static bool _isRepeatable(KeyboardKey key) =>
+    key.type != KeyboardKeyType.plane && key.type != KeyboardKeyType.shift && key.type != KeyboardKeyType.changeLang;
+
+  static void _releaseKey(int planeNo, KeyboardKeyRect touched) =>
+    Keebie.releaseKey(plane: planeNo, rowNo: touched.rowNo, keyNo: touched.keyNo);
+
+  /// Types into the emoji search rather than the text, returns false for
+  /// keys which act the same either way.
+  bool _editEmojiQuery(KeyboardKey key) {
+    final query = _emojiQuery!;
+    switch (key.type) {
+      case KeyboardKeyType.regular:
+        final text = isShifted && key.shiftedName.isNotEmpty ? key.shiftedName : key.name;
+        setState(() {
+          _emojiQuery = query + text;
+          isShifted = false;
+        });
+        return true;
+      case KeyboardKeyType.space:
+        setState(() {
+          _emojiQuery = '$query ';
+        });
+        return true;
+      case KeyboardKeyType.backspace:
+        setState(() {
+          _emojiQuery = query.characters.skipLast(1).toString();
+        });
+        return true;
+      case KeyboardKeyType.enter:
+        setState(() {
+          _emojiQuery = null;
+        });
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  void _activateKey(KeyboardKey key, int planeNo, KeyboardKeyRect rect, {bool isPressed = false}) {
+    if (_emojiQuery != null && _editEmojiQuery(key)) return;
+
+    switch (key.type) {
+      case KeyboardKeyType.plane:
+        setState(() {
+          plane = key.plane!;
+          isShifted = false;
+          _emojiQuery = null;
+        });
+        break;
+      case KeyboardKeyType.shift:
+        setState(() {
+          isShifted = !isShifted;
+        });
+        break;
+      case KeyboardKeyType.changeLang:
+        // Natively the key would switch languages again behind our back.
+        if (!changeLanguage() && KeebieNative.instance == null) {
+          Keebie.sendKey(key,
+            isShifted: isShifted,
+            plane: planeNo,
+            rowNo: rect.rowNo,
+            keyNo: rect.keyNo,
+          ).catchError((error, trace) => handleError(error, trace: trace));
+        }
+        break;
+      default:
+        // The press already went out natively when the key went down.
+        if (!isPressed) {
+          Keebie.sendKey(key,
+            isShifted: isShifted,
+            plane: planeNo,
+            rowNo: rect.rowNo,
+            keyNo: rect.keyNo,
+          ).catchError((error, trace) => handleError(error, trace: trace));
+        }
+
+        if (isShifted) {
+          setState(() {
+            isShifted = false;
+          });
+        }
+        break;
+    }
+  }
+
+  /// Takes touches back from the runner, keys then only type through Flutter.
+  void _withdrawTouchSurface() {
+    if (_touchSurface == null) return;
+    _touchSurface = null;
+    Keebie.announceTouchSurface(null).catchError((error, trace) => handleError(error, trace: trace));
+  }
+
+  /// Hands the laid out keys to the runner, again whenever they moved or
+  /// anything typing them depends on changed.
+  void _announceTouchSurface(KeyboardGeometry geometry, int planeNo, double childSize, Rect monitorGeometry) {
+    final box = _surfaceKey.currentContext?.findRenderObject() as RenderBox?;
+    if (!mounted || box == null || !box.hasSize) return;
+
+    final origin = box.localToGlobal(Offset.zero);
+    final surface = (geometry, origin, isShifted);
+    if (surface == _touchSurface) return;
+    _touchSurface = surface;
+
+    geometry.announceTouchSurface(origin,
+      planeNo: planeNo,
+      childSize: childSize,
+      monitorGeometry: monitorGeometry,
+      constraints: constraints,
+      isShifted: isShifted,
+    ).catchError((error, trace) => handleError(error, trace: trace));
+  }
+
+  Widget buildKey(BuildContext context, List<KeyboardRow> rows, KeyboardGeometry geometry, int planeNo, KeyboardKeyRect rect, double childSize, Rect monitorGeometry) {
+    final key = rows[rect.rowNo].keyAt(rect.keyNo);
+
     var textColor = Theme.of(context).colorScheme.primary;
     var backgroundColor = ButtonTheme.of(context).colorScheme!.onSurface;
 
@@ -88,9 +343,13 @@ class _KeyboardState extends State<Keyboard> {
       backgroundColor = ButtonTheme.of(context).colorScheme!.onSecondary;
     }
 
+    if (_pressed.contains((planeNo, rect.rowNo, rect.keyNo))) {
+      backgroundColor = Color.alphaBlend(Theme.of(context).highlightColor, backgroundColor);
+    }
+
     final textStyle = Theme.of(context).textTheme.labelSmall!.copyWith(
       color: textColor,
-      fontSize: key.getChildSize(context, isShifted, monitorGeometry).height,
+      fontSize: childSize,
     );
 
     Widget? child;
@@ -122,111 +381,143 @@ class _KeyboardState extends State<Keyboard> {
       }
     }
 
-    final currentPlane = layout.getPlane(
-      plane,
-      contentType: contentType
-    );
-    final row = currentPlane.rows[rowNo];
-    final size = key.getContainerSize(context: context, row: row, isShifted: isShifted, monitorGeometry: monitorGeometry);
-
-    return Padding(
-      padding: KeyboardKey.padding,
+    return Positioned.fromRect(
+      rect: rect.rect,
       child: InkWell(
-        child: SizedBox(
-          height: size.height,
-          width: size.width,
-          child: Material(
-            shape: RoundedRectangleBorder(
-              borderRadius: BorderRadius.circular(8.0),
-            ),
-            color: backgroundColor,
-            child: Center(child: child),
+        child: Material(
+          shape: RoundedRectangleBorder(
+            borderRadius: BorderRadius.circular(8.0),
           ),
+          color: backgroundColor,
+          child: Center(child: child),
         ),
-        onTap: () {
-          switch (key.type) {
-            case KeyboardKeyType.plane:
-              setState(() {
-                plane = key.plane!;
-                isShifted = false;
-              });
-              break;
-            case KeyboardKeyType.shift:
-              setState(() {
-                isShifted = !isShifted;
-              });
-              break;
-            default:
-              setState(() {
-                Keebie.sendKey(key,
-                  isShifted: isShifted,
-                  rowNo: rowNo,
-                  keyNo: keyNo,
-                ).catchError((error, trace) => handleError(error, trace: trace));
-
-                if (isShifted) {
-                  isShifted = false;
-                }
-              });
-              break;
+        onTapDown: (details) {
+          // Whichever key the touch was meant for, not only the one it landed on.
+          final touched = geometry.resolveTouch(rect.rect.topLeft + details.localPosition, rect,
+            planeNo: planeNo,
+            childSize: childSize,
+            monitorGeometry: monitorGeometry,
+            constraints: constraints,
+            isAnnounced: isAnnounced,
+          );
+
+          final isPressed = _emojiQuery == null && _isRepeatable(rows[touched.rowNo].keyAt(touched.keyNo)) && Keebie.pressKey(
+            isShifted: isShifted,
+            plane: planeNo,
+            rowNo: touched.rowNo,
+            keyNo: touched.keyNo,
+          );
+
+          // The runner only repeats the latest press, earlier touches hold nothing now.
+          if (isPressed) {
+            _touches.updateAll((_, touch) => (touched: touch.touched, isPressed: touch.isPressed, isHeld: false));
           }
+          _touches[rect] = (touched: touched, isPressed: isPressed, isHeld: isPressed);
+        },
+        onTapUp: (details) {
+          // Only the touch holding a key stops it, not another one lifting meanwhile.
+          final touch = _touches[rect];
+          if (touch != null && touch.isHeld) _releaseKey(planeNo, touch.touched);
+        },
+        onTapCancel: () {
+          final touch = _touches.remove(rect);
+          if (touch != null && touch.isHeld) _releaseKey(planeNo, touch.touched);
+        },
+        onTap: () {
+          final touch = _touches.remove(rect);
+          final touched = touch?.touched ?? rect;
+          _activateKey(rows[touched.rowNo].keyAt(touched.keyNo), planeNo, touched, isPressed: touch?.isPressed ?? false);
         },
       ),
     );
   }
 
-  Widget buildLayout(BuildContext context, KeyboardLayout layout) =>
-      FutureBuilder(
-        future: Keebie.monitorGeometry,
-        builder: (context, snapshot) {
-          if (!isAnnounced) {
-            Keebie.announceLayout(layout).then((nothing) {
-              isAnnounced = true;
-            }).catchError((error, trace) {
-              handleError(error, trace: trace);
-            });
-          }
+  Widget buildLayout(BuildContext context, KeyboardLayout layout) {
+    if (!isAnnounced) {
+      Keebie.announceLayout(layout).then((nothing) {
+        setState(() {
+          isAnnounced = true;
+        });
+      }).catchError((error, trace) {
+        handleError(error, trace: trace);
+      });
+    }
 
-          final monitorGeometry = snapshot.hasData ? snapshot.data! : Rect.fromLTRB(0, 0, KeebieApp.getInitialSize(context).width, KeebieApp.getInitialSize(context).height);
+    final monitorGeometry = _monitorGeometry ?? Rect.fromLTRB(0, 0, KeebieApp.getInitialSize(context).width, KeebieApp.getInitialSize(context).height);
 
-          final currentPlane = layout.getPlane(
-            plane,
-            contentType: contentType
-          );
+    // Searching for emoji types the query on the default plane's letters.
+    final isSearchingEmoji = _emojiQuery != null;
+    final planeNo = isSearchingEmoji ? widget.plane : layout.resolvePlane(plane, contentType: contentType);
+    final currentPlane = layout.getPlane(planeNo);
+    final childSize = KeyboardKey.getChildSize(context, monitorGeometry).height;
+    final geometry = getGeometry(layout, planeNo, childSize, monitorGeometry);
+    final rows = currentPlane.rows;
 
-          final size = currentPlane.getSize(context, constraints: constraints, isShifted: isShifted, monitorGeometry: monitorGeometry);
-
-          Widget layoutWidget = Column(
-            mainAxisAlignment: MainAxisAlignment.spaceEvenly,
-            children: currentPlane.rows.map((row) => Row(
-              mainAxisAlignment: MainAxisAlignment.spaceAround,
-              children: row.getKeys(constraints: constraints)
-                .asMap()
-                .map((keyNo, key) =>
-                  MapEntry(
-                    keyNo,
-                    buildKey(context, layout, key, row.number, keyNo, monitorGeometry)
-                  )
-                ).values.toList()
-            )).toList(),
-          );
+    // Handwriting and emoji planes put a pad above their keys which scales
+    // with them, a search only needs a strip of results.
+    final isHandwriting = currentPlane.type == KeyboardPlaneType.handwriting;
+    final isEmoji = currentPlane.type == KeyboardPlaneType.emoji || isSearchingEmoji;
+    final padSize = isSearchingEmoji ? Size(geometry.size.width, childSize * 4)
+      : isHandwriting || isEmoji ? Size(geometry.size.width, childSize * 8) : Size.zero;
 
-          if (widget.onSize != null) {
-            widget.onSize!(size);
-          }
-          return SizedBox(
-            width: size.width,
-            height: size.height,
-            child: layoutWidget,
-          );
-        },
-      );
+    if (widget.onSize != null) {
+      widget.onSize!(Size(geometry.size.width, geometry.size.height + padSize.height));
+    }
+
+    // The runner would type a search into the text, so Flutter takes it.
+    if (isSearchingEmoji) {
+      WidgetsBinding.instance.addPostFrameCallback((_) => _withdrawTouchSurface());
+    } else if (isAnnounced) {
+      WidgetsBinding.instance.addPostFrameCallback((_) => _announceTouchSurface(geometry, planeNo, childSize, monitorGeometry));
+    }
+
+    final keys = SizedBox(
+      key: _surfaceKey,
+      width: geometry.size.width,
+      height: geometry.size.height,
+      child: Stack(
+        children: geometry.keys.map((rect) =>
+          buildKey(context, rows, geometry, planeNo, rect, childSize, monitorGeometry)
+        ).toList(),
+      ),
+    );
+
+    if (!isHandwriting && !isEmoji) return keys;
+    return Column(
+      mainAxisSize: MainAxisSize.min,
+      children: [
+        if (isHandwriting) HandwritingPad(size: padSize),
+        if (isEmoji) EmojiPicker(
+          key: ValueKey(_name),
+          size: padSize,
+          childSize: childSize,
+          query: _emojiQuery,
+          onSearch: () => setState(() {
+            _emojiQuery = '';
+            isShifted = false;
+          }),
+          onPicked: (text) {
+            if (isSearchingEmoji) {
+              setState(() {
+                _emojiQuery = null;
+              });
+            }
+          },
+        ),
+        keys,
+      ],
+    );
+  }
 
   @override
   Widget build(BuildContext context) {
+    if (_switchedLayout != null) {
+      return buildLayout(context, _switchedLayout!);
+    }
+
     if (widget.onLayout != null) {
       return FutureBuilder(
-        future: widget.onLayout!(),
+        future: _layout ??= _loadLayout(),
         builder: (context, snapshot) {
           if (snapshot.hasError) {
             return BasicCard(
@@ -236,6 +527,7 @@ class _KeyboardState extends State<Keyboard> {
           }
 
           if (snapshot.hasData) {
+            if (_name != null) _layouts[_name!] = snapshot.data!;
             return buildLayout(context, snapshot.data!);
           }
           return const CircularProgressIndicator();
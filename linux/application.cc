@@ -1,17 +1,62 @@
-#include <sys/mman.h>
+#include <math.h>
 
 #include "application.h"
+#include "commit-queue.h"
+#include "composition.h"
+#include "converter.h"
+#include "dictionary.h"
+#include "emoji.h"
+#include "frecency.h"
+#include "handwriting.h"
+#include "im-state.h"
+#include "input-thread.h"
+#include "key-adjacency.h"
+#include "keymap.h"
+#include "keymap-extension.h"
+#include "key-repeat.h"
+#include "output-cache.h"
+#include "surrounding.h"
+#include "touch-model.h"
+#include "touch-tracker.h"
+#include "user-model.h"
 #include "window.h"
 #include "utils.h"
 
+/**
+ * An enabled language, changeLang swaps all of it in at once.
+ */
+typedef struct {
+  gchar* name;
+  KeebieLayout* layout;
+  KeebieKeymap* keymap;
+} KeebieLanguage;
+
 struct _KeebieApplication {
   GtkApplication parent_instance;
 
   KeebieWindow* keyboard_window;
+  GRecMutex lock;
+  KeebieLayout* layout;
+  gchar* layout_name;
+  KeebieLayoutRegistry* layout_registry;
+  KeebieGeometryCache* geometry_cache;
+  KeebieOutputCache* output_cache;
+
+  GPtrArray* languages;
+  gboolean is_preloading;
+
+  KeebieKeyRepeat* key_repeat;
+  guint held_plane;
+  guint held_row;
+  guint held_key;
+  gboolean held_is_shifted;
+  guint held_repeats;
 
   char** dart_entrypoint_arguments;
   bool launch_settings;
 
+  KeebieInputThread* input_thread;
+  struct wl_display* display;
   struct wl_seat* seat;
   struct zwp_input_method_manager_v2* input_method_manager;
   struct zwp_input_method_v2* input_method;
@@ -20,36 +65,270 @@ struct _KeebieApplication {
   struct zwp_virtual_keyboard_v1* virtual_keyboard;
 
   struct xkb_context* xkb_context;
-  struct xkb_keymap* xkb_keymap;
-  uint32_t keymap_fmt;
-  int32_t keymap_fd;
-  uint32_t keymap_size;
+  KeebieKeymap* keymap;
+  KeebieKeymapExtension* keymap_extension;
+  uint64_t uploaded_keymap_hash;
 
   uint32_t im_serial;
+  KeebieCommitQueue* commit_queue;
+  KeebieComposition composition;
+
+  // Locale to KeebieDictionary, NULL for locales without one.
+  GHashTable* dictionaries;
+  KeebieUserModel* user_model;
+  KeebieKeyAdjacency* key_adjacency;
+  KeebieTouchModel* touch_model;
+
+  // Locale to KeebieConverter, NULL for locales without one. While reading
+  // holds kana the composition shows them, or the conversion picked of
+  // them, and typing edits reading rather than the text.
+  GHashTable* converters;
+  KeebieLattice* lattice;
+  GString* reading;
+  GPtrArray* conversions;
+  gint conversion;
+
+  // Locale to KeebieHandwriting, NULL for locales without templates.
+  GHashTable* handwritings;
+
+  // Locale to KeebieEmoji, NULL for locales without a catalog. The history
+  // ranks what the user picked before first.
+  GHashTable* emojis;
+  KeebieFrecency* emoji_history;
+
+  // Swipes are decoded against the plane of the geometry last asked about.
+  gboolean swipe_typing;
+  KeebieSwipeDecoder* swipe_decoder;
+  KeebieGeometry* swipe_geometry;
+  KeebieDictionary* swipe_dictionary;
+
+  // The last autocorrection, the word as typed and what replaced it along
+  // with the text which ended it, so a backspace right after can undo it.
+  gboolean autocorrect;
+  gchar* corrected_word;
+  gchar* correction;
+  gchar* rejected_correction;
+
+  // Whether keys touched in the window type as they go down or only once
+  // they are let go of, and how long a lifted key waits on earlier ones.
+  gboolean commit_on_press;
+  guint rollover;
+
+  KeebieImState im_state;
+  KeebieImState pending_im_state;
+  gboolean is_im_state_queued;
 };
 
+// Holding delete for this many repeats moves on to deleting whole words.
+#define KEEBIE_APPLICATION_WORD_DELETE_REPEATS 10
+
+// Completions are drawn from this many candidates per completion asked for,
+// so what the user typed before has something to re-rank.
+#define KEEBIE_APPLICATION_COMPLETION_CANDIDATES 4
+
+// How many conversions the space key cycles through.
+#define KEEBIE_APPLICATION_CONVERSIONS 9
+
+// Shorter words are too often meant the way they were typed.
+#define KEEBIE_APPLICATION_CORRECTION_MIN_LENGTH 2
+
+// What the dictionary thinks of keys which commit no text, halfway between
+// certain and the least the touch model lets it say.
+#define KEEBIE_APPLICATION_TOUCH_PRIOR_NEUTRAL -2.3f
+
+// Real modifier indices are fixed in every XKB keymap, Control is the third.
+#define KEEBIE_APPLICATION_CONTROL_MASK (1 << 2)
+
 G_DEFINE_TYPE(KeebieApplication, keebie_application, GTK_TYPE_APPLICATION);
 
+static void keebie_language_free(KeebieLanguage* self) {
+  g_free(self->name);
+  g_clear_pointer(&self->layout, keebie_layout_unref);
+  g_clear_pointer(&self->keymap, keebie_keymap_unref);
+  g_free(self);
+}
+
+static gboolean keebie_application_show_keyboard(gpointer data) {
+  KeebieApplication* self = KEEBIE_APPLICATION(data);
+  if (self->keyboard_window != nullptr) {
+    gtk_widget_show_all(GTK_WIDGET(self->keyboard_window));
+  }
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean keebie_application_hide_keyboard(gpointer data) {
+  KeebieApplication* self = KEEBIE_APPLICATION(data);
+  if (self->keyboard_window != nullptr) {
+    gtk_widget_hide(GTK_WIDGET(self->keyboard_window));
+  }
+
+  // Nothing is looked up until the next activation, the pages can go.
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, self->dictionaries);
+  while (g_hash_table_iter_next(&iter, nullptr, &value)) {
+    if (value != nullptr) {
+      keebie_dictionary_release(reinterpret_cast<KeebieDictionary*>(value));
+    }
+  }
+
+  // Idle is when rewriting the learned model costs nobody a keystroke.
+  if (self->user_model != nullptr) {
+    keebie_user_model_compact(self->user_model);
+    keebie_touch_model_save(self->touch_model);
+  }
+  if (self->emoji_history != nullptr) {
+    keebie_frecency_save(self->emoji_history);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+static void keebie_application_finish_composing_locked(KeebieApplication* self, const char* text);
+static void keebie_application_reset_conversion_locked(KeebieApplication* self);
+
+static gboolean keebie_application_notify_im_state(gpointer data) {
+  KeebieApplication* self = KEEBIE_APPLICATION(data);
+
+  KeebieImState state = {};
+  {
+    g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+    keebie_im_state_copy(&state, &self->im_state);
+    self->is_im_state_queued = FALSE;
+  }
+
+  GList* windows = gtk_application_get_windows(GTK_APPLICATION(self));
+  for (GList* item = windows; item != nullptr; item = item->next) {
+    if (KEEBIE_IS_WINDOW(item->data)) {
+      keebie_window_im_state_changed(KEEBIE_WINDOW(item->data), &state);
+    }
+  }
+
+  keebie_im_state_clear(&state);
+  return G_SOURCE_REMOVE;
+}
+
+static void keebie_application_queue_im_state_locked(KeebieApplication* self) {
+  if (!self->is_im_state_queued) {
+    self->is_im_state_queued = TRUE;
+    g_main_context_invoke(nullptr, keebie_application_notify_im_state, self);
+  }
+}
+
+// Input-method events arrive on the input thread, GTK is left to the main one.
 static void keebie_application_im_activate(void* data, struct zwp_input_method_v2* zwp_input_method_v2) {
   KeebieApplication* self = KEEBIE_APPLICATION(data);
-  gtk_widget_show_all(GTK_WIDGET(self->keyboard_window));
+
+  // Activation starts over with a blank state.
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  keebie_im_state_clear(&self->pending_im_state);
+  self->pending_im_state.is_active = TRUE;
 }
 
 static void keebie_application_im_deactivate(void* data, struct zwp_input_method_v2* zwp_input_method_v2) {
   KeebieApplication* self = KEEBIE_APPLICATION(data);
-  gtk_widget_hide(GTK_WIDGET(self->keyboard_window));
+
+  // Still valid until the done which follows, after that it would be ignored.
+  // The client drops the preedit with focus, so the composition goes too.
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  keebie_composition_clear(&self->composition);
+  keebie_application_reset_conversion_locked(self);
+  keebie_commit_queue_set_preedit(self->commit_queue, nullptr, 0, 0);
+  keebie_commit_queue_flush(self->commit_queue);
+  self->pending_im_state.is_active = FALSE;
+}
+
+static void keebie_application_im_surrounding_text(void* data, struct zwp_input_method_v2* zwp_input_method_v2, const char* text, uint32_t cursor, uint32_t anchor) {
+  KeebieApplication* self = KEEBIE_APPLICATION(data);
+
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  keebie_surrounding_set(&self->pending_im_state.surrounding, text, cursor, anchor);
+}
+
+static void keebie_application_im_text_change_cause(void* data, struct zwp_input_method_v2* zwp_input_method_v2, uint32_t cause) {
+  KeebieApplication* self = KEEBIE_APPLICATION(data);
+
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  self->pending_im_state.text_change_cause = cause;
+}
+
+static void keebie_application_im_content_type(void* data, struct zwp_input_method_v2* zwp_input_method_v2, uint32_t hint, uint32_t purpose) {
+  KeebieApplication* self = KEEBIE_APPLICATION(data);
+
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  self->pending_im_state.content_hint = hint;
+  self->pending_im_state.content_purpose = purpose;
 }
 
-static void keebie_application_im_surrounding_text(void* data, struct zwp_input_method_v2* zwp_input_method_v2, const char* text, uint32_t cursor, uint32_t anchor) {}
+static void keebie_application_im_done(void* data, struct zwp_input_method_v2* zwp_input_method_v2) {
+  KeebieApplication* self = KEEBIE_APPLICATION(data);
+
+  // State is double-buffered, whatever was not sent before done is unset.
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  self->im_serial++;
 
-static void keebie_application_im_text_change_cause(void* data, struct zwp_input_method_v2* zwp_input_method_v2, uint32_t cause) {}
+  guint changed = keebie_im_state_diff(&self->im_state, &self->pending_im_state);
+  keebie_im_state_clear(&self->im_state);
+  self->im_state = self->pending_im_state;
+  self->pending_im_state = {};
+  self->pending_im_state.is_active = self->im_state.is_active;
 
-static void keebie_application_im_content_type(void* data, struct zwp_input_method_v2* zwp_input_method_v2, uint32_t hint, uint32_t purpose) {}
+  // The cursor moved or the text was edited under the composition, like
+  // other input methods this keeps what was composed so far.
+  if ((changed & KEEBIE_IM_STATE_SURROUNDING) && self->im_state.text_change_cause == KEEBIE_IM_STATE_CHANGE_CAUSE_OTHER && keebie_composition_is_active(&self->composition)) {
+    keebie_application_finish_composing_locked(self, nullptr);
+  }
+
+  if (changed & KEEBIE_IM_STATE_ACTIVE) {
+    g_main_context_invoke(nullptr, self->im_state.is_active ? keebie_application_show_keyboard : keebie_application_hide_keyboard, self);
+  }
 
-static void keebie_application_im_done(void* data, struct zwp_input_method_v2* zwp_input_method_v2) {}
+  // The cause alone flips with every commit, it is not worth a message.
+  if ((changed & ~KEEBIE_IM_STATE_TEXT_CHANGE_CAUSE) != 0) {
+    keebie_application_queue_im_state_locked(self);
+  }
+}
 
 static void keebie_application_im_unavailable(void* data, struct zwp_input_method_v2* zwp_input_method_v2) {
-  g_error("IM is not available");
+  KeebieApplication* self = KEEBIE_APPLICATION(data);
+  g_warning("IM is not available, typing through the virtual keyboard instead");
+
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  g_clear_pointer(&self->input_method, zwp_input_method_v2_destroy);
+  keebie_commit_queue_clear(self->commit_queue);
+  keebie_composition_clear(&self->composition);
+  keebie_application_reset_conversion_locked(self);
+  keebie_im_state_clear(&self->im_state);
+  keebie_im_state_clear(&self->pending_im_state);
+
+  // Nothing will activate the keyboard anymore.
+  if (self->virtual_keyboard != nullptr) {
+    g_main_context_invoke(nullptr, keebie_application_show_keyboard, self);
+  }
+}
+
+static void keebie_application_im_commit(const KeebieCommit* commit, gpointer data) {
+  KeebieApplication* self = KEEBIE_APPLICATION(data);
+  if (self->input_method == nullptr) {
+    return;
+  }
+
+  if (commit->before > 0 || commit->after > 0) {
+    zwp_input_method_v2_delete_surrounding_text(self->input_method, commit->before, commit->after);
+  }
+
+  if (commit->text->len > 0) {
+    zwp_input_method_v2_commit_string(self->input_method, commit->text->str);
+  }
+
+  if (commit->preedit != nullptr) {
+    zwp_input_method_v2_set_preedit_string(self->input_method, commit->preedit, commit->preedit_begin, commit->preedit_end);
+  }
+
+  // The serial is the number of done events seen, the compositor ignores a
+  // commit made against state it has since replaced.
+  zwp_input_method_v2_commit(self->input_method, self->im_serial);
+  wl_display_flush(self->display);
 }
 
 static const struct zwp_input_method_v2_listener keebie_application_im_listener = {
@@ -65,14 +344,11 @@ static const struct zwp_input_method_v2_listener keebie_application_im_listener
 static void keebie_application_kb_keymap(void* data, struct wl_keyboard* wl_keyboard, uint32_t fmt, int32_t fd, uint32_t size) {
   KeebieApplication* self = KEEBIE_APPLICATION(data);
 
-  if (self->keymap_fd > 0) {
-    close(self->keymap_fd);
-  }
-
-  self->keymap_fmt = fmt;
-  self->keymap_fd = fd;
-  self->keymap_size = size;
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  g_clear_pointer(&self->keymap, keebie_keymap_unref);
+  self->keymap = keebie_keymap_new_from_fd(fmt, fd, size);
 
+  // Compositors resend the keymap on every focus change, mostly unchanged.
   keebie_application_keymap(self);
 }
 
@@ -88,7 +364,12 @@ static void keebie_application_kb_key(void* data, struct wl_keyboard* wl_keyboar
 static void keebie_application_kb_modifiers(void* data, struct wl_keyboard* wl_keyboard, uint32_t serial, uint32_t mods_depressed, uint32_t mods_latched, uint32_t mods_locked, uint32_t group) {
 }
 
-static void keebie_application_kb_repeat_info(void* data, struct wl_keyboard* wl_keyboard, int32_t rate, int32_t delay) {}
+static void keebie_application_kb_repeat_info(void* data, struct wl_keyboard* wl_keyboard, int32_t rate, int32_t delay) {
+  KeebieApplication* self = KEEBIE_APPLICATION(data);
+
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  keebie_key_repeat_set_info(self->key_repeat, rate, delay);
+}
 
 static const struct wl_keyboard_listener keebie_application_kb_listener = {
   .keymap = keebie_application_kb_keymap,
@@ -118,63 +399,114 @@ static const struct wl_registry_listener registry_listener = {
   .global = wayland_register_global,
 };
 
+static void keebie_application_output_changed(GdkMonitor* monitor, gpointer data) {
+  KeebieApplication* self = KEEBIE_APPLICATION(data);
+
+  GList* windows = gtk_application_get_windows(GTK_APPLICATION(self));
+  for (GList* item = windows; item != nullptr; item = item->next) {
+    if (KEEBIE_IS_WINDOW(item->data)) {
+      keebie_window_output_changed(KEEBIE_WINDOW(item->data), monitor);
+    }
+  }
+}
+
+static void keebie_application_layout_changed(const gchar* name, KeebieLayout* layout, gpointer user_data);
+static void keebie_application_key_repeat(guint count, gpointer data);
+static void keebie_application_input_command(const KeebieInputCommand* command, gpointer data);
+static gboolean keebie_application_run_input(KeebieApplication* self, const KeebieInputCommand* command);
+
+static void keebie_application_startup(GApplication* application) {
+  KeebieApplication* self = KEEBIE_APPLICATION(application);
+  G_APPLICATION_CLASS(keebie_application_parent_class)->startup(application);
+
+  // Settings show layouts as much as the keyboard does.
+  g_autofree gchar* bundle_dir = keebie_layout_registry_get_bundle_dir();
+  g_autofree gchar* cache_dir = keebie_layout_registry_get_cache_dir();
+  g_auto(GStrv) source_dirs = keebie_layout_registry_get_source_dirs();
+  self->layout_registry = keebie_layout_registry_new(bundle_dir, cache_dir, source_dirs);
+}
+
+// Everything only typing needs, the settings never pay for any of it.
+static void keebie_application_start_keyboard(KeebieApplication* self) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  if (self->input_thread != nullptr) {
+    return;
+  }
+
+  self->input_thread = keebie_input_thread_new(keebie_application_input_command, self);
+  GMainContext* input_context = keebie_input_thread_get_context(self->input_thread);
+  self->key_repeat = keebie_key_repeat_new(input_context, keebie_application_key_repeat, self);
+  self->commit_queue = keebie_commit_queue_new(input_context, &self->lock, keebie_application_im_commit, self);
+
+  g_autofree gchar* data_dir = g_build_filename(g_get_user_data_dir(), "keebie", nullptr);
+  self->user_model = keebie_user_model_new(data_dir);
+
+  g_autofree gchar* touch_model_path = g_build_filename(data_dir, "touch-model.ini", nullptr);
+  self->touch_model = keebie_touch_model_new(touch_model_path);
+  self->swipe_decoder = keebie_swipe_decoder_new();
+
+  keebie_layout_registry_watch(self->layout_registry, keebie_application_layout_changed, self);
+}
+
 static void keebie_application_activate(GApplication* application) {
   KeebieApplication* self = KEEBIE_APPLICATION(application);
 
+  if (!self->launch_settings) {
+    keebie_application_start_keyboard(self);
+  }
+
   GdkDisplay* gdisp = gdk_display_get_default();
   g_assert(gdisp != nullptr);
 
+  self->output_cache = keebie_output_cache_new(gdisp, keebie_application_output_changed, self);
+
   self->xkb_context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
   g_assert(self->xkb_context != nullptr);
 
   if (GDK_IS_WAYLAND_DISPLAY(gdisp)) {
-    struct wl_display* disp = gdk_wayland_display_get_wl_display(gdisp);
-    struct wl_registry* registry = wl_display_get_registry(disp);
+    self->display = gdk_wayland_display_get_wl_display(gdisp);
+    struct wl_registry* registry = wl_display_get_registry(self->display);
 
     wl_registry_add_listener(registry, &registry_listener, reinterpret_cast<void*>(self));
-    wl_display_roundtrip(disp);
+    wl_display_roundtrip(self->display);
 
     if (!self->launch_settings) {
-      struct wl_keyboard* keyboard = wl_seat_get_keyboard(self->seat);
+      g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+      struct wl_event_queue* queue = keebie_input_thread_create_queue(self->input_thread, self->display);
+
+      // Objects made through a wrapper start out on its queue, so none of
+      // their events can ever be dispatched by the main loop.
+      struct wl_seat* seat = reinterpret_cast<struct wl_seat*>(wl_proxy_create_wrapper(self->seat));
+      wl_proxy_set_queue(reinterpret_cast<struct wl_proxy*>(seat), queue);
+      struct wl_keyboard* keyboard = wl_seat_get_keyboard(seat);
+      wl_proxy_wrapper_destroy(seat);
 
       if (self->input_method_manager != nullptr) {
-        self->input_method = zwp_input_method_manager_v2_get_input_method(self->input_method_manager, self->seat);
+        struct zwp_input_method_manager_v2* manager = reinterpret_cast<struct zwp_input_method_manager_v2*>(wl_proxy_create_wrapper(self->input_method_manager));
+        wl_proxy_set_queue(reinterpret_cast<struct wl_proxy*>(manager), queue);
+        self->input_method = zwp_input_method_manager_v2_get_input_method(manager, self->seat);
         zwp_input_method_v2_add_listener(self->input_method, &keebie_application_im_listener, self);
+        wl_proxy_wrapper_destroy(manager);
       }
 
       if (self->virtual_keyboard_manager != nullptr) {
-        self->virtual_keyboard = zwp_virtual_keyboard_manager_v1_create_virtual_keyboard(self->virtual_keyboard_manager, self->seat);
+        struct zwp_virtual_keyboard_manager_v1* manager = reinterpret_cast<struct zwp_virtual_keyboard_manager_v1*>(wl_proxy_create_wrapper(self->virtual_keyboard_manager));
+        wl_proxy_set_queue(reinterpret_cast<struct wl_proxy*>(manager), queue);
+        self->virtual_keyboard = zwp_virtual_keyboard_manager_v1_create_virtual_keyboard(manager, self->seat);
+        wl_proxy_wrapper_destroy(manager);
       }
 
       if (keyboard != nullptr) {
         wl_keyboard_add_listener(keyboard, &keebie_application_kb_listener, self);
       } else {
-        struct xkb_rule_names names;
-        names.rules = nullptr;
-        names.model = nullptr;
-        names.layout = nullptr;
-        names.variant = nullptr;
-        names.options = nullptr;
-
-        self->xkb_keymap = xkb_keymap_new_from_names(self->xkb_context, &names, XKB_KEYMAP_COMPILE_NO_FLAGS);
-        g_assert(self->xkb_keymap != nullptr);
-
-        self->keymap_fmt = XKB_KEYMAP_FORMAT_TEXT_V1;
-
-        char* keymap_str = xkb_keymap_get_as_string(self->xkb_keymap, (enum xkb_keymap_format)self->keymap_fmt);
-        self->keymap_size = strlen(keymap_str) + 1;
-
-        int ro_fd = -1;
-        g_assert(allocate_shm_file_pair(self->keymap_size, &self->keymap_fd, &ro_fd));
-
-        void* dst = mmap(NULL, self->keymap_size, PROT_READ | PROT_WRITE, MAP_SHARED, self->keymap_fd, 0);
-        g_assert(dst != MAP_FAILED);
-
-        memcpy(dst, keymap_str, self->keymap_size);
-        munmap(dst, self->keymap_size);
+        self->keymap = keebie_keymap_new_from_names(self->xkb_context, nullptr);
+        g_assert(self->keymap != nullptr);
 
         keebie_application_keymap(self);
       }
+
+      keebie_input_thread_start(self->input_thread);
+      wl_display_flush(self->display);
     }
   }
 
@@ -222,30 +554,138 @@ static gboolean keebie_application_local_command_line(GApplication* application,
 static void keebie_application_dispose(GObject* object) {
   KeebieApplication* self = KEEBIE_APPLICATION(object);
 
+  // Nothing may dispatch on the input queue while the proxies go away.
+  g_clear_pointer(&self->input_thread, keebie_input_thread_free);
+
   g_clear_pointer(&self->dart_entrypoint_arguments, g_strfreev);
+  g_clear_pointer(&self->commit_queue, keebie_commit_queue_free);
+  g_clear_pointer(&self->dictionaries, g_hash_table_unref);
+  g_clear_pointer(&self->lattice, keebie_lattice_free);
+  g_clear_pointer(&self->converters, g_hash_table_unref);
+  g_clear_pointer(&self->conversions, g_ptr_array_unref);
+  g_clear_pointer(&self->handwritings, g_hash_table_unref);
+  g_clear_pointer(&self->emojis, g_hash_table_unref);
+  g_clear_pointer(&self->emoji_history, keebie_frecency_free);
+  g_clear_pointer(&self->user_model, keebie_user_model_free);
+  g_clear_pointer(&self->key_adjacency, keebie_key_adjacency_free);
+  g_clear_pointer(&self->touch_model, keebie_touch_model_free);
+  g_clear_pointer(&self->swipe_decoder, keebie_swipe_decoder_free);
+  g_clear_pointer(&self->swipe_geometry, keebie_geometry_unref);
+  g_clear_pointer(&self->corrected_word, g_free);
+  g_clear_pointer(&self->correction, g_free);
+  g_clear_pointer(&self->rejected_correction, g_free);
+  keebie_composition_clear(&self->composition);
   g_clear_pointer(&self->input_method_manager, zwp_input_method_manager_v2_destroy);
   g_clear_pointer(&self->input_method, zwp_input_method_v2_destroy);
+  keebie_im_state_clear(&self->im_state);
+  keebie_im_state_clear(&self->pending_im_state);
   g_clear_pointer(&self->virtual_keyboard_manager, zwp_virtual_keyboard_manager_v1_destroy);
   g_clear_pointer(&self->virtual_keyboard, zwp_virtual_keyboard_v1_destroy);
   g_clear_pointer(&self->xkb_context, xkb_context_unref);
-  g_clear_pointer(&self->xkb_keymap, xkb_keymap_unref);
+  g_clear_pointer(&self->keymap, keebie_keymap_unref);
+  g_clear_pointer(&self->keymap_extension, keebie_keymap_extension_free);
+  g_clear_pointer(&self->languages, g_ptr_array_unref);
+  g_clear_pointer(&self->key_repeat, keebie_key_repeat_free);
+  g_clear_pointer(&self->layout, keebie_layout_unref);
+  g_clear_pointer(&self->layout_name, g_free);
+  g_clear_pointer(&self->layout_registry, keebie_layout_registry_free);
+  g_clear_pointer(&self->geometry_cache, keebie_geometry_cache_free);
+  g_clear_pointer(&self->output_cache, keebie_output_cache_free);
   g_clear_object(&self->keyboard_window);
 
-  if (self->keymap_fd > 0) {
-    close(self->keymap_fd);
-    self->keymap_fd = 0;
-  }
-
   G_OBJECT_CLASS(keebie_application_parent_class)->dispose(object);
 }
 
+static void keebie_application_finalize(GObject* object) {
+  KeebieApplication* self = KEEBIE_APPLICATION(object);
+
+  g_string_free(self->reading, TRUE);
+  g_rec_mutex_clear(&self->lock);
+
+  G_OBJECT_CLASS(keebie_application_parent_class)->finalize(object);
+}
+
 static void keebie_application_class_init(KeebieApplicationClass* klass) {
+  G_APPLICATION_CLASS(klass)->startup = keebie_application_startup;
   G_APPLICATION_CLASS(klass)->activate = keebie_application_activate;
   G_APPLICATION_CLASS(klass)->local_command_line = keebie_application_local_command_line;
   G_OBJECT_CLASS(klass)->dispose = keebie_application_dispose;
+  G_OBJECT_CLASS(klass)->finalize = keebie_application_finalize;
+}
+
+static void keebie_application_layout_changed(const gchar* name, KeebieLayout* layout, gpointer user_data) {
+  KeebieApplication* self = KEEBIE_APPLICATION(user_data);
+
+  {
+    g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+    for (guint i = 0; self->languages != nullptr && i < self->languages->len; i++) {
+      KeebieLanguage* language = reinterpret_cast<KeebieLanguage*>(g_ptr_array_index(self->languages, i));
+      if (language->layout != nullptr && g_strcmp0(language->name, name) == 0) {
+        keebie_layout_unref(language->layout);
+        language->layout = keebie_layout_ref(layout);
+      }
+    }
+
+    if (g_strcmp0(self->layout_name, name) == 0) {
+      g_clear_pointer(&self->layout, keebie_layout_unref);
+      self->layout = keebie_layout_ref(layout);
+
+      if (self->geometry_cache != nullptr) {
+        keebie_geometry_cache_clear(self->geometry_cache);
+      }
+      g_clear_pointer(&self->key_adjacency, keebie_key_adjacency_free);
+    }
+  }
+
+  GList* windows = gtk_application_get_windows(GTK_APPLICATION(self));
+  for (GList* item = windows; item != nullptr; item = item->next) {
+    if (KEEBIE_IS_WINDOW(item->data)) {
+      keebie_window_layout_changed(KEEBIE_WINDOW(item->data), name);
+    }
+  }
+}
+
+static void keebie_application_dictionary_unref(gpointer data) {
+  if (data != nullptr) {
+    keebie_dictionary_unref(reinterpret_cast<KeebieDictionary*>(data));
+  }
+}
+
+static void keebie_application_converter_unref(gpointer data) {
+  if (data != nullptr) {
+    keebie_converter_unref(reinterpret_cast<KeebieConverter*>(data));
+  }
+}
+
+static void keebie_application_handwriting_unref(gpointer data) {
+  if (data != nullptr) {
+    keebie_handwriting_unref(reinterpret_cast<KeebieHandwriting*>(data));
+  }
+}
+
+static void keebie_application_emoji_unref(gpointer data) {
+  if (data != nullptr) {
+    keebie_emoji_unref(reinterpret_cast<KeebieEmoji*>(data));
+  }
 }
 
-static void keebie_application_init(KeebieApplication* self) {}
+static void keebie_application_init(KeebieApplication* self) {
+  g_rec_mutex_init(&self->lock);
+  self->geometry_cache = keebie_geometry_cache_new();
+  self->dictionaries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, keebie_application_dictionary_unref);
+  self->converters = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, keebie_application_converter_unref);
+  self->handwritings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, keebie_application_handwriting_unref);
+  self->emojis = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, keebie_application_emoji_unref);
+  self->reading = g_string_new(nullptr);
+  self->conversion = -1;
+  self->autocorrect = TRUE;
+  self->commit_on_press = TRUE;
+  self->rollover = KEEBIE_TOUCH_TRACKER_DEFAULT_ROLLOVER;
+  self->swipe_typing = TRUE;
+
+  // The FFI entry points in ffi.cc look the application up through this.
+  g_application_set_default(G_APPLICATION(self));
+}
 
 KeebieApplication* keebie_application_new() {
   return KEEBIE_APPLICATION(g_object_new(keebie_application_get_type(),
@@ -260,6 +700,13 @@ FlDartProject* keebie_application_get_dart_project(KeebieApplication* self) {
   return project;
 }
 
+gboolean keebie_application_lookup_output(KeebieApplication* self, GdkMonitor* monitor, GdkRectangle* geometry, gint* scale) {
+  if (self->output_cache == nullptr) {
+    return FALSE;
+  }
+  return keebie_output_cache_lookup(self->output_cache, monitor, geometry, scale);
+}
+
 struct wl_seat* keebie_application_get_wayland_seat(KeebieApplication* self) {
   return self->seat;
 }
@@ -276,17 +723,15 @@ struct zwp_virtual_keyboard_manager_v1* keebie_application_get_virtual_keyboard_
   return self->virtual_keyboard_manager;
 }
 
-gboolean keebie_application_commit_text(KeebieApplication* self, const char* text) {
-  if (self->input_method != nullptr) {
-    zwp_input_method_v2_commit_string(self->input_method, text);
-    zwp_input_method_v2_commit(self->input_method, self->im_serial++);
-    return TRUE;
-  }
-  return FALSE;
-}
-
-gboolean keebie_application_send_key(KeebieApplication* self, uint32_t key) {
+static gboolean keebie_application_send_key_locked(KeebieApplication* self, uint32_t key) {
   if (self->virtual_keyboard != nullptr) {
+    // A key ends the composition, then queued edits have to reach the client
+    // before it does.
+    if (keebie_composition_is_active(&self->composition)) {
+      keebie_application_finish_composing_locked(self, nullptr);
+    }
+    keebie_commit_queue_flush(self->commit_queue);
+
     long time = get_time_ms();
 
     zwp_virtual_keyboard_v1_key(self->virtual_keyboard, time, key, WL_KEYBOARD_KEY_STATE_PRESSED);
@@ -296,34 +741,1572 @@ gboolean keebie_application_send_key(KeebieApplication* self, uint32_t key) {
   return FALSE;
 }
 
-gboolean keebie_application_delete_surrounding(KeebieApplication* self, uint32_t before, uint32_t after) {
-  if (self->virtual_keyboard != nullptr) {
-    while ((before--) > 0) {
-      keebie_application_send_key(self, KEY_BACKSPACE);
+static KeebieKeymap* keebie_application_get_effective_keymap(KeebieApplication* self) {
+  // Once text went over the virtual keyboard the generated keymap has to stay,
+  // the keycodes it handed out mean nothing in the base keymap.
+  if (self->input_method == nullptr && self->keymap_extension != nullptr) {
+    return keebie_keymap_extension_get_keymap(self->keymap_extension);
+  }
+  return self->keymap;
+}
+
+static gboolean keebie_application_type_text_locked(KeebieApplication* self, const char* text) {
+  glong n_chars = 0;
+  g_autofree gunichar* chars = g_utf8_to_ucs4_fast(text, -1, &n_chars);
+
+  g_autofree xkb_keysym_t* keysyms = g_new(xkb_keysym_t, n_chars);
+  gsize n_keysyms = 0;
+  for (glong i = 0; i < n_chars; i++) {
+    xkb_keysym_t keysym = chars[i] == '\n' ? XKB_KEY_Return : xkb_utf32_to_keysym(chars[i]);
+    if (keysym == XKB_KEY_NoSymbol) {
+      g_warning("Cannot type U+%04X, it has no keysym", chars[i]);
+      continue;
     }
+    keysyms[n_keysyms++] = keysym;
+  }
 
-    while ((after--) > 0) {
-      keebie_application_send_key(self, KEY_INSERT);
+  if (self->keymap_extension == nullptr) {
+    self->keymap_extension = keebie_keymap_extension_new();
+  }
+
+  // Each chunk is whatever fits into the free slots, one keymap upload for all of it.
+  g_autofree uint32_t* keycodes = g_new(uint32_t, n_keysyms);
+  gsize offset = 0;
+  while (offset < n_keysyms) {
+    gsize n_mapped = keebie_keymap_extension_map(self->keymap_extension, keysyms + offset, n_keysyms - offset, keycodes);
+    if (n_mapped == 0) {
+      return FALSE;
     }
-    return TRUE;
+
+    keebie_application_keymap(self);
+
+    for (gsize i = 0; i < n_mapped; i++) {
+      keebie_application_send_key_locked(self, keycodes[i]);
+    }
+
+    offset += n_mapped;
+  }
+  return TRUE;
+}
+
+// Learning only needs the text before the cursor, the model looks for the
+// words this commit completed in it on its own thread.
+static void keebie_application_learn_locked(KeebieApplication* self, const char* text) {
+  const KeebieSurrounding* surrounding = &self->im_state.surrounding;
+  gsize length = strlen(text);
+  if (self->user_model == nullptr || surrounding->text == nullptr || surrounding->cursor < length || keebie_im_state_is_private(&self->im_state)) {
+    return;
   }
+  keebie_user_model_learn(self->user_model, surrounding->text, surrounding->cursor, surrounding->cursor - length);
+}
 
+static gboolean keebie_application_commit_text_locked(KeebieApplication* self, const char* text) {
   if (self->input_method != nullptr) {
-    zwp_input_method_v2_delete_surrounding_text(self->input_method, before, after);
-    zwp_input_method_v2_commit_string(self->input_method, "");
-    zwp_input_method_v2_commit(self->input_method, self->im_serial++);
+    // Committing behind a composition would put the text before it.
+    if (keebie_composition_is_active(&self->composition)) {
+      keebie_application_finish_composing_locked(self, nullptr);
+    }
+
+    keebie_commit_queue_commit_text(self->commit_queue, text);
+    keebie_surrounding_insert(&self->im_state.surrounding, text);
+    keebie_application_learn_locked(self, text);
     return TRUE;
   }
+
+  if (self->virtual_keyboard != nullptr) {
+    gboolean result = keebie_application_type_text_locked(self, text);
+    wl_display_flush(self->display);
+    return result;
+  }
   return FALSE;
 }
 
-void keebie_application_keymap(KeebieApplication* self) {
-  if (self->virtual_keyboard != nullptr) {
-    zwp_virtual_keyboard_v1_keymap(
-      self->virtual_keyboard,
-      self->keymap_fmt,
-      self->keymap_fd,
-      self->keymap_size
-    );
+static void keebie_application_update_preedit_locked(KeebieApplication* self) {
+  if (keebie_composition_is_active(&self->composition)) {
+    keebie_commit_queue_set_preedit(self->commit_queue, self->composition.text->str, self->composition.cursor_begin, self->composition.cursor_end);
+  } else {
+    keebie_commit_queue_set_preedit(self->commit_queue, nullptr, 0, 0);
+  }
+}
+
+static gboolean keebie_application_compose_locked(KeebieApplication* self, uint32_t start, uint32_t end, const char* text) {
+  if (self->input_method == nullptr) {
+    return FALSE;
+  }
+
+  // Dart editing the composition takes it over from the converter.
+  keebie_application_reset_conversion_locked(self);
+  keebie_composition_replace(&self->composition, start, end, text);
+  keebie_application_update_preedit_locked(self);
+  return TRUE;
+}
+
+static gboolean keebie_application_set_composing_cursor_locked(KeebieApplication* self, uint32_t begin, uint32_t end) {
+  if (self->input_method == nullptr || !keebie_composition_is_active(&self->composition)) {
+    return FALSE;
+  }
+
+  keebie_composition_set_cursor(&self->composition, begin, end);
+  keebie_application_update_preedit_locked(self);
+  return TRUE;
+}
+
+static void keebie_application_finish_composing_locked(KeebieApplication* self, const char* text) {
+  keebie_application_reset_conversion_locked(self);
+
+  g_autofree gchar* composed = keebie_composition_steal(&self->composition);
+  keebie_commit_queue_set_preedit(self->commit_queue, nullptr, 0, 0);
+
+  // Preedit removal and commit share a transaction, the text never flickers.
+  const char* result = text != nullptr ? text : composed;
+  if (result != nullptr && result[0] != '\0') {
+    keebie_application_commit_text_locked(self, result);
+  }
+}
+
+// Dictionaries are named after the locale codes get_locale_name knows.
+static gchar* keebie_application_get_dictionary_path(const char* locale, const char* extension) {
+  if (get_locale_name(locale) == nullptr) {
+    return nullptr;
+  }
+
+  g_autofree gchar* exe = g_file_read_link("/proc/self/exe", nullptr);
+  g_autofree gchar* dir = exe != nullptr ? g_path_get_dirname(exe) : nullptr;
+  g_autofree gchar* name = g_strconcat(locale, extension, nullptr);
+  return g_build_filename(dir != nullptr ? dir : ".", "data", "dictionaries", name, nullptr);
+}
+
+static KeebieDictionary* keebie_application_get_dictionary_locked(KeebieApplication* self) {
+  if (self->layout == nullptr) {
+    return nullptr;
+  }
+
+  const char* locale = keebie_layout_get_locale(self->layout);
+  gpointer dictionary = nullptr;
+  if (g_hash_table_lookup_extended(self->dictionaries, locale, nullptr, &dictionary)) {
+    return reinterpret_cast<KeebieDictionary*>(dictionary);
+  }
+
+  g_autofree gchar* path = keebie_application_get_dictionary_path(locale, ".kbd");
+  if (path != nullptr) {
+    g_autoptr(GError) error = nullptr;
+    dictionary = keebie_dictionary_new_from_file(path, &error);
+    if (dictionary == nullptr) {
+      g_warning("No dictionary for %s: %s", locale, error->message);
+    }
+  }
+
+  // Missing ones are remembered too, so they are only looked for once.
+  g_hash_table_insert(self->dictionaries, g_strdup(locale), dictionary);
+  return reinterpret_cast<KeebieDictionary*>(dictionary);
+}
+
+static KeebieConverter* keebie_application_get_converter_locked(KeebieApplication* self) {
+  if (self->layout == nullptr) {
+    return nullptr;
+  }
+
+  const char* locale = keebie_layout_get_locale(self->layout);
+  gpointer converter = nullptr;
+  if (g_hash_table_lookup_extended(self->converters, locale, nullptr, &converter)) {
+    return reinterpret_cast<KeebieConverter*>(converter);
+  }
+
+  // Only languages written in kana come with one, a missing one is no error.
+  g_autofree gchar* path = keebie_application_get_dictionary_path(locale, ".kkc");
+  if (path != nullptr && g_file_test(path, G_FILE_TEST_EXISTS)) {
+    g_autoptr(GError) error = nullptr;
+    converter = keebie_converter_new_from_file(path, &error);
+    if (converter == nullptr) {
+      g_warning("No converter for %s: %s", locale, error->message);
+    }
+  }
+
+  g_hash_table_insert(self->converters, g_strdup(locale), converter);
+  return reinterpret_cast<KeebieConverter*>(converter);
+}
+
+// The lattice of the current language's converter, NULL when what is typed
+// goes into the text the way it was typed.
+static KeebieLattice* keebie_application_get_lattice_locked(KeebieApplication* self) {
+  if (self->input_method == nullptr || !keebie_im_state_wants_correction(&self->im_state)) {
+    return nullptr;
+  }
+
+  KeebieConverter* converter = keebie_application_get_converter_locked(self);
+  if (converter == nullptr) {
+    return nullptr;
+  }
+
+  if (self->lattice == nullptr || keebie_lattice_get_converter(self->lattice) != converter) {
+    g_clear_pointer(&self->lattice, keebie_lattice_free);
+    self->lattice = keebie_lattice_new(converter);
+  }
+  return self->lattice;
+}
+
+static gboolean keebie_application_is_converting_locked(KeebieApplication* self) {
+  return self->reading->len > 0 && self->lattice != nullptr;
+}
+
+static void keebie_application_reset_conversion_locked(KeebieApplication* self) {
+  g_string_truncate(self->reading, 0);
+  g_clear_pointer(&self->conversions, g_ptr_array_unref);
+  self->conversion = -1;
+}
+
+// Shows the reading, or the conversion picked with the whole of it
+// highlighted, and has the candidates refreshed.
+static void keebie_application_show_conversion_locked(KeebieApplication* self) {
+  if (self->conversion >= 0) {
+    keebie_composition_replace(&self->composition, 0, G_MAXUINT32, reinterpret_cast<const char*>(g_ptr_array_index(self->conversions, self->conversion)));
+    keebie_composition_set_cursor(&self->composition, 0, G_MAXUINT32);
+  } else if (self->reading->len > 0) {
+    keebie_composition_replace(&self->composition, 0, G_MAXUINT32, self->reading->str);
+  } else {
+    keebie_composition_clear(&self->composition);
+  }
+
+  keebie_application_update_preedit_locked(self);
+  keebie_application_queue_im_state_locked(self);
+}
+
+static void keebie_application_set_reading_locked(KeebieApplication* self) {
+  keebie_lattice_set_reading(self->lattice, self->reading->str);
+  g_clear_pointer(&self->conversions, g_ptr_array_unref);
+  self->conversion = -1;
+  keebie_application_show_conversion_locked(self);
+}
+
+static void keebie_application_next_conversion_locked(KeebieApplication* self) {
+  if (self->conversions == nullptr) {
+    keebie_romaji_finish(self->reading);
+    keebie_lattice_set_reading(self->lattice, self->reading->str);
+    self->conversions = g_ptr_array_new_with_free_func(g_free);
+    keebie_lattice_convert(self->lattice, KEEBIE_APPLICATION_CONVERSIONS, self->conversions);
+  }
+
+  if (self->conversions->len > 0) {
+    self->conversion = (self->conversion + 1) % static_cast<gint>(self->conversions->len);
+  }
+  keebie_application_show_conversion_locked(self);
+}
+
+// Commits what the composition shows, the kana as typed unless a conversion
+// was picked.
+static void keebie_application_finish_conversion_locked(KeebieApplication* self) {
+  if (self->conversion < 0) {
+    keebie_romaji_finish(self->reading);
+    keebie_application_show_conversion_locked(self);
+  }
+  keebie_application_finish_composing_locked(self, nullptr);
+}
+
+// Kana and romaji go into the reading rather than the text, a space converts
+// it and every further one moves on to the next conversion. Returns FALSE
+// for anything else, which goes after what was composed so far.
+static gboolean keebie_application_convert_typed_locked(KeebieApplication* self, const char* text) {
+  gboolean is_converting = keebie_application_is_converting_locked(self);
+  if (is_converting && strcmp(text, " ") == 0) {
+    keebie_application_next_conversion_locked(self);
+    return TRUE;
+  }
+
+  // Repeats which piled up come as one text, only kana if all of it is.
+  g_autoptr(GString) kana = g_string_new(nullptr);
+  gboolean is_kana = text[0] != '\0';
+  for (const char* p = text; is_kana && *p != '\0'; p = g_utf8_next_char(p)) {
+    is_kana = keebie_romaji_append(kana, g_utf8_get_char(p));
   }
+
+  if (is_kana && (is_converting || keebie_application_get_lattice_locked(self) != nullptr)) {
+    // Typing on after picking a conversion keeps it, as does starting a
+    // reading after a composition of Dart's.
+    if (self->conversion >= 0) {
+      keebie_application_finish_conversion_locked(self);
+    } else if (!is_converting && keebie_composition_is_active(&self->composition)) {
+      keebie_application_finish_composing_locked(self, nullptr);
+    }
+
+    for (const char* p = text; *p != '\0'; p = g_utf8_next_char(p)) {
+      keebie_romaji_append(self->reading, g_utf8_get_char(p));
+    }
+    keebie_application_set_reading_locked(self);
+    return TRUE;
+  }
+
+  if (is_converting) {
+    keebie_application_finish_conversion_locked(self);
+  }
+  return FALSE;
+}
+
+// Backspace goes back from a conversion to its reading first, then takes
+// kana off the end of the reading.
+static void keebie_application_delete_reading_locked(KeebieApplication* self, guint count) {
+  if (self->conversion < 0) {
+    glong length = g_utf8_strlen(self->reading->str, -1);
+    glong kept = length > static_cast<glong>(count) ? length - count : 0;
+    g_string_truncate(self->reading, g_utf8_offset_to_pointer(self->reading->str, kept) - self->reading->str);
+  }
+  keebie_application_set_reading_locked(self);
+}
+
+static gchar* keebie_application_get_composing_word_locked(KeebieApplication* self) {
+  if (keebie_composition_is_active(&self->composition)) {
+    return g_strdup(self->composition.text->str);
+  }
+  return keebie_surrounding_get_word_before_cursor(&self->im_state.surrounding);
+}
+
+// The word before the one being typed, the way the user model keeps it.
+static gchar* keebie_application_get_context_word_locked(KeebieApplication* self, const char* word) {
+  const KeebieSurrounding* surrounding = &self->im_state.surrounding;
+
+  // A composition sits at the cursor, otherwise the word being typed ends there.
+  uint32_t offset = surrounding->cursor;
+  if (!keebie_composition_is_active(&self->composition)) {
+    offset -= MIN(offset, strlen(word));
+  }
+
+  KeebieSurroundingWord previous;
+  if (!keebie_surrounding_get_previous_word(surrounding, offset, &previous)) {
+    return nullptr;
+  }
+  return keebie_user_model_normalize_word(surrounding->text + previous.start, previous.end - previous.start, previous.starts_sentence);
+}
+
+static void keebie_application_im_delete_locked(KeebieApplication* self, uint32_t before, uint32_t after) {
+  keebie_commit_queue_delete_surrounding(self->commit_queue, before, after);
+  keebie_surrounding_delete(&self->im_state.surrounding, before, after);
+}
+
+static gchar* keebie_application_set_first_case(const char* word, gboolean is_upper) {
+  gunichar first = g_utf8_get_char(word);
+  gchar head[6];
+  gint head_len = g_unichar_to_utf8(is_upper ? g_unichar_toupper(first) : g_unichar_tolower(first), head);
+  return g_strdup_printf("%.*s%s", head_len, head, g_utf8_next_char(word));
+}
+
+static uint32_t keebie_application_get_user_count(KeebieApplication* self, const char* context, const char* word, const char* lower) {
+  if (self->user_model == nullptr) {
+    return 0;
+  }
+
+  uint32_t count = keebie_user_model_get_count(self->user_model, context, word);
+  return lower != nullptr ? MAX(count, keebie_user_model_get_count(self->user_model, context, lower)) : count;
+}
+
+static gboolean keebie_application_is_adjacent(gunichar a, gunichar b, gpointer user_data) {
+  return keebie_key_adjacency_contains(reinterpret_cast<KeebieKeyAdjacency*>(user_data), a, b);
+}
+
+static KeebieKeyAdjacency* keebie_application_get_key_adjacency_locked(KeebieApplication* self) {
+  if (self->key_adjacency != nullptr || self->layout == nullptr || self->geometry_cache == nullptr) {
+    return self->key_adjacency;
+  }
+
+  int32_t plane = keebie_layout_get_content_plane(self->layout, KEEBIE_CONTENT_TYPE_TEXT);
+
+  // Only where keys are relative to each other matters, not their size.
+  KeebieGeometryParams params = {};
+  params.plane = plane >= 0 ? plane : 0;
+  params.child_size = 1.0f;
+  g_autoptr(KeebieGeometry) geometry = keebie_geometry_cache_get(self->geometry_cache, self->layout, &params);
+  self->key_adjacency = keebie_key_adjacency_new(self->layout, geometry, params.plane);
+  return self->key_adjacency;
+}
+
+// Hands out the decoder once it knows the keys of the plane and the words of
+// the current language, or NULL when swiping makes no sense right now.
+static KeebieSwipeDecoder* keebie_application_get_swipe_decoder_locked(KeebieApplication* self, const KeebieGeometryParams* params) {
+  if (!self->swipe_typing || self->swipe_decoder == nullptr || self->layout == nullptr || self->geometry_cache == nullptr
+      || !keebie_im_state_wants_correction(&self->im_state)) {
+    return nullptr;
+  }
+
+  KeebieDictionary* dictionary = keebie_application_get_dictionary_locked(self);
+  if (dictionary == nullptr) {
+    return nullptr;
+  }
+
+  // The cache hands out a new geometry for a new layout, holding on to the
+  // old one keeps it from being mistaken for it.
+  g_autoptr(KeebieGeometry) geometry = keebie_geometry_cache_get(self->geometry_cache, self->layout, params);
+  if (geometry != self->swipe_geometry || dictionary != self->swipe_dictionary) {
+    keebie_swipe_decoder_set_keyboard(self->swipe_decoder, dictionary, self->layout, geometry, params->plane);
+    g_clear_pointer(&self->swipe_geometry, keebie_geometry_unref);
+    self->swipe_geometry = keebie_geometry_ref(geometry);
+    self->swipe_dictionary = dictionary;
+  }
+  return self->swipe_decoder;
+}
+
+static void keebie_application_clear_correction_locked(KeebieApplication* self) {
+  g_clear_pointer(&self->corrected_word, g_free);
+  g_clear_pointer(&self->correction, g_free);
+}
+
+static gboolean keebie_application_ends_word(const char* text) {
+  // Apostrophes and hyphens join words rather than end them.
+  gunichar c = g_utf8_get_char(text);
+  return g_unichar_isspace(c) || (g_unichar_ispunct(c) && c != '\'' && c != '-');
+}
+
+// Replaces the word before the cursor with the dictionary's best correction
+// of it, when it is neither a known word nor one the user typed before.
+// Returns the replacement.
+static gchar* keebie_application_correct_word_locked(KeebieApplication* self, const char* word) {
+  if (g_utf8_strlen(word, -1) < KEEBIE_APPLICATION_CORRECTION_MIN_LENGTH || g_strcmp0(word, self->rejected_correction) == 0) {
+    return nullptr;
+  }
+
+  // Lowercase and capitalized words only, any other casing was deliberate.
+  gboolean is_capitalized = FALSE;
+  for (const char* p = word; *p != '\0'; p = g_utf8_next_char(p)) {
+    gunichar c = g_utf8_get_char(p);
+    if (!g_unichar_isalpha(c) || (g_unichar_isupper(c) && p != word)) {
+      return nullptr;
+    }
+    is_capitalized |= g_unichar_isupper(c);
+  }
+
+  KeebieDictionary* dictionary = keebie_application_get_dictionary_locked(self);
+  if (dictionary == nullptr) {
+    return nullptr;
+  }
+
+  g_autofree gchar* lower = is_capitalized ? keebie_application_set_first_case(word, FALSE) : g_strdup(word);
+  if (keebie_dictionary_lookup(dictionary, word) > 0 || keebie_dictionary_lookup(dictionary, lower) > 0
+      || keebie_application_get_user_count(self, nullptr, word, lower) > 0) {
+    return nullptr;
+  }
+
+  KeebieKeyAdjacency* adjacency = keebie_application_get_key_adjacency_locked(self);
+  g_autoptr(GPtrArray) corrections = g_ptr_array_new_with_free_func(g_free);
+  if (keebie_dictionary_correct(dictionary, lower, adjacency != nullptr ? keebie_application_is_adjacent : nullptr, adjacency, 1, corrections) == 0) {
+    return nullptr;
+  }
+
+  const char* best = reinterpret_cast<const char*>(g_ptr_array_index(corrections, 0));
+  return is_capitalized ? keebie_application_set_first_case(best, TRUE) : g_strdup(best);
+}
+
+// Commits what was typed, correcting the word it ends first. Both go out in
+// the same transaction, the correction never holds up the commit.
+static gboolean keebie_application_commit_typed_locked(KeebieApplication* self, const char* text) {
+  keebie_application_clear_correction_locked(self);
+
+  // What ends a conversion was not typed against the dictionary either.
+  gboolean was_converting = keebie_application_is_converting_locked(self);
+  if (keebie_application_convert_typed_locked(self, text)) {
+    return TRUE;
+  }
+
+  if (!self->autocorrect || self->input_method == nullptr || was_converting || !keebie_application_ends_word(text)
+      || keebie_composition_is_active(&self->composition) || !keebie_im_state_wants_correction(&self->im_state)) {
+    return keebie_application_commit_text_locked(self, text);
+  }
+
+  g_autofree gchar* word = keebie_surrounding_get_word_before_cursor(&self->im_state.surrounding);
+  g_autofree gchar* replacement = word != nullptr ? keebie_application_correct_word_locked(self, word) : nullptr;
+  if (replacement != nullptr) {
+    keebie_application_im_delete_locked(self, strlen(word), 0);
+    keebie_application_commit_text_locked(self, replacement);
+  }
+
+  gboolean result = keebie_application_commit_text_locked(self, text);
+  if (replacement != nullptr) {
+    self->corrected_word = reinterpret_cast<gchar*>(g_steal_pointer(&word));
+    self->correction = g_strconcat(replacement, text, nullptr);
+  }
+  return result;
+}
+
+// Puts the word back the way it was typed when the cursor still sits right
+// after its correction, minus what ended it.
+static gboolean keebie_application_undo_correction_locked(KeebieApplication* self) {
+  const KeebieSurrounding* surrounding = &self->im_state.surrounding;
+  if (self->correction == nullptr || self->input_method == nullptr || surrounding->text == nullptr
+      || surrounding->cursor != surrounding->anchor || keebie_composition_is_active(&self->composition)) {
+    return FALSE;
+  }
+
+  gsize length = strlen(self->correction);
+  if (surrounding->cursor < length || strncmp(surrounding->text + surrounding->cursor - length, self->correction, length) != 0) {
+    return FALSE;
+  }
+
+  keebie_application_im_delete_locked(self, length, 0);
+  keebie_application_commit_text_locked(self, self->corrected_word);
+
+  // Ending the word again keeps it, and teaches the user model it is a word.
+  g_free(self->rejected_correction);
+  self->rejected_correction = reinterpret_cast<gchar*>(g_steal_pointer(&self->corrected_word));
+  g_clear_pointer(&self->correction, g_free);
+  return TRUE;
+}
+
+static gboolean keebie_application_replace_word_locked(KeebieApplication* self, const char* text) {
+  keebie_application_clear_correction_locked(self);
+
+  // Conversions replace the reading as they are, without the word's space.
+  if (keebie_application_is_converting_locked(self)) {
+    g_autofree gchar* conversion = g_strchomp(g_strdup(text));
+    keebie_application_finish_composing_locked(self, conversion);
+    return TRUE;
+  }
+
+  if (keebie_composition_is_active(&self->composition)) {
+    keebie_application_finish_composing_locked(self, text);
+    return TRUE;
+  }
+
+  g_autofree gchar* word = keebie_surrounding_get_word_before_cursor(&self->im_state.surrounding);
+  if (word == nullptr || self->input_method == nullptr) {
+    return FALSE;
+  }
+
+  if (word[0] != '\0') {
+    keebie_application_im_delete_locked(self, strlen(word), 0);
+  }
+  return keebie_application_commit_text_locked(self, text);
+}
+
+// Picked rather than typed, so the word before it is left as it is.
+static gboolean keebie_application_commit_emoji_locked(KeebieApplication* self, const char* text) {
+  keebie_application_clear_correction_locked(self);
+  if (keebie_application_is_converting_locked(self)) {
+    keebie_application_finish_conversion_locked(self);
+  }
+
+  if (!keebie_application_commit_text_locked(self, text)) {
+    return FALSE;
+  }
+
+  if (self->emoji_history != nullptr) {
+    keebie_frecency_use(self->emoji_history, text);
+  }
+  return TRUE;
+}
+
+static gboolean keebie_application_delete_surrounding_locked(KeebieApplication* self, uint32_t before, uint32_t after) {
+  // Lengths are in bytes on the wire, only the surrounding text tells how many.
+  if (self->input_method != nullptr && self->im_state.surrounding.text != nullptr) {
+    uint32_t before_bytes;
+    uint32_t after_bytes;
+    keebie_surrounding_get_char_range(&self->im_state.surrounding, before, after, &before_bytes, &after_bytes);
+
+    if (before_bytes > 0 || after_bytes > 0) {
+      keebie_application_im_delete_locked(self, before_bytes, after_bytes);
+    }
+    return TRUE;
+  }
+
+  if (self->virtual_keyboard != nullptr) {
+    while ((before--) > 0) {
+      keebie_application_send_key_locked(self, KEY_BACKSPACE);
+    }
+
+    while ((after--) > 0) {
+      keebie_application_send_key_locked(self, KEY_DELETE);
+    }
+
+    wl_display_flush(self->display);
+    return TRUE;
+  }
+
+  if (self->input_method != nullptr) {
+    keebie_application_im_delete_locked(self, before, after);
+    return TRUE;
+  }
+  return FALSE;
+}
+
+static gboolean keebie_application_delete_locked(KeebieApplication* self, KeebieDeleteUnit unit, guint count);
+
+static gboolean keebie_application_commit_swipe_locked(KeebieApplication* self, const char* word, guint taken_back, gboolean is_shifted) {
+  keebie_application_clear_correction_locked(self);
+  if (taken_back > 0) {
+    keebie_application_delete_locked(self, KEEBIE_DELETE_CHAR, taken_back);
+  }
+
+  // Swiped words come one after another without a space key in between,
+  // without the text there is no telling whether one is needed.
+  const KeebieSurrounding* surrounding = &self->im_state.surrounding;
+  gboolean needs_space = FALSE;
+  if (surrounding->text != nullptr && surrounding->cursor > 0 && !keebie_composition_is_active(&self->composition)) {
+    gunichar c = g_utf8_get_char(g_utf8_find_prev_char(surrounding->text, surrounding->text + surrounding->cursor));
+    GUnicodeType type = g_unichar_type(c);
+    needs_space = !g_unichar_isspace(c) && type != G_UNICODE_OPEN_PUNCTUATION && type != G_UNICODE_INITIAL_PUNCTUATION;
+  }
+
+  g_autofree gchar* cased = is_shifted ? keebie_application_set_first_case(word, TRUE) : g_strdup(word);
+  g_autofree gchar* text = g_strconcat(needs_space ? " " : "", cased, nullptr);
+  return keebie_application_commit_text_locked(self, text);
+}
+
+static gboolean keebie_application_delete_locked(KeebieApplication* self, KeebieDeleteUnit unit, guint count) {
+  // A single backspace right after an autocorrection takes it back.
+  if (unit == KEEBIE_DELETE_CHAR && count == 1 && keebie_application_undo_correction_locked(self)) {
+    return TRUE;
+  }
+  keebie_application_clear_correction_locked(self);
+
+  if (unit == KEEBIE_DELETE_CHAR && keebie_application_is_converting_locked(self)) {
+    keebie_application_delete_reading_locked(self, count);
+    return TRUE;
+  }
+
+  // Deleting while composing edits the composition, bigger units drop it whole.
+  if (keebie_composition_is_active(&self->composition)) {
+    if (unit != KEEBIE_DELETE_CHAR || !keebie_composition_delete(&self->composition, count)) {
+      keebie_composition_clear(&self->composition);
+      keebie_application_reset_conversion_locked(self);
+    }
+    keebie_application_update_preedit_locked(self);
+    return TRUE;
+  }
+
+  if (self->input_method != nullptr && self->im_state.surrounding.text != nullptr) {
+    uint32_t before;
+    uint32_t after;
+    if (!keebie_surrounding_get_delete_range(&self->im_state.surrounding, unit, count, &before, &after)) {
+      return FALSE;
+    }
+
+    keebie_application_im_delete_locked(self, before, after);
+    return TRUE;
+  }
+
+  switch (unit) {
+    case KEEBIE_DELETE_CHAR:
+      return keebie_application_delete_surrounding_locked(self, count, 0);
+    case KEEBIE_DELETE_SELECTION:
+      return keebie_application_delete_surrounding_locked(self, 1, 0);
+    case KEEBIE_DELETE_WORD:
+      if (self->virtual_keyboard != nullptr) {
+        // Without the text, the client's own Ctrl+BackSpace is the next best thing.
+        zwp_virtual_keyboard_v1_modifiers(self->virtual_keyboard, KEEBIE_APPLICATION_CONTROL_MASK, 0, 0, 0);
+        for (guint i = 0; i < count; i++) {
+          keebie_application_send_key_locked(self, KEY_BACKSPACE);
+        }
+        zwp_virtual_keyboard_v1_modifiers(self->virtual_keyboard, 0, 0, 0, 0);
+
+        wl_display_flush(self->display);
+        return TRUE;
+      }
+      return FALSE;
+    default:
+      return FALSE;
+  }
+}
+
+void keebie_application_keymap(KeebieApplication* self) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+
+  // Every client recompiles on a new keymap, so never upload the same one twice.
+  KeebieKeymap* keymap = keebie_application_get_effective_keymap(self);
+  if (self->virtual_keyboard != nullptr && keymap != nullptr && (keymap->hash == 0 || keymap->hash != self->uploaded_keymap_hash)) {
+    zwp_virtual_keyboard_v1_keymap(
+      self->virtual_keyboard,
+      keymap->format,
+      keymap->fd,
+      keymap->size
+    );
+    self->uploaded_keymap_hash = keymap->hash;
+  }
+}
+
+void keebie_application_set_layout(KeebieApplication* self, KeebieLayout* layout) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+
+  // A reading belongs to the language it was typed in, what it shows goes
+  // into the text before the next one takes over.
+  if (keebie_application_is_converting_locked(self)) {
+    keebie_application_finish_conversion_locked(self);
+  }
+  g_clear_pointer(&self->lattice, keebie_lattice_free);
+
+  g_clear_pointer(&self->layout, keebie_layout_unref);
+  g_clear_pointer(&self->layout_name, g_free);
+  if (layout != nullptr) {
+    self->layout = keebie_layout_ref(layout);
+  }
+
+  if (self->geometry_cache != nullptr) {
+    keebie_geometry_cache_clear(self->geometry_cache);
+  }
+  g_clear_pointer(&self->key_adjacency, keebie_key_adjacency_free);
+}
+
+void keebie_application_get_im_state(KeebieApplication* self, KeebieImState* state) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  keebie_im_state_copy(state, &self->im_state);
+}
+
+KeebieLayout* keebie_application_get_layout_by_name(KeebieApplication* self, const char* name) {
+  g_autoptr(GError) error = nullptr;
+  KeebieLayout* layout = keebie_layout_registry_get(self->layout_registry, name, &error);
+  if (layout == nullptr) {
+    g_debug("Failed to load layout %s: %s", name, error->message);
+  }
+  return layout;
+}
+
+gboolean keebie_application_activate_layout(KeebieApplication* self, const char* name) {
+  g_autoptr(KeebieLayout) layout = keebie_application_get_layout_by_name(self, name);
+  if (layout == nullptr) {
+    return FALSE;
+  }
+
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  keebie_application_set_layout(self, layout);
+  self->layout_name = g_strdup(name);
+  return TRUE;
+}
+
+KeebieGeometry* keebie_application_get_geometry(KeebieApplication* self, const KeebieGeometryParams* params) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+
+  if (self->layout == nullptr || self->geometry_cache == nullptr) {
+    return nullptr;
+  }
+  return keebie_geometry_cache_get(self->geometry_cache, self->layout, params);
+}
+
+typedef struct {
+  KeebieDictionary* dictionary;
+  const char* word;
+  uint32_t best;
+} KeebieApplicationTouchPrior;
+
+// How likely the dictionary thinks text continues the word being typed,
+// relative to its likeliest continuation.
+static float keebie_application_touch_prior(const char* text, gpointer user_data) {
+  const KeebieApplicationTouchPrior* prior = reinterpret_cast<const KeebieApplicationTouchPrior*>(user_data);
+  if (text == nullptr || text[0] == '\0' || (keebie_application_ends_word(text) && prior->word[0] == '\0')) {
+    return KEEBIE_APPLICATION_TOUCH_PRIOR_NEUTRAL;
+  }
+
+  uint32_t frequency;
+  if (keebie_application_ends_word(text)) {
+    frequency = keebie_dictionary_lookup(prior->dictionary, prior->word);
+  } else {
+    g_autofree gchar* lower = g_utf8_strdown(text, -1);
+    g_autofree gchar* next = g_strconcat(prior->word, lower, nullptr);
+    frequency = keebie_dictionary_get_best(prior->dictionary, next);
+  }
+  return frequency > 0 ? logf(static_cast<float>(frequency) / prior->best) : -G_MAXFLOAT;
+}
+
+gint keebie_application_resolve_touch(KeebieApplication* self, const KeebieGeometryParams* params, float x, float y) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+
+  if (self->layout == nullptr || self->geometry_cache == nullptr || self->touch_model == nullptr) {
+    return -1;
+  }
+  g_autoptr(KeebieGeometry) geometry = keebie_geometry_cache_get(self->geometry_cache, self->layout, params);
+
+  // Outside of prose, or past what the dictionary knows, only the geometry
+  // has a say.
+  KeebieApplicationTouchPrior prior = {};
+  g_autofree gchar* word = nullptr;
+  if (keebie_im_state_wants_correction(&self->im_state)) {
+    prior.dictionary = keebie_application_get_dictionary_locked(self);
+    g_autofree gchar* composing = prior.dictionary != nullptr ? keebie_application_get_composing_word_locked(self) : nullptr;
+    word = composing != nullptr ? g_utf8_strdown(composing, -1) : nullptr;
+    prior.word = word;
+    prior.best = word != nullptr ? keebie_dictionary_get_best(prior.dictionary, word) : 0;
+  }
+
+  return keebie_touch_model_resolve(self->touch_model, self->layout, geometry, params->plane, x, y,
+    prior.best > 0 ? keebie_application_touch_prior : nullptr, &prior);
+}
+
+/**
+ * A language for a worker to load, with a keymap only where there is a
+ * virtual keyboard to upload it to.
+ */
+typedef struct {
+  gchar* name;
+  gboolean wants_keymap;
+} KeebieLanguageLoad;
+
+static void keebie_language_load_free(KeebieLanguageLoad* self) {
+  g_free(self->name);
+  g_free(self);
+}
+
+// Runs on a worker, compiling a keymap can take far longer than a frame.
+// The language comes back whole for the callback to swap in.
+static void keebie_application_load_language_thread(GTask* task, gpointer source_object, gpointer task_data, GCancellable* cancellable) {
+  KeebieApplication* self = KEEBIE_APPLICATION(source_object);
+  const KeebieLanguageLoad* request = reinterpret_cast<const KeebieLanguageLoad*>(task_data);
+
+  g_autoptr(GError) error = nullptr;
+  KeebieLayout* layout = keebie_layout_registry_get(self->layout_registry, request->name, &error);
+  if (layout == nullptr) {
+    g_task_return_error(task, reinterpret_cast<GError*>(g_steal_pointer(&error)));
+    return;
+  }
+
+  KeebieLanguage* language = g_new0(KeebieLanguage, 1);
+  language->name = g_strdup(request->name);
+  language->layout = layout;
+
+  // Contexts are not thread safe, the worker gets one of its own.
+  if (request->wants_keymap) {
+    const char* xkb_layout = get_locale_xkb_layout(keebie_layout_get_locale(layout));
+    struct xkb_context* context = xkb_layout != nullptr ? xkb_context_new(XKB_CONTEXT_NO_FLAGS) : nullptr;
+    if (context != nullptr) {
+      language->keymap = keebie_keymap_new_from_names(context, xkb_layout);
+      xkb_context_unref(context);
+    }
+  }
+  g_task_return_pointer(task, language, (GDestroyNotify)keebie_language_free);
+}
+
+static void keebie_application_preload_languages_locked(KeebieApplication* self);
+
+static void keebie_application_load_language_cb(GObject* source_object, GAsyncResult* result, gpointer user_data) {
+  KeebieApplication* self = KEEBIE_APPLICATION(source_object);
+  GTask* task = G_TASK(result);
+  const KeebieLanguageLoad* request = reinterpret_cast<const KeebieLanguageLoad*>(g_task_get_task_data(task));
+
+  g_autoptr(GError) error = nullptr;
+  KeebieLanguage* loaded = reinterpret_cast<KeebieLanguage*>(g_task_propagate_pointer(task, &error));
+
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  self->is_preloading = FALSE;
+
+  // The languages may have been set anew meanwhile, only the one still
+  // waiting for it takes what was loaded.
+  for (guint i = 0; self->languages != nullptr && i < self->languages->len; i++) {
+    KeebieLanguage* language = reinterpret_cast<KeebieLanguage*>(g_ptr_array_index(self->languages, i));
+    if (language->layout != nullptr || g_strcmp0(language->name, request->name) != 0) {
+      continue;
+    }
+
+    if (loaded == nullptr) {
+      g_warning("Failed to preload layout %s: %s", language->name, error->message);
+      g_ptr_array_remove_index(self->languages, i);
+    } else {
+      language->layout = reinterpret_cast<KeebieLayout*>(g_steal_pointer(&loaded->layout));
+      language->keymap = reinterpret_cast<KeebieKeymap*>(g_steal_pointer(&loaded->keymap));
+    }
+    break;
+  }
+  g_clear_pointer(&loaded, keebie_language_free);
+
+  keebie_application_preload_languages_locked(self);
+}
+
+// Loads one language at a time off the lock, each one's result starts the
+// next.
+static void keebie_application_preload_languages_locked(KeebieApplication* self) {
+  if (self->is_preloading || self->languages == nullptr) {
+    return;
+  }
+
+  for (guint i = 0; i < self->languages->len; i++) {
+    KeebieLanguage* language = reinterpret_cast<KeebieLanguage*>(g_ptr_array_index(self->languages, i));
+    if (language->layout != nullptr) {
+      continue;
+    }
+
+    KeebieLanguageLoad* request = g_new0(KeebieLanguageLoad, 1);
+    request->name = g_strdup(language->name);
+    request->wants_keymap = self->virtual_keyboard != nullptr;
+
+    g_autoptr(GTask) task = g_task_new(self, nullptr, keebie_application_load_language_cb, nullptr);
+    g_task_set_task_data(task, request, (GDestroyNotify)keebie_language_load_free);
+    g_task_run_in_thread(task, keebie_application_load_language_thread);
+    self->is_preloading = TRUE;
+    return;
+  }
+}
+
+void keebie_application_set_languages(KeebieApplication* self, const char* const* names) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+
+  g_autoptr(GPtrArray) languages = g_ptr_array_new_with_free_func((GDestroyNotify)keebie_language_free);
+  for (size_t i = 0; names[i] != nullptr; i++) {
+    KeebieLanguage* language = g_new0(KeebieLanguage, 1);
+    language->name = g_strdup(names[i]);
+
+    // Whatever was preloaded already carries over.
+    for (guint x = 0; self->languages != nullptr && x < self->languages->len; x++) {
+      KeebieLanguage* old = reinterpret_cast<KeebieLanguage*>(g_ptr_array_index(self->languages, x));
+      if (g_strcmp0(old->name, language->name) == 0) {
+        language->layout = old->layout != nullptr ? keebie_layout_ref(old->layout) : nullptr;
+        language->keymap = old->keymap != nullptr ? keebie_keymap_ref(old->keymap) : nullptr;
+        break;
+      }
+    }
+
+    g_ptr_array_add(languages, language);
+  }
+
+  g_clear_pointer(&self->languages, g_ptr_array_unref);
+  self->languages = reinterpret_cast<GPtrArray*>(g_steal_pointer(&languages));
+
+  keebie_application_preload_languages_locked(self);
+}
+
+gchar* keebie_application_change_language(KeebieApplication* self) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+
+  if (self->languages == nullptr || self->languages->len == 0) {
+    return nullptr;
+  }
+
+  guint current = self->languages->len - 1;
+  for (guint i = 0; i < self->languages->len; i++) {
+    KeebieLanguage* language = reinterpret_cast<KeebieLanguage*>(g_ptr_array_index(self->languages, i));
+    if (g_strcmp0(language->name, self->layout_name) == 0) {
+      current = i;
+      break;
+    }
+  }
+
+  // Languages still being preloaded are skipped, nothing is compiled here.
+  KeebieLanguage* language = nullptr;
+  for (guint i = 1; i <= self->languages->len && language == nullptr; i++) {
+    KeebieLanguage* next = reinterpret_cast<KeebieLanguage*>(g_ptr_array_index(self->languages, (current + i) % self->languages->len));
+    if (next->layout != nullptr) {
+      language = next;
+    }
+  }
+
+  if (language == nullptr) {
+    return nullptr;
+  }
+
+  keebie_application_set_layout(self, language->layout);
+  self->layout_name = g_strdup(language->name);
+
+  if (language->keymap != nullptr && language->keymap != self->keymap) {
+    g_clear_pointer(&self->keymap, keebie_keymap_unref);
+    self->keymap = keebie_keymap_ref(language->keymap);
+
+    // The virtual keyboard lives on the input thread's queue.
+    KeebieInputCommand command = {};
+    command.type = KEEBIE_INPUT_UPLOAD_KEYMAP;
+    keebie_application_run_input(self, &command);
+  }
+  return g_strdup(language->name);
+}
+
+static int keebie_application_perform_key_locked(KeebieApplication* self, guint plane, guint row, guint key, gboolean is_shifted, guint count) {
+  if (self->layout == nullptr) {
+    return -1;
+  }
+
+  const KeebieKeyAction* action = keebie_layout_lookup(self->layout, plane, row, key);
+  if (action == nullptr) {
+    return -1;
+  }
+
+  gboolean result = FALSE;
+  switch (action->type) {
+    case KEEBIE_KEY_ACTION_COMMIT:
+      {
+        // Repeats which piled up go out as one commit.
+        const char* text = keebie_layout_get_text(self->layout, action, is_shifted);
+        g_autoptr(GString) str = g_string_new(nullptr);
+        for (guint i = 0; i < count; i++) {
+          g_string_append(str, text);
+        }
+        result = keebie_application_commit_typed_locked(self, str->str);
+      }
+      break;
+    case KEEBIE_KEY_ACTION_KEYCODE:
+      // Enter commits the reading, or its conversion, instead of a newline.
+      if (action->arg == KEY_ENTER && keebie_application_is_converting_locked(self)) {
+        keebie_application_finish_conversion_locked(self);
+        result = TRUE;
+        break;
+      }
+
+      for (guint i = 0; i < count; i++) {
+        result = keebie_application_send_key_locked(self, action->arg);
+      }
+
+      if (result) {
+        wl_display_flush(self->display);
+      }
+      break;
+    case KEEBIE_KEY_ACTION_DELETE:
+      if (self->held_repeats >= KEEBIE_APPLICATION_WORD_DELETE_REPEATS) {
+        result = keebie_application_delete_locked(self, KEEBIE_DELETE_WORD, count);
+      } else {
+        result = keebie_application_delete_locked(self, KEEBIE_DELETE_CHAR, action->arg * count);
+      }
+      break;
+    case KEEBIE_KEY_ACTION_CHANGE_LANG:
+      {
+        g_autofree gchar* name = keebie_application_change_language(self);
+        result = name != nullptr;
+      }
+      break;
+    case KEEBIE_KEY_ACTION_PLANE:
+    case KEEBIE_KEY_ACTION_SHIFT:
+      // Plane and shift state is owned by the Flutter side.
+      result = TRUE;
+      break;
+    default:
+      break;
+  }
+  return result ? action->type : -1;
+}
+
+static void keebie_application_key_repeat(guint count, gpointer data) {
+  KeebieApplication* self = KEEBIE_APPLICATION(data);
+
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  self->held_repeats += count;
+  if (keebie_application_perform_key_locked(self, self->held_plane, self->held_row, self->held_key, self->held_is_shifted, count) < 0) {
+    keebie_key_repeat_stop(self->key_repeat);
+  }
+}
+
+static int keebie_application_press_key_locked(KeebieApplication* self, guint plane, guint row, guint key, gboolean is_shifted) {
+  keebie_key_repeat_stop(self->key_repeat);
+  self->held_repeats = 0;
+
+  int type = keebie_application_perform_key_locked(self, plane, row, key, is_shifted, 1);
+  if (type == KEEBIE_KEY_ACTION_COMMIT || type == KEEBIE_KEY_ACTION_KEYCODE || type == KEEBIE_KEY_ACTION_DELETE) {
+    self->held_plane = plane;
+    self->held_row = row;
+    self->held_key = key;
+    self->held_is_shifted = is_shifted;
+    keebie_key_repeat_start(self->key_repeat);
+  }
+  return type;
+}
+
+static void keebie_application_input_command(const KeebieInputCommand* command, gpointer data) {
+  KeebieApplication* self = KEEBIE_APPLICATION(data);
+
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  switch (command->type) {
+    case KEEBIE_INPUT_COMMIT_TEXT:
+      keebie_application_commit_typed_locked(self, command->text);
+      break;
+    case KEEBIE_INPUT_COMMIT_EMOJI:
+      keebie_application_commit_emoji_locked(self, command->text);
+      break;
+    case KEEBIE_INPUT_SEND_KEY:
+      if (keebie_application_send_key_locked(self, command->args[0])) {
+        wl_display_flush(self->display);
+      }
+      break;
+    case KEEBIE_INPUT_DELETE_SURROUNDING:
+      keebie_application_delete_surrounding_locked(self, command->args[0], command->args[1]);
+      break;
+    case KEEBIE_INPUT_DELETE:
+      keebie_application_delete_locked(self, static_cast<KeebieDeleteUnit>(command->args[0]), command->args[1]);
+      break;
+    case KEEBIE_INPUT_ACTIVATE_KEY:
+      keebie_application_perform_key_locked(self, command->args[0], command->args[1], command->args[2], command->is_shifted, 1);
+      break;
+    case KEEBIE_INPUT_PRESS_KEY:
+      keebie_application_press_key_locked(self, command->args[0], command->args[1], command->args[2], command->is_shifted);
+      break;
+    case KEEBIE_INPUT_RELEASE_KEY:
+      // A key pressed meanwhile took over the repeat, only its own release stops it.
+      if (command->args[0] == self->held_plane && command->args[1] == self->held_row && command->args[2] == self->held_key) {
+        keebie_key_repeat_stop(self->key_repeat);
+        self->held_repeats = 0;
+      }
+      break;
+    case KEEBIE_INPUT_COMPOSE:
+      keebie_application_compose_locked(self, command->args[0], command->args[1], command->text);
+      break;
+    case KEEBIE_INPUT_SET_COMPOSING_CURSOR:
+      keebie_application_set_composing_cursor_locked(self, command->args[0], command->args[1]);
+      break;
+    case KEEBIE_INPUT_FINISH_COMPOSING:
+      keebie_application_finish_composing_locked(self, command->text);
+      break;
+    case KEEBIE_INPUT_REPLACE_WORD:
+      keebie_application_replace_word_locked(self, command->text);
+      break;
+    case KEEBIE_INPUT_COMMIT_SWIPE:
+      keebie_application_commit_swipe_locked(self, command->text, command->args[0], command->is_shifted);
+      break;
+    case KEEBIE_INPUT_UPLOAD_KEYMAP:
+      keebie_application_keymap(self);
+      if (self->display != nullptr) {
+        wl_display_flush(self->display);
+      }
+      break;
+  }
+}
+
+// Returns FALSE when the input thread is too far behind to take the command.
+static gboolean keebie_application_run_input(KeebieApplication* self, const KeebieInputCommand* command) {
+  if (self->input_thread == nullptr) {
+    return FALSE;
+  }
+
+  if (keebie_input_thread_is_current(self->input_thread)) {
+    keebie_application_input_command(command, self);
+    return TRUE;
+  }
+
+  if (!keebie_input_thread_push(self->input_thread, command)) {
+    g_warning("Input thread is behind, dropped a key action");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean keebie_application_has_output(KeebieApplication* self) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  return self->input_method != nullptr || self->virtual_keyboard != nullptr;
+}
+
+gboolean keebie_application_commit_text(KeebieApplication* self, const char* text) {
+  if (!keebie_application_has_output(self)) {
+    return FALSE;
+  }
+
+  KeebieInputCommand command = {};
+  command.type = KEEBIE_INPUT_COMMIT_TEXT;
+  command.text = const_cast<gchar*>(text);
+  return keebie_application_run_input(self, &command);
+}
+
+static gboolean keebie_application_has_input_method(KeebieApplication* self) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  return self->input_method != nullptr;
+}
+
+gboolean keebie_application_compose(KeebieApplication* self, uint32_t start, uint32_t end, const char* text) {
+  if (!keebie_application_has_input_method(self)) {
+    return FALSE;
+  }
+
+  KeebieInputCommand command = {};
+  command.type = KEEBIE_INPUT_COMPOSE;
+  command.args[0] = start;
+  command.args[1] = end;
+  command.text = const_cast<gchar*>(text);
+  return keebie_application_run_input(self, &command);
+}
+
+gboolean keebie_application_set_composing_cursor(KeebieApplication* self, uint32_t begin, uint32_t end) {
+  if (!keebie_application_has_input_method(self)) {
+    return FALSE;
+  }
+
+  KeebieInputCommand command = {};
+  command.type = KEEBIE_INPUT_SET_COMPOSING_CURSOR;
+  command.args[0] = begin;
+  command.args[1] = end;
+  return keebie_application_run_input(self, &command);
+}
+
+gboolean keebie_application_finish_composing(KeebieApplication* self, const char* text) {
+  if (!keebie_application_has_output(self)) {
+    return FALSE;
+  }
+
+  KeebieInputCommand command = {};
+  command.type = KEEBIE_INPUT_FINISH_COMPOSING;
+  command.text = const_cast<gchar*>(text);
+  return keebie_application_run_input(self, &command);
+}
+
+gboolean keebie_application_replace_word(KeebieApplication* self, const char* text) {
+  if (!keebie_application_has_input_method(self)) {
+    return FALSE;
+  }
+
+  KeebieInputCommand command = {};
+  command.type = KEEBIE_INPUT_REPLACE_WORD;
+  command.text = const_cast<gchar*>(text);
+  return keebie_application_run_input(self, &command);
+}
+
+gboolean keebie_application_commit_swipe(KeebieApplication* self, const char* word, guint taken_back, gboolean is_shifted) {
+  if (!keebie_application_has_output(self)) {
+    return FALSE;
+  }
+
+  KeebieInputCommand command = {};
+  command.type = KEEBIE_INPUT_COMMIT_SWIPE;
+  command.is_shifted = is_shifted;
+  command.args[0] = taken_back;
+  command.text = const_cast<gchar*>(word);
+  return keebie_application_run_input(self, &command);
+}
+
+void keebie_application_set_autocorrect(KeebieApplication* self, gboolean autocorrect) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  self->autocorrect = autocorrect;
+  if (!autocorrect) {
+    keebie_application_clear_correction_locked(self);
+  }
+}
+
+void keebie_application_set_commit_on_press(KeebieApplication* self, gboolean commit_on_press) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  self->commit_on_press = commit_on_press;
+}
+
+gboolean keebie_application_get_commit_on_press(KeebieApplication* self) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  return self->commit_on_press;
+}
+
+void keebie_application_set_rollover(KeebieApplication* self, guint rollover) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  self->rollover = rollover;
+}
+
+guint keebie_application_get_rollover(KeebieApplication* self) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  return self->rollover;
+}
+
+void keebie_application_set_swipe_typing(KeebieApplication* self, gboolean swipe_typing) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  self->swipe_typing = swipe_typing;
+}
+
+gboolean keebie_application_can_swipe(KeebieApplication* self, const KeebieGeometryParams* params, guint row, guint key) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  KeebieSwipeDecoder* decoder = keebie_application_get_swipe_decoder_locked(self, params);
+  return decoder != nullptr && keebie_swipe_decoder_has_key(decoder, row, key);
+}
+
+gboolean keebie_application_decode_swipe(KeebieApplication* self, const KeebieGeometryParams* params, const float* points, guint n_points,
+    gboolean is_final, guint k, KeebieSwipeFunc func, gpointer data, GDestroyNotify destroy) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  KeebieSwipeDecoder* decoder = keebie_application_get_swipe_decoder_locked(self, params);
+  if (decoder == nullptr) {
+    return FALSE;
+  }
+
+  keebie_swipe_decoder_decode(decoder, points, n_points, is_final, k, func, data, destroy);
+  return TRUE;
+}
+
+KeebieHandwriting* keebie_application_get_handwriting(KeebieApplication* self) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  if (self->layout == nullptr) {
+    return nullptr;
+  }
+
+  const char* locale = keebie_layout_get_locale(self->layout);
+  gpointer handwriting = nullptr;
+  if (!g_hash_table_lookup_extended(self->handwritings, locale, nullptr, &handwriting)) {
+    // Templates are only loaded once a pad is shown, most never are.
+    g_autofree gchar* path = keebie_application_get_dictionary_path(locale, ".khw");
+    if (path != nullptr && g_file_test(path, G_FILE_TEST_EXISTS)) {
+      g_autoptr(GError) error = nullptr;
+      handwriting = keebie_handwriting_new_from_file(path, &error);
+      if (handwriting == nullptr) {
+        g_warning("No handwriting for %s: %s", locale, error->message);
+      }
+    }
+
+    g_hash_table_insert(self->handwritings, g_strdup(locale), handwriting);
+  }
+  return handwriting != nullptr ? keebie_handwriting_ref(reinterpret_cast<KeebieHandwriting*>(handwriting)) : nullptr;
+}
+
+static KeebieEmoji* keebie_application_get_emoji_locked(KeebieApplication* self) {
+  if (self->layout == nullptr) {
+    return nullptr;
+  }
+
+  // What was picked before matters to the picker only.
+  if (self->emoji_history == nullptr) {
+    g_autofree gchar* path = g_build_filename(g_get_user_data_dir(), "keebie", "emoji-history", nullptr);
+    self->emoji_history = keebie_frecency_new(path);
+  }
+
+  const char* locale = keebie_layout_get_locale(self->layout);
+  gpointer emoji = nullptr;
+  if (g_hash_table_lookup_extended(self->emojis, locale, nullptr, &emoji)) {
+    return reinterpret_cast<KeebieEmoji*>(emoji);
+  }
+
+  // Catalogs are only loaded once the picker is shown.
+  g_autofree gchar* path = keebie_application_get_dictionary_path(locale, ".kem");
+  if (path != nullptr && g_file_test(path, G_FILE_TEST_EXISTS)) {
+    g_autoptr(GError) error = nullptr;
+    emoji = keebie_emoji_new_from_file(path, &error);
+    if (emoji == nullptr) {
+      g_warning("No emoji for %s: %s", locale, error->message);
+    }
+  }
+
+  g_hash_table_insert(self->emojis, g_strdup(locale), emoji);
+  return reinterpret_cast<KeebieEmoji*>(emoji);
+}
+
+typedef struct {
+  KeebieFrecency* history;
+  gint64 now;
+} KeebieApplicationEmojiScore;
+
+static gdouble keebie_application_score_emoji(const char* text, gpointer data) {
+  KeebieApplicationEmojiScore* score = reinterpret_cast<KeebieApplicationEmojiScore*>(data);
+  return keebie_frecency_get_score(score->history, text, score->now);
+}
+
+gint keebie_application_search_emoji(KeebieApplication* self, const char* query, guint k, GPtrArray* results) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+  KeebieEmoji* emoji = keebie_application_get_emoji_locked(self);
+  if (emoji == nullptr) {
+    return -1;
+  }
+
+  if (query[0] != '\0') {
+    KeebieApplicationEmojiScore score = { self->emoji_history, g_get_real_time() / G_USEC_PER_SEC };
+    g_autoptr(GArray) indices = g_array_new(FALSE, FALSE, sizeof (uint32_t));
+    guint found = keebie_emoji_search(emoji, query, k, keebie_application_score_emoji, &score, indices);
+    for (guint i = 0; i < found; i++) {
+      g_ptr_array_add(results, g_strdup(keebie_emoji_get_text(emoji, g_array_index(indices, uint32_t, i))));
+    }
+    return found;
+  }
+
+  // Browsing starts with what the user picked before, then the catalog.
+  g_autoptr(GPtrArray) recent = g_ptr_array_new_with_free_func(g_free);
+  keebie_frecency_get_best(self->emoji_history, k, recent);
+  g_autoptr(GHashTable) seen = g_hash_table_new(g_str_hash, g_str_equal);
+  guint found = 0;
+  for (guint i = 0; i < recent->len; i++) {
+    const char* text = reinterpret_cast<const char*>(g_ptr_array_index(recent, i));
+    g_hash_table_add(seen, const_cast<char*>(text));
+    g_ptr_array_add(results, g_strdup(text));
+    found++;
+  }
+
+  guint n_entries = keebie_emoji_get_n_entries(emoji);
+  for (guint i = 0; i < n_entries && found < k; i++) {
+    const char* text = keebie_emoji_get_text(emoji, i);
+    if (!g_hash_table_contains(seen, text)) {
+      g_ptr_array_add(results, g_strdup(text));
+      found++;
+    }
+  }
+  return found;
+}
+
+gboolean keebie_application_commit_emoji(KeebieApplication* self, const char* text) {
+  if (!keebie_application_has_output(self)) {
+    return FALSE;
+  }
+
+  KeebieInputCommand command = {};
+  command.type = KEEBIE_INPUT_COMMIT_EMOJI;
+  command.text = const_cast<gchar*>(text);
+  return keebie_application_run_input(self, &command);
+}
+
+typedef struct {
+  const char* word;
+  uint32_t bigram;
+  uint32_t unigram;
+  guint rank;
+} KeebieApplicationCandidate;
+
+static gint keebie_application_compare_candidates(gconstpointer a, gconstpointer b) {
+  const KeebieApplicationCandidate* candidate_a = reinterpret_cast<const KeebieApplicationCandidate*>(a);
+  const KeebieApplicationCandidate* candidate_b = reinterpret_cast<const KeebieApplicationCandidate*>(b);
+  if (candidate_a->bigram != candidate_b->bigram) {
+    return candidate_a->bigram > candidate_b->bigram ? -1 : 1;
+  }
+  if (candidate_a->unigram != candidate_b->unigram) {
+    return candidate_a->unigram > candidate_b->unigram ? -1 : 1;
+  }
+  return candidate_a->rank < candidate_b->rank ? -1 : candidate_a->rank > candidate_b->rank ? 1 : 0;
+}
+
+static void keebie_application_add_candidates_locked(KeebieApplication* self, KeebieDictionary* dictionary, const char* prefix, const char* context, guint n, GPtrArray* candidates) {
+  if (dictionary != nullptr) {
+    keebie_dictionary_complete(dictionary, prefix, n, candidates);
+  }
+
+  if (self->user_model == nullptr) {
+    return;
+  }
+  keebie_user_model_complete(self->user_model, prefix, n, candidates);
+
+  // Right after a space there is nothing to complete, only to predict.
+  if (prefix[0] == '\0' && context != nullptr) {
+    keebie_user_model_predict(self->user_model, context, n, candidates);
+  }
+}
+
+gint keebie_application_complete(KeebieApplication* self, guint k, GPtrArray* words) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+
+  // While converting, what the reading converts to is what is on offer.
+  if (keebie_application_is_converting_locked(self)) {
+    return keebie_lattice_convert(self->lattice, k, words);
+  }
+
+  g_autofree gchar* word = keebie_application_get_composing_word_locked(self);
+  if (word == nullptr) {
+    return -1;
+  }
+
+  KeebieDictionary* dictionary = keebie_application_get_dictionary_locked(self);
+  g_autofree gchar* context = keebie_application_get_context_word_locked(self, word);
+  guint n = k * KEEBIE_APPLICATION_COMPLETION_CANDIDATES;
+
+  g_autoptr(GPtrArray) candidates = g_ptr_array_new_with_free_func(g_free);
+  keebie_application_add_candidates_locked(self, dictionary, word, context, n, candidates);
+
+  // Words are kept the way they are written mid-sentence, a capitalized
+  // prefix also gets the lowercase ones capitalized to match.
+  gboolean is_capitalized = g_unichar_isupper(g_utf8_get_char(word));
+  if (is_capitalized) {
+    g_autofree gchar* lower = keebie_application_set_first_case(word, FALSE);
+    g_autoptr(GPtrArray) extra = g_ptr_array_new_with_free_func(g_free);
+    keebie_application_add_candidates_locked(self, dictionary, lower, context, n, extra);
+
+    for (guint i = 0; i < extra->len; i++) {
+      g_ptr_array_add(candidates, keebie_application_set_first_case(reinterpret_cast<const char*>(g_ptr_array_index(extra, i)), TRUE));
+    }
+  }
+
+  // What the user typed after the same word, then what they typed at all,
+  // then the dictionary's order.
+  g_autoptr(GHashTable) seen = g_hash_table_new(g_str_hash, g_str_equal);
+  g_autoptr(GArray) ranked = g_array_new(FALSE, FALSE, sizeof (KeebieApplicationCandidate));
+  for (guint i = 0; i < candidates->len; i++) {
+    const char* candidate = reinterpret_cast<const char*>(g_ptr_array_index(candidates, i));
+    if (!g_hash_table_add(seen, const_cast<char*>(candidate))) {
+      continue;
+    }
+
+    g_autofree gchar* lower = is_capitalized ? keebie_application_set_first_case(candidate, FALSE) : nullptr;
+    KeebieApplicationCandidate entry;
+    entry.word = candidate;
+    entry.bigram = context != nullptr ? keebie_application_get_user_count(self, context, candidate, lower) : 0;
+    entry.unigram = keebie_application_get_user_count(self, nullptr, candidate, lower);
+    entry.rank = i;
+    g_array_append_val(ranked, entry);
+  }
+  g_array_sort(ranked, keebie_application_compare_candidates);
+
+  guint found = MIN(k, ranked->len);
+  for (guint i = 0; i < found; i++) {
+    g_ptr_array_add(words, g_strdup(g_array_index(ranked, KeebieApplicationCandidate, i).word));
+  }
+  return found;
+}
+
+gboolean keebie_application_send_key(KeebieApplication* self, uint32_t key) {
+  if (!keebie_application_has_output(self)) {
+    return FALSE;
+  }
+
+  KeebieInputCommand command = {};
+  command.type = KEEBIE_INPUT_SEND_KEY;
+  command.args[0] = key;
+  return keebie_application_run_input(self, &command);
+}
+
+gboolean keebie_application_delete_surrounding(KeebieApplication* self, uint32_t before, uint32_t after) {
+  if (!keebie_application_has_output(self)) {
+    return FALSE;
+  }
+
+  KeebieInputCommand command = {};
+  command.type = KEEBIE_INPUT_DELETE_SURROUNDING;
+  command.args[0] = before;
+  command.args[1] = after;
+  return keebie_application_run_input(self, &command);
+}
+
+gboolean keebie_application_delete(KeebieApplication* self, KeebieDeleteUnit unit, guint count) {
+  if (!keebie_application_has_output(self)) {
+    return FALSE;
+  }
+
+  KeebieInputCommand command = {};
+  command.type = KEEBIE_INPUT_DELETE;
+  command.args[0] = unit;
+  command.args[1] = count;
+  return keebie_application_run_input(self, &command);
+}
+
+int keebie_application_get_action_type(KeebieApplication* self, guint plane, guint row, guint key) {
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(&self->lock);
+
+  if (self->layout == nullptr) {
+    return -1;
+  }
+
+  const KeebieKeyAction* action = keebie_layout_lookup(self->layout, plane, row, key);
+  if (action == nullptr) {
+    return -1;
+  }
+
+  switch (action->type) {
+    case KEEBIE_KEY_ACTION_COMMIT:
+    case KEEBIE_KEY_ACTION_KEYCODE:
+    case KEEBIE_KEY_ACTION_DELETE:
+      return self->input_method != nullptr || self->virtual_keyboard != nullptr ? action->type : -1;
+    case KEEBIE_KEY_ACTION_PLANE:
+    case KEEBIE_KEY_ACTION_SHIFT:
+    case KEEBIE_KEY_ACTION_CHANGE_LANG:
+      return action->type;
+    default:
+      return -1;
+  }
+}
+
+int keebie_application_activate_key(KeebieApplication* self, guint plane, guint row, guint key, gboolean is_shifted) {
+  int type = keebie_application_get_action_type(self, plane, row, key);
+
+  // Plane and shift state is owned by the Flutter side.
+  if (type >= 0 && type != KEEBIE_KEY_ACTION_PLANE && type != KEEBIE_KEY_ACTION_SHIFT) {
+    KeebieInputCommand command = {};
+    command.type = KEEBIE_INPUT_ACTIVATE_KEY;
+    command.is_shifted = is_shifted;
+    command.args[0] = plane;
+    command.args[1] = row;
+    command.args[2] = key;
+    if (!keebie_application_run_input(self, &command)) {
+      return -1;
+    }
+  }
+  return type;
+}
+
+int keebie_application_press_key(KeebieApplication* self, guint plane, guint row, guint key, gboolean is_shifted) {
+  int type = keebie_application_get_action_type(self, plane, row, key);
+
+  if (type >= 0 && type != KEEBIE_KEY_ACTION_PLANE && type != KEEBIE_KEY_ACTION_SHIFT) {
+    KeebieInputCommand command = {};
+    command.type = KEEBIE_INPUT_PRESS_KEY;
+    command.is_shifted = is_shifted;
+    command.args[0] = plane;
+    command.args[1] = row;
+    command.args[2] = key;
+    if (!keebie_application_run_input(self, &command)) {
+      return -1;
+    }
+  }
+  return type;
+}
+
+void keebie_application_release_key(KeebieApplication* self, guint plane, guint row, guint key) {
+  KeebieInputCommand command = {};
+  command.type = KEEBIE_INPUT_RELEASE_KEY;
+  command.args[0] = plane;
+  command.args[1] = row;
+  command.args[2] = key;
+  keebie_application_run_input(self, &command);
 }
\ No newline at end of file
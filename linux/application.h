@@ -10,6 +10,13 @@
 #include <wayland-client.h>
 #endif
 
+#include "geometry.h"
+#include "handwriting.h"
+#include "im-state.h"
+#include "layout.h"
+#include "layout-registry.h"
+#include "surrounding.h"
+#include "swipe-decoder.h"
 #include "input-method-unstable-v2-client.h"
 #include "virtual-keyboard-unstable-v1-client.h"
 
@@ -20,12 +27,200 @@ FlDartProject* keebie_application_get_dart_project(KeebieApplication* self);
 
 struct xkb_context* keebie_application_get_xkb_context(KeebieApplication* self);
 
+/**
+ * Reads the cached geometry and scale of an output, FALSE if it is gone.
+ */
+gboolean keebie_application_lookup_output(KeebieApplication* self, GdkMonitor* monitor, GdkRectangle* geometry, gint* scale);
+
 struct wl_seat* keebie_application_get_wayland_seat(KeebieApplication* self);
 struct zwp_input_method_manager_v2* keebie_application_get_input_method_manager(KeebieApplication* self);
 struct zwp_input_method_v2* keebie_application_get_input_method(KeebieApplication* self);
 struct zwp_virtual_keyboard_manager_v1* keebie_application_get_virtual_keyboard_manager(KeebieApplication* self);
 
+/**
+ * Key actions are queued for the input thread and return right away, FALSE
+ * only means there is neither an input method nor a virtual keyboard.
+ */
 gboolean keebie_application_commit_text(KeebieApplication* self, const char* text);
 gboolean keebie_application_send_key(KeebieApplication* self, uint32_t key);
 gboolean keebie_application_delete_surrounding(KeebieApplication* self, uint32_t before, uint32_t after);
-void keebie_application_keymap(KeebieApplication* self);
\ No newline at end of file
+
+/**
+ * Deletes count units back from the cursor in a single request. With the
+ * client's surrounding text this is one delete_surrounding_text of the right
+ * byte lengths, otherwise it falls back to keys on the virtual keyboard.
+ */
+gboolean keebie_application_delete(KeebieApplication* self, KeebieDeleteUnit unit, guint count);
+
+/**
+ * Edits the composition shown as preedit, ranges are in UTF-16 code units.
+ * Only works with an input method, there is no preedit over the virtual
+ * keyboard. Committing text, keys and deletes end or edit the composition.
+ */
+gboolean keebie_application_compose(KeebieApplication* self, uint32_t start, uint32_t end, const char* text);
+gboolean keebie_application_set_composing_cursor(KeebieApplication* self, uint32_t begin, uint32_t end);
+
+/**
+ * Commits text in place of the composition, or the composition itself when
+ * text is NULL. An empty text cancels it.
+ */
+gboolean keebie_application_finish_composing(KeebieApplication* self, const char* text);
+
+/**
+ * Appends up to k completions of the word being typed to words, most likely
+ * first. Candidates come from the dictionary of the current layout's locale
+ * and the words the user typed, and are ranked by what the user typed after
+ * the previous word. Right after a space these are next-word predictions.
+ * Returns -1 when there is no word at the cursor.
+ */
+gint keebie_application_complete(KeebieApplication* self, guint k, GPtrArray* words);
+
+/**
+ * Replaces the word being typed, composing or not, with text.
+ */
+gboolean keebie_application_replace_word(KeebieApplication* self, const char* text);
+
+/**
+ * Turns correcting the word just typed as it is ended on or off, a backspace
+ * right after a correction undoes it.
+ */
+void keebie_application_set_autocorrect(KeebieApplication* self, gboolean autocorrect);
+
+/**
+ * Whether keys touched in a keyboard window type as soon as they go down,
+ * rather than when they are released. Delete and keycode keys always act on
+ * the way down so holding them repeats.
+ */
+void keebie_application_set_commit_on_press(KeebieApplication* self, gboolean commit_on_press);
+gboolean keebie_application_get_commit_on_press(KeebieApplication* self);
+
+/**
+ * How long in milliseconds a key whose touch lifted waits on keys touched
+ * before it which are still held, so overlapping touches type in the order
+ * they went down. Only matters when keys type on release.
+ */
+void keebie_application_set_rollover(KeebieApplication* self, guint rollover);
+guint keebie_application_get_rollover(KeebieApplication* self);
+
+/**
+ * Turns typing words by dragging across their letters on or off.
+ */
+void keebie_application_set_swipe_typing(KeebieApplication* self, gboolean swipe_typing);
+void keebie_application_keymap(KeebieApplication* self);
+
+/**
+ * Copies the input-method state as of the last done into state, which the
+ * caller clears with keebie_im_state_clear.
+ */
+void keebie_application_get_im_state(KeebieApplication* self, KeebieImState* state);
+
+/**
+ * Swaps the compiled action table keys are resolved against.
+ */
+void keebie_application_set_layout(KeebieApplication* self, KeebieLayout* layout);
+
+/**
+ * Returns a new reference to the compiled layout of the given name from the
+ * user layout dirs or the bundle, nullptr if there is none.
+ */
+KeebieLayout* keebie_application_get_layout_by_name(KeebieApplication* self, const char* name);
+
+/**
+ * Makes a compiled layout active by name without it ever going through the
+ * method channel. It is swapped again whenever its source changes on disk.
+ */
+gboolean keebie_application_activate_layout(KeebieApplication* self, const char* name);
+
+/**
+ * Sets the layouts changeLang cycles through, they are preloaded together
+ * with their XKB keymap while the main loop is idle.
+ */
+void keebie_application_set_languages(KeebieApplication* self, const char* const* names);
+
+/**
+ * Makes the next language active, swapping the layout, the action table and
+ * the virtual keyboard's keymap in one step. Returns the new layout's name.
+ */
+gchar* keebie_application_change_language(KeebieApplication* self);
+
+/**
+ * Resolves what the key would do without doing it, so the UI learns whether
+ * the key was handled while the action itself happens on the input thread.
+ * Returns the KeebieKeyActionType or -1 when the key does nothing.
+ */
+int keebie_application_get_action_type(KeebieApplication* self, guint plane, guint row, guint key);
+
+/**
+ * Resolves the key from the active layout and queues its action on the input
+ * thread. Returns the KeebieKeyActionType the key resolved to once queued, or
+ * -1 when the key does nothing. Whether the action then reached the client is
+ * not known yet.
+ */
+int keebie_application_activate_key(KeebieApplication* self, guint plane, guint row, guint key, gboolean is_shifted);
+
+/**
+ * Activates the key like keebie_application_activate_key and keeps repeating
+ * it at the compositor's repeat rate until keebie_application_release_key.
+ * Only text, keycode and delete actions repeat.
+ */
+int keebie_application_press_key(KeebieApplication* self, guint plane, guint row, guint key, gboolean is_shifted);
+
+/**
+ * Stops the repeat of the key. Pressing another key stopped it already, its
+ * release then leaves the newer repeat alone.
+ */
+void keebie_application_release_key(KeebieApplication* self, guint plane, guint row, guint key);
+
+/**
+ * Returns a new reference to the memoized key rects of the active layout.
+ */
+KeebieGeometry* keebie_application_get_geometry(KeebieApplication* self, const KeebieGeometryParams* params);
+
+/**
+ * Returns the index into the geometry's keys of the key a touch at x, y
+ * within the plane was meant for, weighing where it landed against what the
+ * dictionary expects to be typed next. -1 when no layout was announced.
+ */
+gint keebie_application_resolve_touch(KeebieApplication* self, const KeebieGeometryParams* params, float x, float y);
+
+/**
+ * Returns whether a touch starting on the key of the plane may turn into a
+ * swipe, which takes a letter key, a dictionary and a text field that wants
+ * words corrected.
+ */
+gboolean keebie_application_can_swipe(KeebieApplication* self, const KeebieGeometryParams* params, guint row, guint key);
+
+/**
+ * Queues decoding n_points x, y pairs within the plane into up to k words,
+ * see keebie_swipe_decoder_decode. Returns FALSE without queueing anything
+ * when swiping is not possible right now.
+ */
+gboolean keebie_application_decode_swipe(KeebieApplication* self, const KeebieGeometryParams* params, const float* points, guint n_points,
+  gboolean is_final, guint k, KeebieSwipeFunc func, gpointer data, GDestroyNotify destroy);
+
+/**
+ * Commits a swiped word, after deleting the taken_back characters its touch
+ * typed on the way down and spaced from the word before it. Shifted
+ * capitalizes it.
+ */
+gboolean keebie_application_commit_swipe(KeebieApplication* self, const char* word, guint taken_back, gboolean is_shifted);
+
+/**
+ * Gets the handwriting templates of the current language, loading them the
+ * first time, or NULL when there are none. Unref when done.
+ */
+KeebieHandwriting* keebie_application_get_handwriting(KeebieApplication* self);
+
+/**
+ * Appends up to k emoji and symbols of the current language's catalog
+ * matching query to results, those the user picked most and lately first.
+ * An empty query browses them instead, the user's picks then the rest of the
+ * catalog in order. Returns -1 when the language has no catalog.
+ */
+gint keebie_application_search_emoji(KeebieApplication* self, const char* query, guint k, GPtrArray* results);
+
+/**
+ * Commits an emoji or symbol picked by the user as is, the word before it
+ * is never autocorrected, and remembers it for searches.
+ */
+gboolean keebie_application_commit_emoji(KeebieApplication* self, const char* text);
\ No newline at end of file
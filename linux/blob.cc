@@ -0,0 +1,22 @@
+#include <sys/mman.h>
+#include "blob.h"
+
+GMappedFile* keebie_blob_map(const char* path, gsize header_size, int advice, GError** error) {
+  g_autoptr(GMappedFile) file = g_mapped_file_new(path, FALSE, error);
+  if (file == nullptr) {
+    return nullptr;
+  }
+
+  gsize size = g_mapped_file_get_length(file);
+  if (size < header_size) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is truncated, corrupt or of another version", path);
+    return nullptr;
+  }
+
+  madvise(g_mapped_file_get_contents(file), size, advice);
+  return reinterpret_cast<GMappedFile*>(g_steal_pointer(&file));
+}
+
+gboolean keebie_blob_section_is_valid(gsize size, gsize header_size, uint32_t offset, uint32_t n, gsize record) {
+  return offset % MIN(record, sizeof (uint32_t)) == 0 && offset >= header_size && offset <= size && n <= (size - offset) / record;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Maps a compiled blob read-only, refusing files too short for its header.
+ * advice is the madvise(2) advice for how lookups go through it, which is
+ * all that differs between the formats mapped straight from disk.
+ */
+GMappedFile* keebie_blob_map(const char* path, gsize header_size, int advice, GError** error);
+
+/**
+ * Returns whether n records of record bytes at offset lie within a blob of
+ * size bytes, after its header and aligned for the records.
+ */
+gboolean keebie_blob_section_is_valid(gsize size, gsize header_size, uint32_t offset, uint32_t n, gsize record);
+
+G_END_DECLS
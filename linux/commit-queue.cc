@@ -0,0 +1,123 @@
+#include "commit-queue.h"
+
+// Half a frame at 60Hz, short enough to never be noticed on a single key.
+#define KEEBIE_COMMIT_QUEUE_BUDGET_US 8000
+
+struct _KeebieCommitQueue {
+  GMainContext* context;
+  GRecMutex* lock;
+  KeebieCommitQueueFunc func;
+  gpointer data;
+
+  KeebieCommit commit;
+  gboolean is_pending;
+
+  gint64 last_flush;
+  GSource* source;
+};
+
+KeebieCommitQueue* keebie_commit_queue_new(GMainContext* context, GRecMutex* lock, KeebieCommitQueueFunc func, gpointer data) {
+  KeebieCommitQueue* self = g_new0(KeebieCommitQueue, 1);
+  self->context = context;
+  self->lock = lock;
+  self->func = func;
+  self->data = data;
+  self->commit.text = g_string_new(nullptr);
+  return self;
+}
+
+static void keebie_commit_queue_cancel(KeebieCommitQueue* self) {
+  if (self->source != nullptr) {
+    g_source_destroy(self->source);
+    g_clear_pointer(&self->source, g_source_unref);
+  }
+}
+
+void keebie_commit_queue_free(KeebieCommitQueue* self) {
+  keebie_commit_queue_cancel(self);
+  g_string_free(self->commit.text, TRUE);
+  g_free(self->commit.preedit);
+  g_free(self);
+}
+
+static gboolean keebie_commit_queue_dispatch(gpointer data) {
+  KeebieCommitQueue* self = reinterpret_cast<KeebieCommitQueue*>(data);
+
+  g_autoptr(GRecMutexLocker) locker = g_rec_mutex_locker_new(self->lock);
+  keebie_commit_queue_flush(self);
+  return G_SOURCE_REMOVE;
+}
+
+static void keebie_commit_queue_schedule(KeebieCommitQueue* self) {
+  self->is_pending = TRUE;
+
+  if (self->source != nullptr) {
+    return;
+  }
+
+  gint64 now = g_get_monotonic_time();
+  gint64 due = self->last_flush + KEEBIE_COMMIT_QUEUE_BUDGET_US;
+  if (now >= due) {
+    keebie_commit_queue_flush(self);
+    return;
+  }
+
+  self->source = g_timeout_source_new((due - now + 999) / 1000);
+  g_source_set_priority(self->source, G_PRIORITY_HIGH);
+  g_source_set_callback(self->source, keebie_commit_queue_dispatch, self, nullptr);
+  g_source_attach(self->source, self->context);
+}
+
+void keebie_commit_queue_commit_text(KeebieCommitQueue* self, const char* text) {
+  g_string_append(self->commit.text, text);
+  keebie_commit_queue_schedule(self);
+}
+
+void keebie_commit_queue_delete_surrounding(KeebieCommitQueue* self, uint32_t before, uint32_t after) {
+  // The delete applies before the commit string, so whatever is still pending
+  // is trimmed and only the rest reaches into the client's text.
+  uint32_t pending = MIN(before, self->commit.text->len);
+  g_string_truncate(self->commit.text, self->commit.text->len - pending);
+
+  self->commit.before += before - pending;
+  self->commit.after += after;
+  keebie_commit_queue_schedule(self);
+}
+
+void keebie_commit_queue_set_preedit(KeebieCommitQueue* self, const char* text, int32_t begin, int32_t end) {
+  if (g_strcmp0(self->commit.preedit, text) == 0 && self->commit.preedit_begin == begin && self->commit.preedit_end == end) {
+    return;
+  }
+
+  g_free(self->commit.preedit);
+  self->commit.preedit = g_strdup(text);
+  self->commit.preedit_begin = begin;
+  self->commit.preedit_end = end;
+  keebie_commit_queue_schedule(self);
+}
+
+void keebie_commit_queue_flush(KeebieCommitQueue* self) {
+  keebie_commit_queue_cancel(self);
+
+  if (!self->is_pending) {
+    return;
+  }
+
+  self->func(&self->commit, self->data);
+
+  self->commit.before = 0;
+  self->commit.after = 0;
+  g_string_truncate(self->commit.text, 0);
+  self->is_pending = FALSE;
+  self->last_flush = g_get_monotonic_time();
+}
+
+void keebie_commit_queue_clear(KeebieCommitQueue* self) {
+  keebie_commit_queue_cancel(self);
+
+  self->commit.before = 0;
+  self->commit.after = 0;
+  g_string_truncate(self->commit.text, 0);
+  g_clear_pointer(&self->commit.preedit, g_free);
+  self->is_pending = FALSE;
+}
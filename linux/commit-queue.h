@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+/**
+ * One input-method transaction, in the order the compositor applies it:
+ * delete_surrounding_text, commit_string, then set_preedit_string.
+ */
+typedef struct {
+  uint32_t before;
+  uint32_t after;
+  GString* text;
+  gchar* preedit;
+  int32_t preedit_begin;
+  int32_t preedit_end;
+} KeebieCommit;
+
+typedef void (*KeebieCommitQueueFunc)(const KeebieCommit* commit, gpointer data);
+
+/**
+ * Coalesces text, deletes and preedit changes into one transaction per
+ * latency budget. An edit after a quiet period goes out right away, edits
+ * arriving faster than the budget wait for the rest of it and then go out
+ * together, so fast typing costs clients one relayout per frame rather than
+ * per character. The queue is guarded by the owner's lock, which the flush
+ * timer on the given context takes as well.
+ */
+typedef struct _KeebieCommitQueue KeebieCommitQueue;
+
+KeebieCommitQueue* keebie_commit_queue_new(GMainContext* context, GRecMutex* lock, KeebieCommitQueueFunc func, gpointer data);
+void keebie_commit_queue_free(KeebieCommitQueue* self);
+
+void keebie_commit_queue_commit_text(KeebieCommitQueue* self, const char* text);
+
+/**
+ * Takes byte lengths relative to the cursor as it is with everything queued
+ * applied, so bytes before the cursor come out of pending text first.
+ */
+void keebie_commit_queue_delete_surrounding(KeebieCommitQueue* self, uint32_t before, uint32_t after);
+
+/**
+ * The preedit is part of every transaction until it is set to NULL, the
+ * protocol drops it from any commit which does not carry it.
+ */
+void keebie_commit_queue_set_preedit(KeebieCommitQueue* self, const char* text, int32_t begin, int32_t end);
+
+/**
+ * Sends whatever is pending now, needed before anything which has to be
+ * ordered after the queued edits, like keys on the virtual keyboard.
+ */
+void keebie_commit_queue_flush(KeebieCommitQueue* self);
+
+/**
+ * Drops everything pending including the preedit, for when the input method
+ * went away and nothing queued can be delivered anymore.
+ */
+void keebie_commit_queue_clear(KeebieCommitQueue* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieCommitQueue, keebie_commit_queue_free);
+
+G_END_DECLS
@@ -0,0 +1,84 @@
+#include <string.h>
+#include "composition.h"
+
+// Walks the UTF-8 text until units UTF-16 code units are covered.
+static uint32_t keebie_composition_get_offset(const GString* text, uint32_t units) {
+  const char* p = text->str;
+  const char* end = text->str + text->len;
+  while (p < end && units > 0) {
+    gunichar c = g_utf8_get_char(p);
+    units -= MIN(units, c > 0xffff ? 2u : 1u);
+    p = g_utf8_next_char(p);
+  }
+  return p - text->str;
+}
+
+void keebie_composition_clear(KeebieComposition* self) {
+  if (self->text != nullptr) {
+    g_string_free(self->text, TRUE);
+    self->text = nullptr;
+  }
+  self->cursor_begin = 0;
+  self->cursor_end = 0;
+}
+
+gboolean keebie_composition_is_active(const KeebieComposition* self) {
+  return self->text != nullptr && self->text->len > 0;
+}
+
+void keebie_composition_replace(KeebieComposition* self, uint32_t start, uint32_t end, const char* text) {
+  if (self->text == nullptr) {
+    self->text = g_string_new(nullptr);
+  }
+
+  uint32_t start_bytes = keebie_composition_get_offset(self->text, start);
+  uint32_t end_bytes = MAX(start_bytes, keebie_composition_get_offset(self->text, end));
+  g_string_erase(self->text, start_bytes, end_bytes - start_bytes);
+  g_string_insert(self->text, start_bytes, text);
+
+  self->cursor_begin = start_bytes + strlen(text);
+  self->cursor_end = self->cursor_begin;
+}
+
+void keebie_composition_set_cursor(KeebieComposition* self, uint32_t begin, uint32_t end) {
+  if (self->text == nullptr) {
+    return;
+  }
+
+  self->cursor_begin = keebie_composition_get_offset(self->text, MIN(begin, end));
+  self->cursor_end = keebie_composition_get_offset(self->text, MAX(begin, end));
+}
+
+gboolean keebie_composition_delete(KeebieComposition* self, guint count) {
+  if (!keebie_composition_is_active(self)) {
+    return FALSE;
+  }
+
+  uint32_t begin = self->cursor_begin;
+  if (begin == self->cursor_end) {
+    for (; begin > 0 && count > 0; count--) {
+      begin = g_utf8_find_prev_char(self->text->str, self->text->str + begin) - self->text->str;
+    }
+  }
+
+  if (begin == self->cursor_end) {
+    return FALSE;
+  }
+
+  g_string_erase(self->text, begin, self->cursor_end - begin);
+  self->cursor_begin = begin;
+  self->cursor_end = begin;
+  return TRUE;
+}
+
+gchar* keebie_composition_steal(KeebieComposition* self) {
+  if (self->text == nullptr) {
+    return nullptr;
+  }
+
+  gchar* text = g_string_free(self->text, FALSE);
+  self->text = nullptr;
+  self->cursor_begin = 0;
+  self->cursor_end = 0;
+  return text;
+}
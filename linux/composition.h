@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+/**
+ * The text being composed, shown by the client as preedit until it is
+ * committed. Dart edits it with deltas in UTF-16 code units, which is how
+ * its strings index, while cursor_begin and cursor_end are the byte offsets
+ * set_preedit_string takes. A NULL text means nothing is being composed.
+ */
+typedef struct {
+  GString* text;
+  uint32_t cursor_begin;
+  uint32_t cursor_end;
+} KeebieComposition;
+
+void keebie_composition_clear(KeebieComposition* self);
+
+gboolean keebie_composition_is_active(const KeebieComposition* self);
+
+/**
+ * Replaces the UTF-16 range [start, end) with text and puts the cursor after
+ * it, ranges past the end are clamped. The edit happens in place, a delta
+ * never rebuilds the whole composition.
+ */
+void keebie_composition_replace(KeebieComposition* self, uint32_t start, uint32_t end, const char* text);
+
+/**
+ * Sets the highlighted range in UTF-16 code units, begin equal to end is a
+ * plain cursor.
+ */
+void keebie_composition_set_cursor(KeebieComposition* self, uint32_t begin, uint32_t end);
+
+/**
+ * Removes count characters before the cursor, or the highlighted range if
+ * there is one. Returns FALSE if there was nothing to remove.
+ */
+gboolean keebie_composition_delete(KeebieComposition* self, guint count);
+
+/**
+ * Hands the composed text to the caller and ends the composition, NULL if
+ * nothing was being composed.
+ */
+gchar* keebie_composition_steal(KeebieComposition* self);
+
+G_END_DECLS
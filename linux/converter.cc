@@ -0,0 +1,803 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "blob.h"
+#include "converter.h"
+
+// Longer readings are split into words anyway, and it bounds how far back a
+// new column looks for words ending at it.
+#define KEEBIE_CONVERTER_MAX_READING 16
+
+// Word classes are a few dozen, this keeps the matrix of their pairs small.
+#define KEEBIE_CONVERTER_MAX_CLASSES 1024
+
+// What a class pair without a connection line costs.
+#define KEEBIE_CONVERTER_DEFAULT_CONNECTION 2000
+
+// A character no word covers is left the way it was typed, at a cost high
+// enough that any dictionary word beats it.
+#define KEEBIE_LATTICE_UNKNOWN_COST 10000
+
+// Bounds the paths a single conversion may extend, even on a corrupt blob.
+#define KEEBIE_LATTICE_MAX_EXPANSIONS 4096
+
+#define KEEBIE_LATTICE_NO_ENTRY G_MAXUINT32
+#define KEEBIE_LATTICE_NO_PATH G_MAXUINT32
+
+typedef struct {
+  gchar* reading;
+  gchar* surface;
+  uint16_t klass;
+  int16_t cost;
+} KeebieConverterBuildEntry;
+
+struct _KeebieConverterBuilder {
+  gchar* locale;
+  GHashTable* classes;
+  GArray* entries;
+  GHashTable* costs;
+  int16_t default_cost;
+};
+
+struct _KeebieConverter {
+  gint ref_count;
+  GMappedFile* file;
+  guint8* data;
+  gsize size;
+
+  const KeebieConverterHeader* header;
+  const int16_t* costs;
+  const KeebieConverterReading* readings;
+  const KeebieConverterEntry* entries;
+  const char* strings;
+};
+
+typedef struct {
+  uint32_t start;
+  uint32_t end;
+  uint32_t entry;
+  uint16_t klass;
+  int32_t cost;
+  int32_t total;
+} KeebieLatticeNode;
+
+struct _KeebieLattice {
+  KeebieConverter* converter;
+  GString* reading;
+
+  // Byte offsets of the character boundaries, the columns of nodes ending at
+  // each of them and the nodes, column by column. Column 0 only holds the
+  // start of the text.
+  GArray* offsets;
+  GArray* columns;
+  GArray* nodes;
+};
+
+KeebieConverterBuilder* keebie_converter_builder_new(const char* locale) {
+  KeebieConverterBuilder* self = g_new0(KeebieConverterBuilder, 1);
+  self->locale = g_strdup(locale);
+  self->classes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, nullptr);
+  self->entries = g_array_new(FALSE, FALSE, sizeof (KeebieConverterBuildEntry));
+  self->costs = g_hash_table_new(g_direct_hash, g_direct_equal);
+  self->default_cost = KEEBIE_CONVERTER_DEFAULT_CONNECTION;
+
+  g_hash_table_insert(self->classes, g_strdup("BOS"), GUINT_TO_POINTER(0));
+  return self;
+}
+
+void keebie_converter_builder_free(KeebieConverterBuilder* self) {
+  for (guint i = 0; i < self->entries->len; i++) {
+    KeebieConverterBuildEntry* entry = &g_array_index(self->entries, KeebieConverterBuildEntry, i);
+    g_free(entry->reading);
+    g_free(entry->surface);
+  }
+
+  g_array_unref(self->entries);
+  g_hash_table_unref(self->classes);
+  g_hash_table_unref(self->costs);
+  g_free(self->locale);
+  g_free(self);
+}
+
+static gboolean keebie_converter_builder_get_class(KeebieConverterBuilder* self, const char* name, uint16_t* klass) {
+  gpointer value = nullptr;
+  if (g_hash_table_lookup_extended(self->classes, name, nullptr, &value)) {
+    *klass = GPOINTER_TO_UINT(value);
+    return TRUE;
+  }
+
+  guint size = g_hash_table_size(self->classes);
+  if (name[0] == '\0' || size >= KEEBIE_CONVERTER_MAX_CLASSES) {
+    return FALSE;
+  }
+
+  g_hash_table_insert(self->classes, g_strdup(name), GUINT_TO_POINTER(size));
+  *klass = size;
+  return TRUE;
+}
+
+static gboolean keebie_converter_parse_cost(const char* text, int16_t* cost) {
+  gchar* end = nullptr;
+  gint64 value = g_ascii_strtoll(text, &end, 10);
+  if (end == text || *end != '\0' || value < G_MININT16 || value > G_MAXINT16) {
+    return FALSE;
+  }
+
+  *cost = value;
+  return TRUE;
+}
+
+gboolean keebie_converter_builder_add_source(KeebieConverterBuilder* self, const char* data, gsize length, GError** error) {
+  g_autofree gchar* copy = g_strndup(data, length);
+  g_auto(GStrv) lines = g_strsplit(copy, "\n", -1);
+
+  for (guint i = 0; lines[i] != nullptr; i++) {
+    gchar* line = g_strstrip(lines[i]);
+    if (line[0] == '\0' || line[0] == '#') {
+      continue;
+    }
+
+    g_auto(GStrv) fields = g_strsplit(line, "\t", -1);
+    guint n_fields = g_strv_length(fields);
+
+    if (g_strcmp0(fields[0], "@") == 0) {
+      uint16_t left = 0;
+      uint16_t right = 0;
+      int16_t cost = 0;
+      if (n_fields == 3 && strcmp(fields[1], "default") == 0 && keebie_converter_parse_cost(fields[2], &cost)) {
+        self->default_cost = cost;
+        continue;
+      }
+
+      if (n_fields != 4 || !keebie_converter_builder_get_class(self, fields[1], &left) || !keebie_converter_builder_get_class(self, fields[2], &right)
+          || !keebie_converter_parse_cost(fields[3], &cost)) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Line %u: expected @<TAB>class<TAB>class<TAB>cost", i + 1);
+        return FALSE;
+      }
+
+      g_hash_table_insert(self->costs, GUINT_TO_POINTER((static_cast<guint>(left) << 16) | right), GINT_TO_POINTER(cost));
+      continue;
+    }
+
+    KeebieConverterBuildEntry entry = {};
+    if (n_fields != 4 || fields[0][0] == '\0' || fields[1][0] == '\0'
+        || !g_utf8_validate(fields[0], -1, nullptr) || !g_utf8_validate(fields[1], -1, nullptr)
+        || g_utf8_strlen(fields[0], -1) > KEEBIE_CONVERTER_MAX_READING
+        || strcmp(fields[2], "BOS") == 0 || !keebie_converter_builder_get_class(self, fields[2], &entry.klass)
+        || !keebie_converter_parse_cost(fields[3], &entry.cost)) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Line %u: expected reading<TAB>surface<TAB>class<TAB>cost", i + 1);
+      return FALSE;
+    }
+
+    entry.reading = g_strdup(fields[0]);
+    entry.surface = g_strdup(fields[1]);
+    g_array_append_val(self->entries, entry);
+  }
+  return TRUE;
+}
+
+static gint keebie_converter_compare_surfaces(gconstpointer a, gconstpointer b) {
+  const KeebieConverterBuildEntry* entry_a = reinterpret_cast<const KeebieConverterBuildEntry*>(a);
+  const KeebieConverterBuildEntry* entry_b = reinterpret_cast<const KeebieConverterBuildEntry*>(b);
+  gint result = strcmp(entry_a->reading, entry_b->reading);
+  if (result == 0) {
+    result = strcmp(entry_a->surface, entry_b->surface);
+  }
+  if (result == 0) {
+    result = entry_a->klass - entry_b->klass;
+  }
+  return result != 0 ? result : entry_a->cost - entry_b->cost;
+}
+
+static gint keebie_converter_compare_costs(gconstpointer a, gconstpointer b) {
+  const KeebieConverterBuildEntry* entry_a = reinterpret_cast<const KeebieConverterBuildEntry*>(a);
+  const KeebieConverterBuildEntry* entry_b = reinterpret_cast<const KeebieConverterBuildEntry*>(b);
+  gint result = strcmp(entry_a->reading, entry_b->reading);
+  if (result == 0) {
+    result = entry_a->cost - entry_b->cost;
+  }
+  return result != 0 ? result : strcmp(entry_a->surface, entry_b->surface);
+}
+
+static uint32_t keebie_converter_builder_intern(GByteArray* strings, GHashTable* interned, const char* text) {
+  gpointer offset = nullptr;
+  if (g_hash_table_lookup_extended(interned, text, nullptr, &offset)) {
+    return GPOINTER_TO_UINT(offset);
+  }
+
+  uint32_t result = strings->len;
+  g_byte_array_append(strings, reinterpret_cast<const guint8*>(text), strlen(text) + 1);
+  g_hash_table_insert(interned, const_cast<char*>(text), GUINT_TO_POINTER(result));
+  return result;
+}
+
+GBytes* keebie_converter_builder_end(KeebieConverterBuilder* self) {
+  // The same word listed twice keeps its cheapest cost.
+  GArray* entries = self->entries;
+  g_array_sort(entries, keebie_converter_compare_surfaces);
+  guint n_unique = 0;
+  for (guint i = 0; i < entries->len; i++) {
+    KeebieConverterBuildEntry* entry = &g_array_index(entries, KeebieConverterBuildEntry, i);
+    if (n_unique > 0) {
+      KeebieConverterBuildEntry* last = &g_array_index(entries, KeebieConverterBuildEntry, n_unique - 1);
+      if (strcmp(last->reading, entry->reading) == 0 && strcmp(last->surface, entry->surface) == 0 && last->klass == entry->klass) {
+        g_free(entry->reading);
+        g_free(entry->surface);
+        continue;
+      }
+    }
+    g_array_index(entries, KeebieConverterBuildEntry, n_unique++) = *entry;
+  }
+  g_array_set_size(entries, n_unique);
+  g_array_sort(entries, keebie_converter_compare_costs);
+
+  uint32_t n_classes = g_hash_table_size(self->classes);
+  g_autofree int16_t* costs = g_new(int16_t, n_classes * n_classes);
+  for (uint32_t i = 0; i < n_classes * n_classes; i++) {
+    costs[i] = self->default_cost;
+  }
+
+  GHashTableIter iter;
+  gpointer key = nullptr;
+  gpointer value = nullptr;
+  g_hash_table_iter_init(&iter, self->costs);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    guint pair = GPOINTER_TO_UINT(key);
+    costs[(pair >> 16) * n_classes + (pair & 0xffff)] = GPOINTER_TO_INT(value);
+  }
+
+  g_autoptr(GArray) readings = g_array_new(FALSE, FALSE, sizeof (KeebieConverterReading));
+  g_autoptr(GArray) list = g_array_sized_new(FALSE, FALSE, sizeof (KeebieConverterEntry), entries->len);
+  g_autoptr(GByteArray) strings = g_byte_array_new();
+  g_autoptr(GHashTable) interned = g_hash_table_new(g_str_hash, g_str_equal);
+  for (guint i = 0; i < entries->len; i++) {
+    const KeebieConverterBuildEntry* entry = &g_array_index(entries, KeebieConverterBuildEntry, i);
+
+    KeebieConverterReading* reading = readings->len > 0 ? &g_array_index(readings, KeebieConverterReading, readings->len - 1) : nullptr;
+    if (reading == nullptr || strcmp(strings->len > 0 ? reinterpret_cast<const char*>(strings->data) + reading->text_offset : "", entry->reading) != 0) {
+      KeebieConverterReading item = {};
+      item.text_offset = keebie_converter_builder_intern(strings, interned, entry->reading);
+      item.length = strlen(entry->reading);
+      item.first_entry = i;
+      g_array_append_val(readings, item);
+      reading = &g_array_index(readings, KeebieConverterReading, readings->len - 1);
+    }
+    reading->n_entries++;
+
+    KeebieConverterEntry item = {};
+    item.text_offset = keebie_converter_builder_intern(strings, interned, entry->surface);
+    item.length = strlen(entry->surface);
+    item.klass = entry->klass;
+    item.cost = entry->cost;
+    g_array_append_val(list, item);
+  }
+
+  KeebieConverterHeader header = {};
+  header.magic = KEEBIE_CONVERTER_MAGIC;
+  header.version = KEEBIE_CONVERTER_VERSION;
+  g_strlcpy(header.locale, self->locale, sizeof (header.locale));
+  header.n_classes = n_classes;
+  header.costs_offset = sizeof (KeebieConverterHeader);
+  header.n_readings = readings->len;
+  header.readings_offset = header.costs_offset + (n_classes * n_classes * sizeof (int16_t) + 3) / 4 * 4;
+  header.n_entries = list->len;
+  header.entries_offset = header.readings_offset + header.n_readings * sizeof (KeebieConverterReading);
+  header.strings_offset = header.entries_offset + header.n_entries * sizeof (KeebieConverterEntry);
+  header.strings_size = strings->len;
+  header.size = header.strings_offset + header.strings_size;
+
+  guint8* data = reinterpret_cast<guint8*>(g_malloc0(header.size));
+  memcpy(data, &header, sizeof (header));
+  memcpy(data + header.costs_offset, costs, n_classes * n_classes * sizeof (int16_t));
+  memcpy(data + header.readings_offset, readings->data, header.n_readings * sizeof (KeebieConverterReading));
+  memcpy(data + header.entries_offset, list->data, header.n_entries * sizeof (KeebieConverterEntry));
+  memcpy(data + header.strings_offset, strings->data, header.strings_size);
+  return g_bytes_new_take(data, header.size);
+}
+
+KeebieConverter* keebie_converter_new_from_file(const char* path, GError** error) {
+  // Readings are binary searched, readahead would only fault in pages no
+  // lookup ever needs.
+  GMappedFile* file = keebie_blob_map(path, sizeof (KeebieConverterHeader), MADV_RANDOM, error);
+  if (file == nullptr) {
+    return nullptr;
+  }
+
+  KeebieConverter* self = g_new0(KeebieConverter, 1);
+  self->ref_count = 1;
+  self->file = file;
+  self->data = reinterpret_cast<guint8*>(g_mapped_file_get_contents(file));
+  self->size = g_mapped_file_get_length(file);
+  self->header = reinterpret_cast<const KeebieConverterHeader*>(self->data);
+
+  const KeebieConverterHeader* header = self->header;
+  if (header->magic != KEEBIE_CONVERTER_MAGIC || header->version != KEEBIE_CONVERTER_VERSION
+      || header->size != self->size
+      || memchr(header->locale, '\0', sizeof (header->locale)) == nullptr
+      || header->n_classes == 0 || header->n_classes > KEEBIE_CONVERTER_MAX_CLASSES
+      || !keebie_blob_section_is_valid(self->size, sizeof (KeebieConverterHeader), header->costs_offset, header->n_classes * header->n_classes, sizeof (int16_t))
+      || !keebie_blob_section_is_valid(self->size, sizeof (KeebieConverterHeader), header->readings_offset, header->n_readings, sizeof (KeebieConverterReading))
+      || !keebie_blob_section_is_valid(self->size, sizeof (KeebieConverterHeader), header->entries_offset, header->n_entries, sizeof (KeebieConverterEntry))
+      || !keebie_blob_section_is_valid(self->size, sizeof (KeebieConverterHeader), header->strings_offset, header->strings_size, 1)) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is truncated, corrupt or of another version", path);
+    keebie_converter_unref(self);
+    return nullptr;
+  }
+
+  self->costs = reinterpret_cast<const int16_t*>(self->data + header->costs_offset);
+  self->readings = reinterpret_cast<const KeebieConverterReading*>(self->data + header->readings_offset);
+  self->entries = reinterpret_cast<const KeebieConverterEntry*>(self->data + header->entries_offset);
+  self->strings = reinterpret_cast<const char*>(self->data + header->strings_offset);
+  return self;
+}
+
+KeebieConverter* keebie_converter_ref(KeebieConverter* self) {
+  g_atomic_int_inc(&self->ref_count);
+  return self;
+}
+
+void keebie_converter_unref(KeebieConverter* self) {
+  if (g_atomic_int_dec_and_test(&self->ref_count)) {
+    g_mapped_file_unref(self->file);
+    g_free(self);
+  }
+}
+
+const char* keebie_converter_get_locale(KeebieConverter* self) {
+  return self->header->locale;
+}
+
+void keebie_converter_release(KeebieConverter* self) {
+  madvise(self->data, self->size, MADV_DONTNEED);
+}
+
+static const char* keebie_converter_get_text(KeebieConverter* self, uint32_t offset, uint32_t length) {
+  const KeebieConverterHeader* header = self->header;
+  if (offset > header->strings_size || length > header->strings_size - offset) {
+    return nullptr;
+  }
+  return self->strings + offset;
+}
+
+static int32_t keebie_converter_get_cost(KeebieConverter* self, uint16_t left, uint16_t right) {
+  uint32_t n_classes = self->header->n_classes;
+  if (left >= n_classes || right >= n_classes) {
+    return KEEBIE_LATTICE_UNKNOWN_COST;
+  }
+  return self->costs[left * n_classes + right];
+}
+
+static const KeebieConverterReading* keebie_converter_lookup(KeebieConverter* self, const char* text, gsize length) {
+  guint low = 0;
+  guint high = self->header->n_readings;
+  while (low < high) {
+    guint mid = (low + high) / 2;
+    const KeebieConverterReading* reading = &self->readings[mid];
+    const char* other = keebie_converter_get_text(self, reading->text_offset, reading->length);
+    if (other == nullptr) {
+      return nullptr;
+    }
+
+    gint result = memcmp(other, text, MIN(reading->length, length));
+    if (result == 0) {
+      result = reading->length < length ? -1 : (reading->length > length ? 1 : 0);
+    }
+
+    if (result == 0) {
+      const KeebieConverterHeader* header = self->header;
+      return reading->first_entry <= header->n_entries && reading->n_entries <= header->n_entries - reading->first_entry ? reading : nullptr;
+    }
+
+    if (result < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return nullptr;
+}
+
+KeebieLattice* keebie_lattice_new(KeebieConverter* converter) {
+  KeebieLattice* self = g_new0(KeebieLattice, 1);
+  self->converter = keebie_converter_ref(converter);
+  self->reading = g_string_new(nullptr);
+  self->offsets = g_array_new(FALSE, FALSE, sizeof (uint32_t));
+  self->columns = g_array_new(FALSE, FALSE, sizeof (uint32_t));
+  self->nodes = g_array_new(FALSE, FALSE, sizeof (KeebieLatticeNode));
+
+  uint32_t zero = 0;
+  g_array_append_val(self->offsets, zero);
+  g_array_append_val(self->columns, zero);
+
+  KeebieLatticeNode start = {};
+  start.entry = KEEBIE_LATTICE_NO_ENTRY;
+  g_array_append_val(self->nodes, start);
+  return self;
+}
+
+void keebie_lattice_free(KeebieLattice* self) {
+  keebie_converter_unref(self->converter);
+  g_string_free(self->reading, TRUE);
+  g_array_unref(self->offsets);
+  g_array_unref(self->columns);
+  g_array_unref(self->nodes);
+  g_free(self);
+}
+
+KeebieConverter* keebie_lattice_get_converter(KeebieLattice* self) {
+  return self->converter;
+}
+
+static void keebie_lattice_add_node(KeebieLattice* self, uint32_t start, uint32_t end, uint32_t entry, uint16_t klass, int32_t cost) {
+  // The cheapest way into the word is all Viterbi keeps, the other ways in
+  // are only looked at again when conversions beyond the best are asked for.
+  uint32_t first = g_array_index(self->columns, uint32_t, start);
+  uint32_t last = start + 1 < self->columns->len ? g_array_index(self->columns, uint32_t, start + 1) : self->nodes->len;
+
+  int32_t best = G_MAXINT32;
+  for (uint32_t i = first; i < last; i++) {
+    const KeebieLatticeNode* previous = &g_array_index(self->nodes, KeebieLatticeNode, i);
+    int32_t total = previous->total + keebie_converter_get_cost(self->converter, previous->klass, klass);
+    best = MIN(best, total);
+  }
+
+  if (best == G_MAXINT32) {
+    return;
+  }
+
+  KeebieLatticeNode node = { start, end, entry, klass, cost, best + cost };
+  g_array_append_val(self->nodes, node);
+}
+
+static void keebie_lattice_add_column(KeebieLattice* self) {
+  uint32_t end = self->offsets->len - 1;
+  uint32_t first = self->nodes->len;
+  g_array_append_val(self->columns, first);
+
+  const uint32_t* offsets = reinterpret_cast<const uint32_t*>(self->offsets->data);
+  uint32_t start = end > KEEBIE_CONVERTER_MAX_READING ? end - KEEBIE_CONVERTER_MAX_READING : 0;
+  for (; start < end; start++) {
+    const KeebieConverterReading* reading = keebie_converter_lookup(self->converter, self->reading->str + offsets[start], offsets[end] - offsets[start]);
+    for (uint32_t i = 0; reading != nullptr && i < reading->n_entries; i++) {
+      uint32_t index = reading->first_entry + i;
+      const KeebieConverterEntry* entry = &self->converter->entries[index];
+      keebie_lattice_add_node(self, start, end, index, entry->klass, entry->cost);
+    }
+  }
+
+  keebie_lattice_add_node(self, end - 1, end, KEEBIE_LATTICE_NO_ENTRY, 0, KEEBIE_LATTICE_UNKNOWN_COST);
+}
+
+void keebie_lattice_set_reading(KeebieLattice* self, const char* reading) {
+  // Columns up to the last boundary both readings share stay as they are.
+  gsize same = 0;
+  while (same < self->reading->len && reading[same] != '\0' && reading[same] == self->reading->str[same]) {
+    same++;
+  }
+
+  guint kept = self->offsets->len - 1;
+  while (kept > 0 && g_array_index(self->offsets, uint32_t, kept) > same) {
+    kept--;
+  }
+
+  g_array_set_size(self->nodes, kept + 1 < self->columns->len ? g_array_index(self->columns, uint32_t, kept + 1) : self->nodes->len);
+  g_array_set_size(self->columns, kept + 1);
+  g_array_set_size(self->offsets, kept + 1);
+  g_string_truncate(self->reading, g_array_index(self->offsets, uint32_t, kept));
+
+  const char* rest = reading + self->reading->len;
+  if (!g_utf8_validate(rest, -1, nullptr)) {
+    return;
+  }
+
+  for (const char* p = rest; *p != '\0'; p = g_utf8_next_char(p)) {
+    g_string_append_len(self->reading, p, g_utf8_next_char(p) - p);
+
+    uint32_t offset = self->reading->len;
+    g_array_append_val(self->offsets, offset);
+    keebie_lattice_add_column(self);
+  }
+}
+
+const char* keebie_lattice_get_reading(KeebieLattice* self) {
+  return self->reading->str;
+}
+
+typedef struct {
+  uint32_t node;
+  uint32_t next;
+} KeebieLatticePath;
+
+typedef struct {
+  int32_t priority;
+  int32_t suffix;
+  uint32_t path;
+} KeebieLatticeCandidate;
+
+static void keebie_lattice_heap_push(GArray* heap, const KeebieLatticeCandidate* candidate) {
+  g_array_append_val(heap, *candidate);
+
+  KeebieLatticeCandidate* items = reinterpret_cast<KeebieLatticeCandidate*>(heap->data);
+  guint i = heap->len - 1;
+  while (i > 0 && items[(i - 1) / 2].priority > items[i].priority) {
+    KeebieLatticeCandidate tmp = items[i];
+    items[i] = items[(i - 1) / 2];
+    items[(i - 1) / 2] = tmp;
+    i = (i - 1) / 2;
+  }
+}
+
+static KeebieLatticeCandidate keebie_lattice_heap_pop(GArray* heap) {
+  KeebieLatticeCandidate* items = reinterpret_cast<KeebieLatticeCandidate*>(heap->data);
+  KeebieLatticeCandidate top = items[0];
+  items[0] = items[heap->len - 1];
+  g_array_set_size(heap, heap->len - 1);
+
+  guint i = 0;
+  for (;;) {
+    guint smallest = i;
+    guint left = i * 2 + 1;
+    guint right = left + 1;
+    if (left < heap->len && items[left].priority < items[smallest].priority) {
+      smallest = left;
+    }
+    if (right < heap->len && items[right].priority < items[smallest].priority) {
+      smallest = right;
+    }
+    if (smallest == i) {
+      break;
+    }
+
+    KeebieLatticeCandidate tmp = items[i];
+    items[i] = items[smallest];
+    items[smallest] = tmp;
+    i = smallest;
+  }
+  return top;
+}
+
+static gchar* keebie_lattice_build_text(KeebieLattice* self, GArray* paths, uint32_t path) {
+  GString* text = g_string_new(nullptr);
+  const uint32_t* offsets = reinterpret_cast<const uint32_t*>(self->offsets->data);
+
+  // The path starts at the start of the text, its first node is no word.
+  path = g_array_index(paths, KeebieLatticePath, path).next;
+  for (; path != KEEBIE_LATTICE_NO_PATH; path = g_array_index(paths, KeebieLatticePath, path).next) {
+    const KeebieLatticeNode* node = &g_array_index(self->nodes, KeebieLatticeNode, g_array_index(paths, KeebieLatticePath, path).node);
+    const char* surface = nullptr;
+    uint32_t length = 0;
+    if (node->entry != KEEBIE_LATTICE_NO_ENTRY) {
+      const KeebieConverterEntry* entry = &self->converter->entries[node->entry];
+      surface = keebie_converter_get_text(self->converter, entry->text_offset, entry->length);
+      length = entry->length;
+    }
+
+    if (surface != nullptr && g_utf8_validate(surface, length, nullptr)) {
+      g_string_append_len(text, surface, length);
+    } else {
+      g_string_append_len(text, self->reading->str + offsets[node->start], offsets[node->end] - offsets[node->start]);
+    }
+  }
+  return g_string_free(text, FALSE);
+}
+
+static gchar* keebie_lattice_to_katakana(const char* text) {
+  GString* result = g_string_new(nullptr);
+  for (const char* p = text; *p != '\0'; p = g_utf8_next_char(p)) {
+    gunichar c = g_utf8_get_char(p);
+    g_string_append_unichar(result, c >= 0x3041 && c <= 0x3096 ? c + 0x60 : c);
+  }
+  return g_string_free(result, FALSE);
+}
+
+guint keebie_lattice_convert(KeebieLattice* self, guint k, GPtrArray* candidates) {
+  if (k == 0 || self->reading->len == 0) {
+    return 0;
+  }
+
+  // Best-first backwards from the end of the text. Every node already knows
+  // the cheapest way to it from the start, which makes the estimate of a
+  // partial path exact, so whole paths come off the heap cheapest first.
+  g_autoptr(GArray) heap = g_array_new(FALSE, FALSE, sizeof (KeebieLatticeCandidate));
+  g_autoptr(GArray) paths = g_array_new(FALSE, FALSE, sizeof (KeebieLatticePath));
+  g_autoptr(GPtrArray) conversions = g_ptr_array_new_with_free_func(g_free);
+  g_autoptr(GHashTable) seen = g_hash_table_new(g_str_hash, g_str_equal);
+
+  guint last = self->columns->len - 1;
+  for (uint32_t i = g_array_index(self->columns, uint32_t, last); i < self->nodes->len; i++) {
+    const KeebieLatticeNode* node = &g_array_index(self->nodes, KeebieLatticeNode, i);
+    KeebieLatticePath path = { i, KEEBIE_LATTICE_NO_PATH };
+    g_array_append_val(paths, path);
+
+    int32_t suffix = keebie_converter_get_cost(self->converter, node->klass, 0);
+    KeebieLatticeCandidate candidate = { node->total + suffix, suffix, paths->len - 1 };
+    keebie_lattice_heap_push(heap, &candidate);
+  }
+
+  for (guint expansions = 0; heap->len > 0 && conversions->len < k && expansions < KEEBIE_LATTICE_MAX_EXPANSIONS; expansions++) {
+    KeebieLatticeCandidate top = keebie_lattice_heap_pop(heap);
+    uint32_t index = g_array_index(paths, KeebieLatticePath, top.path).node;
+    if (index == 0) {
+      // Different splits of the reading often spell the same text.
+      gchar* text = keebie_lattice_build_text(self, paths, top.path);
+      if (g_hash_table_contains(seen, text)) {
+        g_free(text);
+      } else {
+        g_hash_table_add(seen, text);
+        g_ptr_array_add(conversions, text);
+      }
+      continue;
+    }
+
+    KeebieLatticeNode node = g_array_index(self->nodes, KeebieLatticeNode, index);
+    uint32_t first = g_array_index(self->columns, uint32_t, node.start);
+    uint32_t end = g_array_index(self->columns, uint32_t, node.start + 1);
+    for (uint32_t i = first; i < end; i++) {
+      const KeebieLatticeNode* previous = &g_array_index(self->nodes, KeebieLatticeNode, i);
+      KeebieLatticePath path = { i, top.path };
+      g_array_append_val(paths, path);
+
+      int32_t suffix = top.suffix + node.cost + keebie_converter_get_cost(self->converter, previous->klass, node.klass);
+      KeebieLatticeCandidate candidate = { previous->total + suffix, suffix, paths->len - 1 };
+      keebie_lattice_heap_push(heap, &candidate);
+    }
+  }
+
+  // The kana themselves are always on offer, conversions make room for them.
+  g_autofree gchar* katakana = keebie_lattice_to_katakana(self->reading->str);
+  const char* fallbacks[] = { self->reading->str, katakana };
+  guint n_fallbacks = 0;
+  for (guint i = 0; i < G_N_ELEMENTS(fallbacks); i++) {
+    if (!g_hash_table_contains(seen, fallbacks[i]) && (i == 0 || strcmp(fallbacks[i], fallbacks[0]) != 0)) {
+      fallbacks[n_fallbacks++] = fallbacks[i];
+    }
+  }
+
+  guint n_conversions = MIN(conversions->len, MAX(k > n_fallbacks ? k - n_fallbacks : 0, 1u));
+  guint found = 0;
+  for (; found < n_conversions; found++) {
+    g_ptr_array_add(candidates, g_strdup(reinterpret_cast<const char*>(g_ptr_array_index(conversions, found))));
+  }
+  for (guint i = 0; i < n_fallbacks && found < k; i++, found++) {
+    g_ptr_array_add(candidates, g_strdup(fallbacks[i]));
+  }
+  return found;
+}
+
+typedef struct {
+  const char* romaji;
+  const char* kana;
+} KeebieRomaji;
+
+static const KeebieRomaji keebie_romaji_table[] = {
+  { "a", "あ" }, { "i", "い" }, { "u", "う" }, { "e", "え" }, { "o", "お" },
+  { "ka", "か" }, { "ki", "き" }, { "ku", "く" }, { "ke", "け" }, { "ko", "こ" },
+  { "ga", "が" }, { "gi", "ぎ" }, { "gu", "ぐ" }, { "ge", "げ" }, { "go", "ご" },
+  { "sa", "さ" }, { "si", "し" }, { "shi", "し" }, { "su", "す" }, { "se", "せ" }, { "so", "そ" },
+  { "za", "ざ" }, { "zi", "じ" }, { "ji", "じ" }, { "zu", "ず" }, { "ze", "ぜ" }, { "zo", "ぞ" },
+  { "ta", "た" }, { "ti", "ち" }, { "chi", "ち" }, { "tu", "つ" }, { "tsu", "つ" }, { "te", "て" }, { "to", "と" },
+  { "da", "だ" }, { "di", "ぢ" }, { "du", "づ" }, { "de", "で" }, { "do", "ど" },
+  { "na", "な" }, { "ni", "に" }, { "nu", "ぬ" }, { "ne", "ね" }, { "no", "の" },
+  { "ha", "は" }, { "hi", "ひ" }, { "hu", "ふ" }, { "fu", "ふ" }, { "he", "へ" }, { "ho", "ほ" },
+  { "ba", "ば" }, { "bi", "び" }, { "bu", "ぶ" }, { "be", "べ" }, { "bo", "ぼ" },
+  { "pa", "ぱ" }, { "pi", "ぴ" }, { "pu", "ぷ" }, { "pe", "ぺ" }, { "po", "ぽ" },
+  { "ma", "ま" }, { "mi", "み" }, { "mu", "む" }, { "me", "め" }, { "mo", "も" },
+  { "ya", "や" }, { "yu", "ゆ" }, { "yo", "よ" },
+  { "ra", "ら" }, { "ri", "り" }, { "ru", "る" }, { "re", "れ" }, { "ro", "ろ" },
+  { "wa", "わ" }, { "wi", "うぃ" }, { "we", "うぇ" }, { "wo", "を" },
+  { "nn", "ん" }, { "n'", "ん" }, { "xn", "ん" },
+  { "kya", "きゃ" }, { "kyu", "きゅ" }, { "kyo", "きょ" },
+  { "gya", "ぎゃ" }, { "gyu", "ぎゅ" }, { "gyo", "ぎょ" },
+  { "sya", "しゃ" }, { "syu", "しゅ" }, { "syo", "しょ" }, { "sha", "しゃ" }, { "shu", "しゅ" }, { "she", "しぇ" }, { "sho", "しょ" },
+  { "zya", "じゃ" }, { "zyu", "じゅ" }, { "zyo", "じょ" }, { "ja", "じゃ" }, { "ju", "じゅ" }, { "je", "じぇ" }, { "jo", "じょ" },
+  { "jya", "じゃ" }, { "jyu", "じゅ" }, { "jyo", "じょ" },
+  { "tya", "ちゃ" }, { "tyu", "ちゅ" }, { "tyo", "ちょ" }, { "cha", "ちゃ" }, { "chu", "ちゅ" }, { "che", "ちぇ" }, { "cho", "ちょ" },
+  { "cya", "ちゃ" }, { "cyu", "ちゅ" }, { "cyo", "ちょ" },
+  { "dya", "ぢゃ" }, { "dyu", "ぢゅ" }, { "dyo", "ぢょ" },
+  { "thi", "てぃ" }, { "dhi", "でぃ" }, { "twu", "とぅ" }, { "dwu", "どぅ" },
+  { "nya", "にゃ" }, { "nyu", "にゅ" }, { "nyo", "にょ" },
+  { "hya", "ひゃ" }, { "hyu", "ひゅ" }, { "hyo", "ひょ" },
+  { "fa", "ふぁ" }, { "fi", "ふぃ" }, { "fe", "ふぇ" }, { "fo", "ふぉ" },
+  { "bya", "びゃ" }, { "byu", "びゅ" }, { "byo", "びょ" },
+  { "pya", "ぴゃ" }, { "pyu", "ぴゅ" }, { "pyo", "ぴょ" },
+  { "mya", "みゃ" }, { "myu", "みゅ" }, { "myo", "みょ" },
+  { "rya", "りゃ" }, { "ryu", "りゅ" }, { "ryo", "りょ" },
+  { "va", "ゔぁ" }, { "vi", "ゔぃ" }, { "vu", "ゔ" }, { "ve", "ゔぇ" }, { "vo", "ゔぉ" },
+  { "xa", "ぁ" }, { "xi", "ぃ" }, { "xu", "ぅ" }, { "xe", "ぇ" }, { "xo", "ぉ" },
+  { "la", "ぁ" }, { "li", "ぃ" }, { "lu", "ぅ" }, { "le", "ぇ" }, { "lo", "ぉ" },
+  { "xya", "ゃ" }, { "xyu", "ゅ" }, { "xyo", "ょ" }, { "lya", "ゃ" }, { "lyu", "ゅ" }, { "lyo", "ょ" },
+  { "xtu", "っ" }, { "ltu", "っ" }, { "xtsu", "っ" }, { "ltsu", "っ" }, { "xwa", "ゎ" }, { "lwa", "ゎ" },
+  { "-", "ー" },
+};
+
+static gboolean keebie_romaji_is_letter(char c) {
+  return (c >= 'a' && c <= 'z') || c == '-' || c == '\'';
+}
+
+// 0 when nothing in the table starts with the letters, 1 when only longer
+// romaji do, 2 when they spell a kana, kana is set then.
+static gint keebie_romaji_match(const char* letters, gsize length, const char** kana) {
+  gint result = 0;
+  for (guint i = 0; i < G_N_ELEMENTS(keebie_romaji_table); i++) {
+    const char* romaji = keebie_romaji_table[i].romaji;
+    if (strncmp(romaji, letters, length) != 0) {
+      continue;
+    }
+
+    if (romaji[length] == '\0') {
+      *kana = keebie_romaji_table[i].kana;
+      return 2;
+    }
+    result = 1;
+  }
+  return result;
+}
+
+// Turns the letters at the end of text into kana from the first on, leaving
+// those which may still become one as they are.
+static void keebie_romaji_convert(GString* text, gboolean is_final) {
+  gsize start = text->len;
+  while (start > 0 && keebie_romaji_is_letter(text->str[start - 1])) {
+    start--;
+  }
+
+  g_autofree gchar* letters = g_strndup(text->str + start, text->len - start);
+  g_string_truncate(text, start);
+
+  const char* p = letters;
+  while (*p != '\0') {
+    gsize length = strlen(p);
+    const char* kana = nullptr;
+    gint match = keebie_romaji_match(p, length, &kana);
+    if (match == 2) {
+      g_string_append(text, kana);
+      break;
+    }
+
+    if (match == 1 && !is_final) {
+      g_string_append(text, p);
+      break;
+    }
+
+    if (p[0] == 'n' && (length == 1 || !strchr("aiueoy", p[1]))) {
+      // A lone n before anything but a vowel is already the syllabic one.
+      if (length == 1 && !is_final) {
+        g_string_append_c(text, 'n');
+        break;
+      }
+      g_string_append(text, "ん");
+    } else if (length > 1 && p[0] == p[1] && !strchr("aiueon-'", p[0])) {
+      // Doubled consonants are a small tsu before the second one.
+      g_string_append(text, "っ");
+    } else {
+      g_string_append_c(text, p[0]);
+    }
+    p++;
+  }
+}
+
+gboolean keebie_romaji_append(GString* text, gunichar c) {
+  if (c < 0x80) {
+    char letter = g_ascii_tolower(c);
+    if (!keebie_romaji_is_letter(letter)) {
+      return FALSE;
+    }
+
+    g_string_append_c(text, letter);
+    keebie_romaji_convert(text, FALSE);
+    return TRUE;
+  }
+
+  // Hiragana, and the prolonged sound mark which goes with them.
+  if ((c < 0x3041 || c > 0x3096) && c != 0x30fc) {
+    return FALSE;
+  }
+
+  keebie_romaji_finish(text);
+  g_string_append_unichar(text, c);
+  return TRUE;
+}
+
+void keebie_romaji_finish(GString* text) {
+  keebie_romaji_convert(text, TRUE);
+}
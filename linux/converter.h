@@ -0,0 +1,135 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+#define KEEBIE_CONVERTER_MAGIC 0x4b4b424bu /* "KBKK" */
+#define KEEBIE_CONVERTER_VERSION 1
+
+/**
+ * The compiled kana-kanji conversion dictionary, a single blob of:
+ *
+ *   header | costs | readings | entries | strings
+ *
+ * A word is typed as its reading, in hiragana, and written as its surface.
+ * Readings are sorted byte-wise and point at their run of entries, cheapest
+ * first. Every entry has a class, and costs is the n_classes by n_classes
+ * matrix of what a word of the row's class costs followed by one of the
+ * column's. Class 0 is the start and the end of the text. Costs are scaled
+ * negative log probabilities, lower is likelier. Records are in host byte
+ * order, bump KEEBIE_CONVERTER_VERSION on any change.
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;
+  char locale[16];
+  uint32_t n_classes;
+  uint32_t costs_offset;
+  uint32_t n_readings;
+  uint32_t readings_offset;
+  uint32_t n_entries;
+  uint32_t entries_offset;
+  uint32_t strings_offset;
+  uint32_t strings_size;
+} KeebieConverterHeader;
+
+typedef struct {
+  uint32_t text_offset;
+  uint32_t length;
+  uint32_t first_entry;
+  uint32_t n_entries;
+} KeebieConverterReading;
+
+typedef struct {
+  uint32_t text_offset;
+  uint32_t length;
+  uint16_t klass;
+  int16_t cost;
+} KeebieConverterEntry;
+
+typedef struct _KeebieConverter KeebieConverter;
+typedef struct _KeebieConverterBuilder KeebieConverterBuilder;
+
+KeebieConverterBuilder* keebie_converter_builder_new(const char* locale);
+void keebie_converter_builder_free(KeebieConverterBuilder* self);
+
+/**
+ * Parses a source of one "reading<TAB>surface<TAB>class<TAB>cost" per line,
+ * and "@<TAB>class<TAB>class<TAB>cost" lines for the cost of a word of the
+ * first class followed by one of the second. The class "BOS" is the start
+ * and end of the text, pairs without a line cost the "@<TAB>default" one.
+ * Blank lines and lines starting with # are skipped.
+ */
+gboolean keebie_converter_builder_add_source(KeebieConverterBuilder* self, const char* data, gsize length, GError** error);
+
+/**
+ * Serializes everything added so far into a compiled converter blob.
+ */
+GBytes* keebie_converter_builder_end(KeebieConverterBuilder* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieConverterBuilder, keebie_converter_builder_free);
+
+/**
+ * Maps a compiled converter read-only, only the header is checked here.
+ */
+KeebieConverter* keebie_converter_new_from_file(const char* path, GError** error);
+KeebieConverter* keebie_converter_ref(KeebieConverter* self);
+void keebie_converter_unref(KeebieConverter* self);
+
+const char* keebie_converter_get_locale(KeebieConverter* self);
+
+/**
+ * Gives the pages touched so far back to the kernel, like
+ * keebie_dictionary_release.
+ */
+void keebie_converter_release(KeebieConverter* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieConverter, keebie_converter_unref);
+
+/**
+ * The conversion lattice of one reading: every dictionary word found in it,
+ * by the character it ends at, along with the cheapest way to get there
+ * from the start. The reading is only ever edited at its end while typing,
+ * so the lattice keeps every column before the edit and only looks up the
+ * words ending after it.
+ */
+typedef struct _KeebieLattice KeebieLattice;
+
+KeebieLattice* keebie_lattice_new(KeebieConverter* converter);
+void keebie_lattice_free(KeebieLattice* self);
+
+KeebieConverter* keebie_lattice_get_converter(KeebieLattice* self);
+
+/**
+ * Makes reading the text to convert, reusing the columns of the part it
+ * shares with the previous one.
+ */
+void keebie_lattice_set_reading(KeebieLattice* self, const char* reading);
+const char* keebie_lattice_get_reading(KeebieLattice* self);
+
+/**
+ * Appends up to k conversions of the whole reading to candidates, cheapest
+ * first, and returns how many were appended. The reading itself and its
+ * katakana come last unless a conversion already spelled them.
+ */
+guint keebie_lattice_convert(KeebieLattice* self, guint k, GPtrArray* candidates);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieLattice, keebie_lattice_free);
+
+/**
+ * Appends a typed character to text, turning the latin letters at its end
+ * into kana as soon as they spell one. Returns FALSE when c is neither kana
+ * nor a latin letter, and leaves text alone then.
+ */
+gboolean keebie_romaji_append(GString* text, gunichar c);
+
+/**
+ * Turns what is left of the letters at the end of text into kana where it
+ * can, a lone n ends in ん once nothing else follows.
+ */
+void keebie_romaji_finish(GString* text);
+
+G_END_DECLS
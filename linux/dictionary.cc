@@ -0,0 +1,715 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "blob.h"
+#include "dictionary.h"
+
+// Bounds the work a single completion may do, even on a corrupt blob.
+#define KEEBIE_DICTIONARY_MAX_VISITS 4096
+
+// Two edits catch nearly every typo, indexing only the start of words keeps
+// the deletes of long words from dominating the index.
+#define KEEBIE_DICTIONARY_MAX_EDITS 2
+#define KEEBIE_DICTIONARY_PREFIX_LENGTH 7
+
+// Longer input is not a word worth correcting, and bounds the distance rows.
+#define KEEBIE_DICTIONARY_MAX_WORD 48
+
+// Bounds how many candidates a single correction may verify.
+#define KEEBIE_DICTIONARY_MAX_CANDIDATES 512
+
+// How much likelier, as a natural log of frequency, a word must be to win
+// over one an edit closer to what was typed.
+#define KEEBIE_DICTIONARY_EDIT_PENALTY 4.0f
+
+typedef struct {
+  uint8_t byte;
+  uint32_t child;
+} KeebieDictionaryBuildEdge;
+
+typedef struct {
+  uint32_t frequency;
+  uint32_t best;
+  GArray* edges;
+} KeebieDictionaryBuildNode;
+
+struct _KeebieDictionaryBuilder {
+  gchar* locale;
+  GHashTable* words;
+};
+
+struct _KeebieDictionary {
+  gint ref_count;
+  GMappedFile* file;
+  guint8* data;
+  gsize size;
+
+  const KeebieDictionaryHeader* header;
+  const KeebieDictionaryNode* nodes;
+  const KeebieDictionaryEdge* edges;
+  const KeebieDictionaryWord* words;
+  const uint32_t* buckets;
+  const KeebieDictionaryDelete* deletes;
+  const char* strings;
+};
+
+KeebieDictionaryBuilder* keebie_dictionary_builder_new(const char* locale) {
+  KeebieDictionaryBuilder* self = g_new0(KeebieDictionaryBuilder, 1);
+  self->locale = g_strdup(locale);
+  self->words = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, nullptr);
+  return self;
+}
+
+void keebie_dictionary_builder_free(KeebieDictionaryBuilder* self) {
+  g_hash_table_unref(self->words);
+  g_free(self->locale);
+  g_free(self);
+}
+
+void keebie_dictionary_builder_add(KeebieDictionaryBuilder* self, const char* word, uint32_t frequency) {
+  if (word[0] == '\0' || frequency == 0) {
+    return;
+  }
+
+  gpointer value = nullptr;
+  if (g_hash_table_lookup_extended(self->words, word, nullptr, &value)) {
+    uint64_t sum = static_cast<uint64_t>(GPOINTER_TO_UINT(value)) + frequency;
+    g_hash_table_insert(self->words, g_strdup(word), GUINT_TO_POINTER(MIN(sum, G_MAXUINT32)));
+  } else {
+    g_hash_table_insert(self->words, g_strdup(word), GUINT_TO_POINTER(frequency));
+  }
+}
+
+gboolean keebie_dictionary_builder_add_list(KeebieDictionaryBuilder* self, const char* data, gsize length, GError** error) {
+  g_autofree gchar* copy = g_strndup(data, length);
+  g_auto(GStrv) lines = g_strsplit(copy, "\n", -1);
+
+  for (guint i = 0; lines[i] != nullptr; i++) {
+    gchar* line = g_strstrip(lines[i]);
+    if (line[0] == '\0' || line[0] == '#') {
+      continue;
+    }
+
+    gchar* tab = strchr(line, '\t');
+    if (tab == nullptr) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Line %u: expected word<TAB>frequency", i + 1);
+      return FALSE;
+    }
+    *tab = '\0';
+
+    gchar* end = nullptr;
+    guint64 frequency = g_ascii_strtoull(tab + 1, &end, 10);
+    if (end == tab + 1 || *end != '\0' || !g_utf8_validate(line, -1, nullptr)) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Line %u: invalid word or frequency", i + 1);
+      return FALSE;
+    }
+
+    keebie_dictionary_builder_add(self, g_strstrip(line), MIN(frequency, G_MAXUINT32));
+  }
+  return TRUE;
+}
+
+static gint keebie_dictionary_compare_words(gconstpointer a, gconstpointer b) {
+  return strcmp(*reinterpret_cast<const char* const*>(a), *reinterpret_cast<const char* const*>(b));
+}
+
+typedef struct {
+  GArray* build_nodes;
+  GArray* nodes;
+  GArray* edges;
+  GHashTable* shared;
+} KeebieDictionaryWriter;
+
+// Emits children before their parent, so a subtree identical to one already
+// written resolves to the existing node instead of being written again.
+static uint32_t keebie_dictionary_write_node(KeebieDictionaryWriter* writer, uint32_t index) {
+  KeebieDictionaryBuildNode* build = &g_array_index(writer->build_nodes, KeebieDictionaryBuildNode, index);
+
+  guint n_edges = build->edges->len;
+  g_autofree KeebieDictionaryEdge* edges = g_new0(KeebieDictionaryEdge, n_edges);
+  for (guint i = 0; i < n_edges; i++) {
+    KeebieDictionaryBuildEdge* edge = &g_array_index(build->edges, KeebieDictionaryBuildEdge, i);
+    edges[i].byte = edge->byte;
+    edges[i].target = keebie_dictionary_write_node(writer, edge->child);
+  }
+
+  GByteArray* key = g_byte_array_new();
+  g_byte_array_append(key, reinterpret_cast<const guint8*>(&build->frequency), sizeof (build->frequency));
+  g_byte_array_append(key, reinterpret_cast<const guint8*>(&build->best), sizeof (build->best));
+  g_byte_array_append(key, reinterpret_cast<const guint8*>(edges), n_edges * sizeof (KeebieDictionaryEdge));
+  g_autoptr(GBytes) key_bytes = g_byte_array_free_to_bytes(key);
+
+  gpointer existing = nullptr;
+  if (g_hash_table_lookup_extended(writer->shared, key_bytes, nullptr, &existing)) {
+    return GPOINTER_TO_UINT(existing);
+  }
+
+  KeebieDictionaryNode node = {};
+  node.first_edge = writer->edges->len;
+  node.n_edges = n_edges;
+  node.frequency = build->frequency;
+  node.best = build->best;
+  g_array_append_vals(writer->edges, edges, n_edges);
+  g_array_append_val(writer->nodes, node);
+
+  uint32_t result = writer->nodes->len - 1;
+  g_hash_table_insert(writer->shared, g_bytes_ref(key_bytes), GUINT_TO_POINTER(result));
+  return result;
+}
+
+static uint32_t keebie_dictionary_update_best(GArray* build_nodes, uint32_t index) {
+  KeebieDictionaryBuildNode* build = &g_array_index(build_nodes, KeebieDictionaryBuildNode, index);
+  uint32_t best = build->frequency;
+  for (guint i = 0; i < build->edges->len; i++) {
+    uint32_t child = g_array_index(build->edges, KeebieDictionaryBuildEdge, i).child;
+    best = MAX(best, keebie_dictionary_update_best(build_nodes, child));
+  }
+
+  g_array_index(build_nodes, KeebieDictionaryBuildNode, index).best = best;
+  return best;
+}
+
+static uint32_t keebie_dictionary_hash(const char* text) {
+  // FNV-1a, it only has to spread short strings over the buckets.
+  uint32_t hash = 2166136261u;
+  for (const char* p = text; *p != '\0'; p++) {
+    hash = (hash ^ static_cast<uint8_t>(*p)) * 16777619u;
+  }
+  return hash;
+}
+
+// Collects every distinct string left after deleting up to max_edits code
+// points from text, text itself included. A string is always reached with
+// the same edits left, so one already collected has its deletes too.
+static void keebie_dictionary_collect_deletes(const gunichar* text, glong length, guint max_edits, GHashTable* deletes) {
+  if (!g_hash_table_add(deletes, g_ucs4_to_utf8(text, length, nullptr, nullptr, nullptr)) || max_edits == 0 || length == 0) {
+    return;
+  }
+
+  g_autofree gunichar* shorter = g_new(gunichar, length);
+  for (glong i = 0; i < length; i++) {
+    memcpy(shorter, text, i * sizeof (gunichar));
+    memcpy(shorter + i, text + i + 1, (length - i - 1) * sizeof (gunichar));
+    keebie_dictionary_collect_deletes(shorter, length - 1, max_edits - 1, deletes);
+  }
+}
+
+static GHashTable* keebie_dictionary_get_deletes(const gunichar* text, glong length, guint max_edits, guint prefix_length) {
+  GHashTable* deletes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, nullptr);
+  keebie_dictionary_collect_deletes(text, MIN(length, static_cast<glong>(prefix_length)), max_edits, deletes);
+  return deletes;
+}
+
+GBytes* keebie_dictionary_builder_end(KeebieDictionaryBuilder* self) {
+  // Sorted words only ever add a child after the last one, so the edges of
+  // every node come out sorted without searching.
+  g_autofree gpointer* words = g_hash_table_get_keys_as_array(self->words, nullptr);
+  guint n_words = g_hash_table_size(self->words);
+  qsort(words, n_words, sizeof (gpointer), keebie_dictionary_compare_words);
+
+  GArray* build_nodes = g_array_new(FALSE, TRUE, sizeof (KeebieDictionaryBuildNode));
+  KeebieDictionaryBuildNode root = {};
+  root.edges = g_array_new(FALSE, FALSE, sizeof (KeebieDictionaryBuildEdge));
+  g_array_append_val(build_nodes, root);
+
+  for (guint i = 0; i < n_words; i++) {
+    const char* word = reinterpret_cast<const char*>(words[i]);
+    uint32_t index = 0;
+
+    for (const char* p = word; *p != '\0'; p++) {
+      GArray* edges = g_array_index(build_nodes, KeebieDictionaryBuildNode, index).edges;
+      uint8_t byte = static_cast<uint8_t>(*p);
+
+      if (edges->len > 0 && g_array_index(edges, KeebieDictionaryBuildEdge, edges->len - 1).byte == byte) {
+        index = g_array_index(edges, KeebieDictionaryBuildEdge, edges->len - 1).child;
+        continue;
+      }
+
+      KeebieDictionaryBuildNode node = {};
+      node.edges = g_array_new(FALSE, FALSE, sizeof (KeebieDictionaryBuildEdge));
+      g_array_append_val(build_nodes, node);
+
+      KeebieDictionaryBuildEdge edge = { byte, build_nodes->len - 1 };
+      g_array_append_val(edges, edge);
+      index = edge.child;
+    }
+
+    g_array_index(build_nodes, KeebieDictionaryBuildNode, index).frequency = GPOINTER_TO_UINT(g_hash_table_lookup(self->words, word));
+  }
+
+  keebie_dictionary_update_best(build_nodes, 0);
+
+  KeebieDictionaryWriter writer = {};
+  writer.build_nodes = build_nodes;
+  writer.nodes = g_array_new(FALSE, FALSE, sizeof (KeebieDictionaryNode));
+  writer.edges = g_array_new(FALSE, FALSE, sizeof (KeebieDictionaryEdge));
+  writer.shared = g_hash_table_new_full(g_bytes_hash, g_bytes_equal, (GDestroyNotify)g_bytes_unref, nullptr);
+  uint32_t root_index = keebie_dictionary_write_node(&writer, 0);
+
+  GArray* list = g_array_sized_new(FALSE, FALSE, sizeof (KeebieDictionaryWord), n_words);
+  GByteArray* strings = g_byte_array_new();
+  GArray* pending = g_array_new(FALSE, FALSE, sizeof (KeebieDictionaryDelete));
+  for (guint i = 0; i < n_words; i++) {
+    const char* word = reinterpret_cast<const char*>(words[i]);
+
+    KeebieDictionaryWord entry = {};
+    entry.text_offset = strings->len;
+    entry.length = strlen(word);
+    entry.frequency = GPOINTER_TO_UINT(g_hash_table_lookup(self->words, word));
+    g_array_append_val(list, entry);
+    g_byte_array_append(strings, reinterpret_cast<const guint8*>(word), entry.length + 1);
+
+    glong length = 0;
+    g_autofree gunichar* text = g_utf8_to_ucs4_fast(word, -1, &length);
+    g_autoptr(GHashTable) deletes = keebie_dictionary_get_deletes(text, length, KEEBIE_DICTIONARY_MAX_EDITS, KEEBIE_DICTIONARY_PREFIX_LENGTH);
+
+    GHashTableIter iter;
+    gpointer key = nullptr;
+    g_hash_table_iter_init(&iter, deletes);
+    while (g_hash_table_iter_next(&iter, &key, nullptr)) {
+      KeebieDictionaryDelete item = { keebie_dictionary_hash(reinterpret_cast<const char*>(key)), i };
+      g_array_append_val(pending, item);
+    }
+  }
+
+  // About two deletes a bucket, laid out in bucket order by counting sort.
+  uint32_t n_buckets = 1;
+  while (n_buckets < pending->len / 2 && n_buckets < (1u << 31)) {
+    n_buckets <<= 1;
+  }
+
+  g_autofree uint32_t* buckets = g_new0(uint32_t, n_buckets + 1);
+  for (guint i = 0; i < pending->len; i++) {
+    buckets[(g_array_index(pending, KeebieDictionaryDelete, i).hash & (n_buckets - 1)) + 1]++;
+  }
+  for (uint32_t i = 0; i < n_buckets; i++) {
+    buckets[i + 1] += buckets[i];
+  }
+
+  g_autofree uint32_t* fill = reinterpret_cast<uint32_t*>(g_memdup2(buckets, n_buckets * sizeof (uint32_t)));
+  g_autofree KeebieDictionaryDelete* deletes = g_new(KeebieDictionaryDelete, MAX(pending->len, 1));
+  for (guint i = 0; i < pending->len; i++) {
+    const KeebieDictionaryDelete* item = &g_array_index(pending, KeebieDictionaryDelete, i);
+    deletes[fill[item->hash & (n_buckets - 1)]++] = *item;
+  }
+
+  KeebieDictionaryHeader header = {};
+  header.magic = KEEBIE_DICTIONARY_MAGIC;
+  header.version = KEEBIE_DICTIONARY_VERSION;
+  g_strlcpy(header.locale, self->locale, sizeof (header.locale));
+  header.n_words = n_words;
+  header.root = root_index;
+  header.n_nodes = writer.nodes->len;
+  header.nodes_offset = sizeof (KeebieDictionaryHeader);
+  header.n_edges = writer.edges->len;
+  header.edges_offset = header.nodes_offset + header.n_nodes * sizeof (KeebieDictionaryNode);
+  header.words_offset = header.edges_offset + header.n_edges * sizeof (KeebieDictionaryEdge);
+  header.max_edits = KEEBIE_DICTIONARY_MAX_EDITS;
+  header.prefix_length = KEEBIE_DICTIONARY_PREFIX_LENGTH;
+  header.n_buckets = n_buckets;
+  header.buckets_offset = header.words_offset + n_words * sizeof (KeebieDictionaryWord);
+  header.n_deletes = pending->len;
+  header.deletes_offset = header.buckets_offset + (n_buckets + 1) * sizeof (uint32_t);
+  header.strings_offset = header.deletes_offset + header.n_deletes * sizeof (KeebieDictionaryDelete);
+  header.strings_size = strings->len;
+  header.size = header.strings_offset + header.strings_size;
+
+  guint8* data = reinterpret_cast<guint8*>(g_malloc0(header.size));
+  memcpy(data, &header, sizeof (header));
+  memcpy(data + header.nodes_offset, writer.nodes->data, header.n_nodes * sizeof (KeebieDictionaryNode));
+  memcpy(data + header.edges_offset, writer.edges->data, header.n_edges * sizeof (KeebieDictionaryEdge));
+  memcpy(data + header.words_offset, list->data, n_words * sizeof (KeebieDictionaryWord));
+  memcpy(data + header.buckets_offset, buckets, (n_buckets + 1) * sizeof (uint32_t));
+  memcpy(data + header.deletes_offset, deletes, header.n_deletes * sizeof (KeebieDictionaryDelete));
+  memcpy(data + header.strings_offset, strings->data, header.strings_size);
+
+  for (guint i = 0; i < build_nodes->len; i++) {
+    g_array_unref(g_array_index(build_nodes, KeebieDictionaryBuildNode, i).edges);
+  }
+  g_array_unref(build_nodes);
+  g_array_unref(writer.nodes);
+  g_array_unref(writer.edges);
+  g_hash_table_unref(writer.shared);
+  g_array_unref(list);
+  g_byte_array_unref(strings);
+  g_array_unref(pending);
+  return g_bytes_new_take(data, header.size);
+}
+
+static gboolean keebie_dictionary_index_is_valid(const KeebieDictionaryHeader* header, gsize size) {
+  return header->n_buckets > 0 && (header->n_buckets & (header->n_buckets - 1)) == 0
+    && header->max_edits <= KEEBIE_DICTIONARY_MAX_EDITS && header->prefix_length <= KEEBIE_DICTIONARY_MAX_WORD
+    && keebie_blob_section_is_valid(size, sizeof (KeebieDictionaryHeader), header->words_offset, header->n_words, sizeof (KeebieDictionaryWord))
+    && keebie_blob_section_is_valid(size, sizeof (KeebieDictionaryHeader), header->buckets_offset, header->n_buckets + 1, sizeof (uint32_t))
+    && keebie_blob_section_is_valid(size, sizeof (KeebieDictionaryHeader), header->deletes_offset, header->n_deletes, sizeof (KeebieDictionaryDelete))
+    && keebie_blob_section_is_valid(size, sizeof (KeebieDictionaryHeader), header->strings_offset, header->strings_size, 1);
+}
+
+KeebieDictionary* keebie_dictionary_new_from_file(const char* path, GError** error) {
+  // Lookups hop all over the trie, readahead would only fault in pages no
+  // lookup ever needs.
+  GMappedFile* file = keebie_blob_map(path, sizeof (KeebieDictionaryHeader), MADV_RANDOM, error);
+  if (file == nullptr) {
+    return nullptr;
+  }
+
+  KeebieDictionary* self = g_new0(KeebieDictionary, 1);
+  self->ref_count = 1;
+  self->file = file;
+  self->data = reinterpret_cast<guint8*>(g_mapped_file_get_contents(file));
+  self->size = g_mapped_file_get_length(file);
+  self->header = reinterpret_cast<const KeebieDictionaryHeader*>(self->data);
+
+  const KeebieDictionaryHeader* header = self->header;
+  if (header->magic != KEEBIE_DICTIONARY_MAGIC || header->version != KEEBIE_DICTIONARY_VERSION
+      || header->size != self->size
+      || memchr(header->locale, '\0', sizeof (header->locale)) == nullptr
+      || !keebie_blob_section_is_valid(self->size, sizeof (KeebieDictionaryHeader), header->nodes_offset, header->n_nodes, sizeof (KeebieDictionaryNode))
+      || !keebie_blob_section_is_valid(self->size, sizeof (KeebieDictionaryHeader), header->edges_offset, header->n_edges, sizeof (KeebieDictionaryEdge))
+      || !keebie_dictionary_index_is_valid(header, self->size)
+      || header->root >= header->n_nodes) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is truncated, corrupt or of another version", path);
+    keebie_dictionary_unref(self);
+    return nullptr;
+  }
+
+  self->nodes = reinterpret_cast<const KeebieDictionaryNode*>(self->data + header->nodes_offset);
+  self->edges = reinterpret_cast<const KeebieDictionaryEdge*>(self->data + header->edges_offset);
+  self->words = reinterpret_cast<const KeebieDictionaryWord*>(self->data + header->words_offset);
+  self->buckets = reinterpret_cast<const uint32_t*>(self->data + header->buckets_offset);
+  self->deletes = reinterpret_cast<const KeebieDictionaryDelete*>(self->data + header->deletes_offset);
+  self->strings = reinterpret_cast<const char*>(self->data + header->strings_offset);
+  return self;
+}
+
+KeebieDictionary* keebie_dictionary_ref(KeebieDictionary* self) {
+  g_atomic_int_inc(&self->ref_count);
+  return self;
+}
+
+void keebie_dictionary_unref(KeebieDictionary* self) {
+  if (g_atomic_int_dec_and_test(&self->ref_count)) {
+    g_mapped_file_unref(self->file);
+    g_free(self);
+  }
+}
+
+const char* keebie_dictionary_get_locale(KeebieDictionary* self) {
+  return self->header->locale;
+}
+
+guint keebie_dictionary_get_n_words(KeebieDictionary* self) {
+  return self->header->n_words;
+}
+
+static const KeebieDictionaryNode* keebie_dictionary_get_node(KeebieDictionary* self, uint32_t index) {
+  return index < self->header->n_nodes ? &self->nodes[index] : nullptr;
+}
+
+static const KeebieDictionaryEdge* keebie_dictionary_get_edges(KeebieDictionary* self, const KeebieDictionaryNode* node) {
+  if (node->first_edge > self->header->n_edges || node->n_edges > self->header->n_edges - node->first_edge) {
+    return nullptr;
+  }
+  return &self->edges[node->first_edge];
+}
+
+static const KeebieDictionaryNode* keebie_dictionary_walk(KeebieDictionary* self, const char* prefix) {
+  const KeebieDictionaryNode* node = keebie_dictionary_get_node(self, self->header->root);
+
+  for (const char* p = prefix; node != nullptr && *p != '\0'; p++) {
+    const KeebieDictionaryEdge* edges = keebie_dictionary_get_edges(self, node);
+    if (edges == nullptr) {
+      return nullptr;
+    }
+
+    uint8_t byte = static_cast<uint8_t>(*p);
+    guint low = 0;
+    guint high = node->n_edges;
+    while (low < high) {
+      guint mid = (low + high) / 2;
+      if (edges[mid].byte < byte) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+
+    if (low == node->n_edges || edges[low].byte != byte) {
+      return nullptr;
+    }
+    node = keebie_dictionary_get_node(self, edges[low].target);
+  }
+  return node;
+}
+
+uint32_t keebie_dictionary_lookup(KeebieDictionary* self, const char* word) {
+  const KeebieDictionaryNode* node = keebie_dictionary_walk(self, word);
+  return node != nullptr ? node->frequency : 0;
+}
+
+uint32_t keebie_dictionary_get_best(KeebieDictionary* self, const char* prefix) {
+  const KeebieDictionaryNode* node = keebie_dictionary_walk(self, prefix);
+  return node != nullptr ? node->best : 0;
+}
+
+typedef struct {
+  uint32_t priority;
+  uint32_t node;
+  uint32_t path;
+  gboolean is_word;
+} KeebieDictionaryCandidate;
+
+typedef struct {
+  uint32_t parent;
+  uint8_t byte;
+} KeebieDictionaryPath;
+
+#define KEEBIE_DICTIONARY_NO_PATH G_MAXUINT32
+
+static void keebie_dictionary_heap_push(GArray* heap, const KeebieDictionaryCandidate* candidate) {
+  g_array_append_val(heap, *candidate);
+
+  KeebieDictionaryCandidate* items = reinterpret_cast<KeebieDictionaryCandidate*>(heap->data);
+  guint i = heap->len - 1;
+  while (i > 0 && items[(i - 1) / 2].priority < items[i].priority) {
+    KeebieDictionaryCandidate tmp = items[i];
+    items[i] = items[(i - 1) / 2];
+    items[(i - 1) / 2] = tmp;
+    i = (i - 1) / 2;
+  }
+}
+
+static KeebieDictionaryCandidate keebie_dictionary_heap_pop(GArray* heap) {
+  KeebieDictionaryCandidate* items = reinterpret_cast<KeebieDictionaryCandidate*>(heap->data);
+  KeebieDictionaryCandidate top = items[0];
+  items[0] = items[heap->len - 1];
+  g_array_set_size(heap, heap->len - 1);
+
+  guint i = 0;
+  for (;;) {
+    guint largest = i;
+    guint left = i * 2 + 1;
+    guint right = left + 1;
+    if (left < heap->len && items[left].priority > items[largest].priority) {
+      largest = left;
+    }
+    if (right < heap->len && items[right].priority > items[largest].priority) {
+      largest = right;
+    }
+    if (largest == i) {
+      break;
+    }
+
+    KeebieDictionaryCandidate tmp = items[i];
+    items[i] = items[largest];
+    items[largest] = tmp;
+    i = largest;
+  }
+  return top;
+}
+
+static gchar* keebie_dictionary_build_word(GArray* paths, const char* prefix, uint32_t path) {
+  GString* suffix = g_string_new(nullptr);
+  for (; path != KEEBIE_DICTIONARY_NO_PATH; path = g_array_index(paths, KeebieDictionaryPath, path).parent) {
+    g_string_append_c(suffix, g_array_index(paths, KeebieDictionaryPath, path).byte);
+  }
+
+  g_strreverse(suffix->str);
+  g_string_prepend(suffix, prefix);
+  return g_string_free(suffix, FALSE);
+}
+
+guint keebie_dictionary_complete(KeebieDictionary* self, const char* prefix, guint k, GPtrArray* words) {
+  const KeebieDictionaryNode* start = keebie_dictionary_walk(self, prefix);
+  if (start == nullptr || k == 0) {
+    return 0;
+  }
+
+  // Best-first over the subtree, a node's priority is the best word below it
+  // so words come off the heap in order of frequency.
+  g_autoptr(GArray) heap = g_array_new(FALSE, FALSE, sizeof (KeebieDictionaryCandidate));
+  g_autoptr(GArray) paths = g_array_new(FALSE, FALSE, sizeof (KeebieDictionaryPath));
+
+  KeebieDictionaryCandidate candidate = { start->best, static_cast<uint32_t>(start - self->nodes), KEEBIE_DICTIONARY_NO_PATH, FALSE };
+  keebie_dictionary_heap_push(heap, &candidate);
+
+  guint found = 0;
+  for (guint visits = 0; heap->len > 0 && found < k && visits < KEEBIE_DICTIONARY_MAX_VISITS; visits++) {
+    KeebieDictionaryCandidate top = keebie_dictionary_heap_pop(heap);
+    if (top.is_word) {
+      g_ptr_array_add(words, keebie_dictionary_build_word(paths, prefix, top.path));
+      found++;
+      continue;
+    }
+
+    const KeebieDictionaryNode* node = keebie_dictionary_get_node(self, top.node);
+    const KeebieDictionaryEdge* edges = node != nullptr ? keebie_dictionary_get_edges(self, node) : nullptr;
+    if (edges == nullptr) {
+      continue;
+    }
+
+    if (node->frequency > 0) {
+      KeebieDictionaryCandidate word = { node->frequency, top.node, top.path, TRUE };
+      keebie_dictionary_heap_push(heap, &word);
+    }
+
+    for (guint i = 0; i < node->n_edges; i++) {
+      const KeebieDictionaryNode* child = keebie_dictionary_get_node(self, edges[i].target);
+      if (child == nullptr || child->best == 0) {
+        continue;
+      }
+
+      KeebieDictionaryPath path = { top.path, edges[i].byte };
+      g_array_append_val(paths, path);
+
+      KeebieDictionaryCandidate next = { child->best, edges[i].target, paths->len - 1, FALSE };
+      keebie_dictionary_heap_push(heap, &next);
+    }
+  }
+  return found;
+}
+
+typedef struct {
+  uint32_t word;
+  float score;
+} KeebieDictionaryCorrection;
+
+// Optimal string alignment distance, substituting adjacent keys costs half
+// an edit when adjacent is given.
+static float keebie_dictionary_distance(const gunichar* a, glong n, const gunichar* b, glong m, KeebieDictionaryAdjacentFunc adjacent, gpointer user_data) {
+  float rows[3][KEEBIE_DICTIONARY_MAX_WORD + KEEBIE_DICTIONARY_MAX_EDITS + 1];
+  float* before = rows[0];
+  float* previous = rows[1];
+  float* current = rows[2];
+
+  for (glong j = 0; j <= m; j++) {
+    previous[j] = j;
+  }
+
+  for (glong i = 1; i <= n; i++) {
+    current[0] = i;
+    for (glong j = 1; j <= m; j++) {
+      float substitute = 0.0f;
+      if (a[i - 1] != b[j - 1]) {
+        substitute = adjacent != nullptr && adjacent(a[i - 1], b[j - 1], user_data) ? 0.5f : 1.0f;
+      }
+
+      float cost = MIN(MIN(previous[j] + 1.0f, current[j - 1] + 1.0f), previous[j - 1] + substitute);
+      if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]) {
+        cost = MIN(cost, before[j - 2] + 1.0f);
+      }
+      current[j] = cost;
+    }
+
+    float* recycled = before;
+    before = previous;
+    previous = current;
+    current = recycled;
+  }
+  return previous[m];
+}
+
+static gint keebie_dictionary_compare_corrections(gconstpointer a, gconstpointer b) {
+  float score_a = reinterpret_cast<const KeebieDictionaryCorrection*>(a)->score;
+  float score_b = reinterpret_cast<const KeebieDictionaryCorrection*>(b)->score;
+  return score_a < score_b ? 1 : (score_a > score_b ? -1 : 0);
+}
+
+static const char* keebie_dictionary_get_word_text(KeebieDictionary* self, const KeebieDictionaryWord* word) {
+  const KeebieDictionaryHeader* header = self->header;
+  if (word->text_offset > header->strings_size || word->length > header->strings_size - word->text_offset) {
+    return nullptr;
+  }
+
+  const char* text = self->strings + word->text_offset;
+  return g_utf8_validate(text, word->length, nullptr) ? text : nullptr;
+}
+
+const char* keebie_dictionary_get_word(KeebieDictionary* self, guint index, gsize* length, uint32_t* frequency) {
+  if (index >= self->header->n_words) {
+    return nullptr;
+  }
+
+  const KeebieDictionaryWord* word = &self->words[index];
+  const char* text = keebie_dictionary_get_word_text(self, word);
+  if (text != nullptr) {
+    *length = word->length;
+    *frequency = word->frequency;
+  }
+  return text;
+}
+
+guint keebie_dictionary_correct(KeebieDictionary* self, const char* word, KeebieDictionaryAdjacentFunc adjacent, gpointer user_data, guint k, GPtrArray* words) {
+  const KeebieDictionaryHeader* header = self->header;
+
+  glong length = 0;
+  g_autofree gunichar* input = g_utf8_to_ucs4_fast(word, -1, &length);
+  if (k == 0 || length == 0 || length > KEEBIE_DICTIONARY_MAX_WORD) {
+    return 0;
+  }
+
+  g_autoptr(GHashTable) deletes = keebie_dictionary_get_deletes(input, length, header->max_edits, header->prefix_length);
+  g_autoptr(GHashTable) seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+  g_autoptr(GArray) corrections = g_array_new(FALSE, FALSE, sizeof (KeebieDictionaryCorrection));
+  size_t word_length = strlen(word);
+  guint n_candidates = 0;
+
+  GHashTableIter iter;
+  gpointer key = nullptr;
+  g_hash_table_iter_init(&iter, deletes);
+  while (g_hash_table_iter_next(&iter, &key, nullptr) && n_candidates < KEEBIE_DICTIONARY_MAX_CANDIDATES) {
+    uint32_t hash = keebie_dictionary_hash(reinterpret_cast<const char*>(key));
+    uint32_t bucket = hash & (header->n_buckets - 1);
+    uint32_t start = self->buckets[bucket];
+    uint32_t end = self->buckets[bucket + 1];
+    if (start > end || end > header->n_deletes) {
+      continue;
+    }
+
+    for (uint32_t i = start; i < end && n_candidates < KEEBIE_DICTIONARY_MAX_CANDIDATES; i++) {
+      // Hashes colliding within the bucket only cost a wasted verification.
+      uint32_t index = self->deletes[i].word;
+      if (self->deletes[i].hash != hash || index >= header->n_words || !g_hash_table_add(seen, GUINT_TO_POINTER(index + 1))) {
+        continue;
+      }
+      n_candidates++;
+
+      const KeebieDictionaryWord* candidate = &self->words[index];
+      const char* text = keebie_dictionary_get_word_text(self, candidate);
+      if (text == nullptr || candidate->frequency == 0
+          || (candidate->length == word_length && memcmp(text, word, word_length) == 0)) {
+        continue;
+      }
+
+      glong candidate_length = 0;
+      g_autofree gunichar* other = g_utf8_to_ucs4_fast(text, candidate->length, &candidate_length);
+      if (ABS(candidate_length - length) > static_cast<glong>(header->max_edits)) {
+        continue;
+      }
+
+      // The plain distance decides whether it is a correction at all, the
+      // weighted one how good of one.
+      if (keebie_dictionary_distance(input, length, other, candidate_length, nullptr, nullptr) > header->max_edits) {
+        continue;
+      }
+
+      float cost = keebie_dictionary_distance(input, length, other, candidate_length, adjacent, user_data);
+      KeebieDictionaryCorrection correction = { index, logf(candidate->frequency) - KEEBIE_DICTIONARY_EDIT_PENALTY * cost };
+      g_array_append_val(corrections, correction);
+    }
+  }
+
+  qsort(corrections->data, corrections->len, sizeof (KeebieDictionaryCorrection), keebie_dictionary_compare_corrections);
+
+  guint found = MIN(k, corrections->len);
+  for (guint i = 0; i < found; i++) {
+    const KeebieDictionaryWord* candidate = &self->words[g_array_index(corrections, KeebieDictionaryCorrection, i).word];
+    g_ptr_array_add(words, g_strndup(keebie_dictionary_get_word_text(self, candidate), candidate->length));
+  }
+  return found;
+}
+
+void keebie_dictionary_release(KeebieDictionary* self) {
+  madvise(self->data, self->size, MADV_DONTNEED);
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+#define KEEBIE_DICTIONARY_MAGIC 0x4344424bu /* "KBDC" */
+#define KEEBIE_DICTIONARY_VERSION 2
+
+/**
+ * The compiled dictionary format, a single blob of:
+ *
+ *   header | nodes | edges | words | buckets | deletes | strings
+ *
+ * The words form a byte-wise trie over their UTF-8 spelling in which
+ * identical subtrees are stored once, so common endings cost nothing extra.
+ * Every node carries the frequency of the word ending there and the best
+ * frequency anywhere below it, which lets completion visit the most likely
+ * branches first and stop after k words.
+ *
+ * For correction every word is also listed with its spelling in the string
+ * pool, and indexed under each string left after deleting up to max_edits
+ * code points from its first prefix_length ones. Deleting from a typo finds
+ * every word within max_edits edits of it by probing that index, a hash
+ * table of n_buckets (a power of two) runs of deletes. Records are in host
+ * byte order, bump KEEBIE_DICTIONARY_VERSION on any change.
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;
+  char locale[16];
+  uint32_t n_words;
+  uint32_t root;
+  uint32_t n_nodes;
+  uint32_t nodes_offset;
+  uint32_t n_edges;
+  uint32_t edges_offset;
+  uint32_t words_offset;
+  uint32_t max_edits;
+  uint32_t prefix_length;
+  uint32_t n_buckets;
+  uint32_t buckets_offset;
+  uint32_t n_deletes;
+  uint32_t deletes_offset;
+  uint32_t strings_offset;
+  uint32_t strings_size;
+} KeebieDictionaryHeader;
+
+/**
+ * A frequency of 0 means no word ends at this node.
+ */
+typedef struct {
+  uint32_t first_edge;
+  uint32_t n_edges;
+  uint32_t frequency;
+  uint32_t best;
+} KeebieDictionaryNode;
+
+/**
+ * Edges of a node are sorted by byte.
+ */
+typedef struct {
+  uint8_t byte;
+  uint8_t padding[3];
+  uint32_t target;
+} KeebieDictionaryEdge;
+
+/**
+ * Words are listed in byte order of their spelling.
+ */
+typedef struct {
+  uint32_t text_offset;
+  uint32_t length;
+  uint32_t frequency;
+} KeebieDictionaryWord;
+
+/**
+ * Bucket i holds the deletes from buckets[i] up to buckets[i + 1], those
+ * whose hash & (n_buckets - 1) is i.
+ */
+typedef struct {
+  uint32_t hash;
+  uint32_t word;
+} KeebieDictionaryDelete;
+
+/**
+ * Tells whether a and b sit next to each other on the keyboard, a typo
+ * swapping them is then the likelier explanation.
+ */
+typedef gboolean (*KeebieDictionaryAdjacentFunc)(gunichar a, gunichar b, gpointer user_data);
+
+typedef struct _KeebieDictionary KeebieDictionary;
+typedef struct _KeebieDictionaryBuilder KeebieDictionaryBuilder;
+
+KeebieDictionaryBuilder* keebie_dictionary_builder_new(const char* locale);
+void keebie_dictionary_builder_free(KeebieDictionaryBuilder* self);
+
+/**
+ * Adds a word, the frequencies of duplicates are summed.
+ */
+void keebie_dictionary_builder_add(KeebieDictionaryBuilder* self, const char* word, uint32_t frequency);
+
+/**
+ * Parses a word list of one "word<TAB>frequency" per line, blank lines and
+ * lines starting with # are skipped.
+ */
+gboolean keebie_dictionary_builder_add_list(KeebieDictionaryBuilder* self, const char* data, gsize length, GError** error);
+
+/**
+ * Serializes every word added so far into a compiled dictionary blob.
+ */
+GBytes* keebie_dictionary_builder_end(KeebieDictionaryBuilder* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieDictionaryBuilder, keebie_dictionary_builder_free);
+
+/**
+ * Maps a compiled dictionary read-only. Only the header is checked here, so
+ * opening touches a single page however large the dictionary is, lookups
+ * bounds check what they visit instead.
+ */
+KeebieDictionary* keebie_dictionary_new_from_file(const char* path, GError** error);
+KeebieDictionary* keebie_dictionary_ref(KeebieDictionary* self);
+void keebie_dictionary_unref(KeebieDictionary* self);
+
+const char* keebie_dictionary_get_locale(KeebieDictionary* self);
+guint keebie_dictionary_get_n_words(KeebieDictionary* self);
+
+/**
+ * Returns the spelling of the word at index, below get_n_words, which is
+ * length bytes long and not terminated, and sets its frequency. NULL where
+ * the dictionary is corrupt.
+ */
+const char* keebie_dictionary_get_word(KeebieDictionary* self, guint index, gsize* length, uint32_t* frequency);
+
+/**
+ * Returns the frequency of the exact word, 0 if it is not in the dictionary.
+ */
+uint32_t keebie_dictionary_lookup(KeebieDictionary* self, const char* word);
+
+/**
+ * Returns the frequency of the most frequent word starting with prefix, 0 if
+ * no word does.
+ */
+uint32_t keebie_dictionary_get_best(KeebieDictionary* self, const char* prefix);
+
+/**
+ * Appends up to k words starting with prefix to words, most frequent first,
+ * and returns how many were appended. The prefix itself is included when it
+ * is a word.
+ */
+guint keebie_dictionary_complete(KeebieDictionary* self, const char* prefix, guint k, GPtrArray* words);
+
+/**
+ * Appends up to k words within the dictionary's max_edits edits of word to
+ * words, best first, and returns how many were appended. Candidates are
+ * ranked by frequency against how far off they are, substituting a key
+ * adjacent to the intended one costs half an edit. The word itself is never
+ * a correction of itself.
+ */
+guint keebie_dictionary_correct(KeebieDictionary* self, const char* word, KeebieDictionaryAdjacentFunc adjacent, gpointer user_data, guint k, GPtrArray* words);
+
+/**
+ * Gives the pages touched so far back to the kernel, they are read from the
+ * page cache again on the next lookup. Called whenever the keyboard goes idle.
+ */
+void keebie_dictionary_release(KeebieDictionary* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieDictionary, keebie_dictionary_unref);
+
+G_END_DECLS
@@ -0,0 +1,458 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "blob.h"
+#include "emoji.h"
+
+// Posting lists intersected per query, further trigrams are only verified.
+#define KEEBIE_EMOJI_MAX_LISTS 32
+
+typedef struct {
+  gchar* text;
+  GString* keywords;
+} KeebieEmojiBuildEntry;
+
+struct _KeebieEmojiBuilder {
+  gchar* locale;
+  GArray* entries;
+
+  // Text to its index in entries.
+  GHashTable* index;
+};
+
+typedef struct {
+  uint32_t index;
+  gboolean is_prefix;
+  gdouble score;
+} KeebieEmojiMatch;
+
+struct _KeebieEmoji {
+  gint ref_count;
+  GMappedFile* file;
+  guint8* data;
+  gsize size;
+
+  const KeebieEmojiHeader* header;
+  const KeebieEmojiEntry* entries;
+  const KeebieEmojiTrigram* trigrams;
+  const uint32_t* postings;
+  const char* strings;
+
+  // Reused by every search, grown to at most one match per entry.
+  GArray* matches;
+};
+
+KeebieEmojiBuilder* keebie_emoji_builder_new(const char* locale) {
+  KeebieEmojiBuilder* self = g_new0(KeebieEmojiBuilder, 1);
+  self->locale = g_strdup(locale);
+  self->entries = g_array_new(FALSE, FALSE, sizeof (KeebieEmojiBuildEntry));
+  self->index = g_hash_table_new(g_str_hash, g_str_equal);
+  return self;
+}
+
+void keebie_emoji_builder_free(KeebieEmojiBuilder* self) {
+  for (guint i = 0; i < self->entries->len; i++) {
+    KeebieEmojiBuildEntry* entry = &g_array_index(self->entries, KeebieEmojiBuildEntry, i);
+    g_free(entry->text);
+    g_string_free(entry->keywords, TRUE);
+  }
+
+  g_hash_table_unref(self->index);
+  g_array_unref(self->entries);
+  g_free(self->locale);
+  g_free(self);
+}
+
+// Whether keywords, each behind a mark, already hold keyword.
+static gboolean keebie_emoji_has_keyword(const char* keywords, gsize length, const char* keyword, gsize keyword_length) {
+  for (const char* p = keywords; p != nullptr && p < keywords + length;) {
+    const char* end = reinterpret_cast<const char*>(memchr(p + 1, KEEBIE_EMOJI_KEYWORD_MARK, keywords + length - p - 1));
+    gsize size = (end != nullptr ? end : keywords + length) - p - 1;
+    if (size == keyword_length && memcmp(p + 1, keyword, size) == 0) {
+      return TRUE;
+    }
+    p = end;
+  }
+  return FALSE;
+}
+
+gboolean keebie_emoji_builder_add_source(KeebieEmojiBuilder* self, const char* data, gsize length, GError** error) {
+  g_autofree gchar* copy = g_strndup(data, length);
+  g_auto(GStrv) lines = g_strsplit(copy, "\n", -1);
+
+  for (guint i = 0; lines[i] != nullptr; i++) {
+    gchar* line = g_strstrip(lines[i]);
+    if (line[0] == '\0' || line[0] == '#') {
+      continue;
+    }
+
+    gchar* tab = strchr(line, '\t');
+    if (tab != nullptr) {
+      *tab = '\0';
+    }
+
+    if (line[0] == '\0' || !g_utf8_validate(line, -1, nullptr) || (tab != nullptr && !g_utf8_validate(tab + 1, -1, nullptr))) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Line %u: expected text<TAB>keywords in UTF-8", i + 1);
+      return FALSE;
+    }
+
+    gpointer value = nullptr;
+    if (!g_hash_table_lookup_extended(self->index, line, nullptr, &value)) {
+      KeebieEmojiBuildEntry entry = {};
+      entry.text = g_strdup(line);
+      entry.keywords = g_string_new(nullptr);
+      value = GUINT_TO_POINTER(self->entries->len);
+      g_array_append_val(self->entries, entry);
+      g_hash_table_insert(self->index, entry.text, value);
+    }
+
+    KeebieEmojiBuildEntry* entry = &g_array_index(self->entries, KeebieEmojiBuildEntry, GPOINTER_TO_UINT(value));
+    g_auto(GStrv) keywords = g_strsplit(tab != nullptr ? tab + 1 : "", " ", -1);
+    for (guint x = 0; keywords[x] != nullptr; x++) {
+      if (keywords[x][0] == '\0') {
+        continue;
+      }
+
+      if (strchr(keywords[x], KEEBIE_EMOJI_KEYWORD_MARK) != nullptr) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Line %u: keyword %u holds a control character", i + 1, x + 1);
+        return FALSE;
+      }
+
+      g_autofree gchar* folded = g_utf8_casefold(keywords[x], -1);
+      gsize folded_length = strlen(folded);
+      if (!keebie_emoji_has_keyword(entry->keywords->str, entry->keywords->len, folded, folded_length)) {
+        g_string_append_c(entry->keywords, KEEBIE_EMOJI_KEYWORD_MARK);
+        g_string_append_len(entry->keywords, folded, folded_length);
+      }
+    }
+  }
+  return TRUE;
+}
+
+static uint32_t keebie_emoji_trigram(guint8 a, guint8 b, guint8 c) {
+  return (static_cast<uint32_t>(a) << 16) | (static_cast<uint32_t>(b) << 8) | c;
+}
+
+static gint keebie_emoji_compare_pairs(gconstpointer a, gconstpointer b) {
+  uint64_t pair_a = *reinterpret_cast<const uint64_t*>(a);
+  uint64_t pair_b = *reinterpret_cast<const uint64_t*>(b);
+  return pair_a < pair_b ? -1 : pair_a > pair_b ? 1 : 0;
+}
+
+GBytes* keebie_emoji_builder_end(KeebieEmojiBuilder* self) {
+  g_autoptr(GArray) entries = g_array_sized_new(FALSE, FALSE, sizeof (KeebieEmojiEntry), self->entries->len);
+  g_autoptr(GArray) pairs = g_array_new(FALSE, FALSE, sizeof (uint64_t));
+  g_autoptr(GByteArray) strings = g_byte_array_new();
+
+  for (guint i = 0; i < self->entries->len; i++) {
+    const KeebieEmojiBuildEntry* build = &g_array_index(self->entries, KeebieEmojiBuildEntry, i);
+
+    KeebieEmojiEntry entry = {};
+    entry.text_offset = strings->len;
+    entry.text_length = strlen(build->text);
+    g_byte_array_append(strings, reinterpret_cast<const guint8*>(build->text), entry.text_length + 1);
+    entry.keywords_offset = strings->len;
+    entry.keywords_length = build->keywords->len;
+    g_byte_array_append(strings, reinterpret_cast<const guint8*>(build->keywords->str), entry.keywords_length + 1);
+    g_array_append_val(entries, entry);
+
+    const guint8* keywords = reinterpret_cast<const guint8*>(build->keywords->str);
+    for (gsize start = 0; start < build->keywords->len;) {
+      gsize end = start + 1;
+      while (end < build->keywords->len && keywords[end] != KEEBIE_EMOJI_KEYWORD_MARK) {
+        end++;
+      }
+
+      // The keyword is keywords[start + 1, end), padded with two marks.
+      for (gsize x = start + 1; x < end; x++) {
+        guint8 a = x >= start + 2 ? keywords[x - 2] : KEEBIE_EMOJI_KEYWORD_MARK;
+        guint8 b = keywords[x - 1];
+        uint64_t pair = (static_cast<uint64_t>(keebie_emoji_trigram(a, b, keywords[x])) << 32) | i;
+        g_array_append_val(pairs, pair);
+      }
+      start = end;
+    }
+  }
+
+  g_array_sort(pairs, keebie_emoji_compare_pairs);
+
+  g_autoptr(GArray) trigrams = g_array_new(FALSE, FALSE, sizeof (KeebieEmojiTrigram));
+  g_autoptr(GArray) postings = g_array_sized_new(FALSE, FALSE, sizeof (uint32_t), pairs->len);
+  for (guint i = 0; i < pairs->len; i++) {
+    uint64_t pair = g_array_index(pairs, uint64_t, i);
+    if (i > 0 && pair == g_array_index(pairs, uint64_t, i - 1)) {
+      continue;
+    }
+
+    uint32_t trigram = pair >> 32;
+    uint32_t index = pair & 0xffffffffu;
+    if (trigrams->len == 0 || g_array_index(trigrams, KeebieEmojiTrigram, trigrams->len - 1).trigram != trigram) {
+      KeebieEmojiTrigram record = {};
+      record.trigram = trigram;
+      record.first_posting = postings->len;
+      g_array_append_val(trigrams, record);
+    }
+
+    g_array_append_val(postings, index);
+    g_array_index(trigrams, KeebieEmojiTrigram, trigrams->len - 1).n_postings++;
+  }
+
+  KeebieEmojiHeader header = {};
+  header.magic = KEEBIE_EMOJI_MAGIC;
+  header.version = KEEBIE_EMOJI_VERSION;
+  g_strlcpy(header.locale, self->locale, sizeof (header.locale));
+  header.n_entries = entries->len;
+  header.entries_offset = sizeof (KeebieEmojiHeader);
+  header.n_trigrams = trigrams->len;
+  header.trigrams_offset = header.entries_offset + header.n_entries * sizeof (KeebieEmojiEntry);
+  header.n_postings = postings->len;
+  header.postings_offset = header.trigrams_offset + header.n_trigrams * sizeof (KeebieEmojiTrigram);
+  header.strings_offset = header.postings_offset + header.n_postings * sizeof (uint32_t);
+  header.strings_size = strings->len;
+  header.size = header.strings_offset + header.strings_size;
+
+  guint8* data = reinterpret_cast<guint8*>(g_malloc0(header.size));
+  memcpy(data, &header, sizeof (header));
+  memcpy(data + header.entries_offset, entries->data, header.n_entries * sizeof (KeebieEmojiEntry));
+  memcpy(data + header.trigrams_offset, trigrams->data, header.n_trigrams * sizeof (KeebieEmojiTrigram));
+  memcpy(data + header.postings_offset, postings->data, header.n_postings * sizeof (uint32_t));
+  memcpy(data + header.strings_offset, strings->data, header.strings_size);
+  return g_bytes_new_take(data, header.size);
+}
+
+static gboolean keebie_emoji_string_is_valid(const KeebieEmojiHeader* header, const char* strings, uint32_t offset, uint32_t length) {
+  return offset < header->strings_size && length < header->strings_size - offset && strings[offset + length] == '\0';
+}
+
+static gboolean keebie_emoji_is_valid(KeebieEmoji* self) {
+  const KeebieEmojiHeader* header = self->header;
+  if (header->magic != KEEBIE_EMOJI_MAGIC || header->version != KEEBIE_EMOJI_VERSION
+      || header->size != self->size
+      || memchr(header->locale, '\0', sizeof (header->locale)) == nullptr
+      || !keebie_blob_section_is_valid(self->size, sizeof (KeebieEmojiHeader), header->entries_offset, header->n_entries, sizeof (KeebieEmojiEntry))
+      || !keebie_blob_section_is_valid(self->size, sizeof (KeebieEmojiHeader), header->trigrams_offset, header->n_trigrams, sizeof (KeebieEmojiTrigram))
+      || !keebie_blob_section_is_valid(self->size, sizeof (KeebieEmojiHeader), header->postings_offset, header->n_postings, sizeof (uint32_t))
+      || !keebie_blob_section_is_valid(self->size, sizeof (KeebieEmojiHeader), header->strings_offset, header->strings_size, 1)) {
+    return FALSE;
+  }
+
+  self->entries = reinterpret_cast<const KeebieEmojiEntry*>(self->data + header->entries_offset);
+  self->trigrams = reinterpret_cast<const KeebieEmojiTrigram*>(self->data + header->trigrams_offset);
+  self->postings = reinterpret_cast<const uint32_t*>(self->data + header->postings_offset);
+  self->strings = reinterpret_cast<const char*>(self->data + header->strings_offset);
+
+  for (uint32_t i = 0; i < header->n_entries; i++) {
+    const KeebieEmojiEntry* entry = &self->entries[i];
+    if (entry->text_length == 0 || !keebie_emoji_string_is_valid(header, self->strings, entry->text_offset, entry->text_length)
+        || !keebie_emoji_string_is_valid(header, self->strings, entry->keywords_offset, entry->keywords_length)
+        || (entry->keywords_length > 0 && self->strings[entry->keywords_offset] != KEEBIE_EMOJI_KEYWORD_MARK)) {
+      return FALSE;
+    }
+  }
+
+  // Searching bisects the trigrams and merges the postings, both sorted.
+  for (uint32_t i = 0; i < header->n_trigrams; i++) {
+    const KeebieEmojiTrigram* trigram = &self->trigrams[i];
+    if ((i > 0 && trigram->trigram <= self->trigrams[i - 1].trigram)
+        || trigram->n_postings == 0
+        || trigram->first_posting > header->n_postings || trigram->n_postings > header->n_postings - trigram->first_posting) {
+      return FALSE;
+    }
+
+    const uint32_t* postings = self->postings + trigram->first_posting;
+    for (uint32_t x = 0; x < trigram->n_postings; x++) {
+      if (postings[x] >= header->n_entries || (x > 0 && postings[x] <= postings[x - 1])) {
+        return FALSE;
+      }
+    }
+  }
+  return TRUE;
+}
+
+KeebieEmoji* keebie_emoji_new_from_file(const char* path, GError** error) {
+  // A search only touches a few posting runs and keywords.
+  GMappedFile* file = keebie_blob_map(path, sizeof (KeebieEmojiHeader), MADV_RANDOM, error);
+  if (file == nullptr) {
+    return nullptr;
+  }
+
+  KeebieEmoji* self = g_new0(KeebieEmoji, 1);
+  self->ref_count = 1;
+  self->file = file;
+  self->data = reinterpret_cast<guint8*>(g_mapped_file_get_contents(file));
+  self->size = g_mapped_file_get_length(file);
+  self->header = reinterpret_cast<const KeebieEmojiHeader*>(self->data);
+  self->matches = g_array_new(FALSE, FALSE, sizeof (KeebieEmojiMatch));
+
+  if (!keebie_emoji_is_valid(self)) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is truncated, corrupt or of another version", path);
+    keebie_emoji_unref(self);
+    return nullptr;
+  }
+  return self;
+}
+
+KeebieEmoji* keebie_emoji_ref(KeebieEmoji* self) {
+  g_atomic_int_inc(&self->ref_count);
+  return self;
+}
+
+void keebie_emoji_unref(KeebieEmoji* self) {
+  if (g_atomic_int_dec_and_test(&self->ref_count)) {
+    g_mapped_file_unref(self->file);
+    g_array_unref(self->matches);
+    g_free(self);
+  }
+}
+
+const char* keebie_emoji_get_locale(KeebieEmoji* self) {
+  return self->header->locale;
+}
+
+guint keebie_emoji_get_n_entries(KeebieEmoji* self) {
+  return self->header->n_entries;
+}
+
+const char* keebie_emoji_get_text(KeebieEmoji* self, guint index) {
+  g_return_val_if_fail(index < self->header->n_entries, nullptr);
+  return self->strings + self->entries[index].text_offset;
+}
+
+static const KeebieEmojiTrigram* keebie_emoji_find_trigram(KeebieEmoji* self, uint32_t trigram) {
+  uint32_t low = 0;
+  uint32_t high = self->header->n_trigrams;
+  while (low < high) {
+    uint32_t middle = low + (high - low) / 2;
+    if (self->trigrams[middle].trigram < trigram) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low < self->header->n_trigrams && self->trigrams[low].trigram == trigram ? &self->trigrams[low] : nullptr;
+}
+
+// Whether an entry's keywords contain term, and where: at the start of a
+// keyword when at_start ends up TRUE.
+static gboolean keebie_emoji_find_term(const char* keywords, gsize length, const char* term, gsize term_length, gboolean* at_start) {
+  gboolean found = FALSE;
+  *at_start = FALSE;
+  for (const char* p = keywords; p < keywords + length;) {
+    p = reinterpret_cast<const char*>(memmem(p, keywords + length - p, term, term_length));
+    if (p == nullptr) {
+      break;
+    }
+
+    found = TRUE;
+    if (p > keywords && p[-1] == KEEBIE_EMOJI_KEYWORD_MARK) {
+      *at_start = TRUE;
+      break;
+    }
+    p++;
+  }
+  return found;
+}
+
+static gint keebie_emoji_compare_matches(gconstpointer a, gconstpointer b) {
+  const KeebieEmojiMatch* match_a = reinterpret_cast<const KeebieEmojiMatch*>(a);
+  const KeebieEmojiMatch* match_b = reinterpret_cast<const KeebieEmojiMatch*>(b);
+  if (match_a->is_prefix != match_b->is_prefix) {
+    return match_a->is_prefix ? -1 : 1;
+  }
+  if (match_a->score != match_b->score) {
+    return match_a->score > match_b->score ? -1 : 1;
+  }
+  return match_a->index < match_b->index ? -1 : match_a->index > match_b->index ? 1 : 0;
+}
+
+guint keebie_emoji_search(KeebieEmoji* self, const char* query, guint k, KeebieEmojiScoreFunc score, gpointer data, GArray* indices) {
+  g_autofree gchar* folded = g_utf8_casefold(query, -1);
+  if (strchr(folded, KEEBIE_EMOJI_KEYWORD_MARK) != nullptr) {
+    return 0;
+  }
+
+  g_auto(GStrv) terms = g_strsplit(folded, " ", -1);
+  const uint32_t* lists[KEEBIE_EMOJI_MAX_LISTS];
+  uint32_t lengths[KEEBIE_EMOJI_MAX_LISTS];
+  guint n_lists = 0;
+  guint shortest = 0;
+
+  for (guint i = 0; terms[i] != nullptr; i++) {
+    const guint8* term = reinterpret_cast<const guint8*>(terms[i]);
+    gsize length = strlen(terms[i]);
+
+    // Terms shorter than a trigram have to start a keyword, so they look up
+    // the trigrams with the marks in front. Longer ones may match anywhere.
+    for (gsize x = length >= 3 ? 2 : 0; x < length; x++) {
+      guint8 a = x >= 2 ? term[x - 2] : KEEBIE_EMOJI_KEYWORD_MARK;
+      guint8 b = x >= 1 ? term[x - 1] : KEEBIE_EMOJI_KEYWORD_MARK;
+      const KeebieEmojiTrigram* trigram = keebie_emoji_find_trigram(self, keebie_emoji_trigram(a, b, term[x]));
+      if (trigram == nullptr) {
+        return 0;
+      }
+
+      if (n_lists < KEEBIE_EMOJI_MAX_LISTS) {
+        lists[n_lists] = self->postings + trigram->first_posting;
+        lengths[n_lists] = trigram->n_postings;
+        if (lengths[n_lists] < lengths[shortest]) {
+          shortest = n_lists;
+        }
+        n_lists++;
+      }
+    }
+  }
+
+  if (n_lists == 0) {
+    return 0;
+  }
+
+  // Walks the shortest list and every other along with it, they are sorted.
+  uint32_t cursors[KEEBIE_EMOJI_MAX_LISTS] = {};
+  g_array_set_size(self->matches, 0);
+  for (uint32_t i = 0; i < lengths[shortest]; i++) {
+    uint32_t index = lists[shortest][i];
+    gboolean is_candidate = TRUE;
+    for (guint x = 0; x < n_lists && is_candidate; x++) {
+      while (cursors[x] < lengths[x] && lists[x][cursors[x]] < index) {
+        cursors[x]++;
+      }
+      is_candidate = cursors[x] < lengths[x] && lists[x][cursors[x]] == index;
+    }
+
+    if (!is_candidate) {
+      continue;
+    }
+
+    // Trigrams match apart, the terms have to as a whole.
+    const KeebieEmojiEntry* entry = &self->entries[index];
+    const char* keywords = self->strings + entry->keywords_offset;
+    gboolean is_prefix = TRUE;
+    for (guint x = 0; terms[x] != nullptr && is_candidate; x++) {
+      gsize length = strlen(terms[x]);
+      gboolean at_start = FALSE;
+      if (length == 0) {
+        continue;
+      }
+
+      is_candidate = keebie_emoji_find_term(keywords, entry->keywords_length, terms[x], length, &at_start) && (at_start || length >= 3);
+      is_prefix = is_prefix && at_start;
+    }
+
+    if (is_candidate) {
+      KeebieEmojiMatch match = {};
+      match.index = index;
+      match.is_prefix = is_prefix;
+      match.score = score != nullptr ? score(self->strings + entry->text_offset, data) : 0.0;
+      g_array_append_val(self->matches, match);
+    }
+  }
+
+  g_array_sort(self->matches, keebie_emoji_compare_matches);
+
+  guint n = MIN(k, self->matches->len);
+  for (guint i = 0; i < n; i++) {
+    uint32_t index = g_array_index(self->matches, KeebieEmojiMatch, i).index;
+    g_array_append_val(indices, index);
+  }
+  return n;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+#define KEEBIE_EMOJI_MAGIC 0x4d45424bu /* "KBEM" */
+#define KEEBIE_EMOJI_VERSION 1
+
+// Starts every keyword in the index, so short queries match their starts.
+#define KEEBIE_EMOJI_KEYWORD_MARK '\x01'
+
+/**
+ * The emoji and symbol catalog of one locale with its keywords, a single
+ * blob of:
+ *
+ *   header | entries | trigrams | postings | strings
+ *
+ * Entries are in catalog order. Each points at its text and at its keywords,
+ * casefolded and each preceded by KEEBIE_EMOJI_KEYWORD_MARK. Trigrams are
+ * every three bytes of every keyword with two marks in front, sorted, and
+ * point at their run of postings, the entries with such a keyword in
+ * ascending order. Records are in host byte order, bump KEEBIE_EMOJI_VERSION
+ * on any change.
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;
+  char locale[16];
+  uint32_t n_entries;
+  uint32_t entries_offset;
+  uint32_t n_trigrams;
+  uint32_t trigrams_offset;
+  uint32_t n_postings;
+  uint32_t postings_offset;
+  uint32_t strings_offset;
+  uint32_t strings_size;
+} KeebieEmojiHeader;
+
+typedef struct {
+  uint32_t text_offset;
+  uint32_t text_length;
+  uint32_t keywords_offset;
+  uint32_t keywords_length;
+} KeebieEmojiEntry;
+
+typedef struct {
+  uint32_t trigram;
+  uint32_t first_posting;
+  uint32_t n_postings;
+} KeebieEmojiTrigram;
+
+typedef struct _KeebieEmoji KeebieEmoji;
+typedef struct _KeebieEmojiBuilder KeebieEmojiBuilder;
+
+KeebieEmojiBuilder* keebie_emoji_builder_new(const char* locale);
+void keebie_emoji_builder_free(KeebieEmojiBuilder* self);
+
+/**
+ * Parses a source of one "text<TAB>keyword keyword..." per line. Blank lines
+ * and lines starting with # are skipped. Text not added yet is appended to
+ * the catalog, text already in it gains the keywords, which is how a
+ * locale's annotations go on top of the shared catalog.
+ */
+gboolean keebie_emoji_builder_add_source(KeebieEmojiBuilder* self, const char* data, gsize length, GError** error);
+
+/**
+ * Serializes everything added so far into a compiled catalog blob.
+ */
+GBytes* keebie_emoji_builder_end(KeebieEmojiBuilder* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieEmojiBuilder, keebie_emoji_builder_free);
+
+/**
+ * Maps a compiled catalog read-only, every record is checked here so
+ * searching does not need to. Not thread safe, searching reuses buffers of
+ * the catalog's own.
+ */
+KeebieEmoji* keebie_emoji_new_from_file(const char* path, GError** error);
+KeebieEmoji* keebie_emoji_ref(KeebieEmoji* self);
+void keebie_emoji_unref(KeebieEmoji* self);
+
+const char* keebie_emoji_get_locale(KeebieEmoji* self);
+guint keebie_emoji_get_n_entries(KeebieEmoji* self);
+
+/**
+ * Returns the text of the entry at index, in catalog order.
+ */
+const char* keebie_emoji_get_text(KeebieEmoji* self, guint index);
+
+/**
+ * How much an entry is wanted above others matching as well, higher first.
+ */
+typedef gdouble (*KeebieEmojiScoreFunc)(const char* text, gpointer data);
+
+/**
+ * Finds the entries with a keyword containing every space separated word of
+ * query, or starting with it for words shorter than a trigram. Appends the
+ * indices of up to k of them to indices, those matching at the start of
+ * their keywords first, then by score, then in catalog order. Returns how
+ * many were appended.
+ */
+guint keebie_emoji_search(KeebieEmoji* self, const char* query, guint k, KeebieEmojiScoreFunc score, gpointer data, GArray* indices);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieEmoji, keebie_emoji_unref);
+
+G_END_DECLS
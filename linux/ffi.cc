@@ -0,0 +1,290 @@
+#include <string.h>
+#include "application.h"
+#include "ffi.h"
+
+static KeebieApplication* keebie_ffi_get_application() {
+  GApplication* app = g_application_get_default();
+  if (app == nullptr || !KEEBIE_IS_APPLICATION(app)) {
+    return nullptr;
+  }
+  return KEEBIE_APPLICATION(app);
+}
+
+bool keebie_ffi_commit_text(const char* text) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr || text == nullptr) {
+    return false;
+  }
+  return keebie_application_commit_text(app, text);
+}
+
+bool keebie_ffi_send_key(uint32_t key) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr) {
+    return false;
+  }
+  return keebie_application_send_key(app, key);
+}
+
+bool keebie_ffi_delete_surrounding(uint32_t before, uint32_t after) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr) {
+    return false;
+  }
+  return keebie_application_delete_surrounding(app, before, after);
+}
+
+bool keebie_ffi_delete(uint32_t unit, uint32_t count) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr || unit > KEEBIE_DELETE_SELECTION) {
+    return false;
+  }
+  return keebie_application_delete(app, static_cast<KeebieDeleteUnit>(unit), count);
+}
+
+bool keebie_ffi_compose(uint32_t start, uint32_t end, const char* text) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr || text == nullptr) {
+    return false;
+  }
+  return keebie_application_compose(app, start, end, text);
+}
+
+bool keebie_ffi_set_composing_cursor(uint32_t begin, uint32_t end) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr) {
+    return false;
+  }
+  return keebie_application_set_composing_cursor(app, begin, end);
+}
+
+bool keebie_ffi_finish_composing(const char* text) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr) {
+    return false;
+  }
+  return keebie_application_finish_composing(app, text);
+}
+
+// Packs strings into out back to back, each NUL terminated, if they fit.
+static int32_t keebie_ffi_write_strings(GPtrArray* strings, char* out, uint32_t capacity) {
+  gsize size = 0;
+  for (guint i = 0; i < strings->len; i++) {
+    size += strlen(reinterpret_cast<const char*>(g_ptr_array_index(strings, i))) + 1;
+  }
+
+  if (out != nullptr && size <= capacity) {
+    char* p = out;
+    for (guint i = 0; i < strings->len; i++) {
+      const char* string = reinterpret_cast<const char*>(g_ptr_array_index(strings, i));
+      size_t length = strlen(string) + 1;
+      memcpy(p, string, length);
+      p += length;
+    }
+  }
+  return size;
+}
+
+int32_t keebie_ffi_get_completions(uint32_t k, char* out, uint32_t capacity) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr) {
+    return -1;
+  }
+
+  g_autoptr(GPtrArray) words = g_ptr_array_new_with_free_func(g_free);
+  if (keebie_application_complete(app, k, words) < 0) {
+    return -1;
+  }
+  return keebie_ffi_write_strings(words, out, capacity);
+}
+
+int32_t keebie_ffi_search_emoji(const char* query, uint32_t k, char* out, uint32_t capacity) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr || query == nullptr) {
+    return -1;
+  }
+
+  g_autoptr(GPtrArray) results = g_ptr_array_new_with_free_func(g_free);
+  if (keebie_application_search_emoji(app, query, k, results) < 0) {
+    return -1;
+  }
+  return keebie_ffi_write_strings(results, out, capacity);
+}
+
+bool keebie_ffi_commit_emoji(const char* text) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr || text == nullptr) {
+    return false;
+  }
+  return keebie_application_commit_emoji(app, text);
+}
+
+bool keebie_ffi_replace_word(const char* text) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr || text == nullptr) {
+    return false;
+  }
+  return keebie_application_replace_word(app, text);
+}
+
+void keebie_ffi_set_autocorrect(bool autocorrect) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app != nullptr) {
+    keebie_application_set_autocorrect(app, autocorrect);
+  }
+}
+
+void keebie_ffi_set_commit_on_press(bool commit_on_press) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app != nullptr) {
+    keebie_application_set_commit_on_press(app, commit_on_press);
+  }
+}
+
+void keebie_ffi_set_rollover(uint32_t rollover) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app != nullptr) {
+    keebie_application_set_rollover(app, rollover);
+  }
+}
+
+void keebie_ffi_set_swipe_typing(bool swipe_typing) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app != nullptr) {
+    keebie_application_set_swipe_typing(app, swipe_typing);
+  }
+}
+
+int32_t keebie_ffi_activate_key(uint32_t plane, uint32_t row, uint32_t key, bool is_shifted) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr) {
+    return -1;
+  }
+  return keebie_application_activate_key(app, plane, row, key, is_shifted);
+}
+
+int32_t keebie_ffi_press_key(uint32_t plane, uint32_t row, uint32_t key, bool is_shifted) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr) {
+    return -1;
+  }
+  return keebie_application_press_key(app, plane, row, key, is_shifted);
+}
+
+void keebie_ffi_release_key(uint32_t plane, uint32_t row, uint32_t key) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app != nullptr) {
+    keebie_application_release_key(app, plane, row, key);
+  }
+}
+
+void* keebie_ffi_layout_ref(const char* name) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr || name == nullptr) {
+    return nullptr;
+  }
+  return keebie_application_get_layout_by_name(app, name);
+}
+
+const uint8_t* keebie_ffi_layout_get_data(void* layout, uint32_t* size) {
+  gsize length = 0;
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(g_bytes_get_data(keebie_layout_get_bytes(reinterpret_cast<KeebieLayout*>(layout)), &length));
+  if (size != nullptr) {
+    *size = length;
+  }
+  return data;
+}
+
+void keebie_ffi_layout_unref(void* layout) {
+  keebie_layout_unref(reinterpret_cast<KeebieLayout*>(layout));
+}
+
+bool keebie_ffi_activate_layout(const char* name) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr || name == nullptr) {
+    return false;
+  }
+  return keebie_application_activate_layout(app, name);
+}
+
+bool keebie_ffi_set_languages(const char* names) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr || names == nullptr) {
+    return false;
+  }
+
+  g_auto(GStrv) list = g_strsplit(names, ",", -1);
+  keebie_application_set_languages(app, list);
+  return true;
+}
+
+int32_t keebie_ffi_change_language(char* out, uint32_t capacity) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr) {
+    return -1;
+  }
+
+  g_autofree gchar* name = keebie_application_change_language(app);
+  if (name == nullptr) {
+    return -1;
+  }
+
+  size_t length = strlen(name);
+  if (out != nullptr && length < capacity) {
+    memcpy(out, name, length + 1);
+  }
+  return length;
+}
+
+int32_t keebie_ffi_get_geometry(uint32_t plane, uint32_t constraints, float child_size, float padding, float monitor_width, float monitor_height, float* out, uint32_t capacity) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr) {
+    return -1;
+  }
+
+  KeebieGeometryParams params = {};
+  params.plane = plane;
+  params.constraints = constraints;
+  params.child_size = child_size;
+  params.padding = padding;
+  params.monitor_width = monitor_width;
+  params.monitor_height = monitor_height;
+
+  g_autoptr(KeebieGeometry) geometry = keebie_application_get_geometry(app, &params);
+  if (geometry == nullptr) {
+    return -1;
+  }
+
+  if (out != nullptr && capacity >= 2 + geometry->n_keys * 6) {
+    out[0] = geometry->width;
+    out[1] = geometry->height;
+
+    for (guint i = 0; i < geometry->n_keys; i++) {
+      const KeebieKeyRect* rect = &geometry->keys[i];
+      float* entry = out + 2 + i * 6;
+      entry[0] = rect->x;
+      entry[1] = rect->y;
+      entry[2] = rect->width;
+      entry[3] = rect->height;
+      entry[4] = rect->row;
+      entry[5] = rect->key;
+    }
+  }
+  return geometry->n_keys;
+}
+
+int32_t keebie_ffi_resolve_touch(uint32_t plane, uint32_t constraints, float child_size, float padding, float monitor_width, float monitor_height, float x, float y) {
+  KeebieApplication* app = keebie_ffi_get_application();
+  if (app == nullptr) {
+    return -1;
+  }
+
+  KeebieGeometryParams params = {};
+  params.plane = plane;
+  params.constraints = constraints;
+  params.child_size = child_size;
+  params.padding = padding;
+  params.monitor_width = monitor_width;
+  params.monitor_height = monitor_height;
+  return keebie_application_resolve_touch(app, &params, x, y);
+}
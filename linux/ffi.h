@@ -0,0 +1,140 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define KEEBIE_FFI_EXPORT __attribute__((visibility("default"))) __attribute__((used))
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * Entry points which lib/logic/native.dart resolves with DynamicLibrary.process().
+ * These are called synchronously from the Dart UI thread, the "keebie" method
+ * channel is left for control-plane calls only.
+ */
+KEEBIE_FFI_EXPORT bool keebie_ffi_commit_text(const char* text);
+KEEBIE_FFI_EXPORT bool keebie_ffi_send_key(uint32_t key);
+KEEBIE_FFI_EXPORT bool keebie_ffi_delete_surrounding(uint32_t before, uint32_t after);
+
+/**
+ * Deletes count KeebieDeleteUnits back from the cursor, a selection goes first.
+ */
+KEEBIE_FFI_EXPORT bool keebie_ffi_delete(uint32_t unit, uint32_t count);
+
+/**
+ * Edits the preedit composition with UTF-16 ranges, see keebie_application_compose.
+ * A NULL text for keebie_ffi_finish_composing commits what was composed.
+ */
+KEEBIE_FFI_EXPORT bool keebie_ffi_compose(uint32_t start, uint32_t end, const char* text);
+KEEBIE_FFI_EXPORT bool keebie_ffi_set_composing_cursor(uint32_t begin, uint32_t end);
+KEEBIE_FFI_EXPORT bool keebie_ffi_finish_composing(const char* text);
+
+/**
+ * Writes up to k completions of the word being typed into out as NUL
+ * terminated strings back to back. Returns the number of bytes all of them
+ * take, nothing is written if that exceeds capacity, or -1 when there is
+ * nothing to complete.
+ */
+KEEBIE_FFI_EXPORT int32_t keebie_ffi_get_completions(uint32_t k, char* out, uint32_t capacity);
+
+/**
+ * Writes up to k emoji and symbols matching query into out the same way,
+ * see keebie_application_search_emoji. Returns -1 when the language has no
+ * catalog.
+ */
+KEEBIE_FFI_EXPORT int32_t keebie_ffi_search_emoji(const char* query, uint32_t k, char* out, uint32_t capacity);
+
+/**
+ * Commits a picked emoji or symbol, see keebie_application_commit_emoji.
+ */
+KEEBIE_FFI_EXPORT bool keebie_ffi_commit_emoji(const char* text);
+
+/**
+ * Replaces the word being typed with text, see keebie_application_replace_word.
+ */
+KEEBIE_FFI_EXPORT bool keebie_ffi_replace_word(const char* text);
+
+/**
+ * Turns autocorrection on or off, see keebie_application_set_autocorrect.
+ */
+KEEBIE_FFI_EXPORT void keebie_ffi_set_autocorrect(bool autocorrect);
+
+/**
+ * Whether touched keys type on the way down or up, see
+ * keebie_application_set_commit_on_press.
+ */
+KEEBIE_FFI_EXPORT void keebie_ffi_set_commit_on_press(bool commit_on_press);
+
+/**
+ * Milliseconds a released key waits on earlier held ones, see
+ * keebie_application_set_rollover.
+ */
+KEEBIE_FFI_EXPORT void keebie_ffi_set_rollover(uint32_t rollover);
+
+/**
+ * Turns typing words by dragging across their letters on or off.
+ */
+KEEBIE_FFI_EXPORT void keebie_ffi_set_swipe_typing(bool swipe_typing);
+
+/**
+ * Resolves a key of the announced layout by its position and queues its
+ * action, returns the KeebieKeyActionType or -1 if the key does nothing.
+ */
+KEEBIE_FFI_EXPORT int32_t keebie_ffi_activate_key(uint32_t plane, uint32_t row, uint32_t key, bool is_shifted);
+
+/**
+ * Same as keebie_ffi_activate_key but the key keeps repeating natively until
+ * keebie_ffi_release_key, so holding it needs no further calls.
+ */
+KEEBIE_FFI_EXPORT int32_t keebie_ffi_press_key(uint32_t plane, uint32_t row, uint32_t key, bool is_shifted);
+
+/**
+ * Stops the repeat of the key, unless another one was pressed since.
+ */
+KEEBIE_FFI_EXPORT void keebie_ffi_release_key(uint32_t plane, uint32_t row, uint32_t key);
+
+/**
+ * Returns a reference to the compiled layout of the given name, or NULL.
+ * The blob from keebie_ffi_layout_get_data stays mapped until the reference
+ * is dropped with keebie_ffi_layout_unref, even if the layout is reloaded.
+ */
+KEEBIE_FFI_EXPORT void* keebie_ffi_layout_ref(const char* name);
+KEEBIE_FFI_EXPORT const uint8_t* keebie_ffi_layout_get_data(void* layout, uint32_t* size);
+KEEBIE_FFI_EXPORT void keebie_ffi_layout_unref(void* layout);
+
+/**
+ * Makes a compiled layout from the bundle the active action table.
+ */
+KEEBIE_FFI_EXPORT bool keebie_ffi_activate_layout(const char* name);
+
+/**
+ * Sets the comma separated layout names changeLang cycles through.
+ */
+KEEBIE_FFI_EXPORT bool keebie_ffi_set_languages(const char* names);
+
+/**
+ * Swaps to the next language and copies its layout name into out, returns
+ * the name's length or -1 if there was nothing to switch to.
+ */
+KEEBIE_FFI_EXPORT int32_t keebie_ffi_change_language(char* out, uint32_t capacity);
+
+/**
+ * Copies the solved geometry of a plane into out as [width, height] followed
+ * by [x, y, width, height, row, key] for every visible key. Returns the number
+ * of keys, which may exceed what fit into capacity floats, or -1 when no layout
+ * has been announced yet.
+ */
+KEEBIE_FFI_EXPORT int32_t keebie_ffi_get_geometry(uint32_t plane, uint32_t constraints, float child_size, float padding, float monitor_width, float monitor_height, float* out, uint32_t capacity);
+
+/**
+ * Resolves a touch at x, y within the plane to the index of the key it was
+ * meant for among those keebie_ffi_get_geometry returns for the same
+ * arguments, -1 when no layout has been announced yet.
+ */
+KEEBIE_FFI_EXPORT int32_t keebie_ffi_resolve_touch(uint32_t plane, uint32_t constraints, float child_size, float padding, float monitor_width, float monitor_height, float x, float y);
+
+#if defined(__cplusplus)
+}
+#endif
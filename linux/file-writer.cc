@@ -0,0 +1,59 @@
+#include <errno.h>
+#include <glib/gstdio.h>
+#include "file-writer.h"
+
+struct _KeebieFileWriter {
+  GThreadPool* worker;
+};
+
+typedef struct {
+  gchar* path;
+  gchar* contents;
+  gsize length;
+} KeebieFileWrite;
+
+static void keebie_file_write_free(KeebieFileWrite* job) {
+  g_free(job->path);
+  g_free(job->contents);
+  g_free(job);
+}
+
+static void keebie_file_writer_run(gpointer data, gpointer user_data) {
+  KeebieFileWrite* job = reinterpret_cast<KeebieFileWrite*>(data);
+
+  g_autofree gchar* dir = g_path_get_dirname(job->path);
+  g_autoptr(GError) error = nullptr;
+  if (g_mkdir_with_parents(dir, 0700) < 0
+      || !g_file_set_contents_full(job->path, job->contents, job->length, G_FILE_SET_CONTENTS_CONSISTENT, 0600, &error)) {
+    g_warning("Failed to save %s: %s", job->path, error != nullptr ? error->message : g_strerror(errno));
+  }
+
+  keebie_file_write_free(job);
+}
+
+KeebieFileWriter* keebie_file_writer_new() {
+  KeebieFileWriter* self = g_new0(KeebieFileWriter, 1);
+
+  // One thread at a time keeps a later save from being overtaken by an
+  // earlier one, the threads themselves are shared with GLib's other pools.
+  self->worker = g_thread_pool_new(keebie_file_writer_run, nullptr, 1, FALSE, nullptr);
+  return self;
+}
+
+void keebie_file_writer_free(KeebieFileWriter* self) {
+  g_thread_pool_free(self->worker, FALSE, TRUE);
+  g_free(self);
+}
+
+void keebie_file_writer_write(KeebieFileWriter* self, const char* path, gchar* contents, gsize length) {
+  KeebieFileWrite* job = g_new0(KeebieFileWrite, 1);
+  job->path = g_strdup(path);
+  job->contents = contents;
+  job->length = length;
+
+  g_autoptr(GError) error = nullptr;
+  if (!g_thread_pool_push(self->worker, job, &error)) {
+    g_warning("Failed to queue saving %s: %s", path, error->message);
+    keebie_file_write_free(job);
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Writes files out on a worker, one at a time in the order they were handed
+ * over, so nobody holding a lock waits on the disk. What is handed over has
+ * to be a copy, taken under whatever lock guards the state it comes from.
+ */
+typedef struct _KeebieFileWriter KeebieFileWriter;
+
+KeebieFileWriter* keebie_file_writer_new();
+
+/**
+ * Waits for everything handed over so far to be written.
+ */
+void keebie_file_writer_free(KeebieFileWriter* self);
+
+/**
+ * Replaces path with contents, which the writer takes, creating the
+ * directory it is in if need be. The file is only readable by the user.
+ */
+void keebie_file_writer_write(KeebieFileWriter* self, const char* path, gchar* contents, gsize length);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieFileWriter, keebie_file_writer_free);
+
+G_END_DECLS
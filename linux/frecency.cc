@@ -0,0 +1,166 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file-writer.h"
+#include "frecency.h"
+
+#define KEEBIE_FRECENCY_HALF_LIFE (7 * 24 * 60 * 60)
+#define KEEBIE_FRECENCY_MAX_TEXTS 64
+
+typedef struct {
+  gdouble score;
+  gint64 time;
+} KeebieFrecencyEntry;
+
+typedef struct {
+  const char* text;
+  gdouble score;
+} KeebieFrecencyRank;
+
+struct _KeebieFrecency {
+  gchar* path;
+
+  // Text to KeebieFrecencyEntry, scored as of its time.
+  GHashTable* entries;
+  gboolean is_dirty;
+  KeebieFileWriter* writer;
+};
+
+static gint64 keebie_frecency_now() {
+  return g_get_real_time() / G_USEC_PER_SEC;
+}
+
+static gdouble keebie_frecency_decay(const KeebieFrecencyEntry* entry, gint64 now) {
+  return entry->score * exp2(-static_cast<gdouble>(MAX(now - entry->time, 0)) / KEEBIE_FRECENCY_HALF_LIFE);
+}
+
+KeebieFrecency* keebie_frecency_new(const char* path) {
+  KeebieFrecency* self = g_new0(KeebieFrecency, 1);
+  self->path = g_strdup(path);
+  self->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  self->writer = keebie_file_writer_new();
+
+  g_autofree gchar* contents = nullptr;
+  g_autoptr(GError) error = nullptr;
+  if (!g_file_get_contents(path, &contents, nullptr, &error)) {
+    if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+      g_warning("Failed to load %s: %s", path, error->message);
+    }
+    return self;
+  }
+
+  // One "score<TAB>time<TAB>text" per line, anything else is skipped.
+  g_auto(GStrv) lines = g_strsplit(contents, "\n", -1);
+  for (guint i = 0; lines[i] != nullptr; i++) {
+    g_auto(GStrv) fields = g_strsplit(lines[i], "\t", 3);
+    if (g_strv_length(fields) != 3 || fields[2][0] == '\0' || !g_utf8_validate(fields[2], -1, nullptr)) {
+      continue;
+    }
+
+    gdouble score = g_ascii_strtod(fields[0], nullptr);
+    if (!isfinite(score) || score <= 0.0) {
+      continue;
+    }
+
+    KeebieFrecencyEntry* entry = g_new0(KeebieFrecencyEntry, 1);
+    entry->score = score;
+    entry->time = g_ascii_strtoll(fields[1], nullptr, 10);
+    g_hash_table_replace(self->entries, g_strdup(fields[2]), entry);
+  }
+  return self;
+}
+
+void keebie_frecency_free(KeebieFrecency* self) {
+  keebie_file_writer_free(self->writer);
+  g_hash_table_unref(self->entries);
+  g_free(self->path);
+  g_free(self);
+}
+
+void keebie_frecency_use(KeebieFrecency* self, const char* text) {
+  gint64 now = keebie_frecency_now();
+  KeebieFrecencyEntry* entry = reinterpret_cast<KeebieFrecencyEntry*>(g_hash_table_lookup(self->entries, text));
+  if (entry == nullptr) {
+    // A new text takes the place of the one least likely to be used again.
+    if (g_hash_table_size(self->entries) >= KEEBIE_FRECENCY_MAX_TEXTS) {
+      GHashTableIter iter;
+      gpointer key;
+      gpointer value;
+      gpointer worst = nullptr;
+      gdouble worst_score = G_MAXDOUBLE;
+      g_hash_table_iter_init(&iter, self->entries);
+      while (g_hash_table_iter_next(&iter, &key, &value)) {
+        gdouble score = keebie_frecency_decay(reinterpret_cast<KeebieFrecencyEntry*>(value), now);
+        if (score < worst_score) {
+          worst_score = score;
+          worst = key;
+        }
+      }
+      g_hash_table_remove(self->entries, worst);
+    }
+
+    entry = g_new0(KeebieFrecencyEntry, 1);
+    g_hash_table_insert(self->entries, g_strdup(text), entry);
+  }
+
+  entry->score = keebie_frecency_decay(entry, now) + 1.0;
+  entry->time = now;
+  self->is_dirty = TRUE;
+}
+
+gdouble keebie_frecency_get_score(KeebieFrecency* self, const char* text, gint64 now) {
+  const KeebieFrecencyEntry* entry = reinterpret_cast<const KeebieFrecencyEntry*>(g_hash_table_lookup(self->entries, text));
+  return entry != nullptr ? keebie_frecency_decay(entry, now) : 0.0;
+}
+
+static gint keebie_frecency_compare_ranks(gconstpointer a, gconstpointer b) {
+  const KeebieFrecencyRank* rank_a = reinterpret_cast<const KeebieFrecencyRank*>(a);
+  const KeebieFrecencyRank* rank_b = reinterpret_cast<const KeebieFrecencyRank*>(b);
+  if (rank_a->score != rank_b->score) {
+    return rank_a->score > rank_b->score ? -1 : 1;
+  }
+  return strcmp(rank_a->text, rank_b->text);
+}
+
+guint keebie_frecency_get_best(KeebieFrecency* self, guint k, GPtrArray* texts) {
+  gint64 now = keebie_frecency_now();
+  g_autoptr(GArray) ranks = g_array_sized_new(FALSE, FALSE, sizeof (KeebieFrecencyRank), g_hash_table_size(self->entries));
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  g_hash_table_iter_init(&iter, self->entries);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    KeebieFrecencyRank rank;
+    rank.text = reinterpret_cast<const char*>(key);
+    rank.score = keebie_frecency_decay(reinterpret_cast<KeebieFrecencyEntry*>(value), now);
+    g_array_append_val(ranks, rank);
+  }
+  g_array_sort(ranks, keebie_frecency_compare_ranks);
+
+  guint n = MIN(k, ranks->len);
+  for (guint i = 0; i < n; i++) {
+    g_ptr_array_add(texts, g_strdup(g_array_index(ranks, KeebieFrecencyRank, i).text));
+  }
+  return n;
+}
+
+void keebie_frecency_save(KeebieFrecency* self) {
+  if (!self->is_dirty) {
+    return;
+  }
+
+  GString* contents = g_string_new(nullptr);
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  g_hash_table_iter_init(&iter, self->entries);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    const KeebieFrecencyEntry* entry = reinterpret_cast<const KeebieFrecencyEntry*>(value);
+    char score[G_ASCII_DTOSTR_BUF_SIZE];
+    g_string_append_printf(contents, "%s\t%" G_GINT64_FORMAT "\t%s\n", g_ascii_dtostr(score, sizeof (score), entry->score), entry->time, reinterpret_cast<const char*>(key));
+  }
+
+  gsize length = contents->len;
+  keebie_file_writer_write(self->writer, self->path, g_string_free(contents, FALSE), length);
+  self->is_dirty = FALSE;
+}
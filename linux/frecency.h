@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Remembers which texts, such as emoji, the user picked and how often and
+ * how lately they did. Every use adds one to a text's score, which halves
+ * every week it goes unused, and only the best scoring texts are kept. Not
+ * thread safe, the application's lock guards it.
+ */
+typedef struct _KeebieFrecency KeebieFrecency;
+
+/**
+ * Loads the uses remembered so far from path, if there are any.
+ */
+KeebieFrecency* keebie_frecency_new(const char* path);
+void keebie_frecency_free(KeebieFrecency* self);
+
+void keebie_frecency_use(KeebieFrecency* self, const char* text);
+
+/**
+ * Returns the score of text as of now, in seconds since the epoch, 0 for
+ * texts never used.
+ */
+gdouble keebie_frecency_get_score(KeebieFrecency* self, const char* text, gint64 now);
+
+/**
+ * Appends up to k of the best scoring texts to texts, best first, as copies
+ * for texts to free. Returns how many were appended.
+ */
+guint keebie_frecency_get_best(KeebieFrecency* self, guint k, GPtrArray* texts);
+
+/**
+ * Has the uses written out on a worker if they changed. Called whenever the
+ * keyboard goes idle.
+ */
+void keebie_frecency_save(KeebieFrecency* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieFrecency, keebie_frecency_free);
+
+G_END_DECLS
@@ -0,0 +1,189 @@
+#include "geometry.h"
+
+/**
+ * Cache entries are only a handful of planes times the few monitor sizes we
+ * ever see, once it grows beyond this something is thrashing it.
+ */
+#define KEEBIE_GEOMETRY_CACHE_MAX 32
+
+struct _KeebieGeometryCache {
+  GMutex lock;
+  GHashTable* entries;
+};
+
+static guint keebie_geometry_params_hash(gconstpointer ptr) {
+  const KeebieGeometryParams* params = reinterpret_cast<const KeebieGeometryParams*>(ptr);
+  const guchar* bytes = reinterpret_cast<const guchar*>(params);
+
+  // FNV-1a over the packed params, the struct has no padding.
+  guint hash = 2166136261u;
+  for (size_t i = 0; i < sizeof (KeebieGeometryParams); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static gboolean keebie_geometry_params_equal(gconstpointer a, gconstpointer b) {
+  return memcmp(a, b, sizeof (KeebieGeometryParams)) == 0;
+}
+
+KeebieGeometry* keebie_geometry_ref(KeebieGeometry* self) {
+  g_atomic_int_inc(&self->ref_count);
+  return self;
+}
+
+void keebie_geometry_unref(KeebieGeometry* self) {
+  if (g_atomic_int_dec_and_test(&self->ref_count)) {
+    g_free(self->keys);
+    g_free(self);
+  }
+}
+
+static void keebie_geometry_free(gpointer ptr) {
+  keebie_geometry_unref(reinterpret_cast<KeebieGeometry*>(ptr));
+}
+
+static inline gboolean keebie_geometry_is_visible(const KeebieKeyAction* action, uint32_t constraints) {
+  return (action->constraints & ~constraints) == 0;
+}
+
+/**
+ * Single pass port of the sizing rules which used to live in
+ * KeyboardKey.getContainerSize. Every regular key is a square derived from the
+ * child size and an expanding key takes the remaining width of the widest
+ * fixed-size row.
+ */
+static KeebieGeometry* keebie_geometry_solve(KeebieLayout* layout, const KeebieGeometryParams* params) {
+  const guint n_rows = keebie_layout_get_n_rows(layout, params->plane);
+
+  const float key_width = params->child_size * 1.5f + params->padding * 4.0f;
+  const float key_height = params->child_size * 1.5f + params->padding * 4.0f;
+  const float total_extra_width = params->padding * 3.0f;
+  const float total_extra_height = params->padding * 4.0f;
+
+  g_autofree float* fixed_widths = g_new0(float, MAX(n_rows, 1));
+  g_autofree gboolean* row_expands = g_new0(gboolean, MAX(n_rows, 1));
+  guint n_keys = 0;
+  float widest_fixed = 0.0f;
+
+  for (guint row = 0; row < n_rows; row++) {
+    const guint row_keys = keebie_layout_get_n_keys(layout, params->plane, row);
+    float total = 0.0f;
+
+    for (guint key = 0; key < row_keys; key++) {
+      const KeebieKeyAction* action = keebie_layout_lookup(layout, params->plane, row, key);
+      if (!keebie_geometry_is_visible(action, params->constraints)) continue;
+
+      n_keys++;
+      if (action->flags & KEEBIE_KEY_FLAG_EXPANDS) {
+        row_expands[row] = TRUE;
+      } else {
+        fixed_widths[row] += key_width;
+      }
+      total += key_width + total_extra_width;
+    }
+
+    if (!row_expands[row]) {
+      widest_fixed = MAX(widest_fixed, total);
+    }
+  }
+
+  KeebieGeometry* geometry = g_new0(KeebieGeometry, 1);
+  geometry->ref_count = 1;
+  geometry->n_keys = n_keys;
+  geometry->keys = g_new0(KeebieKeyRect, MAX(n_keys, 1));
+
+  // Resolve the widths first, the plane width is needed before placing keys.
+  g_autofree float* row_slots = g_new0(float, MAX(n_rows, 1));
+  guint i = 0;
+  for (guint row = 0; row < n_rows; row++) {
+    const guint row_keys = keebie_layout_get_n_keys(layout, params->plane, row);
+    float total = 0.0f;
+
+    for (guint key = 0; key < row_keys; key++) {
+      const KeebieKeyAction* action = keebie_layout_lookup(layout, params->plane, row, key);
+      if (!keebie_geometry_is_visible(action, params->constraints)) continue;
+
+      KeebieKeyRect* rect = &geometry->keys[i++];
+      rect->row = row;
+      rect->key = key;
+      rect->height = key_height;
+      rect->width = (action->flags & KEEBIE_KEY_FLAG_EXPANDS) ? MAX(widest_fixed - fixed_widths[row], key_width) : key_width;
+
+      total += rect->width + total_extra_width;
+      row_slots[row] += rect->width + params->padding * 2.0f;
+    }
+
+    geometry->width = MAX(geometry->width, total);
+  }
+
+  // Rows are stacked and keys are spread out within each row.
+  const float row_height = key_height + total_extra_height;
+  float y = 0.0f;
+  i = 0;
+  for (guint row = 0; row < n_rows; row++) {
+    guint first = i;
+    while (i < n_keys && geometry->keys[i].row == row) i++;
+    if (first == i) continue;
+
+    const float gap = MAX(geometry->width - row_slots[row], 0.0f) / (i - first);
+    float x = gap / 2.0f;
+
+    for (guint k = first; k < i; k++) {
+      KeebieKeyRect* rect = &geometry->keys[k];
+      rect->x = x + params->padding;
+      rect->y = y + (row_height - rect->height) / 2.0f;
+      x += rect->width + params->padding * 2.0f + gap;
+    }
+
+    y += row_height;
+  }
+
+  geometry->height = y;
+
+  // Never lay out wider than the monitor, squeeze the keys horizontally instead.
+  if (params->monitor_width > 0.0f && geometry->width > params->monitor_width) {
+    const float scale = params->monitor_width / geometry->width;
+    for (guint k = 0; k < n_keys; k++) {
+      geometry->keys[k].x *= scale;
+      geometry->keys[k].width *= scale;
+    }
+    geometry->width = params->monitor_width;
+  }
+  return geometry;
+}
+
+KeebieGeometryCache* keebie_geometry_cache_new() {
+  KeebieGeometryCache* self = g_new0(KeebieGeometryCache, 1);
+  g_mutex_init(&self->lock);
+  self->entries = g_hash_table_new_full(keebie_geometry_params_hash, keebie_geometry_params_equal, g_free, keebie_geometry_free);
+  return self;
+}
+
+void keebie_geometry_cache_free(KeebieGeometryCache* self) {
+  g_hash_table_unref(self->entries);
+  g_mutex_clear(&self->lock);
+  g_free(self);
+}
+
+void keebie_geometry_cache_clear(KeebieGeometryCache* self) {
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+  g_hash_table_remove_all(self->entries);
+}
+
+KeebieGeometry* keebie_geometry_cache_get(KeebieGeometryCache* self, KeebieLayout* layout, const KeebieGeometryParams* params) {
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+
+  KeebieGeometry* geometry = reinterpret_cast<KeebieGeometry*>(g_hash_table_lookup(self->entries, params));
+  if (geometry != nullptr) {
+    return keebie_geometry_ref(geometry);
+  }
+
+  if (g_hash_table_size(self->entries) >= KEEBIE_GEOMETRY_CACHE_MAX) {
+    g_hash_table_remove_all(self->entries);
+  }
+
+  geometry = keebie_geometry_solve(layout, params);
+  g_hash_table_insert(self->entries, g_memdup2(params, sizeof (KeebieGeometryParams)), geometry);
+  return keebie_geometry_ref(geometry);
+}
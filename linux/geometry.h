@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glib.h>
+#include "layout.h"
+
+G_BEGIN_DECLS
+
+/**
+ * Everything the size of a plane depends on. Shift state is deliberately not
+ * part of this, the key sizes do not change with it.
+ */
+typedef struct {
+  guint plane;
+  uint32_t constraints;
+  float child_size;
+  float padding;
+  float monitor_width;
+  float monitor_height;
+} KeebieGeometryParams;
+
+/**
+ * The rect of the key's box within the plane, padding excluded. Row and key
+ * address the layout's action table, so key is the index before constraints.
+ */
+typedef struct {
+  float x;
+  float y;
+  float width;
+  float height;
+  uint32_t row;
+  uint32_t key;
+} KeebieKeyRect;
+
+typedef struct {
+  gint ref_count;
+  float width;
+  float height;
+  guint n_keys;
+  KeebieKeyRect* keys;
+} KeebieGeometry;
+
+typedef struct _KeebieGeometryCache KeebieGeometryCache;
+
+KeebieGeometry* keebie_geometry_ref(KeebieGeometry* self);
+void keebie_geometry_unref(KeebieGeometry* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieGeometry, keebie_geometry_unref);
+
+KeebieGeometryCache* keebie_geometry_cache_new();
+void keebie_geometry_cache_free(KeebieGeometryCache* self);
+
+/**
+ * Drops every cached geometry, needed whenever the layout is swapped.
+ */
+void keebie_geometry_cache_clear(KeebieGeometryCache* self);
+
+/**
+ * Solves the geometry once per distinct set of params and returns a new
+ * reference to it.
+ */
+KeebieGeometry* keebie_geometry_cache_get(KeebieGeometryCache* self, KeebieLayout* layout, const KeebieGeometryParams* params);
+
+G_END_DECLS
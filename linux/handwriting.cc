@@ -0,0 +1,592 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "blob.h"
+#include "handwriting.h"
+
+// What each stroke a character takes beyond those written so far costs, a
+// little less than a well written stroke is off by.
+#define KEEBIE_HANDWRITING_MISSING_STROKE_COST 2500
+
+typedef struct {
+  gchar* text;
+  guint first_stroke;
+  guint n_strokes;
+  guint order;
+} KeebieHandwritingBuildCharacter;
+
+struct _KeebieHandwritingBuilder {
+  gchar* locale;
+  GArray* characters;
+  GArray* strokes;
+};
+
+struct _KeebieHandwriting {
+  gint ref_count;
+  GMappedFile* file;
+  guint8* data;
+  gsize size;
+
+  const KeebieHandwritingHeader* header;
+  const KeebieHandwritingCharacter* characters;
+  const KeebieHandwritingStroke* strokes;
+  const char* strings;
+};
+
+struct _KeebieHandwritingRecognizer {
+  guint k;
+  KeebieHandwritingFunc func;
+  gpointer data;
+
+  GThread* thread;
+  GMutex lock;
+  GCond cond;
+  gboolean is_stopping;
+
+  // What is to be matched next, guarded by lock. The generation changes
+  // whenever strokes are taken back rather than added, which is when the
+  // worker has to start over.
+  KeebieHandwriting* handwriting;
+  KeebieHandwritingStroke strokes[KEEBIE_HANDWRITING_MAX_STROKES];
+  guint n_strokes;
+  guint generation;
+  gboolean is_pending;
+
+  // The last results, guarded by lock, and the source delivering them.
+  GSource* source;
+  KeebieHandwriting* results_handwriting;
+  const char** results;
+  guint n_results;
+  guint results_strokes;
+  const char** delivered;
+
+  // Only touched by the worker. The cost of every character for the strokes
+  // matched so far, summed stroke by stroke.
+  KeebieHandwriting* matched_handwriting;
+  KeebieHandwritingStroke matched_strokes[KEEBIE_HANDWRITING_MAX_STROKES];
+  guint matched_generation;
+  guint n_matched;
+  uint32_t* costs;
+  uint32_t* best_costs;
+  uint32_t* best_characters;
+};
+
+KeebieHandwritingBuilder* keebie_handwriting_builder_new(const char* locale) {
+  KeebieHandwritingBuilder* self = g_new0(KeebieHandwritingBuilder, 1);
+  self->locale = g_strdup(locale);
+  self->characters = g_array_new(FALSE, FALSE, sizeof (KeebieHandwritingBuildCharacter));
+  self->strokes = g_array_new(FALSE, FALSE, sizeof (KeebieHandwritingStroke));
+  return self;
+}
+
+void keebie_handwriting_builder_free(KeebieHandwritingBuilder* self) {
+  for (guint i = 0; i < self->characters->len; i++) {
+    g_free(g_array_index(self->characters, KeebieHandwritingBuildCharacter, i).text);
+  }
+
+  g_array_unref(self->characters);
+  g_array_unref(self->strokes);
+  g_free(self->locale);
+  g_free(self);
+}
+
+static gboolean keebie_handwriting_parse_stroke(const char* text, GArray* points) {
+  g_auto(GStrv) pairs = g_strsplit(text, " ", -1);
+  g_array_set_size(points, 0);
+
+  for (guint i = 0; pairs[i] != nullptr; i++) {
+    if (pairs[i][0] == '\0') {
+      continue;
+    }
+
+    gchar* end = nullptr;
+    float point[2];
+    point[0] = g_ascii_strtod(pairs[i], &end);
+    if (end == pairs[i] || *end != ',') {
+      return FALSE;
+    }
+
+    const char* y = end + 1;
+    point[1] = g_ascii_strtod(y, &end);
+    if (end == y || *end != '\0' || point[0] < 0 || point[0] > 100 || point[1] < 0 || point[1] > 100) {
+      return FALSE;
+    }
+
+    point[0] /= 100;
+    point[1] /= 100;
+    g_array_append_vals(points, point, 2);
+  }
+  return points->len > 0;
+}
+
+gboolean keebie_handwriting_builder_add_source(KeebieHandwritingBuilder* self, const char* data, gsize length, GError** error) {
+  g_autofree gchar* copy = g_strndup(data, length);
+  g_auto(GStrv) lines = g_strsplit(copy, "\n", -1);
+  g_autoptr(GArray) points = g_array_new(FALSE, FALSE, sizeof (float));
+
+  for (guint i = 0; lines[i] != nullptr; i++) {
+    gchar* line = g_strstrip(lines[i]);
+    if (line[0] == '\0' || line[0] == '#') {
+      continue;
+    }
+
+    g_auto(GStrv) fields = g_strsplit(line, "\t", -1);
+    guint n_fields = g_strv_length(fields);
+    if (n_fields < 2 || n_fields - 1 > KEEBIE_HANDWRITING_MAX_STROKES || fields[0][0] == '\0' || !g_utf8_validate(fields[0], -1, nullptr)) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Line %u: expected character<TAB>stroke, with at most %u strokes",
+        i + 1, KEEBIE_HANDWRITING_MAX_STROKES);
+      return FALSE;
+    }
+
+    KeebieHandwritingBuildCharacter character = {};
+    character.first_stroke = self->strokes->len;
+    character.n_strokes = n_fields - 1;
+    character.order = self->characters->len;
+
+    for (guint j = 1; j < n_fields; j++) {
+      if (!keebie_handwriting_parse_stroke(fields[j], points)) {
+        g_array_set_size(self->strokes, character.first_stroke);
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Line %u: stroke %u is not x,y points within 0 to 100", i + 1, j);
+        return FALSE;
+      }
+
+      KeebieHandwritingStroke stroke;
+      keebie_handwriting_stroke_resample(reinterpret_cast<const float*>(points->data), points->len / 2, &stroke);
+      g_array_append_val(self->strokes, stroke);
+    }
+
+    character.text = g_strdup(fields[0]);
+    g_array_append_val(self->characters, character);
+  }
+  return TRUE;
+}
+
+static gint keebie_handwriting_compare_characters(gconstpointer a, gconstpointer b) {
+  const KeebieHandwritingBuildCharacter* character_a = reinterpret_cast<const KeebieHandwritingBuildCharacter*>(a);
+  const KeebieHandwritingBuildCharacter* character_b = reinterpret_cast<const KeebieHandwritingBuildCharacter*>(b);
+  if (character_a->n_strokes != character_b->n_strokes) {
+    return character_a->n_strokes < character_b->n_strokes ? -1 : 1;
+  }
+  return character_a->order < character_b->order ? -1 : character_a->order > character_b->order ? 1 : 0;
+}
+
+GBytes* keebie_handwriting_builder_end(KeebieHandwritingBuilder* self) {
+  // Fewest strokes first, the order of the source breaks ties so the more
+  // common of two equally good matches can be listed first.
+  g_array_sort(self->characters, keebie_handwriting_compare_characters);
+
+  g_autoptr(GArray) characters = g_array_sized_new(FALSE, FALSE, sizeof (KeebieHandwritingCharacter), self->characters->len);
+  g_autoptr(GArray) strokes = g_array_sized_new(FALSE, FALSE, sizeof (KeebieHandwritingStroke), self->strokes->len);
+  g_autoptr(GByteArray) strings = g_byte_array_new();
+  for (guint i = 0; i < self->characters->len; i++) {
+    const KeebieHandwritingBuildCharacter* entry = &g_array_index(self->characters, KeebieHandwritingBuildCharacter, i);
+
+    KeebieHandwritingCharacter character = {};
+    character.text_offset = strings->len;
+    character.length = strlen(entry->text);
+    character.first_stroke = strokes->len;
+    character.n_strokes = entry->n_strokes;
+    g_byte_array_append(strings, reinterpret_cast<const guint8*>(entry->text), character.length + 1);
+    g_array_append_vals(strokes, &g_array_index(self->strokes, KeebieHandwritingStroke, entry->first_stroke), entry->n_strokes);
+    g_array_append_val(characters, character);
+  }
+
+  KeebieHandwritingHeader header = {};
+  header.magic = KEEBIE_HANDWRITING_MAGIC;
+  header.version = KEEBIE_HANDWRITING_VERSION;
+  g_strlcpy(header.locale, self->locale, sizeof (header.locale));
+  header.n_characters = characters->len;
+  header.characters_offset = sizeof (KeebieHandwritingHeader);
+  header.n_strokes = strokes->len;
+  header.strokes_offset = header.characters_offset + header.n_characters * sizeof (KeebieHandwritingCharacter);
+  header.strings_offset = header.strokes_offset + header.n_strokes * sizeof (KeebieHandwritingStroke);
+  header.strings_size = strings->len;
+  header.size = header.strings_offset + header.strings_size;
+
+  guint8* data = reinterpret_cast<guint8*>(g_malloc0(header.size));
+  memcpy(data, &header, sizeof (header));
+  memcpy(data + header.characters_offset, characters->data, header.n_characters * sizeof (KeebieHandwritingCharacter));
+  memcpy(data + header.strokes_offset, strokes->data, header.n_strokes * sizeof (KeebieHandwritingStroke));
+  memcpy(data + header.strings_offset, strings->data, header.strings_size);
+  return g_bytes_new_take(data, header.size);
+}
+
+static gboolean keebie_handwriting_is_valid(KeebieHandwriting* self) {
+  const KeebieHandwritingHeader* header = self->header;
+  if (header->magic != KEEBIE_HANDWRITING_MAGIC || header->version != KEEBIE_HANDWRITING_VERSION
+      || header->size != self->size
+      || memchr(header->locale, '\0', sizeof (header->locale)) == nullptr
+      || !keebie_blob_section_is_valid(self->size, sizeof (KeebieHandwritingHeader), header->characters_offset, header->n_characters, sizeof (KeebieHandwritingCharacter))
+      || !keebie_blob_section_is_valid(self->size, sizeof (KeebieHandwritingHeader), header->strokes_offset, header->n_strokes, sizeof (KeebieHandwritingStroke))
+      || !keebie_blob_section_is_valid(self->size, sizeof (KeebieHandwritingHeader), header->strings_offset, header->strings_size, 1)) {
+    return FALSE;
+  }
+
+  self->characters = reinterpret_cast<const KeebieHandwritingCharacter*>(self->data + header->characters_offset);
+  self->strokes = reinterpret_cast<const KeebieHandwritingStroke*>(self->data + header->strokes_offset);
+  self->strings = reinterpret_cast<const char*>(self->data + header->strings_offset);
+
+  // Recognizing hands the texts out as they are and relies on the order.
+  for (uint32_t i = 0; i < header->n_characters; i++) {
+    const KeebieHandwritingCharacter* character = &self->characters[i];
+    if (character->text_offset >= header->strings_size || character->length >= header->strings_size - character->text_offset
+        || self->strings[character->text_offset + character->length] != '\0'
+        || character->n_strokes == 0 || character->n_strokes > KEEBIE_HANDWRITING_MAX_STROKES
+        || character->first_stroke > header->n_strokes || character->n_strokes > header->n_strokes - character->first_stroke
+        || (i > 0 && character->n_strokes < self->characters[i - 1].n_strokes)) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+KeebieHandwriting* keebie_handwriting_new_from_file(const char* path, GError** error) {
+  // Every stroke of the characters with enough of them is read in order.
+  GMappedFile* file = keebie_blob_map(path, sizeof (KeebieHandwritingHeader), MADV_SEQUENTIAL, error);
+  if (file == nullptr) {
+    return nullptr;
+  }
+
+  KeebieHandwriting* self = g_new0(KeebieHandwriting, 1);
+  self->ref_count = 1;
+  self->file = file;
+  self->data = reinterpret_cast<guint8*>(g_mapped_file_get_contents(file));
+  self->size = g_mapped_file_get_length(file);
+  self->header = reinterpret_cast<const KeebieHandwritingHeader*>(self->data);
+
+  if (!keebie_handwriting_is_valid(self)) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is truncated, corrupt or of another version", path);
+    keebie_handwriting_unref(self);
+    return nullptr;
+  }
+  return self;
+}
+
+KeebieHandwriting* keebie_handwriting_ref(KeebieHandwriting* self) {
+  g_atomic_int_inc(&self->ref_count);
+  return self;
+}
+
+void keebie_handwriting_unref(KeebieHandwriting* self) {
+  if (g_atomic_int_dec_and_test(&self->ref_count)) {
+    g_mapped_file_unref(self->file);
+    g_free(self);
+  }
+}
+
+const char* keebie_handwriting_get_locale(KeebieHandwriting* self) {
+  return self->header->locale;
+}
+
+guint keebie_handwriting_get_n_characters(KeebieHandwriting* self) {
+  return self->header->n_characters;
+}
+
+static uint8_t keebie_handwriting_quantize(float value) {
+  return CLAMP(lroundf(value * 255.0f), 0, 255);
+}
+
+void keebie_handwriting_stroke_resample(const float* points, guint n_points, KeebieHandwritingStroke* stroke) {
+  const guint n = KEEBIE_HANDWRITING_POINTS;
+
+  float length = 0;
+  for (guint i = 1; i < n_points; i++) {
+    length += hypotf(points[i * 2] - points[i * 2 - 2], points[i * 2 + 1] - points[i * 2 - 1]);
+  }
+
+  // A dot is all of its points in the same place.
+  if (n_points < 2 || length <= 0) {
+    for (guint i = 0; i < n; i++) {
+      stroke->points[i * 2] = keebie_handwriting_quantize(n_points > 0 ? points[0] : 0);
+      stroke->points[i * 2 + 1] = keebie_handwriting_quantize(n_points > 0 ? points[1] : 0);
+    }
+    return;
+  }
+
+  float step = length / (n - 1);
+  guint segment = 0;
+  float segment_start = 0;
+  float segment_length = hypotf(points[2] - points[0], points[3] - points[1]);
+
+  for (guint i = 0; i < n; i++) {
+    float target = step * i;
+    while (segment + 2 < n_points && segment_start + segment_length < target) {
+      segment_start += segment_length;
+      segment++;
+      segment_length = hypotf(points[segment * 2 + 2] - points[segment * 2], points[segment * 2 + 3] - points[segment * 2 + 1]);
+    }
+
+    float t = segment_length > 0 ? CLAMP((target - segment_start) / segment_length, 0.0f, 1.0f) : 0.0f;
+    stroke->points[i * 2] = keebie_handwriting_quantize(points[segment * 2] + t * (points[segment * 2 + 2] - points[segment * 2]));
+    stroke->points[i * 2 + 1] = keebie_handwriting_quantize(points[segment * 2 + 1] + t * (points[segment * 2 + 3] - points[segment * 2 + 1]));
+  }
+}
+
+// Summed squared distance of the points, the loop vectorizes.
+static uint32_t keebie_handwriting_stroke_distance(const KeebieHandwritingStroke* a, const KeebieHandwritingStroke* b) {
+  uint32_t sum = 0;
+  for (guint i = 0; i < KEEBIE_HANDWRITING_POINTS * 2; i++) {
+    int32_t d = static_cast<int32_t>(a->points[i]) - static_cast<int32_t>(b->points[i]);
+    sum += d * d;
+  }
+  return sum;
+}
+
+// The first character taking at least n_strokes, characters are sorted by it.
+static uint32_t keebie_handwriting_find_strokes(KeebieHandwriting* self, guint n_strokes) {
+  uint32_t low = 0;
+  uint32_t high = self->header->n_characters;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (self->characters[mid].n_strokes < n_strokes) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/**
+ * Matches the strokes not matched yet and ranks every character against all
+ * of them into best_characters, returning how many there are.
+ */
+static guint keebie_handwriting_recognizer_match(KeebieHandwritingRecognizer* self, KeebieHandwriting* handwriting, guint generation, guint n_strokes) {
+  if (handwriting != self->matched_handwriting) {
+    if (self->matched_handwriting != nullptr) {
+      keebie_handwriting_unref(self->matched_handwriting);
+    }
+    self->matched_handwriting = handwriting != nullptr ? keebie_handwriting_ref(handwriting) : nullptr;
+
+    // The only allocation, once per set of templates.
+    g_free(self->costs);
+    self->costs = handwriting != nullptr ? g_new(uint32_t, MAX(keebie_handwriting_get_n_characters(handwriting), 1)) : nullptr;
+    self->n_matched = 0;
+  }
+
+  if (generation != self->matched_generation || n_strokes < self->n_matched) {
+    self->matched_generation = generation;
+    self->n_matched = 0;
+  }
+
+  if (handwriting == nullptr || n_strokes == 0) {
+    return 0;
+  }
+
+  // Characters with fewer strokes than the one being matched are done with.
+  uint32_t n_characters = handwriting->header->n_characters;
+  for (guint s = self->n_matched; s < n_strokes; s++) {
+    const KeebieHandwritingStroke* stroke = &self->matched_strokes[s];
+    for (uint32_t i = keebie_handwriting_find_strokes(handwriting, s + 1); i < n_characters; i++) {
+      const KeebieHandwritingCharacter* character = &handwriting->characters[i];
+      uint32_t distance = keebie_handwriting_stroke_distance(stroke, &handwriting->strokes[character->first_stroke + s]);
+      self->costs[i] = s == 0 ? distance : self->costs[i] + distance;
+    }
+  }
+  self->n_matched = n_strokes;
+
+  // The best k so far, worst last. Strokes still missing only cost more the
+  // further along, so the first character which cannot beat the worst ends it.
+  guint n_best = 0;
+  for (uint32_t i = keebie_handwriting_find_strokes(handwriting, n_strokes); i < n_characters; i++) {
+    uint32_t missing = (handwriting->characters[i].n_strokes - n_strokes) * KEEBIE_HANDWRITING_MISSING_STROKE_COST;
+    if (n_best == self->k && missing >= self->best_costs[self->k - 1]) {
+      break;
+    }
+
+    uint32_t cost = self->costs[i] / n_strokes + missing;
+    if (n_best == self->k && cost >= self->best_costs[self->k - 1]) {
+      continue;
+    }
+
+    guint at = n_best < self->k ? n_best++ : self->k - 1;
+    while (at > 0 && self->best_costs[at - 1] > cost) {
+      self->best_costs[at] = self->best_costs[at - 1];
+      self->best_characters[at] = self->best_characters[at - 1];
+      at--;
+    }
+    self->best_costs[at] = cost;
+    self->best_characters[at] = i;
+  }
+  return n_best;
+}
+
+static gpointer keebie_handwriting_recognizer_run(gpointer data) {
+  KeebieHandwritingRecognizer* self = reinterpret_cast<KeebieHandwritingRecognizer*>(data);
+
+  g_mutex_lock(&self->lock);
+  while (TRUE) {
+    while (!self->is_pending && !self->is_stopping) {
+      g_cond_wait(&self->cond, &self->lock);
+    }
+    if (self->is_stopping) {
+      break;
+    }
+
+    // Strokes keep coming in while the last ones are matched.
+    self->is_pending = FALSE;
+    KeebieHandwriting* handwriting = self->handwriting != nullptr ? keebie_handwriting_ref(self->handwriting) : nullptr;
+    guint generation = self->generation;
+    guint n_strokes = self->n_strokes;
+    memcpy(self->matched_strokes, self->strokes, n_strokes * sizeof (KeebieHandwritingStroke));
+    g_mutex_unlock(&self->lock);
+
+    guint n_best = keebie_handwriting_recognizer_match(self, handwriting, generation, n_strokes);
+
+    g_mutex_lock(&self->lock);
+    if (self->results_handwriting != handwriting) {
+      if (self->results_handwriting != nullptr) {
+        keebie_handwriting_unref(self->results_handwriting);
+      }
+      self->results_handwriting = handwriting != nullptr ? keebie_handwriting_ref(handwriting) : nullptr;
+    }
+
+    for (guint i = 0; i < n_best; i++) {
+      const KeebieHandwritingCharacter* character = &handwriting->characters[self->best_characters[i]];
+      self->results[i] = handwriting->strings + character->text_offset;
+    }
+    self->n_results = n_best;
+    self->results_strokes = n_strokes;
+    g_source_set_ready_time(self->source, 0);
+
+    if (handwriting != nullptr) {
+      keebie_handwriting_unref(handwriting);
+    }
+  }
+  g_mutex_unlock(&self->lock);
+  return nullptr;
+}
+
+static gboolean keebie_handwriting_recognizer_deliver(gpointer data) {
+  KeebieHandwritingRecognizer* self = reinterpret_cast<KeebieHandwritingRecognizer*>(data);
+
+  // The templates the results point into outlive the call even if the
+  // worker moves on to others meanwhile.
+  g_mutex_lock(&self->lock);
+  KeebieHandwriting* handwriting = self->results_handwriting != nullptr ? keebie_handwriting_ref(self->results_handwriting) : nullptr;
+  guint n_results = self->n_results;
+  guint n_strokes = self->results_strokes;
+  memcpy(self->delivered, self->results, n_results * sizeof (const char*));
+  g_mutex_unlock(&self->lock);
+
+  self->func(self->delivered, n_results, n_strokes, self->data);
+
+  if (handwriting != nullptr) {
+    keebie_handwriting_unref(handwriting);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean keebie_handwriting_source_dispatch(GSource* source, GSourceFunc callback, gpointer user_data) {
+  g_source_set_ready_time(source, -1);
+  return callback(user_data);
+}
+
+// Made ready by the worker, which setting the ready time is safe from.
+static GSourceFuncs keebie_handwriting_source_funcs = {
+  nullptr,
+  nullptr,
+  keebie_handwriting_source_dispatch,
+  nullptr,
+  nullptr,
+  nullptr,
+};
+
+KeebieHandwritingRecognizer* keebie_handwriting_recognizer_new(guint k, KeebieHandwritingFunc func, gpointer data) {
+  g_return_val_if_fail(k > 0, nullptr);
+
+  KeebieHandwritingRecognizer* self = g_new0(KeebieHandwritingRecognizer, 1);
+  self->k = k;
+  self->func = func;
+  self->data = data;
+  self->results = g_new0(const char*, k);
+  self->delivered = g_new0(const char*, k);
+  self->best_costs = g_new0(uint32_t, k);
+  self->best_characters = g_new0(uint32_t, k);
+  g_mutex_init(&self->lock);
+  g_cond_init(&self->cond);
+
+  self->source = g_source_new(&keebie_handwriting_source_funcs, sizeof (GSource));
+  g_source_set_callback(self->source, keebie_handwriting_recognizer_deliver, self, nullptr);
+  g_source_attach(self->source, nullptr);
+
+  self->thread = g_thread_new("keebie-handwriting", keebie_handwriting_recognizer_run, self);
+  return self;
+}
+
+void keebie_handwriting_recognizer_free(KeebieHandwritingRecognizer* self) {
+  g_mutex_lock(&self->lock);
+  self->is_stopping = TRUE;
+  g_cond_signal(&self->cond);
+  g_mutex_unlock(&self->lock);
+  g_thread_join(self->thread);
+
+  g_source_destroy(self->source);
+  g_source_unref(self->source);
+
+  g_clear_pointer(&self->handwriting, keebie_handwriting_unref);
+  g_clear_pointer(&self->results_handwriting, keebie_handwriting_unref);
+  g_clear_pointer(&self->matched_handwriting, keebie_handwriting_unref);
+  g_free(self->costs);
+  g_free(self->best_costs);
+  g_free(self->best_characters);
+  g_free(self->results);
+  g_free(self->delivered);
+  g_mutex_clear(&self->lock);
+  g_cond_clear(&self->cond);
+  g_free(self);
+}
+
+static void keebie_handwriting_recognizer_queue_locked(KeebieHandwritingRecognizer* self) {
+  self->is_pending = TRUE;
+  g_cond_signal(&self->cond);
+}
+
+void keebie_handwriting_recognizer_set_handwriting(KeebieHandwritingRecognizer* self, KeebieHandwriting* handwriting) {
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+  if (handwriting == self->handwriting) {
+    return;
+  }
+
+  g_clear_pointer(&self->handwriting, keebie_handwriting_unref);
+  self->handwriting = handwriting != nullptr ? keebie_handwriting_ref(handwriting) : nullptr;
+  self->n_strokes = 0;
+  self->generation++;
+  keebie_handwriting_recognizer_queue_locked(self);
+}
+
+gboolean keebie_handwriting_recognizer_add_stroke(KeebieHandwritingRecognizer* self, const float* points, guint n_points) {
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+  if (self->handwriting == nullptr || n_points == 0 || self->n_strokes == KEEBIE_HANDWRITING_MAX_STROKES) {
+    return FALSE;
+  }
+
+  keebie_handwriting_stroke_resample(points, n_points, &self->strokes[self->n_strokes++]);
+  keebie_handwriting_recognizer_queue_locked(self);
+  return TRUE;
+}
+
+gboolean keebie_handwriting_recognizer_undo_stroke(KeebieHandwritingRecognizer* self) {
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+  if (self->n_strokes == 0) {
+    return FALSE;
+  }
+
+  self->n_strokes--;
+  self->generation++;
+  keebie_handwriting_recognizer_queue_locked(self);
+  return TRUE;
+}
+
+void keebie_handwriting_recognizer_clear(KeebieHandwritingRecognizer* self) {
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+  self->n_strokes = 0;
+  self->generation++;
+  keebie_handwriting_recognizer_queue_locked(self);
+}
+
+guint keebie_handwriting_recognizer_get_n_strokes(KeebieHandwritingRecognizer* self) {
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+  return self->n_strokes;
+}
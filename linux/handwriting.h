@@ -0,0 +1,138 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+#define KEEBIE_HANDWRITING_MAGIC 0x5748424bu /* "KBHW" */
+#define KEEBIE_HANDWRITING_VERSION 1
+
+// Every stroke is compared as this many points spread evenly along it.
+#define KEEBIE_HANDWRITING_POINTS 16
+
+// Characters with more strokes than this are not written by hand.
+#define KEEBIE_HANDWRITING_MAX_STROKES 32
+
+/**
+ * The compiled stroke templates of one locale, a single blob of:
+ *
+ *   header | characters | strokes | strings
+ *
+ * Characters are sorted by how many strokes they take, fewest first, and
+ * point at their run of strokes in the order they are written. A stroke is
+ * KEEBIE_HANDWRITING_POINTS x, y pairs quantized to a byte each, 0 being the
+ * left or top edge of the box the character is written in and 255 the right
+ * or bottom one. Records are in host byte order, bump
+ * KEEBIE_HANDWRITING_VERSION on any change.
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;
+  char locale[16];
+  uint32_t n_characters;
+  uint32_t characters_offset;
+  uint32_t n_strokes;
+  uint32_t strokes_offset;
+  uint32_t strings_offset;
+  uint32_t strings_size;
+} KeebieHandwritingHeader;
+
+typedef struct {
+  uint32_t text_offset;
+  uint32_t length;
+  uint32_t first_stroke;
+  uint32_t n_strokes;
+} KeebieHandwritingCharacter;
+
+typedef struct {
+  uint8_t points[KEEBIE_HANDWRITING_POINTS * 2];
+} KeebieHandwritingStroke;
+
+typedef struct _KeebieHandwriting KeebieHandwriting;
+typedef struct _KeebieHandwritingBuilder KeebieHandwritingBuilder;
+
+KeebieHandwritingBuilder* keebie_handwriting_builder_new(const char* locale);
+void keebie_handwriting_builder_free(KeebieHandwritingBuilder* self);
+
+/**
+ * Parses a source of one "character<TAB>stroke<TAB>stroke..." per line, a
+ * stroke being space separated "x,y" points within a 100 by 100 box. Blank
+ * lines and lines starting with # are skipped.
+ */
+gboolean keebie_handwriting_builder_add_source(KeebieHandwritingBuilder* self, const char* data, gsize length, GError** error);
+
+/**
+ * Serializes everything added so far into a compiled template blob.
+ */
+GBytes* keebie_handwriting_builder_end(KeebieHandwritingBuilder* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieHandwritingBuilder, keebie_handwriting_builder_free);
+
+/**
+ * Maps compiled templates read-only, every record is checked here so
+ * recognizing does not need to.
+ */
+KeebieHandwriting* keebie_handwriting_new_from_file(const char* path, GError** error);
+KeebieHandwriting* keebie_handwriting_ref(KeebieHandwriting* self);
+void keebie_handwriting_unref(KeebieHandwriting* self);
+
+const char* keebie_handwriting_get_locale(KeebieHandwriting* self);
+guint keebie_handwriting_get_n_characters(KeebieHandwriting* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieHandwriting, keebie_handwriting_unref);
+
+/**
+ * Spreads KEEBIE_HANDWRITING_POINTS points evenly along the polyline through
+ * n_points x, y pairs, given in units of the box the character is written
+ * in, and quantizes them into stroke.
+ */
+void keebie_handwriting_stroke_resample(const float* points, guint n_points, KeebieHandwritingStroke* stroke);
+
+/**
+ * Gets the characters the strokes so far most likely are, best first, on
+ * the main context. The strings belong to the templates and only last for
+ * the call. No characters with no strokes means the strokes were cleared.
+ */
+typedef void (*KeebieHandwritingFunc)(const char* const* characters, guint n_characters, guint n_strokes, gpointer data);
+
+/**
+ * Recognizes a character as it is being written, stroke by stroke. Strokes
+ * are matched against the templates' in the order they were written, and
+ * only the newest one is matched when one is added. Matching runs on a
+ * thread of the recognizer's own which, like handing strokes to it and the
+ * results back, does not allocate once the templates are set.
+ */
+typedef struct _KeebieHandwritingRecognizer KeebieHandwritingRecognizer;
+
+/**
+ * Creates a recognizer reporting up to k characters to func after every
+ * change to the strokes.
+ */
+KeebieHandwritingRecognizer* keebie_handwriting_recognizer_new(guint k, KeebieHandwritingFunc func, gpointer data);
+void keebie_handwriting_recognizer_free(KeebieHandwritingRecognizer* self);
+
+/**
+ * Swaps the templates strokes are matched against, which clears them. NULL
+ * turns recognizing off.
+ */
+void keebie_handwriting_recognizer_set_handwriting(KeebieHandwritingRecognizer* self, KeebieHandwriting* handwriting);
+
+/**
+ * Adds a stroke of n_points x, y pairs, see
+ * keebie_handwriting_stroke_resample. Returns FALSE when there are no
+ * templates or the character already has as many strokes as any can.
+ */
+gboolean keebie_handwriting_recognizer_add_stroke(KeebieHandwritingRecognizer* self, const float* points, guint n_points);
+
+/**
+ * Takes back the last stroke, returns FALSE when there was none.
+ */
+gboolean keebie_handwriting_recognizer_undo_stroke(KeebieHandwritingRecognizer* self);
+void keebie_handwriting_recognizer_clear(KeebieHandwritingRecognizer* self);
+guint keebie_handwriting_recognizer_get_n_strokes(KeebieHandwritingRecognizer* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieHandwritingRecognizer, keebie_handwriting_recognizer_free);
+
+G_END_DECLS
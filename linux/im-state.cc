@@ -0,0 +1,82 @@
+#include "im-state.h"
+
+// zwp_text_input_v3.content_purpose, which input-method-v2 forwards as is.
+enum {
+  KEEBIE_PURPOSE_NORMAL = 0,
+  KEEBIE_PURPOSE_ALPHA,
+  KEEBIE_PURPOSE_DIGITS,
+  KEEBIE_PURPOSE_NUMBER,
+  KEEBIE_PURPOSE_PHONE,
+  KEEBIE_PURPOSE_URL,
+  KEEBIE_PURPOSE_EMAIL,
+  KEEBIE_PURPOSE_NAME,
+  KEEBIE_PURPOSE_PASSWORD,
+  KEEBIE_PURPOSE_PIN,
+  KEEBIE_PURPOSE_DATE,
+  KEEBIE_PURPOSE_TIME,
+  KEEBIE_PURPOSE_DATETIME,
+  KEEBIE_PURPOSE_TERMINAL,
+};
+
+// zwp_text_input_v3.content_hint bits which mark what is typed as secret.
+#define KEEBIE_HINT_HIDDEN_TEXT 0x40
+#define KEEBIE_HINT_SENSITIVE_DATA 0x80
+
+void keebie_im_state_clear(KeebieImState* self) {
+  keebie_surrounding_clear(&self->surrounding);
+  *self = {};
+}
+
+void keebie_im_state_copy(KeebieImState* self, const KeebieImState* other) {
+  keebie_im_state_clear(self);
+  *self = *other;
+  self->surrounding.text = g_strdup(other->surrounding.text);
+}
+
+guint keebie_im_state_diff(const KeebieImState* self, const KeebieImState* other) {
+  guint fields = 0;
+
+  if (self->is_active != other->is_active) {
+    fields |= KEEBIE_IM_STATE_ACTIVE;
+  }
+
+  if (g_strcmp0(self->surrounding.text, other->surrounding.text) != 0 || self->surrounding.cursor != other->surrounding.cursor || self->surrounding.anchor != other->surrounding.anchor) {
+    fields |= KEEBIE_IM_STATE_SURROUNDING;
+  }
+
+  if (self->content_hint != other->content_hint || self->content_purpose != other->content_purpose) {
+    fields |= KEEBIE_IM_STATE_CONTENT_TYPE;
+  }
+
+  if (self->text_change_cause != other->text_change_cause) {
+    fields |= KEEBIE_IM_STATE_TEXT_CHANGE_CAUSE;
+  }
+  return fields;
+}
+
+gboolean keebie_im_state_is_private(const KeebieImState* self) {
+  return self->content_purpose == KEEBIE_PURPOSE_PASSWORD || self->content_purpose == KEEBIE_PURPOSE_PIN
+    || (self->content_hint & (KEEBIE_HINT_HIDDEN_TEXT | KEEBIE_HINT_SENSITIVE_DATA)) != 0;
+}
+
+gboolean keebie_im_state_wants_correction(const KeebieImState* self) {
+  return (self->content_purpose == KEEBIE_PURPOSE_NORMAL || self->content_purpose == KEEBIE_PURPOSE_ALPHA)
+    && !keebie_im_state_is_private(self);
+}
+
+KeebieContentType keebie_im_state_get_content_type(const KeebieImState* self) {
+  switch (self->content_purpose) {
+    case KEEBIE_PURPOSE_DIGITS:
+    case KEEBIE_PURPOSE_NUMBER:
+    case KEEBIE_PURPOSE_PIN:
+      return KEEBIE_CONTENT_TYPE_NUMBER;
+    case KEEBIE_PURPOSE_PHONE:
+      return KEEBIE_CONTENT_TYPE_PHONE;
+    case KEEBIE_PURPOSE_DATE:
+    case KEEBIE_PURPOSE_TIME:
+    case KEEBIE_PURPOSE_DATETIME:
+      return KEEBIE_CONTENT_TYPE_DATE_TIME;
+    default:
+      return KEEBIE_CONTENT_TYPE_TEXT;
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+#include "layout.h"
+#include "surrounding.h"
+
+G_BEGIN_DECLS
+
+typedef enum {
+  KEEBIE_IM_STATE_ACTIVE = 1 << 0,
+  KEEBIE_IM_STATE_SURROUNDING = 1 << 1,
+  KEEBIE_IM_STATE_CONTENT_TYPE = 1 << 2,
+  KEEBIE_IM_STATE_TEXT_CHANGE_CAUSE = 1 << 3,
+} KeebieImStateField;
+
+// zwp_text_input_v3.change_cause, the client changed its text on its own.
+#define KEEBIE_IM_STATE_CHANGE_CAUSE_OTHER 1
+
+/**
+ * Everything zwp_input_method_v2 tells about the focused text field. The
+ * compositor sends it double-buffered, events fill a pending copy which
+ * replaces the current one on done. Hint and purpose are the
+ * zwp_text_input_v3 content_hint and content_purpose values.
+ */
+typedef struct {
+  gboolean is_active;
+  KeebieSurrounding surrounding;
+  uint32_t text_change_cause;
+  uint32_t content_hint;
+  uint32_t content_purpose;
+} KeebieImState;
+
+void keebie_im_state_clear(KeebieImState* self);
+void keebie_im_state_copy(KeebieImState* self, const KeebieImState* other);
+
+/**
+ * Returns the KeebieImStateFields which differ between the two.
+ */
+guint keebie_im_state_diff(const KeebieImState* self, const KeebieImState* other);
+
+/**
+ * Whether the field holds passwords or other text which must not be learned.
+ */
+gboolean keebie_im_state_is_private(const KeebieImState* self);
+
+/**
+ * Whether the field holds prose, where fixing typos is wanted. Addresses,
+ * names, numbers and commands are better left as typed.
+ */
+gboolean keebie_im_state_wants_correction(const KeebieImState* self);
+
+/**
+ * Maps the content purpose onto the planes a layout's contentPlaneMap knows.
+ */
+KeebieContentType keebie_im_state_get_content_type(const KeebieImState* self);
+
+G_END_DECLS
@@ -0,0 +1,248 @@
+#include <errno.h>
+#include <glib-unix.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "input-thread.h"
+
+// A power of two, so positions stay in step with slots when they wrap.
+#define KEEBIE_INPUT_QUEUE_SIZE 256
+
+/**
+ * The slot for position p is free for the producer which claimed p while
+ * its sequence is p, and holds that producer's command once it is p + 1.
+ * The consumer hands it on to position p + KEEBIE_INPUT_QUEUE_SIZE.
+ */
+typedef struct {
+  gint sequence;
+  KeebieInputCommand command;
+} KeebieInputSlot;
+
+typedef struct {
+  GSource source;
+  struct wl_display* display;
+  struct wl_event_queue* queue;
+  gpointer fd_tag;
+  gboolean is_reading;
+} KeebieWaylandSource;
+
+struct _KeebieInputThread {
+  KeebieInputFunc func;
+  gpointer data;
+
+  GMainContext* context;
+  GMainLoop* loop;
+  GThread* thread;
+
+  int wakeup_fd;
+  GSource* wakeup_source;
+
+  // Producers claim positions by moving tail on, only the consumer reads
+  // from head.
+  guint head;
+  gint tail;
+  KeebieInputSlot slots[KEEBIE_INPUT_QUEUE_SIZE];
+
+  GSource* wayland_source;
+  struct wl_display* display;
+  struct wl_event_queue* queue;
+};
+
+static gboolean keebie_wayland_source_prepare(GSource* source, gint* timeout) {
+  KeebieWaylandSource* self = reinterpret_cast<KeebieWaylandSource*>(source);
+  *timeout = -1;
+
+  if (self->is_reading) {
+    return FALSE;
+  }
+
+  // Whatever another thread already read for this queue has to go out first.
+  if (wl_display_prepare_read_queue(self->display, self->queue) != 0) {
+    return TRUE;
+  }
+
+  self->is_reading = TRUE;
+  wl_display_flush(self->display);
+  return FALSE;
+}
+
+static gboolean keebie_wayland_source_check(GSource* source) {
+  KeebieWaylandSource* self = reinterpret_cast<KeebieWaylandSource*>(source);
+  if (!self->is_reading) {
+    return TRUE;
+  }
+
+  self->is_reading = FALSE;
+
+  GIOCondition revents = g_source_query_unix_fd(source, self->fd_tag);
+  if (revents & G_IO_IN) {
+    if (wl_display_read_events(self->display) < 0) {
+      g_warning("Failed to read Wayland events: %s", g_strerror(errno));
+      return FALSE;
+    }
+    return TRUE;
+  }
+
+  wl_display_cancel_read(self->display);
+  return FALSE;
+}
+
+static gboolean keebie_wayland_source_dispatch(GSource* source, GSourceFunc callback, gpointer data) {
+  KeebieWaylandSource* self = reinterpret_cast<KeebieWaylandSource*>(source);
+  wl_display_dispatch_queue_pending(self->display, self->queue);
+  return G_SOURCE_CONTINUE;
+}
+
+static void keebie_wayland_source_finalize(GSource* source) {
+  KeebieWaylandSource* self = reinterpret_cast<KeebieWaylandSource*>(source);
+  if (self->is_reading) {
+    wl_display_cancel_read(self->display);
+  }
+}
+
+static GSourceFuncs keebie_wayland_source_funcs = {
+  .prepare = keebie_wayland_source_prepare,
+  .check = keebie_wayland_source_check,
+  .dispatch = keebie_wayland_source_dispatch,
+  .finalize = keebie_wayland_source_finalize,
+};
+
+static gboolean keebie_input_thread_drain(gint fd, GIOCondition condition, gpointer data) {
+  KeebieInputThread* self = reinterpret_cast<KeebieInputThread*>(data);
+
+  uint64_t count;
+  if (read(fd, &count, sizeof (count)) < 0 && errno != EAGAIN) {
+    g_warning("Failed to read the input thread wakeup: %s", g_strerror(errno));
+  }
+
+  while (TRUE) {
+    KeebieInputSlot* slot = &self->slots[self->head % KEEBIE_INPUT_QUEUE_SIZE];
+    if (static_cast<guint>(g_atomic_int_get(&slot->sequence)) != self->head + 1) {
+      break;
+    }
+
+    self->func(&slot->command, self->data);
+    g_clear_pointer(&slot->command.text, g_free);
+
+    g_atomic_int_set(&slot->sequence, static_cast<gint>(self->head + KEEBIE_INPUT_QUEUE_SIZE));
+    self->head++;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static gpointer keebie_input_thread_run(gpointer data) {
+  KeebieInputThread* self = reinterpret_cast<KeebieInputThread*>(data);
+
+  g_main_context_push_thread_default(self->context);
+  g_main_loop_run(self->loop);
+  g_main_context_pop_thread_default(self->context);
+  return nullptr;
+}
+
+KeebieInputThread* keebie_input_thread_new(KeebieInputFunc func, gpointer data) {
+  KeebieInputThread* self = g_new0(KeebieInputThread, 1);
+  self->func = func;
+  self->data = data;
+
+  for (guint i = 0; i < KEEBIE_INPUT_QUEUE_SIZE; i++) {
+    self->slots[i].sequence = i;
+  }
+
+  self->context = g_main_context_new();
+  self->loop = g_main_loop_new(self->context, FALSE);
+
+  self->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  g_assert(self->wakeup_fd >= 0);
+
+  self->wakeup_source = g_unix_fd_source_new(self->wakeup_fd, G_IO_IN);
+  g_source_set_callback(self->wakeup_source, reinterpret_cast<GSourceFunc>(reinterpret_cast<void(*)()>(keebie_input_thread_drain)), self, nullptr);
+  g_source_set_priority(self->wakeup_source, G_PRIORITY_HIGH);
+  g_source_attach(self->wakeup_source, self->context);
+
+  self->thread = g_thread_new("keebie-input", keebie_input_thread_run, self);
+  return self;
+}
+
+void keebie_input_thread_free(KeebieInputThread* self) {
+  g_main_loop_quit(self->loop);
+  g_main_context_wakeup(self->context);
+  g_thread_join(self->thread);
+
+  if (self->wayland_source != nullptr) {
+    g_source_destroy(self->wayland_source);
+    g_source_unref(self->wayland_source);
+  }
+  g_clear_pointer(&self->queue, wl_event_queue_destroy);
+
+  g_source_destroy(self->wakeup_source);
+  g_source_unref(self->wakeup_source);
+  close(self->wakeup_fd);
+
+  for (guint i = 0; i < KEEBIE_INPUT_QUEUE_SIZE; i++) {
+    g_free(self->slots[i].command.text);
+  }
+
+  g_main_loop_unref(self->loop);
+  g_main_context_unref(self->context);
+  g_free(self);
+}
+
+GMainContext* keebie_input_thread_get_context(KeebieInputThread* self) {
+  return self->context;
+}
+
+struct wl_event_queue* keebie_input_thread_create_queue(KeebieInputThread* self, struct wl_display* display) {
+  g_return_val_if_fail(self->queue == nullptr, self->queue);
+
+  self->display = display;
+  self->queue = wl_display_create_queue(display);
+  return self->queue;
+}
+
+void keebie_input_thread_start(KeebieInputThread* self) {
+  g_return_if_fail(self->queue != nullptr && self->wayland_source == nullptr);
+
+  KeebieWaylandSource* source = reinterpret_cast<KeebieWaylandSource*>(g_source_new(&keebie_wayland_source_funcs, sizeof (KeebieWaylandSource)));
+  source->display = self->display;
+  source->queue = self->queue;
+  source->fd_tag = g_source_add_unix_fd(&source->source, wl_display_get_fd(self->display), static_cast<GIOCondition>(G_IO_IN | G_IO_ERR | G_IO_HUP));
+
+  self->wayland_source = &source->source;
+  g_source_set_name(self->wayland_source, "keebie-wayland");
+  g_source_set_priority(self->wayland_source, G_PRIORITY_HIGH);
+  g_source_attach(self->wayland_source, self->context);
+}
+
+gboolean keebie_input_thread_is_current(KeebieInputThread* self) {
+  return g_thread_self() == self->thread;
+}
+
+gboolean keebie_input_thread_push(KeebieInputThread* self, const KeebieInputCommand* command) {
+  guint position = static_cast<guint>(g_atomic_int_get(&self->tail));
+  KeebieInputSlot* slot;
+  while (TRUE) {
+    slot = &self->slots[position % KEEBIE_INPUT_QUEUE_SIZE];
+    gint lag = static_cast<gint>(static_cast<guint>(g_atomic_int_get(&slot->sequence)) - position);
+    if (lag < 0) {
+      // The consumer has yet to take what was put here a lap ago.
+      return FALSE;
+    }
+
+    if (lag == 0 && g_atomic_int_compare_and_exchange(&self->tail, static_cast<gint>(position), static_cast<gint>(position + 1))) {
+      break;
+    }
+
+    // Another producer got there first.
+    position = static_cast<guint>(g_atomic_int_get(&self->tail));
+  }
+
+  slot->command = *command;
+  slot->command.text = g_strdup(command->text);
+  g_atomic_int_set(&slot->sequence, static_cast<gint>(position + 1));
+
+  uint64_t one = 1;
+  if (write(self->wakeup_fd, &one, sizeof (one)) < 0 && errno != EAGAIN) {
+    g_warning("Failed to wake the input thread: %s", g_strerror(errno));
+  }
+  return TRUE;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+#include <wayland-client.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  KEEBIE_INPUT_COMMIT_TEXT = 0,
+  KEEBIE_INPUT_SEND_KEY,
+  KEEBIE_INPUT_DELETE_SURROUNDING,
+  KEEBIE_INPUT_DELETE,
+  KEEBIE_INPUT_ACTIVATE_KEY,
+  KEEBIE_INPUT_PRESS_KEY,
+  KEEBIE_INPUT_RELEASE_KEY,
+  KEEBIE_INPUT_COMPOSE,
+  KEEBIE_INPUT_SET_COMPOSING_CURSOR,
+  KEEBIE_INPUT_FINISH_COMPOSING,
+  KEEBIE_INPUT_REPLACE_WORD,
+  KEEBIE_INPUT_COMMIT_SWIPE,
+  KEEBIE_INPUT_COMMIT_EMOJI,
+  KEEBIE_INPUT_UPLOAD_KEYMAP,
+} KeebieInputCommandType;
+
+/**
+ * A key action handed from the UI to the input thread, what args hold
+ * depends on the type the same way as the keebie_application_* call it
+ * stands for. The text is owned by the command.
+ */
+typedef struct {
+  KeebieInputCommandType type;
+  gboolean is_shifted;
+  uint32_t args[3];
+  gchar* text;
+} KeebieInputCommand;
+
+typedef void (*KeebieInputFunc)(const KeebieInputCommand* command, gpointer data);
+
+/**
+ * A thread with its own GMainContext which services a wl_event_queue of its
+ * own, so input-method events and key requests never wait on the GTK main
+ * loop. Commands reach it through one bounded lock-free queue any thread can
+ * push to, the GTK main thread as well as the UI thread of every Flutter
+ * engine, and run in the order they were pushed.
+ */
+typedef struct _KeebieInputThread KeebieInputThread;
+
+KeebieInputThread* keebie_input_thread_new(KeebieInputFunc func, gpointer data);
+void keebie_input_thread_free(KeebieInputThread* self);
+
+/**
+ * Sources which have to run on the input thread attach to this context.
+ */
+GMainContext* keebie_input_thread_get_context(KeebieInputThread* self);
+
+/**
+ * Creates the queue the input thread services, proxies created from wrappers
+ * set to it have their events dispatched on the input thread.
+ */
+struct wl_event_queue* keebie_input_thread_create_queue(KeebieInputThread* self, struct wl_display* display);
+
+/**
+ * Starts dispatching the queue, only once every proxy on it has a listener
+ * since events for a proxy without one are dropped.
+ */
+void keebie_input_thread_start(KeebieInputThread* self);
+
+gboolean keebie_input_thread_is_current(KeebieInputThread* self);
+
+/**
+ * Queues a copy of the command, the text is duplicated. Returns FALSE
+ * without queueing it if the queue is full, which takes the input thread
+ * being stuck for many keys.
+ */
+gboolean keebie_input_thread_push(KeebieInputThread* self, const KeebieInputCommand* command);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieInputThread, keebie_input_thread_free);
+
+G_END_DECLS
@@ -0,0 +1,69 @@
+#include "key-adjacency.h"
+
+// Keys whose centers are within this many key widths of each other are
+// neighbours, which takes in the diagonal ones of the staggered rows.
+#define KEEBIE_KEY_ADJACENCY_REACH 1.5f
+
+struct _KeebieKeyAdjacency {
+  // Both orders of every pair packed into a 64-bit key.
+  GHashTable* pairs;
+};
+
+static gint64* keebie_key_adjacency_pack(gunichar a, gunichar b) {
+  gint64* pair = g_new(gint64, 1);
+  *pair = (static_cast<gint64>(a) << 32) | b;
+  return pair;
+}
+
+static gunichar keebie_key_adjacency_get_char(KeebieLayout* layout, guint plane, const KeebieKeyRect* rect) {
+  const KeebieKeyAction* action = keebie_layout_lookup(layout, plane, rect->row, rect->key);
+  if (action == nullptr || action->type != KEEBIE_KEY_ACTION_COMMIT || action->key_type != KEEBIE_KEY_TYPE_REGULAR) {
+    return 0;
+  }
+
+  const char* text = keebie_layout_get_text(layout, action, FALSE);
+  if (text == nullptr || text[0] == '\0' || *g_utf8_next_char(text) != '\0') {
+    return 0;
+  }
+  return g_unichar_tolower(g_utf8_get_char(text));
+}
+
+KeebieKeyAdjacency* keebie_key_adjacency_new(KeebieLayout* layout, const KeebieGeometry* geometry, guint plane) {
+  KeebieKeyAdjacency* self = g_new0(KeebieKeyAdjacency, 1);
+  self->pairs = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, nullptr);
+
+  g_autofree gunichar* chars = g_new0(gunichar, MAX(geometry->n_keys, 1));
+  for (guint i = 0; i < geometry->n_keys; i++) {
+    chars[i] = keebie_key_adjacency_get_char(layout, plane, &geometry->keys[i]);
+  }
+
+  // A plane has a few dozen keys, comparing every pair is cheap enough.
+  for (guint i = 0; i < geometry->n_keys; i++) {
+    const KeebieKeyRect* a = &geometry->keys[i];
+    for (guint j = i + 1; j < geometry->n_keys && chars[i] != 0; j++) {
+      const KeebieKeyRect* b = &geometry->keys[j];
+      if (chars[j] == 0 || chars[j] == chars[i]) {
+        continue;
+      }
+
+      float dx = (a->x + a->width / 2.0f) - (b->x + b->width / 2.0f);
+      float dy = (a->y + a->height / 2.0f) - (b->y + b->height / 2.0f);
+      float reach = MIN(a->width, b->width) * KEEBIE_KEY_ADJACENCY_REACH;
+      if (dx * dx + dy * dy <= reach * reach) {
+        g_hash_table_add(self->pairs, keebie_key_adjacency_pack(chars[i], chars[j]));
+        g_hash_table_add(self->pairs, keebie_key_adjacency_pack(chars[j], chars[i]));
+      }
+    }
+  }
+  return self;
+}
+
+void keebie_key_adjacency_free(KeebieKeyAdjacency* self) {
+  g_hash_table_unref(self->pairs);
+  g_free(self);
+}
+
+gboolean keebie_key_adjacency_contains(KeebieKeyAdjacency* self, gunichar a, gunichar b) {
+  gint64 pair = (static_cast<gint64>(g_unichar_tolower(a)) << 32) | g_unichar_tolower(b);
+  return g_hash_table_contains(self->pairs, &pair);
+}
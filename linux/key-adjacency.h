@@ -0,0 +1,23 @@
+#pragma once
+
+#include <glib.h>
+#include "geometry.h"
+#include "layout.h"
+
+G_BEGIN_DECLS
+
+/**
+ * Which characters sit on neighbouring keys of a plane, derived from where
+ * the geometry solver puts the keys. Only keys which commit a single
+ * character take part, characters are compared lowercased.
+ */
+typedef struct _KeebieKeyAdjacency KeebieKeyAdjacency;
+
+KeebieKeyAdjacency* keebie_key_adjacency_new(KeebieLayout* layout, const KeebieGeometry* geometry, guint plane);
+void keebie_key_adjacency_free(KeebieKeyAdjacency* self);
+
+gboolean keebie_key_adjacency_contains(KeebieKeyAdjacency* self, gunichar a, gunichar b);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieKeyAdjacency, keebie_key_adjacency_free);
+
+G_END_DECLS
@@ -0,0 +1,113 @@
+#include <errno.h>
+#include <glib-unix.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include "key-repeat.h"
+
+// What most compositors advertise, used until repeat_info arrives.
+#define KEEBIE_KEY_REPEAT_DEFAULT_RATE 25
+#define KEEBIE_KEY_REPEAT_DEFAULT_DELAY 600
+
+struct _KeebieKeyRepeat {
+  KeebieKeyRepeatFunc func;
+  gpointer data;
+
+  int fd;
+  GSource* source;
+  gboolean is_active;
+
+  int32_t rate;
+  int32_t delay;
+};
+
+static struct timespec keebie_key_repeat_timespec(int64_t nsec) {
+  struct timespec ts;
+  ts.tv_sec = nsec / G_GINT64_CONSTANT(1000000000);
+  ts.tv_nsec = nsec % G_GINT64_CONSTANT(1000000000);
+  return ts;
+}
+
+static gboolean keebie_key_repeat_dispatch(gint fd, GIOCondition condition, gpointer data) {
+  KeebieKeyRepeat* self = reinterpret_cast<KeebieKeyRepeat*>(data);
+
+  uint64_t expirations = 0;
+  if (read(fd, &expirations, sizeof (expirations)) != sizeof (expirations)) {
+    if (errno != EAGAIN) {
+      g_warning("Failed to read the key repeat timer: %s", g_strerror(errno));
+    }
+    return G_SOURCE_CONTINUE;
+  }
+
+  if (self->is_active && expirations > 0) {
+    // A stall of more than a second is a hang, not something to catch up on.
+    self->func(MIN(expirations, (uint64_t)self->rate), self->data);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+KeebieKeyRepeat* keebie_key_repeat_new(GMainContext* context, KeebieKeyRepeatFunc func, gpointer data) {
+  KeebieKeyRepeat* self = g_new0(KeebieKeyRepeat, 1);
+  self->func = func;
+  self->data = data;
+  self->rate = KEEBIE_KEY_REPEAT_DEFAULT_RATE;
+  self->delay = KEEBIE_KEY_REPEAT_DEFAULT_DELAY;
+
+  self->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (self->fd < 0) {
+    g_warning("Failed to create the key repeat timer: %s", g_strerror(errno));
+  } else {
+    self->source = g_unix_fd_source_new(self->fd, G_IO_IN);
+    g_source_set_callback(self->source, reinterpret_cast<GSourceFunc>(reinterpret_cast<void(*)()>(keebie_key_repeat_dispatch)), self, nullptr);
+    g_source_attach(self->source, context);
+  }
+  return self;
+}
+
+void keebie_key_repeat_free(KeebieKeyRepeat* self) {
+  if (self->source != nullptr) {
+    g_source_destroy(self->source);
+    g_source_unref(self->source);
+  }
+
+  if (self->fd >= 0) {
+    close(self->fd);
+  }
+  g_free(self);
+}
+
+void keebie_key_repeat_set_info(KeebieKeyRepeat* self, int32_t rate, int32_t delay) {
+  self->rate = MAX(rate, 0);
+  self->delay = MAX(delay, 0);
+
+  if (self->rate == 0) {
+    keebie_key_repeat_stop(self);
+  }
+}
+
+gboolean keebie_key_repeat_start(KeebieKeyRepeat* self) {
+  if (self->fd < 0 || self->rate == 0) {
+    return FALSE;
+  }
+
+  // A zero it_value disarms the timer, so an immediate start gets 1ns.
+  struct itimerspec spec;
+  spec.it_value = keebie_key_repeat_timespec(MAX((int64_t)self->delay * 1000000, 1));
+  spec.it_interval = keebie_key_repeat_timespec(G_GINT64_CONSTANT(1000000000) / self->rate);
+
+  if (timerfd_settime(self->fd, 0, &spec, nullptr) < 0) {
+    g_warning("Failed to arm the key repeat timer: %s", g_strerror(errno));
+    return FALSE;
+  }
+
+  self->is_active = TRUE;
+  return TRUE;
+}
+
+void keebie_key_repeat_stop(KeebieKeyRepeat* self) {
+  self->is_active = FALSE;
+
+  if (self->fd >= 0) {
+    struct itimerspec spec = {};
+    timerfd_settime(self->fd, 0, &spec, nullptr);
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Called with the number of repeats due since the last call, more than one
+ * when the main loop was held up so a busy UI never makes a held key slower.
+ */
+typedef void (*KeebieKeyRepeatFunc)(guint count, gpointer data);
+
+/**
+ * Schedules repeats of a held key on a CLOCK_MONOTONIC timerfd, the period
+ * is kept by the kernel so repeats never drift with main loop latency.
+ */
+typedef struct _KeebieKeyRepeat KeebieKeyRepeat;
+
+/**
+ * The timer is serviced by the given context, nullptr for the default one.
+ */
+KeebieKeyRepeat* keebie_key_repeat_new(GMainContext* context, KeebieKeyRepeatFunc func, gpointer data);
+void keebie_key_repeat_free(KeebieKeyRepeat* self);
+
+/**
+ * Takes the rate in repeats per second and the delay in milliseconds as sent
+ * by wl_keyboard.repeat_info, a rate of 0 disables repeating.
+ */
+void keebie_key_repeat_set_info(KeebieKeyRepeat* self, int32_t rate, int32_t delay);
+
+/**
+ * Arms the timer for a key which was just pressed, restarting the delay if
+ * another key was still repeating. Returns FALSE if repeating is disabled.
+ */
+gboolean keebie_key_repeat_start(KeebieKeyRepeat* self);
+void keebie_key_repeat_stop(KeebieKeyRepeat* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieKeyRepeat, keebie_key_repeat_free);
+
+G_END_DECLS
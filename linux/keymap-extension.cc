@@ -0,0 +1,182 @@
+#include <linux/input-event-codes.h>
+#include "keymap-extension.h"
+
+// Evdev codes past the functional keys, the last one keeps the XKB keycode
+// within what X11 clients can address.
+#define KEEBIE_KEYMAP_EXTENSION_FIRST_SLOT 120
+#define KEEBIE_KEYMAP_EXTENSION_N_SLOTS 128
+
+typedef struct {
+  uint32_t keycode;
+  xkb_keysym_t keysym;
+} KeebieFixedKey;
+
+static const KeebieFixedKey keebie_keymap_extension_fixed_keys[] = {
+  { KEY_ESC, XKB_KEY_Escape },
+  { KEY_BACKSPACE, XKB_KEY_BackSpace },
+  { KEY_TAB, XKB_KEY_Tab },
+  { KEY_ENTER, XKB_KEY_Return },
+  { KEY_LEFTCTRL, XKB_KEY_Control_L },
+  { KEY_LEFTSHIFT, XKB_KEY_Shift_L },
+  { KEY_LEFTALT, XKB_KEY_Alt_L },
+  { KEY_SPACE, XKB_KEY_space },
+  { KEY_HOME, XKB_KEY_Home },
+  { KEY_UP, XKB_KEY_Up },
+  { KEY_PAGEUP, XKB_KEY_Prior },
+  { KEY_LEFT, XKB_KEY_Left },
+  { KEY_RIGHT, XKB_KEY_Right },
+  { KEY_END, XKB_KEY_End },
+  { KEY_DOWN, XKB_KEY_Down },
+  { KEY_PAGEDOWN, XKB_KEY_Next },
+  { KEY_INSERT, XKB_KEY_Insert },
+  { KEY_DELETE, XKB_KEY_Delete },
+};
+
+typedef struct {
+  xkb_keysym_t keysym;
+  uint64_t last_used;
+} KeebieKeymapSlot;
+
+struct _KeebieKeymapExtension {
+  KeebieKeymapSlot slots[KEEBIE_KEYMAP_EXTENSION_N_SLOTS];
+  GHashTable* slot_by_keysym;
+  uint64_t batch;
+
+  gboolean is_dirty;
+  KeebieKeymap* keymap;
+};
+
+KeebieKeymapExtension* keebie_keymap_extension_new() {
+  KeebieKeymapExtension* self = g_new0(KeebieKeymapExtension, 1);
+  self->slot_by_keysym = g_hash_table_new(g_direct_hash, g_direct_equal);
+  self->is_dirty = TRUE;
+  return self;
+}
+
+void keebie_keymap_extension_free(KeebieKeymapExtension* self) {
+  g_hash_table_unref(self->slot_by_keysym);
+  g_clear_pointer(&self->keymap, keebie_keymap_unref);
+  g_free(self);
+}
+
+static gint keebie_keymap_extension_find_fixed(xkb_keysym_t keysym) {
+  for (size_t i = 0; i < G_N_ELEMENTS(keebie_keymap_extension_fixed_keys); i++) {
+    if (keebie_keymap_extension_fixed_keys[i].keysym == keysym) {
+      return keebie_keymap_extension_fixed_keys[i].keycode;
+    }
+  }
+  return -1;
+}
+
+static gint keebie_keymap_extension_acquire_slot(KeebieKeymapExtension* self) {
+  gint lru = -1;
+  for (gint i = 0; i < KEEBIE_KEYMAP_EXTENSION_N_SLOTS; i++) {
+    KeebieKeymapSlot* slot = &self->slots[i];
+    if (slot->keysym == XKB_KEY_NoSymbol) {
+      return i;
+    }
+
+    // Slots this batch already handed out have to stay put until it is typed.
+    if (slot->last_used < self->batch && (lru < 0 || slot->last_used < self->slots[lru].last_used)) {
+      lru = i;
+    }
+  }
+  return lru;
+}
+
+gsize keebie_keymap_extension_map(KeebieKeymapExtension* self, const xkb_keysym_t* keysyms, gsize n_keysyms, uint32_t* keycodes) {
+  self->batch++;
+
+  for (gsize i = 0; i < n_keysyms; i++) {
+    gint fixed = keebie_keymap_extension_find_fixed(keysyms[i]);
+    if (fixed >= 0) {
+      keycodes[i] = fixed;
+      continue;
+    }
+
+    gpointer value = nullptr;
+    gint index;
+    if (g_hash_table_lookup_extended(self->slot_by_keysym, GUINT_TO_POINTER(keysyms[i]), nullptr, &value)) {
+      index = GPOINTER_TO_INT(value);
+    } else {
+      index = keebie_keymap_extension_acquire_slot(self);
+      if (index < 0) {
+        return i;
+      }
+
+      KeebieKeymapSlot* slot = &self->slots[index];
+      if (slot->keysym != XKB_KEY_NoSymbol) {
+        g_hash_table_remove(self->slot_by_keysym, GUINT_TO_POINTER(slot->keysym));
+      }
+
+      slot->keysym = keysyms[i];
+      g_hash_table_insert(self->slot_by_keysym, GUINT_TO_POINTER(slot->keysym), GINT_TO_POINTER(index));
+      self->is_dirty = TRUE;
+    }
+
+    self->slots[index].last_used = self->batch;
+    keycodes[i] = KEEBIE_KEYMAP_EXTENSION_FIRST_SLOT + index;
+  }
+  return n_keysyms;
+}
+
+static void keebie_keymap_extension_append_key(GString* keycodes, GString* symbols, uint32_t keycode, xkb_keysym_t keysym) {
+  char name[64];
+  if (xkb_keysym_get_name(keysym, name, sizeof (name)) < 0) {
+    return;
+  }
+
+  // XKB keycodes are evdev codes offset by 8.
+  g_string_append_printf(keycodes, "    <I%u> = %u;\n", keycode + 8, keycode + 8);
+  g_string_append_printf(symbols, "    key <I%u> { [ %s ] };\n", keycode + 8, name);
+}
+
+KeebieKeymap* keebie_keymap_extension_get_keymap(KeebieKeymapExtension* self) {
+  if (!self->is_dirty && self->keymap != nullptr) {
+    return self->keymap;
+  }
+
+  g_autoptr(GString) keycodes = g_string_new(nullptr);
+  g_autoptr(GString) symbols = g_string_new(nullptr);
+
+  for (size_t i = 0; i < G_N_ELEMENTS(keebie_keymap_extension_fixed_keys); i++) {
+    const KeebieFixedKey* key = &keebie_keymap_extension_fixed_keys[i];
+    keebie_keymap_extension_append_key(keycodes, symbols, key->keycode, key->keysym);
+  }
+
+  for (guint i = 0; i < KEEBIE_KEYMAP_EXTENSION_N_SLOTS; i++) {
+    if (self->slots[i].keysym != XKB_KEY_NoSymbol) {
+      keebie_keymap_extension_append_key(keycodes, symbols, KEEBIE_KEYMAP_EXTENSION_FIRST_SLOT + i, self->slots[i].keysym);
+    }
+  }
+
+  g_autofree gchar* str = g_strdup_printf(
+    "xkb_keymap {\n"
+    "  xkb_keycodes \"keebie\" {\n"
+    "    minimum = 8;\n"
+    "    maximum = 255;\n"
+    "%s"
+    "  };\n"
+    "  xkb_types \"keebie\" { include \"complete\" };\n"
+    "  xkb_compat \"keebie\" { include \"complete\" };\n"
+    "  xkb_symbols \"keebie\" {\n"
+    "%s"
+    "    modifier_map Shift { <I%u> };\n"
+    "    modifier_map Control { <I%u> };\n"
+    "    modifier_map Mod1 { <I%u> };\n"
+    "  };\n"
+    "};\n",
+    keycodes->str,
+    symbols->str,
+    KEY_LEFTSHIFT + 8,
+    KEY_LEFTCTRL + 8,
+    KEY_LEFTALT + 8);
+
+  KeebieKeymap* keymap = keebie_keymap_new_from_string(str, strlen(str));
+  if (keymap != nullptr) {
+    g_clear_pointer(&self->keymap, keebie_keymap_unref);
+    self->keymap = keymap;
+    self->is_dirty = FALSE;
+  }
+  return self->keymap;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+#include <xkbcommon/xkbcommon.h>
+#include "keymap.h"
+
+G_BEGIN_DECLS
+
+/**
+ * A generated keymap which gives any keysym a key of its own, so text can be
+ * typed over zwp_virtual_keyboard_v1 without input-method-v2. Functional keys
+ * keep their evdev codes, everything else is assigned to one of the spare
+ * slots on demand and the least recently used slot is recycled.
+ */
+typedef struct _KeebieKeymapExtension KeebieKeymapExtension;
+
+KeebieKeymapExtension* keebie_keymap_extension_new();
+void keebie_keymap_extension_free(KeebieKeymapExtension* self);
+
+/**
+ * Resolves the keysyms to evdev keycodes in one batch, assigning slots where
+ * needed. Slots used within the batch are never recycled by it, so it stops
+ * early once every slot is taken; returns how many keysyms were resolved.
+ */
+gsize keebie_keymap_extension_map(KeebieKeymapExtension* self, const xkb_keysym_t* keysyms, gsize n_keysyms, uint32_t* keycodes);
+
+/**
+ * Returns the keymap as of the last batch, only regenerated when a slot
+ * changed since it was last asked for.
+ */
+KeebieKeymap* keebie_keymap_extension_get_keymap(KeebieKeymapExtension* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieKeymapExtension, keebie_keymap_extension_free);
+
+G_END_DECLS
@@ -0,0 +1,142 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include "keymap.h"
+#include "utils.h"
+
+static uint64_t keebie_keymap_hash(const guchar* data, gsize length) {
+  // FNV-1a, keymaps are tens of kilobytes and hashed once.
+  uint64_t hash = 14695981039346656037ull;
+  for (gsize i = 0; i < length; i++) {
+    hash = (hash ^ data[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+static const char* keebie_keymap_resolve_name(const char* value, const char* env) {
+  // Mirrors how xkbcommon fills in names which were left out.
+  if (value != nullptr && value[0] != '\0') {
+    return value;
+  }
+
+  const char* fallback = g_getenv(env);
+  return fallback != nullptr ? fallback : "";
+}
+
+static gchar* keebie_keymap_get_cache_path(struct xkb_context* context, const struct xkb_rule_names* names) {
+  const char* parts[] = {
+    XKBCOMMON_VERSION,
+    keebie_keymap_resolve_name(names->rules, "XKB_DEFAULT_RULES"),
+    keebie_keymap_resolve_name(names->model, "XKB_DEFAULT_MODEL"),
+    keebie_keymap_resolve_name(names->layout, "XKB_DEFAULT_LAYOUT"),
+    keebie_keymap_resolve_name(names->variant, "XKB_DEFAULT_VARIANT"),
+    keebie_keymap_resolve_name(names->options, "XKB_DEFAULT_OPTIONS"),
+  };
+
+  g_autoptr(GChecksum) checksum = g_checksum_new(G_CHECKSUM_SHA256);
+  for (size_t i = 0; i < G_N_ELEMENTS(parts); i++) {
+    g_checksum_update(checksum, reinterpret_cast<const guchar*>(parts[i]), strlen(parts[i]) + 1);
+  }
+
+  // xkeyboard-config is usually updated in place, so the include paths stay
+  // the same. Its rules file is rewritten on every update though, hash when
+  // and how it was last written along with each path.
+  const char* rules = parts[1][0] != '\0' ? parts[1] : "evdev";
+  for (unsigned int i = 0; i < xkb_context_num_include_paths(context); i++) {
+    const char* path = xkb_context_include_path_get(context, i);
+    g_checksum_update(checksum, reinterpret_cast<const guchar*>(path), strlen(path) + 1);
+
+    g_autofree gchar* rules_path = g_build_filename(path, "rules", rules, nullptr);
+    GStatBuf st = {};
+    if (g_stat(rules_path, &st) == 0) {
+      int64_t stamp[] = { static_cast<int64_t>(st.st_mtime), static_cast<int64_t>(st.st_size) };
+      g_checksum_update(checksum, reinterpret_cast<const guchar*>(stamp), sizeof (stamp));
+    }
+  }
+
+  g_autofree gchar* basename = g_strconcat(g_checksum_get_string(checksum), ".xkb", nullptr);
+  return g_build_filename(g_get_user_cache_dir(), "keebie", "keymaps", basename, nullptr);
+}
+
+KeebieKeymap* keebie_keymap_new_from_fd(uint32_t format, int32_t fd, uint32_t size) {
+  KeebieKeymap* self = g_new0(KeebieKeymap, 1);
+  self->ref_count = 1;
+  self->format = format;
+  self->fd = fd;
+  self->size = size;
+
+  void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data != MAP_FAILED) {
+    self->hash = keebie_keymap_hash(reinterpret_cast<const guchar*>(data), size);
+    munmap(data, size);
+  }
+  return self;
+}
+
+KeebieKeymap* keebie_keymap_new_from_string(const char* str, gsize length) {
+  // The protocol wants the terminating NUL within size.
+  int fd = create_sealed_memfd("keebie-keymap", str, length + 1);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  KeebieKeymap* self = g_new0(KeebieKeymap, 1);
+  self->ref_count = 1;
+  self->format = XKB_KEYMAP_FORMAT_TEXT_V1;
+  self->fd = fd;
+  self->size = length + 1;
+  self->hash = keebie_keymap_hash(reinterpret_cast<const guchar*>(str), length + 1);
+  return self;
+}
+
+KeebieKeymap* keebie_keymap_new_from_names(struct xkb_context* context, const char* layout) {
+  struct xkb_rule_names names = {};
+  names.layout = layout;
+
+  g_autofree gchar* path = keebie_keymap_get_cache_path(context, &names);
+  g_autofree gchar* cached = nullptr;
+  gsize length = 0;
+  if (g_file_get_contents(path, &cached, &length, nullptr) && length > 0) {
+    return keebie_keymap_new_from_string(cached, length);
+  }
+
+  struct xkb_keymap* keymap = xkb_keymap_new_from_names(context, &names, XKB_KEYMAP_COMPILE_NO_FLAGS);
+  if (keymap == nullptr) {
+    return nullptr;
+  }
+
+  char* str = xkb_keymap_get_as_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1);
+  xkb_keymap_unref(keymap);
+  if (str == nullptr) {
+    return nullptr;
+  }
+
+  length = strlen(str);
+
+  g_autofree gchar* dir = g_path_get_dirname(path);
+  g_autoptr(GError) error = nullptr;
+  if (g_mkdir_with_parents(dir, 0700) != 0 || !g_file_set_contents(path, str, length, &error)) {
+    g_debug("Failed to cache keymap as %s: %s", path, error != nullptr ? error->message : g_strerror(errno));
+  }
+
+  KeebieKeymap* self = keebie_keymap_new_from_string(str, length);
+  free(str);
+  return self;
+}
+
+KeebieKeymap* keebie_keymap_ref(KeebieKeymap* self) {
+  g_atomic_int_inc(&self->ref_count);
+  return self;
+}
+
+void keebie_keymap_unref(KeebieKeymap* self) {
+  if (g_atomic_int_dec_and_test(&self->ref_count)) {
+    if (self->fd >= 0) {
+      close(self->fd);
+    }
+    g_free(self);
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+#include <xkbcommon/xkbcommon.h>
+
+G_BEGIN_DECLS
+
+/**
+ * A keymap ready to be handed to zwp_virtual_keyboard_v1_keymap, the fd is
+ * read-only and owned by the keymap so it can be uploaded any number of times.
+ * The hash covers the keymap's contents, equal hashes mean there is no point
+ * in uploading it again. A hash of 0 means the contents could not be read.
+ */
+typedef struct {
+  gint ref_count;
+  uint32_t format;
+  int32_t fd;
+  uint32_t size;
+  uint64_t hash;
+} KeebieKeymap;
+
+/**
+ * Takes ownership of a keymap fd as received from wl_keyboard.keymap.
+ */
+KeebieKeymap* keebie_keymap_new_from_fd(uint32_t format, int32_t fd, uint32_t size);
+
+/**
+ * Wraps a serialized text keymap in a sealed memfd.
+ */
+KeebieKeymap* keebie_keymap_new_from_string(const char* str, gsize length);
+
+/**
+ * Compiles the keymap of an XKB layout, nullptr selects the default one.
+ * Serialized keymaps are cached on disk by their RMLVO names, the XKB include
+ * paths and the xkbcommon version, so compiling only happens once.
+ */
+KeebieKeymap* keebie_keymap_new_from_names(struct xkb_context* context, const char* layout);
+
+KeebieKeymap* keebie_keymap_ref(KeebieKeymap* self);
+void keebie_keymap_unref(KeebieKeymap* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieKeymap, keebie_keymap_unref);
+
+G_END_DECLS
@@ -0,0 +1,131 @@
+#include <json-glib/json-glib.h>
+#include "layout-json.h"
+#include "layout.h"
+
+static const gchar* keebie_layout_json_get_string(JsonObject* obj, const gchar* name) {
+  JsonNode* node = json_object_get_member(obj, name);
+  if (node == nullptr || json_node_get_value_type(node) != G_TYPE_STRING) {
+    return nullptr;
+  }
+  return json_node_get_string(node);
+}
+
+static gint64 keebie_layout_json_get_int(JsonObject* obj, const gchar* name, gint64 fallback) {
+  JsonNode* node = json_object_get_member(obj, name);
+  if (node == nullptr || json_node_get_value_type(node) != G_TYPE_INT64) {
+    return fallback;
+  }
+  return json_node_get_int(node);
+}
+
+static gboolean keebie_layout_json_get_bool(JsonObject* obj, const gchar* name) {
+  JsonNode* node = json_object_get_member(obj, name);
+  if (node == nullptr || json_node_get_value_type(node) != G_TYPE_BOOLEAN) {
+    return FALSE;
+  }
+  return json_node_get_boolean(node);
+}
+
+static JsonArray* keebie_layout_json_get_array(JsonNode* node) {
+  if (node == nullptr || !JSON_NODE_HOLDS_ARRAY(node)) {
+    return nullptr;
+  }
+  return json_node_get_array(node);
+}
+
+static void keebie_layout_json_add_key(KeebieLayoutBuilder* builder, JsonObject* obj) {
+  KeebieLayoutKeyInfo info = {};
+  info.type = keebie_key_type_from_string(keebie_layout_json_get_string(obj, "type"));
+  info.name = keebie_layout_json_get_string(obj, "name");
+  info.shifted_name = keebie_layout_json_get_string(obj, "shiftedName");
+  info.icon = keebie_layout_json_get_int(obj, "icon", 0);
+  info.icon_font = keebie_layout_json_get_string(obj, "iconFontFamily");
+  info.shifted_icon = keebie_layout_json_get_int(obj, "shiftedIcon", 0);
+  info.shifted_icon_font = keebie_layout_json_get_string(obj, "shiftedIconFontFamily");
+  info.plane = keebie_layout_json_get_int(obj, "plane", -1);
+
+  if (info.shifted_icon_font == nullptr) {
+    info.shifted_icon_font = info.icon_font;
+  }
+
+  if (keebie_layout_json_get_bool(obj, "expands")) info.flags |= KEEBIE_KEY_FLAG_EXPANDS;
+  if (keebie_layout_json_get_bool(obj, "secondaryColors")) info.flags |= KEEBIE_KEY_FLAG_SECONDARY_COLORS;
+
+  JsonArray* constraints = keebie_layout_json_get_array(json_object_get_member(obj, "constraints"));
+  if (constraints != nullptr) {
+    for (guint i = 0; i < json_array_get_length(constraints); i++) {
+      JsonNode* constraint = json_array_get_element(constraints, i);
+      if (json_node_get_value_type(constraint) == G_TYPE_STRING) {
+        info.constraints |= keebie_key_constraint_from_string(json_node_get_string(constraint));
+      }
+    }
+  }
+
+  keebie_layout_builder_add_key(builder, &info);
+}
+
+GBytes* keebie_layout_compile_json(const gchar* data, gssize length, GError** error) {
+  g_autoptr(JsonParser) parser = json_parser_new_immutable();
+  if (!json_parser_load_from_data(parser, data, length, error)) {
+    return nullptr;
+  }
+
+  JsonNode* root = json_parser_get_root(parser);
+  if (root == nullptr || !JSON_NODE_HOLDS_OBJECT(root)) {
+    g_set_error(error, JSON_PARSER_ERROR, JSON_PARSER_ERROR_INVALID_DATA, "Layout must be an object");
+    return nullptr;
+  }
+
+  JsonObject* obj = json_node_get_object(root);
+  JsonArray* planes = keebie_layout_json_get_array(json_object_get_member(obj, "planes"));
+  if (planes == nullptr || json_array_get_length(planes) == 0) {
+    g_set_error(error, JSON_PARSER_ERROR, JSON_PARSER_ERROR_INVALID_DATA, "Layout does not contain any planes");
+    return nullptr;
+  }
+
+  g_autoptr(KeebieLayoutBuilder) builder = keebie_layout_builder_new(keebie_layout_json_get_string(obj, "locale"));
+
+  JsonNode* content_plane_map = json_object_get_member(obj, "contentPlaneMap");
+  if (content_plane_map != nullptr && JSON_NODE_HOLDS_OBJECT(content_plane_map)) {
+    JsonObject* map = json_node_get_object(content_plane_map);
+    g_autoptr(GList) members = json_object_get_members(map);
+
+    for (GList* item = members; item != nullptr; item = item->next) {
+      const gchar* name = reinterpret_cast<const gchar*>(item->data);
+      int type = keebie_content_type_from_string(name);
+      if (type >= 0) {
+        keebie_layout_builder_set_content_plane(builder, (KeebieContentType)type, keebie_layout_json_get_int(map, name, -1));
+      }
+    }
+  }
+
+  for (guint i = 0; i < json_array_get_length(planes); i++) {
+    // A plane is either its rows of keys, or an object with a type and rows.
+    JsonNode* plane = json_array_get_element(planes, i);
+    JsonArray* rows = keebie_layout_json_get_array(plane);
+    KeebiePlaneType type = KEEBIE_PLANE_TYPE_KEYS;
+    if (JSON_NODE_HOLDS_OBJECT(plane)) {
+      JsonObject* plane_obj = json_node_get_object(plane);
+      type = keebie_plane_type_from_string(keebie_layout_json_get_string(plane_obj, "type"));
+      rows = keebie_layout_json_get_array(json_object_get_member(plane_obj, "rows"));
+    }
+
+    keebie_layout_builder_add_plane(builder, type);
+    if (rows == nullptr) continue;
+
+    for (guint x = 0; x < json_array_get_length(rows); x++) {
+      keebie_layout_builder_add_row(builder);
+
+      JsonArray* keys = keebie_layout_json_get_array(json_array_get_element(rows, x));
+      if (keys == nullptr) continue;
+
+      for (guint y = 0; y < json_array_get_length(keys); y++) {
+        JsonNode* key = json_array_get_element(keys, y);
+        if (JSON_NODE_HOLDS_OBJECT(key)) {
+          keebie_layout_json_add_key(builder, json_node_get_object(key));
+        }
+      }
+    }
+  }
+  return keebie_layout_builder_end(builder);
+}
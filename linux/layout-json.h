@@ -0,0 +1,14 @@
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Compiles a layout in the schema of assets/keyboards into the blob
+ * described in layout.h. Used by keebie-layout-compiler at build time and by
+ * the runner for layouts which are only available as JSON.
+ */
+GBytes* keebie_layout_compile_json(const gchar* data, gssize length, GError** error);
+
+G_END_DECLS
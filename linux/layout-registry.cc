@@ -0,0 +1,356 @@
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include "layout-json.h"
+#include "layout-registry.h"
+
+/**
+ * Where layouts are looked up, copied for every reload so the worker never
+ * touches the registry itself.
+ */
+typedef struct {
+  gchar* bundle_dir;
+  gchar* cache_dir;
+  gchar** source_dirs;
+} KeebieLayoutSources;
+
+struct _KeebieLayoutRegistry {
+  GMutex lock;
+  KeebieLayoutSources sources;
+
+  GHashTable* layouts;
+  GHashTable* generations;
+
+  GPtrArray* monitors;
+  GCancellable* cancellable;
+  KeebieLayoutRegistryChangedFunc changed_func;
+  gpointer changed_data;
+};
+
+typedef struct {
+  KeebieLayoutSources sources;
+  gchar* name;
+  guint generation;
+} KeebieLayoutReload;
+
+static void keebie_layout_reload_free(KeebieLayoutReload* self) {
+  g_free(self->sources.bundle_dir);
+  g_free(self->sources.cache_dir);
+  g_strfreev(self->sources.source_dirs);
+  g_free(self->name);
+  g_free(self);
+}
+
+gchar* keebie_layout_registry_get_bundle_dir() {
+  g_autofree gchar* exe = g_file_read_link("/proc/self/exe", nullptr);
+  if (exe == nullptr) {
+    return nullptr;
+  }
+
+  g_autofree gchar* dir = g_path_get_dirname(exe);
+  return g_build_filename(dir, "data", "keyboards", nullptr);
+}
+
+gchar** keebie_layout_registry_get_source_dirs() {
+  const gchar* const* system_dirs = g_get_system_data_dirs();
+  GPtrArray* dirs = g_ptr_array_new();
+
+  g_ptr_array_add(dirs, g_build_filename(g_get_user_data_dir(), "keebie", "keyboards", nullptr));
+  for (size_t i = 0; system_dirs[i] != nullptr; i++) {
+    g_ptr_array_add(dirs, g_build_filename(system_dirs[i], "keebie", "keyboards", nullptr));
+  }
+
+  g_ptr_array_add(dirs, nullptr);
+  return reinterpret_cast<gchar**>(g_ptr_array_free(dirs, FALSE));
+}
+
+gchar* keebie_layout_registry_get_cache_dir() {
+  return g_build_filename(g_get_user_cache_dir(), "keebie", "layouts", nullptr);
+}
+
+KeebieLayoutRegistry* keebie_layout_registry_new(const gchar* bundle_dir, const gchar* cache_dir, const gchar* const* source_dirs) {
+  KeebieLayoutRegistry* self = g_new0(KeebieLayoutRegistry, 1);
+  g_mutex_init(&self->lock);
+  self->sources.bundle_dir = g_strdup(bundle_dir);
+  self->sources.cache_dir = g_strdup(cache_dir);
+  self->sources.source_dirs = g_strdupv(const_cast<gchar**>(source_dirs));
+  self->layouts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)keebie_layout_unref);
+  self->generations = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, nullptr);
+  self->monitors = g_ptr_array_new_with_free_func(g_object_unref);
+  self->cancellable = g_cancellable_new();
+  return self;
+}
+
+void keebie_layout_registry_free(KeebieLayoutRegistry* self) {
+  // Reloads still in flight see this and drop their result.
+  g_cancellable_cancel(self->cancellable);
+
+  for (guint i = 0; i < self->monitors->len; i++) {
+    g_signal_handlers_disconnect_by_data(g_ptr_array_index(self->monitors, i), self);
+  }
+
+  g_ptr_array_unref(self->monitors);
+  g_object_unref(self->cancellable);
+  g_hash_table_unref(self->layouts);
+  g_hash_table_unref(self->generations);
+  g_strfreev(self->sources.source_dirs);
+  g_free(self->sources.bundle_dir);
+  g_free(self->sources.cache_dir);
+  g_mutex_clear(&self->lock);
+  g_free(self);
+}
+
+// Whether a cache entry is <sha256>.kbl, what follows the name in <name>-<sha256>.kbl.
+static gboolean keebie_layout_cache_is_hash(const gchar* basename) {
+  for (gsize i = 0; i < 64; i++) {
+    if (!g_ascii_isxdigit(basename[i])) {
+      return FALSE;
+    }
+  }
+  return strcmp(basename + 64, ".kbl") == 0;
+}
+
+// Removes what earlier sources of the layout were cached as, once its current
+// source is, and entries from before the cache was keyed by name. The cache
+// then holds at most one blob per layout however often it is edited.
+static void keebie_layout_sources_prune_cache(const KeebieLayoutSources* self, const gchar* name, const gchar* current) {
+  g_autoptr(GDir) dir = g_dir_open(self->cache_dir, 0, nullptr);
+  if (dir == nullptr) {
+    return;
+  }
+
+  gsize name_length = strlen(name);
+  const gchar* entry;
+  while ((entry = g_dir_read_name(dir)) != nullptr) {
+    gboolean is_stale = keebie_layout_cache_is_hash(entry)
+      || (strncmp(entry, name, name_length) == 0 && entry[name_length] == '-' && keebie_layout_cache_is_hash(entry + name_length + 1));
+    if (is_stale && strcmp(entry, current) != 0) {
+      g_autofree gchar* path = g_build_filename(self->cache_dir, entry, nullptr);
+      g_unlink(path);
+    }
+  }
+}
+
+static KeebieLayout* keebie_layout_sources_compile_cached(const KeebieLayoutSources* self, const gchar* name, const gchar* data, gsize length, GError** error) {
+  // The format version is part of the key so a format bump never maps a stale blob.
+  uint32_t version = KEEBIE_LAYOUT_VERSION;
+  g_autoptr(GChecksum) checksum = g_checksum_new(G_CHECKSUM_SHA256);
+  g_checksum_update(checksum, reinterpret_cast<const guchar*>(&version), sizeof (version));
+  g_checksum_update(checksum, reinterpret_cast<const guchar*>(data), length);
+
+  g_autofree gchar* basename = g_strconcat(name, "-", g_checksum_get_string(checksum), ".kbl", nullptr);
+  g_autofree gchar* path = self->cache_dir != nullptr ? g_build_filename(self->cache_dir, basename, nullptr) : nullptr;
+
+  if (path != nullptr) {
+    KeebieLayout* layout = keebie_layout_new_from_file(path, nullptr);
+    if (layout != nullptr) {
+      return layout;
+    }
+  }
+
+  g_autoptr(GBytes) bytes = keebie_layout_compile_json(data, length, error);
+  if (bytes == nullptr) {
+    return nullptr;
+  }
+
+  if (path != nullptr && g_mkdir_with_parents(self->cache_dir, 0700) == 0) {
+    gsize size = 0;
+    const gchar* blob = reinterpret_cast<const gchar*>(g_bytes_get_data(bytes, &size));
+
+    g_autoptr(GError) cache_error = nullptr;
+    if (g_file_set_contents(path, blob, size, &cache_error)) {
+      keebie_layout_sources_prune_cache(self, name, basename);
+
+      // Map what was just written so the heap copy can go away.
+      KeebieLayout* layout = keebie_layout_new_from_file(path, nullptr);
+      if (layout != nullptr) {
+        return layout;
+      }
+    } else {
+      g_debug("Failed to cache layout as %s: %s", path, cache_error->message);
+    }
+  }
+  return keebie_layout_new_from_bytes(bytes, error);
+}
+
+static KeebieLayout* keebie_layout_sources_load(const KeebieLayoutSources* self, const gchar* name, GError** error) {
+  if (strchr(name, G_DIR_SEPARATOR) != nullptr || strlen(name) == 0) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "No layout named \"%s\"", name);
+    return nullptr;
+  }
+
+  g_autofree gchar* source_basename = g_strconcat(name, ".json", nullptr);
+  for (size_t i = 0; self->source_dirs != nullptr && self->source_dirs[i] != nullptr; i++) {
+    g_autofree gchar* path = g_build_filename(self->source_dirs[i], source_basename, nullptr);
+    g_autofree gchar* data = nullptr;
+    gsize length = 0;
+
+    g_autoptr(GError) read_error = nullptr;
+    if (!g_file_get_contents(path, &data, &length, &read_error)) {
+      if (g_error_matches(read_error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) continue;
+
+      g_propagate_error(error, g_steal_pointer(&read_error));
+      return nullptr;
+    }
+
+    KeebieLayout* layout = keebie_layout_sources_compile_cached(self, name, data, length, error);
+    if (layout == nullptr) {
+      g_prefix_error(error, "%s: ", path);
+    }
+    return layout;
+  }
+
+  if (self->bundle_dir == nullptr) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "No layout named \"%s\"", name);
+    return nullptr;
+  }
+
+  g_autofree gchar* basename = g_strconcat(name, ".kbl", nullptr);
+  g_autofree gchar* path = g_build_filename(self->bundle_dir, basename, nullptr);
+  return keebie_layout_new_from_file(path, error);
+}
+
+KeebieLayout* keebie_layout_registry_get(KeebieLayoutRegistry* self, const gchar* name, GError** error) {
+  {
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+    KeebieLayout* layout = reinterpret_cast<KeebieLayout*>(g_hash_table_lookup(self->layouts, name));
+    if (layout != nullptr) {
+      return keebie_layout_ref(layout);
+    }
+  }
+
+  // Loaded without the lock held, whoever inserts first wins.
+  KeebieLayout* layout = keebie_layout_sources_load(&self->sources, name, error);
+  if (layout == nullptr) {
+    return nullptr;
+  }
+
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+  KeebieLayout* existing = reinterpret_cast<KeebieLayout*>(g_hash_table_lookup(self->layouts, name));
+  if (existing != nullptr) {
+    keebie_layout_unref(layout);
+    return keebie_layout_ref(existing);
+  }
+
+  g_hash_table_insert(self->layouts, g_strdup(name), keebie_layout_ref(layout));
+  return layout;
+}
+
+static void keebie_layout_registry_reload_thread(GTask* task, gpointer source_object, gpointer task_data, GCancellable* cancellable) {
+  KeebieLayoutReload* reload = reinterpret_cast<KeebieLayoutReload*>(task_data);
+
+  GError* error = nullptr;
+  KeebieLayout* layout = keebie_layout_sources_load(&reload->sources, reload->name, &error);
+  if (layout == nullptr) {
+    g_task_return_error(task, error);
+    return;
+  }
+  g_task_return_pointer(task, layout, (GDestroyNotify)keebie_layout_unref);
+}
+
+static void keebie_layout_registry_reload_cb(GObject* source_object, GAsyncResult* result, gpointer user_data) {
+  GTask* task = G_TASK(result);
+  KeebieLayoutReload* reload = reinterpret_cast<KeebieLayoutReload*>(g_task_get_task_data(task));
+
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(KeebieLayout) layout = reinterpret_cast<KeebieLayout*>(g_task_propagate_pointer(task, &error));
+
+  // The registry is gone once the reload was cancelled.
+  if (g_cancellable_is_cancelled(g_task_get_cancellable(task))) {
+    return;
+  }
+
+  KeebieLayoutRegistry* self = reinterpret_cast<KeebieLayoutRegistry*>(user_data);
+  {
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+
+    // A newer change to the same layout is already being compiled.
+    if (GPOINTER_TO_UINT(g_hash_table_lookup(self->generations, reload->name)) != reload->generation) {
+      return;
+    }
+
+    if (layout == nullptr) {
+      // Keep serving the last good layout rather than breaking the keyboard.
+      g_warning("Failed to reload layout %s: %s", reload->name, error->message);
+      return;
+    }
+
+    g_hash_table_insert(self->layouts, g_strdup(reload->name), keebie_layout_ref(layout));
+  }
+
+  if (self->changed_func != nullptr) {
+    self->changed_func(reload->name, layout, self->changed_data);
+  }
+}
+
+static void keebie_layout_registry_changed_cb(GFileMonitor* monitor, GFile* file, GFile* other_file, GFileMonitorEvent event_type, gpointer user_data) {
+  KeebieLayoutRegistry* self = reinterpret_cast<KeebieLayoutRegistry*>(user_data);
+
+  switch (event_type) {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+    case G_FILE_MONITOR_EVENT_MOVED_OUT:
+      break;
+    case G_FILE_MONITOR_EVENT_RENAMED:
+      // Editors save by renaming a temporary file over the layout.
+      file = other_file;
+      break;
+    default:
+      return;
+  }
+
+  if (file == nullptr) {
+    return;
+  }
+
+  g_autofree gchar* basename = g_file_get_basename(file);
+  if (basename == nullptr || !g_str_has_suffix(basename, ".json")) {
+    return;
+  }
+
+  g_autofree gchar* name = g_strndup(basename, strlen(basename) - strlen(".json"));
+
+  KeebieLayoutReload* reload = g_new0(KeebieLayoutReload, 1);
+  {
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+
+    // Layouts nobody asked for yet are compiled when they are first used.
+    if (!g_hash_table_contains(self->layouts, name)) {
+      g_free(reload);
+      return;
+    }
+
+    reload->generation = GPOINTER_TO_UINT(g_hash_table_lookup(self->generations, name)) + 1;
+    g_hash_table_insert(self->generations, g_strdup(name), GUINT_TO_POINTER(reload->generation));
+  }
+
+  reload->name = g_steal_pointer(&name);
+  reload->sources.bundle_dir = g_strdup(self->sources.bundle_dir);
+  reload->sources.cache_dir = g_strdup(self->sources.cache_dir);
+  reload->sources.source_dirs = g_strdupv(self->sources.source_dirs);
+
+  g_autoptr(GTask) task = g_task_new(nullptr, self->cancellable, keebie_layout_registry_reload_cb, self);
+  g_task_set_task_data(task, reload, (GDestroyNotify)keebie_layout_reload_free);
+  g_task_run_in_thread(task, keebie_layout_registry_reload_thread);
+}
+
+void keebie_layout_registry_watch(KeebieLayoutRegistry* self, KeebieLayoutRegistryChangedFunc func, gpointer user_data) {
+  self->changed_func = func;
+  self->changed_data = user_data;
+
+  for (size_t i = 0; self->sources.source_dirs != nullptr && self->sources.source_dirs[i] != nullptr; i++) {
+    g_autoptr(GFile) dir = g_file_new_for_path(self->sources.source_dirs[i]);
+    g_autoptr(GError) error = nullptr;
+
+    GFileMonitor* monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_WATCH_MOVES, nullptr, &error);
+    if (monitor == nullptr) {
+      g_debug("Not watching %s for layouts: %s", self->sources.source_dirs[i], error->message);
+      continue;
+    }
+
+    g_signal_connect(monitor, "changed", G_CALLBACK(keebie_layout_registry_changed_cb), self);
+    g_ptr_array_add(self->monitors, monitor);
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glib.h>
+#include "layout.h"
+
+G_BEGIN_DECLS
+
+typedef struct _KeebieLayoutRegistry KeebieLayoutRegistry;
+
+/**
+ * Called on the main context once a layout which was already loaded has been
+ * recompiled because its source changed on disk.
+ */
+typedef void (*KeebieLayoutRegistryChangedFunc)(const gchar* name, KeebieLayout* layout, gpointer user_data);
+
+/**
+ * The directory keebie-layout-compiler's output is installed to within the
+ * bundle, next to flutter_assets.
+ */
+gchar* keebie_layout_registry_get_bundle_dir();
+
+/**
+ * $XDG_DATA_HOME/keebie/keyboards followed by the same path in every
+ * $XDG_DATA_DIRS entry, in the order they take precedence.
+ */
+gchar** keebie_layout_registry_get_source_dirs();
+
+/**
+ * Where layouts compiled from the source dirs are kept, by name and content
+ * hash. Only the entry of a layout's current source is kept.
+ */
+gchar* keebie_layout_registry_get_cache_dir();
+
+KeebieLayoutRegistry* keebie_layout_registry_new(const gchar* bundle_dir, const gchar* cache_dir, const gchar* const* source_dirs);
+void keebie_layout_registry_free(KeebieLayoutRegistry* self);
+
+/**
+ * Starts watching the source dirs, nothing is read until a layout is asked
+ * for so this does not depend on how many layouts are installed.
+ */
+void keebie_layout_registry_watch(KeebieLayoutRegistry* self, KeebieLayoutRegistryChangedFunc func, gpointer user_data);
+
+/**
+ * Resolves <name>.json from the source dirs, falling back to <name>.kbl from
+ * the bundle. Source layouts are served from the cache when their content was
+ * compiled before. Returns a new reference or nullptr when there is no such
+ * layout.
+ */
+KeebieLayout* keebie_layout_registry_get(KeebieLayoutRegistry* self, const gchar* name, GError** error);
+
+G_END_DECLS
@@ -0,0 +1,421 @@
+#include <linux/input-event-codes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "blob.h"
+#include "layout.h"
+
+struct _KeebieLayoutBuilder {
+  int32_t content_plane_map[KEEBIE_N_CONTENT_TYPES];
+  GArray* planes;
+  GArray* rows;
+  GArray* actions;
+  GArray* keys;
+
+  GString* strings;
+  GHashTable* string_offsets;
+  uint32_t locale;
+};
+
+struct _KeebieLayout {
+  gint ref_count;
+  GBytes* bytes;
+
+  const KeebieLayoutHeader* header;
+  const KeebieLayoutPlane* planes;
+  const KeebieLayoutRow* rows;
+  const KeebieKeyAction* actions;
+  const KeebieLayoutKey* keys;
+  const char* strings;
+};
+
+static const char* keebie_key_type_names[KEEBIE_N_KEY_TYPES] = {
+  "regular",
+  "shift",
+  "enter",
+  "backspace",
+  "space",
+  "plane",
+  "changeLang",
+};
+
+static const char* keebie_plane_type_names[KEEBIE_N_PLANE_TYPES] = {
+  "keys",
+  "handwriting",
+  "emoji",
+};
+
+static const char* keebie_content_type_names[KEEBIE_N_CONTENT_TYPES] = {
+  "dateTime",
+  "number",
+  "phone",
+  "text",
+};
+
+KeebieKeyType keebie_key_type_from_string(const char* str) {
+  for (int i = 0; i < KEEBIE_N_KEY_TYPES; i++) {
+    if (g_strcmp0(keebie_key_type_names[i], str) == 0) {
+      return (KeebieKeyType)i;
+    }
+  }
+  return KEEBIE_KEY_TYPE_REGULAR;
+}
+
+KeebiePlaneType keebie_plane_type_from_string(const char* str) {
+  for (int i = 0; i < KEEBIE_N_PLANE_TYPES; i++) {
+    if (g_strcmp0(keebie_plane_type_names[i], str) == 0) {
+      return (KeebiePlaneType)i;
+    }
+  }
+  return KEEBIE_PLANE_TYPE_KEYS;
+}
+
+KeebieKeyConstraint keebie_key_constraint_from_string(const char* str) {
+  if (g_strcmp0(str, "canChangeLanguage") == 0) {
+    return KEEBIE_KEY_CONSTRAINT_CAN_CHANGE_LANGUAGE;
+  }
+  return (KeebieKeyConstraint)0;
+}
+
+int keebie_content_type_from_string(const char* str) {
+  for (int i = 0; i < KEEBIE_N_CONTENT_TYPES; i++) {
+    if (g_strcmp0(keebie_content_type_names[i], str) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static uint32_t keebie_layout_builder_intern(KeebieLayoutBuilder* self, const char* str) {
+  if (str == nullptr) {
+    str = "";
+  }
+
+  gpointer offset = nullptr;
+  if (g_hash_table_lookup_extended(self->string_offsets, str, nullptr, &offset)) {
+    return GPOINTER_TO_UINT(offset);
+  }
+
+  uint32_t value = self->strings->len;
+  g_string_append_len(self->strings, str, strlen(str) + 1);
+  g_hash_table_insert(self->string_offsets, g_strdup(str), GUINT_TO_POINTER(value));
+  return value;
+}
+
+KeebieLayoutBuilder* keebie_layout_builder_new(const char* locale) {
+  KeebieLayoutBuilder* self = g_new0(KeebieLayoutBuilder, 1);
+  self->planes = g_array_new(FALSE, TRUE, sizeof (KeebieLayoutPlane));
+  self->rows = g_array_new(FALSE, TRUE, sizeof (KeebieLayoutRow));
+  self->actions = g_array_new(FALSE, TRUE, sizeof (KeebieKeyAction));
+  self->keys = g_array_new(FALSE, TRUE, sizeof (KeebieLayoutKey));
+  self->strings = g_string_new(nullptr);
+  self->string_offsets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, nullptr);
+
+  for (int i = 0; i < KEEBIE_N_CONTENT_TYPES; i++) {
+    self->content_plane_map[i] = -1;
+  }
+
+  // Offset 0 is always the empty string
+  keebie_layout_builder_intern(self, "");
+  self->locale = keebie_layout_builder_intern(self, locale);
+  return self;
+}
+
+void keebie_layout_builder_free(KeebieLayoutBuilder* self) {
+  g_array_unref(self->planes);
+  g_array_unref(self->rows);
+  g_array_unref(self->actions);
+  g_array_unref(self->keys);
+  g_string_free(self->strings, TRUE);
+  g_hash_table_unref(self->string_offsets);
+  g_free(self);
+}
+
+void keebie_layout_builder_set_content_plane(KeebieLayoutBuilder* self, KeebieContentType type, int32_t plane) {
+  g_return_if_fail(type < KEEBIE_N_CONTENT_TYPES);
+  self->content_plane_map[type] = plane;
+}
+
+void keebie_layout_builder_add_plane(KeebieLayoutBuilder* self, KeebiePlaneType type) {
+  KeebieLayoutPlane plane = {
+    .first_row = self->rows->len,
+    .n_rows = 0,
+    .type = type,
+  };
+  g_array_append_val(self->planes, plane);
+}
+
+void keebie_layout_builder_add_row(KeebieLayoutBuilder* self) {
+  g_assert(self->planes->len > 0);
+
+  KeebieLayoutRow row = {
+    .first_key = self->actions->len,
+    .n_keys = 0,
+  };
+  g_array_append_val(self->rows, row);
+  g_array_index(self->planes, KeebieLayoutPlane, self->planes->len - 1).n_rows++;
+}
+
+void keebie_layout_builder_add_key(KeebieLayoutBuilder* self, const KeebieLayoutKeyInfo* info) {
+  g_assert(self->rows->len > 0);
+
+  KeebieKeyAction action = {};
+  action.key_type = info->type;
+  action.flags = info->flags;
+  action.constraints = info->constraints;
+
+  switch (info->type) {
+    case KEEBIE_KEY_TYPE_REGULAR:
+      action.type = KEEBIE_KEY_ACTION_COMMIT;
+      action.text = keebie_layout_builder_intern(self, info->name);
+      action.shifted_text = info->shifted_name != nullptr && strlen(info->shifted_name) > 0 ? keebie_layout_builder_intern(self, info->shifted_name) : action.text;
+      break;
+    case KEEBIE_KEY_TYPE_SPACE:
+      action.type = KEEBIE_KEY_ACTION_COMMIT;
+      action.text = action.shifted_text = keebie_layout_builder_intern(self, " ");
+      break;
+    case KEEBIE_KEY_TYPE_ENTER:
+      action.type = KEEBIE_KEY_ACTION_KEYCODE;
+      action.arg = KEY_ENTER;
+      break;
+    case KEEBIE_KEY_TYPE_BACKSPACE:
+      action.type = KEEBIE_KEY_ACTION_DELETE;
+      action.arg = 1;
+      break;
+    case KEEBIE_KEY_TYPE_SHIFT:
+      action.type = KEEBIE_KEY_ACTION_SHIFT;
+      break;
+    case KEEBIE_KEY_TYPE_PLANE:
+      action.type = info->plane >= 0 ? KEEBIE_KEY_ACTION_PLANE : KEEBIE_KEY_ACTION_NONE;
+      action.arg = info->plane;
+      break;
+    case KEEBIE_KEY_TYPE_CHANGE_LANG:
+      action.type = KEEBIE_KEY_ACTION_CHANGE_LANG;
+      break;
+    default:
+      action.type = KEEBIE_KEY_ACTION_NONE;
+      break;
+  }
+
+  KeebieLayoutKey key = {};
+  key.name = keebie_layout_builder_intern(self, info->name);
+  key.shifted_name = keebie_layout_builder_intern(self, info->shifted_name);
+  key.icon = info->icon;
+  key.icon_font = keebie_layout_builder_intern(self, info->icon_font);
+  key.shifted_icon = info->shifted_icon;
+  key.shifted_icon_font = keebie_layout_builder_intern(self, info->shifted_icon_font);
+  key.plane = info->plane;
+
+  g_array_append_val(self->actions, action);
+  g_array_append_val(self->keys, key);
+  g_array_index(self->rows, KeebieLayoutRow, self->rows->len - 1).n_keys++;
+}
+
+guint keebie_layout_builder_get_n_planes(KeebieLayoutBuilder* self) {
+  return self->planes->len;
+}
+
+static inline uint32_t keebie_layout_align(uint32_t value) {
+  return (value + 3u) & ~3u;
+}
+
+GBytes* keebie_layout_builder_end(KeebieLayoutBuilder* self) {
+  KeebieLayoutHeader header = {};
+  header.magic = KEEBIE_LAYOUT_MAGIC;
+  header.version = KEEBIE_LAYOUT_VERSION;
+  header.locale = self->locale;
+  memcpy(header.content_plane_map, self->content_plane_map, sizeof (header.content_plane_map));
+
+  header.n_planes = self->planes->len;
+  header.planes_offset = sizeof (KeebieLayoutHeader);
+  header.n_rows = self->rows->len;
+  header.rows_offset = header.planes_offset + header.n_planes * sizeof (KeebieLayoutPlane);
+  header.n_keys = self->actions->len;
+  header.actions_offset = header.rows_offset + header.n_rows * sizeof (KeebieLayoutRow);
+  header.keys_offset = header.actions_offset + header.n_keys * sizeof (KeebieKeyAction);
+  header.strings_offset = header.keys_offset + header.n_keys * sizeof (KeebieLayoutKey);
+  header.strings_size = self->strings->len;
+  header.size = keebie_layout_align(header.strings_offset + header.strings_size);
+
+  guint8* data = reinterpret_cast<guint8*>(g_malloc0(header.size));
+  memcpy(data, &header, sizeof (header));
+  memcpy(data + header.planes_offset, self->planes->data, header.n_planes * sizeof (KeebieLayoutPlane));
+  memcpy(data + header.rows_offset, self->rows->data, header.n_rows * sizeof (KeebieLayoutRow));
+  memcpy(data + header.actions_offset, self->actions->data, header.n_keys * sizeof (KeebieKeyAction));
+  memcpy(data + header.keys_offset, self->keys->data, header.n_keys * sizeof (KeebieLayoutKey));
+  memcpy(data + header.strings_offset, self->strings->str, header.strings_size);
+  return g_bytes_new_take(data, header.size);
+}
+
+static gboolean keebie_layout_validate(KeebieLayout* self, gsize size, GError** error) {
+  const KeebieLayoutHeader* header = self->header;
+
+  if (size < sizeof (KeebieLayoutHeader) || header->magic != KEEBIE_LAYOUT_MAGIC) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Not a compiled keyboard layout");
+    return FALSE;
+  }
+
+  if (header->version != KEEBIE_LAYOUT_VERSION) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Unsupported layout version %u, expected %u", header->version, KEEBIE_LAYOUT_VERSION);
+    return FALSE;
+  }
+
+  if (header->size != size
+      || !keebie_blob_section_is_valid(size, sizeof (KeebieLayoutHeader), header->planes_offset, header->n_planes, sizeof (KeebieLayoutPlane))
+      || !keebie_blob_section_is_valid(size, sizeof (KeebieLayoutHeader), header->rows_offset, header->n_rows, sizeof (KeebieLayoutRow))
+      || !keebie_blob_section_is_valid(size, sizeof (KeebieLayoutHeader), header->actions_offset, header->n_keys, sizeof (KeebieKeyAction))
+      || !keebie_blob_section_is_valid(size, sizeof (KeebieLayoutHeader), header->keys_offset, header->n_keys, sizeof (KeebieLayoutKey))
+      || !keebie_blob_section_is_valid(size, sizeof (KeebieLayoutHeader), header->strings_offset, header->strings_size, 1)
+      || header->strings_size == 0
+      || self->strings[header->strings_size - 1] != '\0'
+      || header->locale >= header->strings_size) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Compiled keyboard layout is truncated or corrupt");
+    return FALSE;
+  }
+
+  for (uint32_t i = 0; i < header->n_planes; i++) {
+    if (self->planes[i].first_row > header->n_rows || self->planes[i].n_rows > header->n_rows - self->planes[i].first_row) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Plane %u references rows out of range", i);
+      return FALSE;
+    }
+
+    if (self->planes[i].type >= KEEBIE_N_PLANE_TYPES) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Plane %u has unknown type %u", i, self->planes[i].type);
+      return FALSE;
+    }
+  }
+
+  for (uint32_t i = 0; i < header->n_rows; i++) {
+    if (self->rows[i].first_key > header->n_keys || self->rows[i].n_keys > header->n_keys - self->rows[i].first_key) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Row %u references keys out of range", i);
+      return FALSE;
+    }
+  }
+
+  for (uint32_t i = 0; i < header->n_keys; i++) {
+    const KeebieKeyAction* action = &self->actions[i];
+    const KeebieLayoutKey* key = &self->keys[i];
+
+    if (action->text >= header->strings_size || action->shifted_text >= header->strings_size
+        || key->name >= header->strings_size || key->shifted_name >= header->strings_size
+        || key->icon_font >= header->strings_size || key->shifted_icon_font >= header->strings_size) {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Key %u references strings out of range", i);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+KeebieLayout* keebie_layout_new_from_bytes(GBytes* bytes, GError** error) {
+  gsize size = 0;
+  const guint8* data = reinterpret_cast<const guint8*>(g_bytes_get_data(bytes, &size));
+
+  if (data == nullptr || size < sizeof (KeebieLayoutHeader)) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Not a compiled keyboard layout");
+    return nullptr;
+  }
+
+  KeebieLayout* self = g_new0(KeebieLayout, 1);
+  self->ref_count = 1;
+  self->bytes = g_bytes_ref(bytes);
+  self->header = reinterpret_cast<const KeebieLayoutHeader*>(data);
+
+  // Only dereferenced after the offsets were checked below.
+  self->planes = reinterpret_cast<const KeebieLayoutPlane*>(data + MIN(self->header->planes_offset, size));
+  self->rows = reinterpret_cast<const KeebieLayoutRow*>(data + MIN(self->header->rows_offset, size));
+  self->actions = reinterpret_cast<const KeebieKeyAction*>(data + MIN(self->header->actions_offset, size));
+  self->keys = reinterpret_cast<const KeebieLayoutKey*>(data + MIN(self->header->keys_offset, size));
+  self->strings = reinterpret_cast<const char*>(data + MIN(self->header->strings_offset, size));
+
+  if (!keebie_layout_validate(self, size, error)) {
+    keebie_layout_unref(self);
+    return nullptr;
+  }
+  return self;
+}
+
+KeebieLayout* keebie_layout_new_from_file(const char* path, GError** error) {
+  // Layouts are small and walked whole as soon as the geometry is solved.
+  g_autoptr(GMappedFile) file = keebie_blob_map(path, sizeof (KeebieLayoutHeader), MADV_WILLNEED, error);
+  if (file == nullptr) {
+    return nullptr;
+  }
+
+  g_autoptr(GBytes) bytes = g_mapped_file_get_bytes(file);
+  return keebie_layout_new_from_bytes(bytes, error);
+}
+
+KeebieLayout* keebie_layout_ref(KeebieLayout* self) {
+  g_atomic_int_inc(&self->ref_count);
+  return self;
+}
+
+void keebie_layout_unref(KeebieLayout* self) {
+  if (g_atomic_int_dec_and_test(&self->ref_count)) {
+    g_bytes_unref(self->bytes);
+    g_free(self);
+  }
+}
+
+GBytes* keebie_layout_get_bytes(KeebieLayout* self) {
+  return self->bytes;
+}
+
+const char* keebie_layout_get_locale(KeebieLayout* self) {
+  return keebie_layout_get_string(self, self->header->locale);
+}
+
+int32_t keebie_layout_get_content_plane(KeebieLayout* self, KeebieContentType type) {
+  g_return_val_if_fail(type < KEEBIE_N_CONTENT_TYPES, -1);
+  return self->header->content_plane_map[type];
+}
+
+guint keebie_layout_get_n_planes(KeebieLayout* self) {
+  return self->header->n_planes;
+}
+
+KeebiePlaneType keebie_layout_get_plane_type(KeebieLayout* self, guint plane) {
+  if (plane >= self->header->n_planes) {
+    return KEEBIE_PLANE_TYPE_KEYS;
+  }
+  return static_cast<KeebiePlaneType>(self->planes[plane].type);
+}
+
+guint keebie_layout_get_n_rows(KeebieLayout* self, guint plane) {
+  if (plane >= self->header->n_planes) {
+    return 0;
+  }
+  return self->planes[plane].n_rows;
+}
+
+guint keebie_layout_get_n_keys(KeebieLayout* self, guint plane, guint row) {
+  if (row >= keebie_layout_get_n_rows(self, plane)) {
+    return 0;
+  }
+  return self->rows[self->planes[plane].first_row + row].n_keys;
+}
+
+static inline gssize keebie_layout_index(KeebieLayout* self, guint plane, guint row, guint key) {
+  if (key >= keebie_layout_get_n_keys(self, plane, row)) {
+    return -1;
+  }
+  return self->rows[self->planes[plane].first_row + row].first_key + key;
+}
+
+const KeebieKeyAction* keebie_layout_lookup(KeebieLayout* self, guint plane, guint row, guint key) {
+  gssize index = keebie_layout_index(self, plane, row, key);
+  return index < 0 ? nullptr : &self->actions[index];
+}
+
+const KeebieLayoutKey* keebie_layout_lookup_key(KeebieLayout* self, guint plane, guint row, guint key) {
+  gssize index = keebie_layout_index(self, plane, row, key);
+  return index < 0 ? nullptr : &self->keys[index];
+}
+
+const char* keebie_layout_get_string(KeebieLayout* self, uint32_t offset) {
+  g_return_val_if_fail(offset < self->header->strings_size, "");
+  return self->strings + offset;
+}
+
+const char* keebie_layout_get_text(KeebieLayout* self, const KeebieKeyAction* action, gboolean is_shifted) {
+  return keebie_layout_get_string(self, is_shifted ? action->shifted_text : action->text);
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Mirrors KeyboardKeyType in lib/logic/keyboard.dart, order matters.
+ */
+typedef enum {
+  KEEBIE_KEY_TYPE_REGULAR = 0,
+  KEEBIE_KEY_TYPE_SHIFT,
+  KEEBIE_KEY_TYPE_ENTER,
+  KEEBIE_KEY_TYPE_BACKSPACE,
+  KEEBIE_KEY_TYPE_SPACE,
+  KEEBIE_KEY_TYPE_PLANE,
+  KEEBIE_KEY_TYPE_CHANGE_LANG,
+  KEEBIE_N_KEY_TYPES
+} KeebieKeyType;
+
+/**
+ * Mirrors KeyboardPlaneType, order matters. Handwriting planes have a pad
+ * for writing characters on above their keys, emoji planes a picker.
+ */
+typedef enum {
+  KEEBIE_PLANE_TYPE_KEYS = 0,
+  KEEBIE_PLANE_TYPE_HANDWRITING,
+  KEEBIE_PLANE_TYPE_EMOJI,
+  KEEBIE_N_PLANE_TYPES
+} KeebiePlaneType;
+
+/**
+ * Mirrors KeyboardContentType, order matters.
+ */
+typedef enum {
+  KEEBIE_CONTENT_TYPE_DATE_TIME = 0,
+  KEEBIE_CONTENT_TYPE_NUMBER,
+  KEEBIE_CONTENT_TYPE_PHONE,
+  KEEBIE_CONTENT_TYPE_TEXT,
+  KEEBIE_N_CONTENT_TYPES
+} KeebieContentType;
+
+typedef enum {
+  KEEBIE_KEY_FLAG_EXPANDS = 1 << 0,
+  KEEBIE_KEY_FLAG_SECONDARY_COLORS = 1 << 1,
+} KeebieKeyFlags;
+
+/**
+ * Mirrors KeyboardKeyConstraint, stored as a bitmask of (1 << index).
+ */
+typedef enum {
+  KEEBIE_KEY_CONSTRAINT_CAN_CHANGE_LANGUAGE = 1 << 0,
+} KeebieKeyConstraint;
+
+typedef enum {
+  KEEBIE_KEY_ACTION_NONE = 0,
+  KEEBIE_KEY_ACTION_COMMIT,
+  KEEBIE_KEY_ACTION_KEYCODE,
+  KEEBIE_KEY_ACTION_DELETE,
+  KEEBIE_KEY_ACTION_PLANE,
+  KEEBIE_KEY_ACTION_SHIFT,
+  KEEBIE_KEY_ACTION_CHANGE_LANG,
+} KeebieKeyActionType;
+
+#define KEEBIE_LAYOUT_MAGIC 0x594c424bu /* "KBLY" */
+#define KEEBIE_LAYOUT_VERSION 2
+
+/**
+ * The compiled layout format, every layout is a single blob of:
+ *
+ *   header | planes | rows | actions | keys | strings
+ *
+ * Sections are arrays of the fixed-size records below in host byte order,
+ * strings are NUL-terminated UTF-8 interned into one pool and referenced by
+ * their offset within it. Offset 0 is always the empty string.
+ * lib/logic/keyboard.dart decodes the same structure, keep the two in sync and
+ * bump KEEBIE_LAYOUT_VERSION on any change.
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;
+  uint32_t locale;
+  int32_t content_plane_map[KEEBIE_N_CONTENT_TYPES];
+  uint32_t n_planes;
+  uint32_t planes_offset;
+  uint32_t n_rows;
+  uint32_t rows_offset;
+  uint32_t n_keys;
+  uint32_t actions_offset;
+  uint32_t keys_offset;
+  uint32_t strings_offset;
+  uint32_t strings_size;
+} KeebieLayoutHeader;
+
+typedef struct {
+  uint32_t first_row;
+  uint32_t n_rows;
+  uint32_t type;
+} KeebieLayoutPlane;
+
+typedef struct {
+  uint32_t first_key;
+  uint32_t n_keys;
+} KeebieLayoutRow;
+
+/**
+ * A single resolved key, the argument depends on the action type:
+ * keycode for KEYCODE, character count for DELETE and plane index for PLANE.
+ * This is the hot part of a key, what is only needed for drawing lives in
+ * KeebieLayoutKey.
+ */
+typedef struct {
+  uint8_t type;
+  uint8_t key_type;
+  uint8_t flags;
+  uint8_t constraints;
+  uint32_t arg;
+  uint32_t text;
+  uint32_t shifted_text;
+} KeebieKeyAction;
+
+/**
+ * What is only needed to draw a key, an icon code point of 0 means no icon.
+ */
+typedef struct {
+  uint32_t name;
+  uint32_t shifted_name;
+  uint32_t icon;
+  uint32_t shifted_icon;
+  uint32_t icon_font;
+  uint32_t shifted_icon_font;
+  int32_t plane;
+} KeebieLayoutKey;
+
+/**
+ * Everything a layout source describes about a single key.
+ */
+typedef struct {
+  KeebieKeyType type;
+  const char* name;
+  const char* shifted_name;
+  uint32_t icon;
+  const char* icon_font;
+  uint32_t shifted_icon;
+  const char* shifted_icon_font;
+  int32_t plane;
+  uint8_t flags;
+  uint8_t constraints;
+} KeebieLayoutKeyInfo;
+
+typedef struct _KeebieLayout KeebieLayout;
+typedef struct _KeebieLayoutBuilder KeebieLayoutBuilder;
+
+KeebieKeyType keebie_key_type_from_string(const char* str);
+KeebiePlaneType keebie_plane_type_from_string(const char* str);
+KeebieKeyConstraint keebie_key_constraint_from_string(const char* str);
+int keebie_content_type_from_string(const char* str);
+
+KeebieLayoutBuilder* keebie_layout_builder_new(const char* locale);
+void keebie_layout_builder_free(KeebieLayoutBuilder* self);
+void keebie_layout_builder_set_content_plane(KeebieLayoutBuilder* self, KeebieContentType type, int32_t plane);
+void keebie_layout_builder_add_plane(KeebieLayoutBuilder* self, KeebiePlaneType type);
+void keebie_layout_builder_add_row(KeebieLayoutBuilder* self);
+void keebie_layout_builder_add_key(KeebieLayoutBuilder* self, const KeebieLayoutKeyInfo* info);
+guint keebie_layout_builder_get_n_planes(KeebieLayoutBuilder* self);
+
+/**
+ * Serializes everything added so far into a compiled layout blob.
+ */
+GBytes* keebie_layout_builder_end(KeebieLayoutBuilder* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieLayoutBuilder, keebie_layout_builder_free);
+
+/**
+ * Wraps a compiled blob without copying it, the blob is validated once here
+ * so lookups do not need to bounds check against the raw offsets again.
+ */
+KeebieLayout* keebie_layout_new_from_bytes(GBytes* bytes, GError** error);
+KeebieLayout* keebie_layout_new_from_file(const char* path, GError** error);
+KeebieLayout* keebie_layout_ref(KeebieLayout* self);
+void keebie_layout_unref(KeebieLayout* self);
+
+GBytes* keebie_layout_get_bytes(KeebieLayout* self);
+const char* keebie_layout_get_locale(KeebieLayout* self);
+int32_t keebie_layout_get_content_plane(KeebieLayout* self, KeebieContentType type);
+guint keebie_layout_get_n_planes(KeebieLayout* self);
+KeebiePlaneType keebie_layout_get_plane_type(KeebieLayout* self, guint plane);
+guint keebie_layout_get_n_rows(KeebieLayout* self, guint plane);
+guint keebie_layout_get_n_keys(KeebieLayout* self, guint plane, guint row);
+const KeebieKeyAction* keebie_layout_lookup(KeebieLayout* self, guint plane, guint row, guint key);
+const KeebieLayoutKey* keebie_layout_lookup_key(KeebieLayout* self, guint plane, guint row, guint key);
+const char* keebie_layout_get_string(KeebieLayout* self, uint32_t offset);
+const char* keebie_layout_get_text(KeebieLayout* self, const KeebieKeyAction* action, gboolean is_shifted);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieLayout, keebie_layout_unref);
+
+G_END_DECLS
@@ -0,0 +1,131 @@
+#include "output-cache.h"
+
+typedef struct {
+  GdkMonitor* monitor;
+  GdkRectangle geometry;
+  gint scale;
+} KeebieOutput;
+
+struct _KeebieOutputCache {
+  GdkDisplay* display;
+  GArray* outputs;
+
+  KeebieOutputCacheFunc func;
+  gpointer data;
+};
+
+static KeebieOutput* keebie_output_cache_find(KeebieOutputCache* self, GdkMonitor* monitor, guint* index) {
+  for (guint i = 0; i < self->outputs->len; i++) {
+    KeebieOutput* output = &g_array_index(self->outputs, KeebieOutput, i);
+    if (output->monitor == monitor) {
+      if (index != nullptr) {
+        *index = i;
+      }
+      return output;
+    }
+  }
+  return nullptr;
+}
+
+static void keebie_output_cache_monitor_notify_cb(GdkMonitor* monitor, GParamSpec* pspec, gpointer data) {
+  KeebieOutputCache* self = reinterpret_cast<KeebieOutputCache*>(data);
+  KeebieOutput* output = keebie_output_cache_find(self, monitor, nullptr);
+  if (output == nullptr) {
+    return;
+  }
+
+  GdkRectangle geometry;
+  gdk_monitor_get_geometry(monitor, &geometry);
+  gint scale = gdk_monitor_get_scale_factor(monitor);
+
+  // Both properties are notified together on most outputs, only tell once.
+  if (gdk_rectangle_equal(&geometry, &output->geometry) && scale == output->scale) {
+    return;
+  }
+
+  output->geometry = geometry;
+  output->scale = scale;
+  self->func(monitor, self->data);
+}
+
+static void keebie_output_cache_add(KeebieOutputCache* self, GdkMonitor* monitor) {
+  KeebieOutput output = {};
+  output.monitor = GDK_MONITOR(g_object_ref(monitor));
+  gdk_monitor_get_geometry(monitor, &output.geometry);
+  output.scale = gdk_monitor_get_scale_factor(monitor);
+  g_array_append_val(self->outputs, output);
+
+  g_signal_connect(monitor, "notify::geometry", G_CALLBACK(keebie_output_cache_monitor_notify_cb), self);
+  g_signal_connect(monitor, "notify::scale-factor", G_CALLBACK(keebie_output_cache_monitor_notify_cb), self);
+}
+
+static void keebie_output_cache_remove_index(KeebieOutputCache* self, guint index) {
+  GdkMonitor* monitor = g_array_index(self->outputs, KeebieOutput, index).monitor;
+  g_signal_handlers_disconnect_by_data(monitor, self);
+  g_array_remove_index_fast(self->outputs, index);
+  g_object_unref(monitor);
+}
+
+static void keebie_output_cache_monitor_added_cb(GdkDisplay* display, GdkMonitor* monitor, gpointer data) {
+  KeebieOutputCache* self = reinterpret_cast<KeebieOutputCache*>(data);
+  keebie_output_cache_add(self, monitor);
+  self->func(monitor, self->data);
+}
+
+static void keebie_output_cache_monitor_removed_cb(GdkDisplay* display, GdkMonitor* monitor, gpointer data) {
+  KeebieOutputCache* self = reinterpret_cast<KeebieOutputCache*>(data);
+
+  guint index;
+  if (keebie_output_cache_find(self, monitor, &index) == nullptr) {
+    return;
+  }
+
+  // Keeps the monitor alive through the callback.
+  g_object_ref(monitor);
+  keebie_output_cache_remove_index(self, index);
+  self->func(monitor, self->data);
+  g_object_unref(monitor);
+}
+
+KeebieOutputCache* keebie_output_cache_new(GdkDisplay* display, KeebieOutputCacheFunc func, gpointer data) {
+  KeebieOutputCache* self = g_new0(KeebieOutputCache, 1);
+  self->display = GDK_DISPLAY(g_object_ref(display));
+  self->outputs = g_array_new(FALSE, FALSE, sizeof (KeebieOutput));
+  self->func = func;
+  self->data = data;
+
+  int n_monitors = gdk_display_get_n_monitors(display);
+  for (int i = 0; i < n_monitors; i++) {
+    keebie_output_cache_add(self, gdk_display_get_monitor(display, i));
+  }
+
+  g_signal_connect(display, "monitor-added", G_CALLBACK(keebie_output_cache_monitor_added_cb), self);
+  g_signal_connect(display, "monitor-removed", G_CALLBACK(keebie_output_cache_monitor_removed_cb), self);
+  return self;
+}
+
+void keebie_output_cache_free(KeebieOutputCache* self) {
+  g_signal_handlers_disconnect_by_data(self->display, self);
+  while (self->outputs->len > 0) {
+    keebie_output_cache_remove_index(self, self->outputs->len - 1);
+  }
+
+  g_array_unref(self->outputs);
+  g_object_unref(self->display);
+  g_free(self);
+}
+
+gboolean keebie_output_cache_lookup(KeebieOutputCache* self, GdkMonitor* monitor, GdkRectangle* geometry, gint* scale) {
+  KeebieOutput* output = keebie_output_cache_find(self, monitor, nullptr);
+  if (output == nullptr) {
+    return FALSE;
+  }
+
+  if (geometry != nullptr) {
+    *geometry = output->geometry;
+  }
+  if (scale != nullptr) {
+    *scale = output->scale;
+  }
+  return TRUE;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <gdk/gdk.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Called on the main thread when a monitor was added, removed or changed its
+ * geometry or scale. A removed monitor is only valid during the call.
+ */
+typedef void (*KeebieOutputCacheFunc)(GdkMonitor* monitor, gpointer data);
+
+/**
+ * Keeps the geometry and scale of every output of a display, updated from
+ * the monitor signals so nothing has to be queried while typing.
+ */
+typedef struct _KeebieOutputCache KeebieOutputCache;
+
+KeebieOutputCache* keebie_output_cache_new(GdkDisplay* display, KeebieOutputCacheFunc func, gpointer data);
+void keebie_output_cache_free(KeebieOutputCache* self);
+
+/**
+ * Fills in the cached geometry and scale, returns FALSE for monitors which
+ * are not part of the display (anymore).
+ */
+gboolean keebie_output_cache_lookup(KeebieOutputCache* self, GdkMonitor* monitor, GdkRectangle* geometry, gint* scale);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieOutputCache, keebie_output_cache_free);
+
+G_END_DECLS
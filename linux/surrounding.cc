@@ -0,0 +1,326 @@
+#include <string.h>
+#include "surrounding.h"
+
+// Word class of characters which belong to whatever word they are next to,
+// digits and marks are COMMON/INHERITED, so is the katakana prolonged sound mark.
+// Every other word class is a GUnicodeScript.
+#define KEEBIE_WORD_CLASS_ANY -2
+#define KEEBIE_WORD_CLASS_PUNCT -3
+#define KEEBIE_WORD_CLASS_SPACE -4
+
+void keebie_surrounding_set(KeebieSurrounding* self, const char* text, uint32_t cursor, uint32_t anchor) {
+  g_free(self->text);
+  self->text = g_strdup(text);
+
+  size_t length = strlen(self->text);
+  self->cursor = MIN(cursor, length);
+  self->anchor = MIN(anchor, length);
+}
+
+void keebie_surrounding_clear(KeebieSurrounding* self) {
+  g_clear_pointer(&self->text, g_free);
+  self->cursor = 0;
+  self->anchor = 0;
+}
+
+static gint keebie_surrounding_word_class(gunichar c) {
+  if (g_unichar_isspace(c)) {
+    return KEEBIE_WORD_CLASS_SPACE;
+  }
+
+  if (!g_unichar_isalnum(c) && !g_unichar_ismark(c)) {
+    return KEEBIE_WORD_CLASS_PUNCT;
+  }
+
+  // Japanese has no spaces, a change of script is the closest thing to a word boundary.
+  GUnicodeScript script = g_unichar_get_script(c);
+  if (script == G_UNICODE_SCRIPT_COMMON || script == G_UNICODE_SCRIPT_INHERITED) {
+    return KEEBIE_WORD_CLASS_ANY;
+  }
+  return script;
+}
+
+static gboolean keebie_surrounding_is_terminator(gunichar c) {
+  switch (c) {
+    case '.':
+    case '!':
+    case '?':
+    case '\n':
+    case 0x2026: // …
+    case 0x3002: // 。
+    case 0xff01: // ！
+    case 0xff0e: // ．
+    case 0xff1f: // ？
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+static const char* keebie_surrounding_prev_char(const char* text, const char* p, gunichar* c) {
+  const char* prev = g_utf8_find_prev_char(text, p);
+  if (prev != nullptr) {
+    *c = g_utf8_get_char(prev);
+  }
+  return prev;
+}
+
+static const char* keebie_surrounding_skip_space(const char* text, const char* p) {
+  gunichar c;
+  const char* prev;
+  while ((prev = keebie_surrounding_prev_char(text, p, &c)) != nullptr && g_unichar_isspace(c) && c != '\n') {
+    p = prev;
+  }
+  return p;
+}
+
+static const char* keebie_surrounding_word_start(const char* text, const char* p) {
+  p = keebie_surrounding_skip_space(text, p);
+  const char* end = p;
+
+  gint word_class = KEEBIE_WORD_CLASS_ANY;
+  gunichar c;
+  const char* prev;
+  while ((prev = keebie_surrounding_prev_char(text, p, &c)) != nullptr) {
+    gint c_class = keebie_surrounding_word_class(c);
+    if (c_class == KEEBIE_WORD_CLASS_SPACE) {
+      break;
+    }
+
+    if (c_class == KEEBIE_WORD_CLASS_ANY) {
+      // Digits after punctuation are not part of it.
+      if (word_class == KEEBIE_WORD_CLASS_PUNCT) {
+        break;
+      }
+    } else if (word_class == KEEBIE_WORD_CLASS_ANY) {
+      // Neither is punctuation in front of digits.
+      if (c_class == KEEBIE_WORD_CLASS_PUNCT && p != end) {
+        break;
+      }
+      word_class = c_class;
+    } else if (c_class != word_class) {
+      break;
+    }
+
+    p = prev;
+  }
+  return p;
+}
+
+static const char* keebie_surrounding_sentence_start(const char* text, const char* p) {
+  p = keebie_surrounding_skip_space(text, p);
+
+  // The sentence being deleted owns its own terminator.
+  gunichar c;
+  const char* prev;
+  while ((prev = keebie_surrounding_prev_char(text, p, &c)) != nullptr && keebie_surrounding_is_terminator(c) && c != '\n') {
+    p = prev;
+  }
+
+  while ((prev = keebie_surrounding_prev_char(text, p, &c)) != nullptr && !keebie_surrounding_is_terminator(c)) {
+    p = prev;
+  }
+  return p;
+}
+
+gchar* keebie_surrounding_get_word_before_cursor(const KeebieSurrounding* self) {
+  if (self->text == nullptr || self->cursor != self->anchor) {
+    return nullptr;
+  }
+
+  // Unlike deleting a word this never reaches over spaces or punctuation.
+  const char* end = self->text + self->cursor;
+  const char* p = end;
+  gint word_class = KEEBIE_WORD_CLASS_ANY;
+  gunichar c;
+  const char* prev;
+  while ((prev = keebie_surrounding_prev_char(self->text, p, &c)) != nullptr) {
+    gint c_class = keebie_surrounding_word_class(c);
+    if (c_class == KEEBIE_WORD_CLASS_SPACE || c_class == KEEBIE_WORD_CLASS_PUNCT) {
+      break;
+    }
+
+    if (c_class != KEEBIE_WORD_CLASS_ANY) {
+      if (word_class != KEEBIE_WORD_CLASS_ANY && c_class != word_class) {
+        break;
+      }
+      word_class = c_class;
+    }
+    p = prev;
+  }
+  return g_strndup(p, end - p);
+}
+
+GArray* keebie_surrounding_split_words(const char* text, gsize length) {
+  GArray* words = g_array_new(FALSE, FALSE, sizeof (KeebieSurroundingWord));
+  KeebieSurroundingWord word = {};
+  gboolean in_word = FALSE;
+  gboolean is_sentence_start = TRUE;
+  gint word_class = KEEBIE_WORD_CLASS_ANY;
+
+  const char* end = text + length;
+  for (const char* p = text; p < end; p = g_utf8_next_char(p)) {
+    gunichar c = g_utf8_get_char(p);
+    gint c_class = keebie_surrounding_word_class(c);
+    gboolean is_boundary = c_class == KEEBIE_WORD_CLASS_SPACE || c_class == KEEBIE_WORD_CLASS_PUNCT
+      || (c_class != KEEBIE_WORD_CLASS_ANY && word_class != KEEBIE_WORD_CLASS_ANY && c_class != word_class);
+
+    if (in_word && is_boundary) {
+      word.end = p - text;
+      g_array_append_val(words, word);
+      in_word = FALSE;
+    }
+
+    if (keebie_surrounding_is_terminator(c)) {
+      is_sentence_start = TRUE;
+    }
+
+    if (!in_word && c_class != KEEBIE_WORD_CLASS_SPACE && c_class != KEEBIE_WORD_CLASS_PUNCT) {
+      word.start = p - text;
+      word.starts_sentence = is_sentence_start;
+      in_word = TRUE;
+      is_sentence_start = FALSE;
+      word_class = KEEBIE_WORD_CLASS_ANY;
+    }
+
+    if (in_word && c_class != KEEBIE_WORD_CLASS_ANY) {
+      word_class = c_class;
+    }
+  }
+
+  if (in_word) {
+    word.end = length;
+    g_array_append_val(words, word);
+  }
+  return words;
+}
+
+gboolean keebie_surrounding_get_previous_word(const KeebieSurrounding* self, uint32_t offset, KeebieSurroundingWord* word) {
+  if (self->text == nullptr || offset > strlen(self->text)) {
+    return FALSE;
+  }
+
+  const char* end = self->text + offset;
+  const char* p = keebie_surrounding_skip_space(self->text, end);
+  gunichar c;
+  if (keebie_surrounding_prev_char(self->text, p, &c) == nullptr || keebie_surrounding_word_class(c) == KEEBIE_WORD_CLASS_PUNCT || c == '\n') {
+    return FALSE;
+  }
+
+  g_autoptr(GArray) words = keebie_surrounding_split_words(self->text, p - self->text);
+  if (words->len == 0) {
+    return FALSE;
+  }
+
+  *word = g_array_index(words, KeebieSurroundingWord, words->len - 1);
+  return TRUE;
+}
+
+gboolean keebie_surrounding_get_delete_range(const KeebieSurrounding* self, KeebieDeleteUnit unit, guint count, uint32_t* before, uint32_t* after) {
+  *before = 0;
+  *after = 0;
+
+  if (self->text == nullptr) {
+    return FALSE;
+  }
+
+  if (self->anchor != self->cursor) {
+    if (self->anchor < self->cursor) {
+      *before = self->cursor - self->anchor;
+    } else {
+      *after = self->anchor - self->cursor;
+    }
+    return TRUE;
+  }
+
+  if (unit == KEEBIE_DELETE_SELECTION) {
+    return FALSE;
+  }
+
+  const char* cursor = self->text + self->cursor;
+  const char* p = cursor;
+  for (guint i = 0; i < count && p > self->text; i++) {
+    switch (unit) {
+      case KEEBIE_DELETE_CHAR:
+        p = g_utf8_find_prev_char(self->text, p);
+        break;
+      case KEEBIE_DELETE_WORD:
+        p = keebie_surrounding_word_start(self->text, p);
+        break;
+      case KEEBIE_DELETE_SENTENCE:
+        p = keebie_surrounding_sentence_start(self->text, p);
+        break;
+      default:
+        g_assert_not_reached();
+    }
+  }
+
+  *before = cursor - p;
+  return *before > 0;
+}
+
+void keebie_surrounding_get_char_range(const KeebieSurrounding* self, guint before_chars, guint after_chars, uint32_t* before, uint32_t* after) {
+  *before = 0;
+  *after = 0;
+
+  if (self->text == nullptr) {
+    return;
+  }
+
+  const char* cursor = self->text + self->cursor;
+  const char* p = cursor;
+  for (guint i = 0; i < before_chars && p > self->text; i++) {
+    p = g_utf8_find_prev_char(self->text, p);
+  }
+  *before = cursor - p;
+
+  p = cursor;
+  for (guint i = 0; i < after_chars && *p != '\0'; i++) {
+    p = g_utf8_next_char(p);
+  }
+  *after = p - cursor;
+}
+
+void keebie_surrounding_delete(KeebieSurrounding* self, uint32_t before, uint32_t after) {
+  if (self->text == nullptr) {
+    return;
+  }
+
+  size_t length = strlen(self->text);
+  before = MIN(before, self->cursor);
+  after = MIN(after, length - self->cursor);
+
+  memmove(self->text + self->cursor - before, self->text + self->cursor + after, length - self->cursor - after + 1);
+  self->cursor -= before;
+  self->anchor = self->cursor;
+}
+
+void keebie_surrounding_insert(KeebieSurrounding* self, const char* text) {
+  if (self->text == nullptr) {
+    return;
+  }
+
+  uint32_t start = MIN(self->cursor, self->anchor);
+  uint32_t end = MAX(self->cursor, self->anchor);
+
+  g_autoptr(GString) str = g_string_new(self->text);
+  g_string_erase(str, start, end - start);
+  g_string_insert(str, start, text);
+
+  g_free(self->text);
+  self->text = g_string_free(reinterpret_cast<GString*>(g_steal_pointer(&str)), FALSE);
+  self->cursor = start + strlen(text);
+  self->anchor = self->cursor;
+}
+
+glong keebie_surrounding_get_utf16_offset(const KeebieSurrounding* self, uint32_t offset) {
+  if (self->text == nullptr) {
+    return 0;
+  }
+
+  glong units = 0;
+  for (const char* p = self->text; *p != '\0' && p < self->text + offset; p = g_utf8_next_char(p)) {
+    units += g_utf8_get_char(p) > 0xffff ? 2 : 1;
+  }
+  return units;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  KEEBIE_DELETE_CHAR = 0,
+  KEEBIE_DELETE_WORD,
+  KEEBIE_DELETE_SENTENCE,
+  KEEBIE_DELETE_SELECTION,
+} KeebieDeleteUnit;
+
+/**
+ * The text around the cursor as sent by zwp_input_method_v2.surrounding_text,
+ * cursor and anchor are byte offsets into text. A NULL text means the client
+ * never told us, so no byte lengths can be derived from it.
+ */
+typedef struct {
+  gchar* text;
+  uint32_t cursor;
+  uint32_t anchor;
+} KeebieSurrounding;
+
+void keebie_surrounding_set(KeebieSurrounding* self, const char* text, uint32_t cursor, uint32_t anchor);
+void keebie_surrounding_clear(KeebieSurrounding* self);
+
+/**
+ * Resolves count units back from the cursor into the byte lengths
+ * delete_surrounding_text takes. An active selection is always what goes
+ * first, whatever the unit. Returns FALSE if there is nothing to delete.
+ */
+gboolean keebie_surrounding_get_delete_range(const KeebieSurrounding* self, KeebieDeleteUnit unit, guint count, uint32_t* before, uint32_t* after);
+
+/**
+ * Resolves a number of characters before and after the cursor into bytes,
+ * clamped to the text. Selections play no part in this.
+ */
+void keebie_surrounding_get_char_range(const KeebieSurrounding* self, guint before_chars, guint after_chars, uint32_t* before, uint32_t* after);
+
+/**
+ * Returns the part of the word which ends at the cursor, the word being
+ * typed, or NULL without text or with a selection. Empty right after a space.
+ */
+gchar* keebie_surrounding_get_word_before_cursor(const KeebieSurrounding* self);
+
+/**
+ * A word of keebie_surrounding_split_words, start and end are byte offsets.
+ * Sentence starts are the first word and words after a terminator.
+ */
+typedef struct {
+  uint32_t start;
+  uint32_t end;
+  gboolean starts_sentence;
+} KeebieSurroundingWord;
+
+/**
+ * Splits text into the words completion sees, runs of letters and digits of
+ * one script, into an array of KeebieSurroundingWord.
+ */
+GArray* keebie_surrounding_split_words(const char* text, gsize length);
+
+/**
+ * Finds the word right before offset, with nothing but spaces in between.
+ * Returns FALSE without text or if punctuation or the text's start come first.
+ */
+gboolean keebie_surrounding_get_previous_word(const KeebieSurrounding* self, uint32_t offset, KeebieSurroundingWord* word);
+
+/**
+ * Converts a byte offset into the text to UTF-16 code units, which is what
+ * Dart strings index by.
+ */
+glong keebie_surrounding_get_utf16_offset(const KeebieSurrounding* self, uint32_t offset);
+
+/**
+ * Applies a commit string locally, it replaces the selection if there is one.
+ */
+void keebie_surrounding_insert(KeebieSurrounding* self, const char* text);
+
+/**
+ * Applies a delete locally so deletes issued before the client's next done
+ * still resolve against the right text.
+ */
+void keebie_surrounding_delete(KeebieSurrounding* self, uint32_t before, uint32_t after);
+
+G_END_DECLS
@@ -0,0 +1,588 @@
+#include <math.h>
+#include <string.h>
+#include "swipe-decoder.h"
+
+// Paths are compared as this many points spread evenly along them.
+#define KEEBIE_SWIPE_DECODER_POINTS 32
+
+// How many points a path may run ahead of or behind a word's ideal one.
+#define KEEBIE_SWIPE_DECODER_BAND 4
+
+// Words start and end on keys within this many key widths of where the path
+// does, or on the nearest key when none is.
+#define KEEBIE_SWIPE_DECODER_REACH 1.0f
+
+// How far a path strays from the ideal one, in key widths.
+#define KEEBIE_SWIPE_DECODER_SIGMA 0.5f
+
+// How much how common a word is counts against how well its path matches.
+#define KEEBIE_SWIPE_DECODER_FREQUENCY_WEIGHT 0.3f
+
+// Key indices are stored in a byte, and words are grouped per key pair.
+#define KEEBIE_SWIPE_DECODER_MAX_KEYS 64
+
+// Longer words are not worth swiping.
+#define KEEBIE_SWIPE_DECODER_MAX_WORD 48
+
+typedef struct {
+  gunichar c;
+  guint row;
+  guint key;
+  float x;
+  float y;
+} KeebieSwipeKey;
+
+typedef struct {
+  uint32_t word;
+  uint32_t keys_offset;
+  uint32_t n_keys;
+  float length;
+  float prior;
+} KeebieSwipeWord;
+
+/**
+ * The keys and words of one keyboard, in key widths so decoding does not
+ * depend on how large the keys are drawn. Shared with queued decodes, only
+ * the worker indexes the words and reads them afterwards.
+ */
+typedef struct {
+  gint ref_count;
+  KeebieDictionary* dictionary;
+  float key_width;
+  guint n_keys;
+  KeebieSwipeKey keys[KEEBIE_SWIPE_DECODER_MAX_KEYS];
+  guint8 ascii[128];
+
+  gboolean is_indexed;
+  GArray* words;
+  GByteArray* sequences;
+
+  // Words are grouped by their first and last key, the run of the pair
+  // first * n_keys + last starts at that bucket and ends at the next.
+  uint32_t* buckets;
+} KeebieSwipeKeyboard;
+
+typedef struct {
+  KeebieSwipeKeyboard* keyboard;
+  float* points;
+  guint n_points;
+  gboolean is_final;
+  guint k;
+  gint serial;
+  GPtrArray* words;
+
+  KeebieSwipeFunc func;
+  gpointer data;
+  GDestroyNotify destroy;
+} KeebieSwipeTask;
+
+typedef struct {
+  float score;
+  uint32_t word;
+} KeebieSwipeCandidate;
+
+struct _KeebieSwipeDecoder {
+  GThreadPool* worker;
+
+  // Guards keyboard, which is swapped rather than changed.
+  GMutex lock;
+  KeebieSwipeKeyboard* keyboard;
+
+  // The serial of the last queued decode, older ones of a finger still down
+  // are not worth decoding anymore.
+  gint serial;
+};
+
+static KeebieSwipeKeyboard* keebie_swipe_keyboard_ref(KeebieSwipeKeyboard* self) {
+  g_atomic_int_inc(&self->ref_count);
+  return self;
+}
+
+static void keebie_swipe_keyboard_unref(KeebieSwipeKeyboard* self) {
+  if (!g_atomic_int_dec_and_test(&self->ref_count)) {
+    return;
+  }
+
+  if (self->dictionary != nullptr) {
+    keebie_dictionary_unref(self->dictionary);
+  }
+  if (self->words != nullptr) {
+    g_array_unref(self->words);
+  }
+  if (self->sequences != nullptr) {
+    g_byte_array_unref(self->sequences);
+  }
+  g_free(self->buckets);
+  g_free(self);
+}
+
+static gint keebie_swipe_keyboard_find_key(const KeebieSwipeKeyboard* self, gunichar c) {
+  if (c < G_N_ELEMENTS(self->ascii)) {
+    return static_cast<gint>(self->ascii[c]) - 1;
+  }
+
+  for (guint i = 0; i < self->n_keys; i++) {
+    if (self->keys[i].c == c) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Spreads KEEBIE_SWIPE_DECODER_POINTS points evenly along the polyline
+ * through n x, y pairs and returns its length.
+ */
+static float keebie_swipe_resample(const float* points, guint n, float* x, float* y) {
+  float length = 0;
+  for (guint i = 1; i < n; i++) {
+    length += hypotf(points[i * 2] - points[i * 2 - 2], points[i * 2 + 1] - points[i * 2 - 1]);
+  }
+
+  float step = length / (KEEBIE_SWIPE_DECODER_POINTS - 1);
+  guint segment = 0;
+  float segment_start = 0;
+  float segment_length = n > 1 ? hypotf(points[2] - points[0], points[3] - points[1]) : 0;
+
+  for (guint i = 0; i < KEEBIE_SWIPE_DECODER_POINTS; i++) {
+    float target = step * i;
+    while (segment + 2 < n && segment_start + segment_length < target) {
+      segment_start += segment_length;
+      segment++;
+      segment_length = hypotf(points[segment * 2 + 2] - points[segment * 2], points[segment * 2 + 3] - points[segment * 2 + 1]);
+    }
+
+    if (n < 2) {
+      x[i] = points[0];
+      y[i] = points[1];
+      continue;
+    }
+
+    float t = segment_length > 0 ? CLAMP((target - segment_start) / segment_length, 0.0f, 1.0f) : 0.0f;
+    x[i] = points[segment * 2] + t * (points[segment * 2 + 2] - points[segment * 2]);
+    y[i] = points[segment * 2 + 1] + t * (points[segment * 2 + 3] - points[segment * 2 + 1]);
+  }
+  return length;
+}
+
+/**
+ * Dynamic time warping of two resampled paths within a band around the
+ * diagonal, summing squared distances. Gives up with INFINITY once every
+ * alignment so far costs more than bound.
+ */
+static float keebie_swipe_distance(const float* ax, const float* ay, const float* bx, const float* by, float bound) {
+  const guint n = KEEBIE_SWIPE_DECODER_POINTS;
+  const guint band = KEEBIE_SWIPE_DECODER_BAND;
+
+  float rows[2][KEEBIE_SWIPE_DECODER_POINTS];
+  float* previous = rows[0];
+  float* current = rows[1];
+  for (guint j = 0; j < n; j++) {
+    previous[j] = INFINITY;
+    current[j] = INFINITY;
+  }
+
+  float costs[KEEBIE_SWIPE_DECODER_BAND * 2 + 1];
+  for (guint i = 0; i < n; i++) {
+    guint low = i > band ? i - band : 0;
+    guint high = MIN(i + band, n - 1);
+
+    // The costs of a row do not depend on each other, this loop vectorizes.
+    float x = ax[i];
+    float y = ay[i];
+    for (guint j = low; j <= high; j++) {
+      float dx = x - bx[j];
+      float dy = y - by[j];
+      costs[j - low] = dx * dx + dy * dy;
+    }
+
+    float row_min = INFINITY;
+    for (guint j = low; j <= high; j++) {
+      float best = i == 0 && j == 0 ? 0 : previous[j];
+      if (j > low) {
+        best = MIN(best, current[j - 1]);
+      }
+      if (j > 0) {
+        best = MIN(best, previous[j - 1]);
+      }
+
+      current[j] = costs[j - low] + best;
+      row_min = MIN(row_min, current[j]);
+    }
+    if (high + 1 < n) {
+      current[high + 1] = INFINITY;
+    }
+
+    if (row_min > bound) {
+      return INFINITY;
+    }
+
+    float* swap = previous;
+    previous = current;
+    current = swap;
+  }
+  return previous[n - 1];
+}
+
+static void keebie_swipe_keyboard_index(KeebieSwipeKeyboard* self) {
+  if (self->is_indexed) {
+    return;
+  }
+  self->is_indexed = TRUE;
+  self->words = g_array_new(FALSE, FALSE, sizeof (KeebieSwipeWord));
+  self->sequences = g_byte_array_new();
+  self->buckets = g_new0(uint32_t, self->n_keys * self->n_keys + 1);
+  if (self->dictionary == nullptr) {
+    return;
+  }
+
+  guint8 keys[KEEBIE_SWIPE_DECODER_MAX_WORD];
+  guint n_words = keebie_dictionary_get_n_words(self->dictionary);
+  for (guint i = 0; i < n_words; i++) {
+    gsize length = 0;
+    uint32_t frequency = 0;
+    const char* text = keebie_dictionary_get_word(self->dictionary, i, &length, &frequency);
+    if (text == nullptr || frequency == 0) {
+      continue;
+    }
+
+    // Letters held down across keys show up once in the path, and words
+    // with anything not on the plane cannot be swiped at all.
+    guint n_keys = 0;
+    gboolean is_swipeable = TRUE;
+    for (const char* p = text; p < text + length && is_swipeable; p = g_utf8_next_char(p)) {
+      gint key = keebie_swipe_keyboard_find_key(self, g_unichar_tolower(g_utf8_get_char(p)));
+      if (key < 0 || (n_keys == G_N_ELEMENTS(keys) && keys[n_keys - 1] != key)) {
+        is_swipeable = FALSE;
+      } else if (n_keys == 0 || keys[n_keys - 1] != key) {
+        keys[n_keys++] = key;
+      }
+    }
+
+    // Paths across a single key are taps.
+    if (!is_swipeable || n_keys < 2) {
+      continue;
+    }
+
+    KeebieSwipeWord word = {};
+    word.word = i;
+    word.keys_offset = self->sequences->len;
+    word.n_keys = n_keys;
+    word.prior = KEEBIE_SWIPE_DECODER_FREQUENCY_WEIGHT * logf(frequency);
+    for (guint j = 1; j < n_keys; j++) {
+      word.length += hypotf(self->keys[keys[j]].x - self->keys[keys[j - 1]].x, self->keys[keys[j]].y - self->keys[keys[j - 1]].y);
+    }
+    g_byte_array_append(self->sequences, keys, n_keys);
+    g_array_append_val(self->words, word);
+  }
+
+  // A counting sort groups the words by their first and last key.
+  for (guint i = 0; i < self->words->len; i++) {
+    const KeebieSwipeWord* word = &g_array_index(self->words, KeebieSwipeWord, i);
+    const guint8* keys = self->sequences->data + word->keys_offset;
+    self->buckets[keys[0] * self->n_keys + keys[word->n_keys - 1] + 1]++;
+  }
+  for (guint i = 1; i <= self->n_keys * self->n_keys; i++) {
+    self->buckets[i] += self->buckets[i - 1];
+  }
+
+  g_autofree uint32_t* next = static_cast<uint32_t*>(g_memdup2(self->buckets, sizeof (uint32_t) * self->n_keys * self->n_keys));
+  GArray* grouped = g_array_sized_new(FALSE, FALSE, sizeof (KeebieSwipeWord), self->words->len);
+  g_array_set_size(grouped, self->words->len);
+  for (guint i = 0; i < self->words->len; i++) {
+    const KeebieSwipeWord* word = &g_array_index(self->words, KeebieSwipeWord, i);
+    const guint8* keys = self->sequences->data + word->keys_offset;
+    g_array_index(grouped, KeebieSwipeWord, next[keys[0] * self->n_keys + keys[word->n_keys - 1]]++) = *word;
+  }
+  g_array_unref(self->words);
+  self->words = grouped;
+}
+
+// The keys within reach of x, y, or the nearest one.
+static guint keebie_swipe_keyboard_get_near_keys(const KeebieSwipeKeyboard* self, float x, float y, guint8* keys) {
+  guint n = 0;
+  guint nearest = 0;
+  float nearest_distance = INFINITY;
+  for (guint i = 0; i < self->n_keys; i++) {
+    float distance = hypotf(self->keys[i].x - x, self->keys[i].y - y);
+    if (distance <= KEEBIE_SWIPE_DECODER_REACH) {
+      keys[n++] = i;
+    }
+    if (distance < nearest_distance) {
+      nearest = i;
+      nearest_distance = distance;
+    }
+  }
+
+  if (n == 0 && self->n_keys > 0) {
+    keys[n++] = nearest;
+  }
+  return n;
+}
+
+static void keebie_swipe_keyboard_decode(KeebieSwipeKeyboard* self, const float* points, guint n_points, guint k, GPtrArray* words) {
+  if (self->words->len == 0 || n_points == 0 || k == 0) {
+    return;
+  }
+
+  g_autofree float* scaled = g_new(float, n_points * 2);
+  for (guint i = 0; i < n_points * 2; i++) {
+    scaled[i] = points[i] / self->key_width;
+  }
+
+  float path_x[KEEBIE_SWIPE_DECODER_POINTS];
+  float path_y[KEEBIE_SWIPE_DECODER_POINTS];
+  float path_length = keebie_swipe_resample(scaled, n_points, path_x, path_y);
+
+  guint8 starts[KEEBIE_SWIPE_DECODER_MAX_KEYS];
+  guint8 ends[KEEBIE_SWIPE_DECODER_MAX_KEYS];
+  guint n_starts = keebie_swipe_keyboard_get_near_keys(self, scaled[0], scaled[1], starts);
+  guint n_ends = keebie_swipe_keyboard_get_near_keys(self, scaled[n_points * 2 - 2], scaled[n_points * 2 - 1], ends);
+
+  // The best k so far, worst last, bound the cost worth computing for the rest.
+  g_autofree KeebieSwipeCandidate* best = g_new(KeebieSwipeCandidate, k);
+  guint n_best = 0;
+
+  float centers[KEEBIE_SWIPE_DECODER_MAX_WORD * 2];
+  float word_x[KEEBIE_SWIPE_DECODER_POINTS];
+  float word_y[KEEBIE_SWIPE_DECODER_POINTS];
+  const float scale = 1.0f / (2.0f * KEEBIE_SWIPE_DECODER_SIGMA * KEEBIE_SWIPE_DECODER_SIGMA * KEEBIE_SWIPE_DECODER_POINTS);
+
+  for (guint s = 0; s < n_starts; s++) {
+    for (guint e = 0; e < n_ends; e++) {
+      guint bucket = starts[s] * self->n_keys + ends[e];
+      for (uint32_t i = self->buckets[bucket]; i < self->buckets[bucket + 1]; i++) {
+        const KeebieSwipeWord* word = &g_array_index(self->words, KeebieSwipeWord, i);
+
+        // A path far shorter or longer than the word's cannot have spelled it.
+        if (fabsf(word->length - path_length) > path_length * 0.5f + 2.0f) {
+          continue;
+        }
+
+        float bound = INFINITY;
+        if (n_best == k) {
+          bound = (word->prior - best[k - 1].score) / scale;
+          if (bound <= 0) {
+            continue;
+          }
+        }
+
+        const guint8* keys = self->sequences->data + word->keys_offset;
+        for (guint j = 0; j < word->n_keys; j++) {
+          centers[j * 2] = self->keys[keys[j]].x;
+          centers[j * 2 + 1] = self->keys[keys[j]].y;
+        }
+        keebie_swipe_resample(centers, word->n_keys, word_x, word_y);
+
+        float distance = keebie_swipe_distance(path_x, path_y, word_x, word_y, bound);
+        if (!isfinite(distance)) {
+          continue;
+        }
+
+        float score = word->prior - distance * scale;
+        if (n_best == k && score <= best[k - 1].score) {
+          continue;
+        }
+
+        guint at = n_best < k ? n_best++ : k - 1;
+        while (at > 0 && best[at - 1].score < score) {
+          best[at] = best[at - 1];
+          at--;
+        }
+        best[at].score = score;
+        best[at].word = word->word;
+      }
+    }
+  }
+
+  for (guint i = 0; i < n_best; i++) {
+    gsize length = 0;
+    uint32_t frequency = 0;
+    const char* text = keebie_dictionary_get_word(self->dictionary, best[i].word, &length, &frequency);
+    if (text != nullptr) {
+      g_ptr_array_add(words, g_strndup(text, length));
+    }
+  }
+}
+
+static void keebie_swipe_task_free(gpointer data) {
+  KeebieSwipeTask* task = reinterpret_cast<KeebieSwipeTask*>(data);
+  if (task->keyboard != nullptr) {
+    keebie_swipe_keyboard_unref(task->keyboard);
+  }
+  if (task->words != nullptr) {
+    g_ptr_array_unref(task->words);
+  }
+  if (task->destroy != nullptr) {
+    task->destroy(task->data);
+  }
+  g_free(task->points);
+  g_free(task);
+}
+
+static gboolean keebie_swipe_task_deliver(gpointer data) {
+  KeebieSwipeTask* task = reinterpret_cast<KeebieSwipeTask*>(data);
+  if (task->words != nullptr) {
+    task->func(task->words, task->is_final, task->data);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+static void keebie_swipe_decoder_run(gpointer data, gpointer user_data) {
+  KeebieSwipeTask* task = reinterpret_cast<KeebieSwipeTask*>(data);
+  KeebieSwipeDecoder* self = reinterpret_cast<KeebieSwipeDecoder*>(user_data);
+
+  keebie_swipe_keyboard_index(task->keyboard);
+  if (task->func == nullptr) {
+    keebie_swipe_task_free(task);
+    return;
+  }
+
+  if (task->is_final || task->serial == g_atomic_int_get(&self->serial)) {
+    task->words = g_ptr_array_new_with_free_func(g_free);
+    keebie_swipe_keyboard_decode(task->keyboard, task->points, task->n_points, task->k, task->words);
+  }
+
+  // Freed on the main context too, whatever data holds is let go of there.
+  g_main_context_invoke_full(nullptr, G_PRIORITY_DEFAULT, keebie_swipe_task_deliver, task, keebie_swipe_task_free);
+}
+
+static void keebie_swipe_decoder_push(KeebieSwipeDecoder* self, KeebieSwipeTask* task) {
+  g_autoptr(GError) error = nullptr;
+  if (self->worker == nullptr || !g_thread_pool_push(self->worker, task, &error)) {
+    if (error != nullptr) {
+      g_warning("Failed to queue swipe decoding: %s", error->message);
+    }
+    keebie_swipe_task_free(task);
+  }
+}
+
+KeebieSwipeDecoder* keebie_swipe_decoder_new() {
+  KeebieSwipeDecoder* self = g_new0(KeebieSwipeDecoder, 1);
+  g_mutex_init(&self->lock);
+
+  // One thread, so a swipe's final decode comes after those while it lasted.
+  g_autoptr(GError) error = nullptr;
+  self->worker = g_thread_pool_new(keebie_swipe_decoder_run, self, 1, TRUE, &error);
+  if (self->worker == nullptr) {
+    g_warning("Failed to start the swipe decoder: %s", error->message);
+  }
+  return self;
+}
+
+void keebie_swipe_decoder_free(KeebieSwipeDecoder* self) {
+  if (self->worker != nullptr) {
+    g_thread_pool_free(self->worker, FALSE, TRUE);
+  }
+
+  if (self->keyboard != nullptr) {
+    keebie_swipe_keyboard_unref(self->keyboard);
+  }
+  g_mutex_clear(&self->lock);
+  g_free(self);
+}
+
+void keebie_swipe_decoder_set_keyboard(KeebieSwipeDecoder* self, KeebieDictionary* dictionary, KeebieLayout* layout, const KeebieGeometry* geometry, guint plane) {
+  KeebieSwipeKeyboard* keyboard = nullptr;
+  if (dictionary != nullptr && layout != nullptr && geometry != nullptr) {
+    keyboard = g_new0(KeebieSwipeKeyboard, 1);
+    keyboard->ref_count = 1;
+    keyboard->dictionary = keebie_dictionary_ref(dictionary);
+    keyboard->key_width = G_MAXFLOAT;
+
+    for (guint i = 0; i < geometry->n_keys && keyboard->n_keys < KEEBIE_SWIPE_DECODER_MAX_KEYS; i++) {
+      const KeebieKeyRect* rect = &geometry->keys[i];
+      const KeebieKeyAction* action = keebie_layout_lookup(layout, plane, rect->row, rect->key);
+      if (action == nullptr || action->type != KEEBIE_KEY_ACTION_COMMIT || action->key_type != KEEBIE_KEY_TYPE_REGULAR) {
+        continue;
+      }
+
+      const char* text = keebie_layout_get_text(layout, action, FALSE);
+      if (text == nullptr || text[0] == '\0' || *g_utf8_next_char(text) != '\0') {
+        continue;
+      }
+
+      gunichar c = g_unichar_tolower(g_utf8_get_char(text));
+      if (!g_unichar_isalpha(c) || keebie_swipe_keyboard_find_key(keyboard, c) >= 0) {
+        continue;
+      }
+
+      KeebieSwipeKey* key = &keyboard->keys[keyboard->n_keys];
+      key->c = c;
+      key->row = rect->row;
+      key->key = rect->key;
+      key->x = rect->x + rect->width / 2.0f;
+      key->y = rect->y + rect->height / 2.0f;
+      keyboard->key_width = MIN(keyboard->key_width, rect->width);
+      if (c < G_N_ELEMENTS(keyboard->ascii)) {
+        keyboard->ascii[c] = keyboard->n_keys + 1;
+      }
+      keyboard->n_keys++;
+    }
+
+    if (keyboard->n_keys < 2 || keyboard->key_width <= 0) {
+      keebie_swipe_keyboard_unref(keyboard);
+      keyboard = nullptr;
+    } else {
+      for (guint i = 0; i < keyboard->n_keys; i++) {
+        keyboard->keys[i].x /= keyboard->key_width;
+        keyboard->keys[i].y /= keyboard->key_width;
+      }
+    }
+  }
+
+  g_mutex_lock(&self->lock);
+  KeebieSwipeKeyboard* old = self->keyboard;
+  self->keyboard = keyboard;
+  g_mutex_unlock(&self->lock);
+
+  if (old != nullptr) {
+    keebie_swipe_keyboard_unref(old);
+  }
+
+  // Indexed ahead of time, the first swipe should not have to wait on it.
+  if (keyboard != nullptr) {
+    KeebieSwipeTask* task = g_new0(KeebieSwipeTask, 1);
+    task->keyboard = keebie_swipe_keyboard_ref(keyboard);
+    keebie_swipe_decoder_push(self, task);
+  }
+}
+
+gboolean keebie_swipe_decoder_has_key(KeebieSwipeDecoder* self, guint row, guint key) {
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+  if (self->keyboard == nullptr) {
+    return FALSE;
+  }
+
+  for (guint i = 0; i < self->keyboard->n_keys; i++) {
+    if (self->keyboard->keys[i].row == row && self->keyboard->keys[i].key == key) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+void keebie_swipe_decoder_decode(KeebieSwipeDecoder* self, const float* points, guint n_points, gboolean is_final, guint k,
+    KeebieSwipeFunc func, gpointer data, GDestroyNotify destroy) {
+  KeebieSwipeTask* task = g_new0(KeebieSwipeTask, 1);
+  task->points = static_cast<float*>(g_memdup2(points, sizeof (float) * n_points * 2));
+  task->n_points = n_points;
+  task->is_final = is_final;
+  task->k = k;
+  task->serial = g_atomic_int_add(&self->serial, 1) + 1;
+  task->func = func;
+  task->data = data;
+  task->destroy = destroy;
+
+  g_mutex_lock(&self->lock);
+  task->keyboard = self->keyboard != nullptr ? keebie_swipe_keyboard_ref(self->keyboard) : nullptr;
+  g_mutex_unlock(&self->lock);
+
+  if (task->keyboard == nullptr || n_points == 0) {
+    // Nothing to decode against still answers, with no words.
+    task->words = g_ptr_array_new_with_free_func(g_free);
+    g_main_context_invoke_full(nullptr, G_PRIORITY_DEFAULT, keebie_swipe_task_deliver, task, keebie_swipe_task_free);
+    return;
+  }
+  keebie_swipe_decoder_push(self, task);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glib.h>
+#include "dictionary.h"
+#include "geometry.h"
+#include "layout.h"
+
+G_BEGIN_DECLS
+
+/**
+ * Gets the words a swiped path most likely spelled, best first, on the main
+ * context. Final is set for the path of a finger which lifted.
+ */
+typedef void (*KeebieSwipeFunc)(GPtrArray* words, gboolean is_final, gpointer data);
+
+/**
+ * Decodes shape-writing, a path dragged across the letter keys, into words.
+ * Every dictionary word has an ideal path through the centers of its keys,
+ * the path is compared against those of the words which start and end near
+ * where it does. Decoding runs on a worker thread of the decoder's own.
+ */
+typedef struct _KeebieSwipeDecoder KeebieSwipeDecoder;
+
+KeebieSwipeDecoder* keebie_swipe_decoder_new();
+void keebie_swipe_decoder_free(KeebieSwipeDecoder* self);
+
+/**
+ * Swaps the words and the keys paths are decoded against, the single letter
+ * keys of the plane. Indexing the words happens on the worker, a NULL
+ * dictionary turns decoding off.
+ */
+void keebie_swipe_decoder_set_keyboard(KeebieSwipeDecoder* self, KeebieDictionary* dictionary, KeebieLayout* layout, const KeebieGeometry* geometry, guint plane);
+
+/**
+ * Returns whether a swipe can start on the key, one of the letters.
+ */
+gboolean keebie_swipe_decoder_has_key(KeebieSwipeDecoder* self, guint row, guint key);
+
+/**
+ * Queues decoding n_points x, y pairs within the plane, returns right away.
+ * Paths of a finger still down are only decoded while nothing newer was
+ * queued, func is not called for those which were skipped.
+ */
+void keebie_swipe_decoder_decode(KeebieSwipeDecoder* self, const float* points, guint n_points, gboolean is_final, guint k,
+  KeebieSwipeFunc func, gpointer data, GDestroyNotify destroy);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieSwipeDecoder, keebie_swipe_decoder_free);
+
+G_END_DECLS
@@ -0,0 +1,122 @@
+#include "../commit-queue.h"
+#include "test.h"
+
+typedef struct {
+  GMainContext* context;
+  GRecMutex lock;
+  KeebieCommitQueue* queue;
+
+  // Every transaction sent, as "before after text".
+  GPtrArray* commits;
+} KeebieCommitQueueTest;
+
+static void keebie_test_commit_queue_func(const KeebieCommit* commit, gpointer data) {
+  KeebieCommitQueueTest* self = reinterpret_cast<KeebieCommitQueueTest*>(data);
+  g_ptr_array_add(self->commits, g_strdup_printf("%u %u %s", commit->before, commit->after, commit->text->str));
+}
+
+static void keebie_test_commit_queue_init(KeebieCommitQueueTest* self) {
+  self->context = g_main_context_new();
+  g_rec_mutex_init(&self->lock);
+  self->queue = keebie_commit_queue_new(self->context, &self->lock, keebie_test_commit_queue_func, self);
+  self->commits = g_ptr_array_new_with_free_func(g_free);
+}
+
+static void keebie_test_commit_queue_finish(KeebieCommitQueueTest* self) {
+  keebie_commit_queue_free(self->queue);
+  g_ptr_array_unref(self->commits);
+  g_rec_mutex_clear(&self->lock);
+  g_main_context_unref(self->context);
+}
+
+// Runs the queue's context until its timer sent what is pending.
+static void keebie_test_commit_queue_wait(KeebieCommitQueueTest* self) {
+  guint n_commits = self->commits->len;
+  while (self->commits->len == n_commits) {
+    g_main_context_iteration(self->context, TRUE);
+  }
+}
+
+static const char* keebie_test_commit_queue_get(KeebieCommitQueueTest* self, guint index) {
+  return reinterpret_cast<const char*>(g_ptr_array_index(self->commits, index));
+}
+
+static void keebie_test_commit_queue_coalesce() {
+  KeebieCommitQueueTest self = {};
+  keebie_test_commit_queue_init(&self);
+
+  // The first edit after a quiet period goes out right away.
+  keebie_commit_queue_commit_text(self.queue, "か");
+  g_assert_cmpuint(self.commits->len, ==, 1);
+  g_assert_cmpstr(keebie_test_commit_queue_get(&self, 0), ==, "0 0 か");
+
+  // Edits within the budget of it wait for the timer and go out as one.
+  keebie_commit_queue_commit_text(self.queue, "な");
+  keebie_commit_queue_commit_text(self.queue, "漢字");
+  keebie_commit_queue_delete_surrounding(self.queue, 0, 3);
+  g_assert_cmpuint(self.commits->len, ==, 1);
+
+  keebie_test_commit_queue_wait(&self);
+  g_assert_cmpuint(self.commits->len, ==, 2);
+  g_assert_cmpstr(keebie_test_commit_queue_get(&self, 1), ==, "0 3 な漢字");
+
+  // Nothing pending, nothing to send.
+  keebie_commit_queue_flush(self.queue);
+  g_assert_cmpuint(self.commits->len, ==, 2);
+
+  keebie_test_commit_queue_finish(&self);
+}
+
+static void keebie_test_commit_queue_delete_surrounding() {
+  KeebieCommitQueueTest self = {};
+  keebie_test_commit_queue_init(&self);
+
+  // Sends right away and starts the budget, so the rest is held back.
+  keebie_commit_queue_commit_text(self.queue, "あ");
+  g_assert_cmpuint(self.commits->len, ==, 1);
+
+  // Deletes before the cursor take pending text first, byte by byte.
+  keebie_commit_queue_commit_text(self.queue, "かな");
+  keebie_commit_queue_delete_surrounding(self.queue, 3, 0);
+  keebie_commit_queue_flush(self.queue);
+  g_assert_cmpstr(keebie_test_commit_queue_get(&self, 1), ==, "0 0 か");
+
+  // What reaches past pending text goes to the client, after adds up.
+  keebie_commit_queue_commit_text(self.queue, "かな");
+  keebie_commit_queue_delete_surrounding(self.queue, 9, 3);
+  keebie_commit_queue_delete_surrounding(self.queue, 3, 6);
+  keebie_commit_queue_commit_text(self.queue, "漢字");
+  keebie_commit_queue_flush(self.queue);
+  g_assert_cmpstr(keebie_test_commit_queue_get(&self, 2), ==, "6 9 漢字");
+
+  // A delete on its own is a transaction as well.
+  keebie_commit_queue_delete_surrounding(self.queue, 3, 0);
+  keebie_commit_queue_flush(self.queue);
+  g_assert_cmpuint(self.commits->len, ==, 4);
+  g_assert_cmpstr(keebie_test_commit_queue_get(&self, 3), ==, "3 0 ");
+
+  keebie_test_commit_queue_finish(&self);
+}
+
+static void keebie_test_commit_queue_clear() {
+  KeebieCommitQueueTest self = {};
+  keebie_test_commit_queue_init(&self);
+
+  keebie_commit_queue_commit_text(self.queue, "あ");
+  keebie_commit_queue_commit_text(self.queue, "かな");
+  keebie_commit_queue_delete_surrounding(self.queue, 6, 3);
+  keebie_commit_queue_clear(self.queue);
+
+  // Neither the timer nor a flush sends what was dropped.
+  g_assert_false(g_main_context_iteration(self.context, FALSE));
+  keebie_commit_queue_flush(self.queue);
+  g_assert_cmpuint(self.commits->len, ==, 1);
+
+  keebie_test_commit_queue_finish(&self);
+}
+
+void keebie_test_add_commit_queue() {
+  g_test_add_func("/commit-queue/coalesce", keebie_test_commit_queue_coalesce);
+  g_test_add_func("/commit-queue/delete-surrounding", keebie_test_commit_queue_delete_surrounding);
+  g_test_add_func("/commit-queue/clear", keebie_test_commit_queue_clear);
+}
@@ -0,0 +1,138 @@
+#include <stddef.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "../converter.h"
+#include "test.h"
+
+static const char keebie_test_converter_source[] =
+  "# Comments and blank lines are skipped.\n"
+  "\n"
+  "@\tdefault\t3000\n"
+  "@\tBOS\tnoun\t0\n"
+  "@\tnoun\tBOS\t0\n"
+  "@\tnoun\tsuffix\t200\n"
+  "@\tsuffix\tBOS\t0\n"
+  "にほん\t日本\tnoun\t1000\n"
+  "にほん\t二本\tnoun\t3000\n"
+  "ご\t語\tsuffix\t500\n"
+  "にほんご\t日本語\tnoun\t1200\n";
+
+static GBytes* keebie_test_converter_build() {
+  g_autoptr(KeebieConverterBuilder) builder = keebie_converter_builder_new("ja-JP");
+  g_autoptr(GError) error = nullptr;
+  g_assert_true(keebie_converter_builder_add_source(builder, keebie_test_converter_source, strlen(keebie_test_converter_source), &error));
+  g_assert_no_error(error);
+  return keebie_converter_builder_end(builder);
+}
+
+static KeebieConverter* keebie_test_converter_load(GBytes* bytes, GError** error) {
+  g_autofree gchar* path = keebie_test_write_file(bytes);
+  KeebieConverter* converter = keebie_converter_new_from_file(path, error);
+  g_unlink(path);
+  return converter;
+}
+
+static void keebie_test_converter_round_trip() {
+  g_autoptr(GBytes) bytes = keebie_test_converter_build();
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(KeebieConverter) converter = keebie_test_converter_load(bytes, &error);
+  g_assert_no_error(error);
+  g_assert_nonnull(converter);
+  g_assert_cmpstr(keebie_converter_get_locale(converter), ==, "ja-JP");
+
+  g_autoptr(KeebieLattice) lattice = keebie_lattice_new(converter);
+  g_autoptr(GPtrArray) candidates = g_ptr_array_new_with_free_func(g_free);
+
+  // Typed one character at a time, the way the lattice is used.
+  keebie_lattice_set_reading(lattice, "にほ");
+  keebie_lattice_set_reading(lattice, "にほん");
+  g_assert_cmpuint(keebie_lattice_convert(lattice, 4, candidates), ==, 4);
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(candidates, 0)), ==, "日本");
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(candidates, 1)), ==, "二本");
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(candidates, 2)), ==, "にほん");
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(candidates, 3)), ==, "ニホン");
+
+  // The whole word is cheaper than its parts, which spell it the same anyway.
+  g_ptr_array_set_size(candidates, 0);
+  keebie_lattice_set_reading(lattice, "にほんご");
+  g_assert_cmpstr(keebie_lattice_get_reading(lattice), ==, "にほんご");
+  g_assert_cmpuint(keebie_lattice_convert(lattice, 4, candidates), ==, 4);
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(candidates, 0)), ==, "日本語");
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(candidates, 1)), ==, "二本語");
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(candidates, 2)), ==, "にほんご");
+
+  // Fewer than asked for still leaves room for the kana.
+  g_ptr_array_set_size(candidates, 0);
+  g_assert_cmpuint(keebie_lattice_convert(lattice, 2, candidates), ==, 2);
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(candidates, 0)), ==, "日本語");
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(candidates, 1)), ==, "にほんご");
+}
+
+static void keebie_test_converter_corrupt() {
+  g_autoptr(GBytes) bytes = keebie_test_converter_build();
+  gsize size = g_bytes_get_size(bytes);
+  const KeebieConverterHeader* header = reinterpret_cast<const KeebieConverterHeader*>(g_bytes_get_data(bytes, nullptr));
+
+  GBytes* corrupt[] = {
+    g_bytes_new_from_bytes(bytes, 0, sizeof (KeebieConverterHeader) - 1),
+    g_bytes_new_from_bytes(bytes, 0, size - 1),
+    keebie_test_corrupt(bytes, offsetof(KeebieConverterHeader, magic), 0),
+    keebie_test_corrupt(bytes, offsetof(KeebieConverterHeader, version), KEEBIE_CONVERTER_VERSION + 1),
+    keebie_test_corrupt(bytes, offsetof(KeebieConverterHeader, n_classes), 0),
+    keebie_test_corrupt(bytes, offsetof(KeebieConverterHeader, n_entries), G_MAXUINT32),
+    keebie_test_corrupt(bytes, offsetof(KeebieConverterHeader, readings_offset), header->readings_offset + 2),
+    keebie_test_corrupt(bytes, offsetof(KeebieConverterHeader, strings_size), size),
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS(corrupt); i++) {
+    g_autoptr(GError) error = nullptr;
+    g_autoptr(KeebieConverter) converter = keebie_test_converter_load(corrupt[i], &error);
+    g_assert_null(converter);
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+    g_bytes_unref(corrupt[i]);
+  }
+}
+
+static void keebie_test_converter_perf() {
+  g_autofree gchar* path = g_build_filename(KEEBIE_TEST_SOURCE_DIR, "assets", "converters", "ja-JP.txt", nullptr);
+  g_autoptr(GError) error = nullptr;
+  g_autofree gchar* source = nullptr;
+  gsize length = 0;
+  g_assert_true(g_file_get_contents(path, &source, &length, &error));
+  g_assert_no_error(error);
+
+  g_autoptr(KeebieConverterBuilder) builder = keebie_converter_builder_new("ja-JP");
+  g_assert_true(keebie_converter_builder_add_source(builder, source, length, &error));
+  g_assert_no_error(error);
+  g_autoptr(GBytes) bytes = keebie_converter_builder_end(builder);
+  g_autoptr(KeebieConverter) converter = keebie_test_converter_load(bytes, &error);
+  g_assert_no_error(error);
+
+  // A long run-on reading, every keystroke converts all of it again.
+  g_autoptr(GString) sentence = g_string_new(nullptr);
+  for (guint i = 0; i < 3; i++) {
+    g_string_append(sentence, "わたしはあしたとうきょうにいきます");
+  }
+
+  g_autoptr(KeebieLattice) lattice = keebie_lattice_new(converter);
+  g_autoptr(GPtrArray) candidates = g_ptr_array_new_with_free_func(g_free);
+  guint n_keystrokes = 0;
+  g_test_timer_start();
+  for (const char* p = sentence->str; *p != '\0';) {
+    p = g_utf8_next_char(p);
+    g_autofree gchar* reading = g_strndup(sentence->str, p - sentence->str);
+    keebie_lattice_set_reading(lattice, reading);
+    keebie_lattice_convert(lattice, 5, candidates);
+    g_ptr_array_set_size(candidates, 0);
+    n_keystrokes++;
+  }
+  keebie_test_check_time("keystroke", n_keystrokes, 5e-3);
+}
+
+void keebie_test_add_converter() {
+  g_test_add_func("/converter/round-trip", keebie_test_converter_round_trip);
+  g_test_add_func("/converter/corrupt", keebie_test_converter_corrupt);
+  if (g_test_perf()) {
+    g_test_add_func("/converter/perf", keebie_test_converter_perf);
+  }
+}
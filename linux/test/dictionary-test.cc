@@ -0,0 +1,138 @@
+#include <stddef.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "../dictionary.h"
+#include "test.h"
+
+// About the size of a full dictionary of a language.
+#define KEEBIE_TEST_DICTIONARY_PERF_WORDS 100000
+
+static const char keebie_test_dictionary_words[] =
+  "# Comments and blank lines are skipped.\n"
+  "\n"
+  "日本\t100\n"
+  "日本語\t80\n"
+  "日曜\t50\n"
+  "keyboard\t30\n"
+  "keyword\t20\n";
+
+static GBytes* keebie_test_dictionary_build() {
+  g_autoptr(KeebieDictionaryBuilder) builder = keebie_dictionary_builder_new("ja-JP");
+  g_autoptr(GError) error = nullptr;
+  g_assert_true(keebie_dictionary_builder_add_list(builder, keebie_test_dictionary_words, strlen(keebie_test_dictionary_words), &error));
+  g_assert_no_error(error);
+
+  // Duplicates add up.
+  keebie_dictionary_builder_add(builder, "keyword", 20);
+  return keebie_dictionary_builder_end(builder);
+}
+
+static KeebieDictionary* keebie_test_dictionary_load(GBytes* bytes, GError** error) {
+  g_autofree gchar* path = keebie_test_write_file(bytes);
+  KeebieDictionary* dictionary = keebie_dictionary_new_from_file(path, error);
+  g_unlink(path);
+  return dictionary;
+}
+
+static void keebie_test_dictionary_round_trip() {
+  g_autoptr(GBytes) bytes = keebie_test_dictionary_build();
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(KeebieDictionary) dictionary = keebie_test_dictionary_load(bytes, &error);
+  g_assert_no_error(error);
+  g_assert_nonnull(dictionary);
+
+  g_assert_cmpstr(keebie_dictionary_get_locale(dictionary), ==, "ja-JP");
+  g_assert_cmpuint(keebie_dictionary_get_n_words(dictionary), ==, 5);
+
+  g_assert_cmpuint(keebie_dictionary_lookup(dictionary, "日本語"), ==, 80);
+  g_assert_cmpuint(keebie_dictionary_lookup(dictionary, "keyword"), ==, 40);
+  g_assert_cmpuint(keebie_dictionary_lookup(dictionary, "日"), ==, 0);
+  g_assert_cmpuint(keebie_dictionary_get_best(dictionary, "日"), ==, 100);
+  g_assert_cmpuint(keebie_dictionary_get_best(dictionary, "月"), ==, 0);
+
+  g_autoptr(GPtrArray) words = g_ptr_array_new_with_free_func(g_free);
+  g_assert_cmpuint(keebie_dictionary_complete(dictionary, "日", 2, words), ==, 2);
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(words, 0)), ==, "日本");
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(words, 1)), ==, "日本語");
+
+  g_ptr_array_set_size(words, 0);
+  g_assert_cmpuint(keebie_dictionary_complete(dictionary, "key", 5, words), ==, 2);
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(words, 0)), ==, "keyword");
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(words, 1)), ==, "keyboard");
+
+  g_ptr_array_set_size(words, 0);
+  g_assert_cmpuint(keebie_dictionary_correct(dictionary, "keyboadr", nullptr, nullptr, 1, words), ==, 1);
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(words, 0)), ==, "keyboard");
+
+  gsize length = 0;
+  uint32_t frequency = 0;
+  const char* word = keebie_dictionary_get_word(dictionary, 0, &length, &frequency);
+  g_assert_nonnull(word);
+  g_assert_cmpuint(length, ==, 8);
+  g_assert_cmpuint(frequency, ==, 30);
+}
+
+static void keebie_test_dictionary_corrupt() {
+  g_autoptr(GBytes) bytes = keebie_test_dictionary_build();
+  gsize size = g_bytes_get_size(bytes);
+
+  GBytes* corrupt[] = {
+    g_bytes_new_from_bytes(bytes, 0, sizeof (KeebieDictionaryHeader) - 1),
+    g_bytes_new_from_bytes(bytes, 0, size - 4),
+    keebie_test_corrupt(bytes, offsetof(KeebieDictionaryHeader, magic), 0),
+    keebie_test_corrupt(bytes, offsetof(KeebieDictionaryHeader, version), KEEBIE_DICTIONARY_VERSION + 1),
+    keebie_test_corrupt(bytes, offsetof(KeebieDictionaryHeader, n_nodes), G_MAXUINT32),
+    keebie_test_corrupt(bytes, offsetof(KeebieDictionaryHeader, edges_offset), size + 4),
+    keebie_test_corrupt(bytes, offsetof(KeebieDictionaryHeader, n_buckets), 3),
+    keebie_test_corrupt(bytes, offsetof(KeebieDictionaryHeader, strings_size), size),
+    keebie_test_corrupt(bytes, offsetof(KeebieDictionaryHeader, root), G_MAXUINT32),
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS(corrupt); i++) {
+    g_autoptr(GError) error = nullptr;
+    g_autoptr(KeebieDictionary) dictionary = keebie_test_dictionary_load(corrupt[i], &error);
+    g_assert_null(dictionary);
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+    g_bytes_unref(corrupt[i]);
+  }
+}
+
+static void keebie_test_dictionary_perf() {
+  gsize length = 0;
+  g_autofree gchar* list = keebie_test_generate_word_list(KEEBIE_TEST_DICTIONARY_PERF_WORDS, &length);
+  g_autoptr(KeebieDictionaryBuilder) builder = keebie_dictionary_builder_new("en-US");
+  g_autoptr(GError) error = nullptr;
+  g_assert_true(keebie_dictionary_builder_add_list(builder, list, length, &error));
+  g_assert_no_error(error);
+
+  g_autoptr(GBytes) bytes = keebie_dictionary_builder_end(builder);
+  g_autoptr(KeebieDictionary) dictionary = keebie_test_dictionary_load(bytes, &error);
+  g_assert_no_error(error);
+
+  // Every prefix of the words, the way they are completed while typed.
+  g_autoptr(GPtrArray) prefixes = g_ptr_array_new_with_free_func(g_free);
+  for (guint i = 0; i < keebie_dictionary_get_n_words(dictionary); i += 97) {
+    gsize word_length = 0;
+    uint32_t frequency = 0;
+    const char* word = keebie_dictionary_get_word(dictionary, i, &word_length, &frequency);
+    for (gsize j = 1; j <= word_length; j++) {
+      g_ptr_array_add(prefixes, g_strndup(word, j));
+    }
+  }
+
+  g_autoptr(GPtrArray) words = g_ptr_array_new_with_free_func(g_free);
+  g_test_timer_start();
+  for (guint i = 0; i < prefixes->len; i++) {
+    keebie_dictionary_complete(dictionary, reinterpret_cast<const char*>(g_ptr_array_index(prefixes, i)), 3, words);
+    g_ptr_array_set_size(words, 0);
+  }
+  keebie_test_check_time("completion", prefixes->len, 1e-3);
+}
+
+void keebie_test_add_dictionary() {
+  g_test_add_func("/dictionary/round-trip", keebie_test_dictionary_round_trip);
+  g_test_add_func("/dictionary/corrupt", keebie_test_dictionary_corrupt);
+  if (g_test_perf()) {
+    g_test_add_func("/dictionary/perf", keebie_test_dictionary_perf);
+  }
+}
@@ -0,0 +1,117 @@
+#include <stddef.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "../emoji.h"
+#include "test.h"
+
+static const char keebie_test_emoji_catalog[] =
+  "# Comments and blank lines are skipped.\n"
+  "\n"
+  "😀\tgrinning face\n"
+  "🐱\tcat\n"
+  "😺\tgrinning cat face\n";
+
+// A locale's annotations add keywords and their own symbols on top.
+static const char keebie_test_emoji_annotations[] =
+  "🐱\tねこ\n"
+  "〒\tゆうびん\n";
+
+static GBytes* keebie_test_emoji_build() {
+  g_autoptr(KeebieEmojiBuilder) builder = keebie_emoji_builder_new("ja-JP");
+  g_autoptr(GError) error = nullptr;
+  g_assert_true(keebie_emoji_builder_add_source(builder, keebie_test_emoji_catalog, strlen(keebie_test_emoji_catalog), &error));
+  g_assert_true(keebie_emoji_builder_add_source(builder, keebie_test_emoji_annotations, strlen(keebie_test_emoji_annotations), &error));
+  g_assert_no_error(error);
+  return keebie_emoji_builder_end(builder);
+}
+
+static KeebieEmoji* keebie_test_emoji_load(GBytes* bytes, GError** error) {
+  g_autofree gchar* path = keebie_test_write_file(bytes);
+  KeebieEmoji* emoji = keebie_emoji_new_from_file(path, error);
+  g_unlink(path);
+  return emoji;
+}
+
+static gdouble keebie_test_emoji_score(const char* text, gpointer data) {
+  return g_strcmp0(text, reinterpret_cast<const char*>(data)) == 0 ? 1.0 : 0.0;
+}
+
+// Searches and joins the texts found with spaces.
+static gchar* keebie_test_emoji_search(KeebieEmoji* emoji, const char* query, KeebieEmojiScoreFunc score, gpointer data) {
+  g_autoptr(GArray) indices = g_array_new(FALSE, FALSE, sizeof (uint32_t));
+  guint n = keebie_emoji_search(emoji, query, 8, score, data, indices);
+  g_assert_cmpuint(n, ==, indices->len);
+
+  GString* texts = g_string_new(nullptr);
+  for (guint i = 0; i < n; i++) {
+    if (i > 0) {
+      g_string_append_c(texts, ' ');
+    }
+    g_string_append(texts, keebie_emoji_get_text(emoji, g_array_index(indices, uint32_t, i)));
+  }
+  return g_string_free(texts, FALSE);
+}
+
+static void keebie_test_emoji_round_trip() {
+  g_autoptr(GBytes) bytes = keebie_test_emoji_build();
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(KeebieEmoji) emoji = keebie_test_emoji_load(bytes, &error);
+  g_assert_no_error(error);
+  g_assert_nonnull(emoji);
+
+  g_assert_cmpstr(keebie_emoji_get_locale(emoji), ==, "ja-JP");
+  g_assert_cmpuint(keebie_emoji_get_n_entries(emoji), ==, 4);
+  g_assert_cmpstr(keebie_emoji_get_text(emoji, 0), ==, "😀");
+  g_assert_cmpstr(keebie_emoji_get_text(emoji, 3), ==, "〒");
+
+  g_autofree gchar* cat = keebie_test_emoji_search(emoji, "cat", nullptr, nullptr);
+  g_assert_cmpstr(cat, ==, "🐱 😺");
+
+  // Short words match the start of keywords, every word has to match.
+  g_autofree gchar* gr = keebie_test_emoji_search(emoji, "gr", nullptr, nullptr);
+  g_assert_cmpstr(gr, ==, "😀 😺");
+  g_autofree gchar* grinning_cat = keebie_test_emoji_search(emoji, "grinning cat", nullptr, nullptr);
+  g_assert_cmpstr(grinning_cat, ==, "😺");
+
+  // Matches at the start of a keyword come first, then by score.
+  g_autofree gchar* ace = keebie_test_emoji_search(emoji, "ace", nullptr, nullptr);
+  g_assert_cmpstr(ace, ==, "😀 😺");
+  g_autofree gchar* face = keebie_test_emoji_search(emoji, "face", keebie_test_emoji_score, const_cast<char*>("😺"));
+  g_assert_cmpstr(face, ==, "😺 😀");
+
+  g_autofree gchar* neko = keebie_test_emoji_search(emoji, "ねこ", nullptr, nullptr);
+  g_assert_cmpstr(neko, ==, "🐱");
+  g_autofree gchar* none = keebie_test_emoji_search(emoji, "dog", nullptr, nullptr);
+  g_assert_cmpstr(none, ==, "");
+}
+
+static void keebie_test_emoji_corrupt() {
+  g_autoptr(GBytes) bytes = keebie_test_emoji_build();
+  gsize size = g_bytes_get_size(bytes);
+  const KeebieEmojiHeader* header = reinterpret_cast<const KeebieEmojiHeader*>(g_bytes_get_data(bytes, nullptr));
+
+  GBytes* corrupt[] = {
+    g_bytes_new_from_bytes(bytes, 0, sizeof (KeebieEmojiHeader) - 1),
+    g_bytes_new_from_bytes(bytes, 0, size - 1),
+    keebie_test_corrupt(bytes, offsetof(KeebieEmojiHeader, magic), 0),
+    keebie_test_corrupt(bytes, offsetof(KeebieEmojiHeader, version), KEEBIE_EMOJI_VERSION + 1),
+    keebie_test_corrupt(bytes, offsetof(KeebieEmojiHeader, n_postings), G_MAXUINT32),
+    keebie_test_corrupt(bytes, header->entries_offset + offsetof(KeebieEmojiEntry, text_length), 0),
+    keebie_test_corrupt(bytes, header->entries_offset + offsetof(KeebieEmojiEntry, keywords_offset), header->strings_size),
+    keebie_test_corrupt(bytes, header->trigrams_offset + offsetof(KeebieEmojiTrigram, n_postings), header->n_postings + 1),
+    keebie_test_corrupt(bytes, header->postings_offset, header->n_entries),
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS(corrupt); i++) {
+    g_autoptr(GError) error = nullptr;
+    g_autoptr(KeebieEmoji) emoji = keebie_test_emoji_load(corrupt[i], &error);
+    g_assert_null(emoji);
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+    g_bytes_unref(corrupt[i]);
+  }
+}
+
+void keebie_test_add_emoji() {
+  g_test_add_func("/emoji/round-trip", keebie_test_emoji_round_trip);
+  g_test_add_func("/emoji/corrupt", keebie_test_emoji_corrupt);
+}
@@ -0,0 +1,82 @@
+#include <json-glib/json-glib.h>
+#include "../geometry.h"
+#include "../layout-json.h"
+#include "test.h"
+
+// Until the runner has a layout, the Dart side solves the same rects in
+// KeyboardGeometry.solve, test/geometry_test.dart checks it against this
+// fixture as well so neither drifts from the other.
+#define KEEBIE_TEST_GEOMETRY_FIXTURE KEEBIE_TEST_SOURCE_DIR "/test/fixtures/geometry.json"
+
+static KeebieLayout* keebie_test_geometry_load_layout(const char* name) {
+  g_autofree gchar* basename = g_strconcat(name, ".json", nullptr);
+  g_autofree gchar* path = g_build_filename(KEEBIE_TEST_SOURCE_DIR, "assets", "keyboards", basename, nullptr);
+  g_autoptr(GError) error = nullptr;
+  g_autofree gchar* data = nullptr;
+  gsize length = 0;
+  g_assert_true(g_file_get_contents(path, &data, &length, &error));
+  g_assert_no_error(error);
+
+  g_autoptr(GBytes) bytes = keebie_layout_compile_json(data, length, &error);
+  g_assert_no_error(error);
+  KeebieLayout* layout = keebie_layout_new_from_bytes(bytes, &error);
+  g_assert_no_error(error);
+  return layout;
+}
+
+static void keebie_test_geometry_bundled_layouts() {
+  g_autoptr(GError) error = nullptr;
+  g_autofree gchar* data = nullptr;
+  gsize length = 0;
+  g_assert_true(g_file_get_contents(KEEBIE_TEST_GEOMETRY_FIXTURE, &data, &length, &error));
+  g_assert_no_error(error);
+
+  g_autoptr(JsonParser) parser = json_parser_new_immutable();
+  g_assert_true(json_parser_load_from_data(parser, data, length, &error));
+  g_assert_no_error(error);
+
+  JsonArray* cases = json_node_get_array(json_parser_get_root(parser));
+  g_assert_cmpuint(json_array_get_length(cases), >, 0);
+
+  KeebieGeometryCache* cache = keebie_geometry_cache_new();
+  for (guint i = 0; i < json_array_get_length(cases); i++) {
+    JsonObject* expected = json_array_get_object_element(cases, i);
+    g_autoptr(KeebieLayout) layout = keebie_test_geometry_load_layout(json_object_get_string_member(expected, "layout"));
+
+    KeebieGeometryParams params = {};
+    params.plane = json_object_get_int_member(expected, "plane");
+    params.child_size = json_object_get_double_member(expected, "childSize");
+    params.padding = json_object_get_double_member(expected, "padding");
+    params.monitor_width = json_object_get_double_member(expected, "monitorWidth");
+    params.monitor_height = json_object_get_double_member(expected, "monitorHeight");
+
+    JsonArray* constraints = json_object_get_array_member(expected, "constraints");
+    for (guint j = 0; j < json_array_get_length(constraints); j++) {
+      params.constraints |= keebie_key_constraint_from_string(json_array_get_string_element(constraints, j));
+    }
+
+    // The cache is keyed by params alone, every layout has to solve afresh.
+    keebie_geometry_cache_clear(cache);
+    g_autoptr(KeebieGeometry) geometry = keebie_geometry_cache_get(cache, layout, &params);
+    g_assert_cmpfloat_with_epsilon(geometry->width, json_object_get_double_member(expected, "width"), 0.01);
+    g_assert_cmpfloat_with_epsilon(geometry->height, json_object_get_double_member(expected, "height"), 0.01);
+
+    JsonArray* keys = json_object_get_array_member(expected, "keys");
+    g_assert_cmpuint(geometry->n_keys, ==, json_array_get_length(keys));
+    for (guint k = 0; k < geometry->n_keys; k++) {
+      JsonObject* key = json_array_get_object_element(keys, k);
+      const KeebieKeyRect* rect = &geometry->keys[k];
+      g_assert_cmpuint(rect->row, ==, json_object_get_int_member(key, "row"));
+      g_assert_cmpuint(rect->key, ==, json_object_get_int_member(key, "key"));
+      g_assert_cmpfloat_with_epsilon(rect->x, json_object_get_double_member(key, "x"), 0.01);
+      g_assert_cmpfloat_with_epsilon(rect->y, json_object_get_double_member(key, "y"), 0.01);
+      g_assert_cmpfloat_with_epsilon(rect->width, json_object_get_double_member(key, "width"), 0.01);
+      g_assert_cmpfloat_with_epsilon(rect->height, json_object_get_double_member(key, "height"), 0.01);
+    }
+  }
+  keebie_geometry_cache_free(cache);
+}
+
+void keebie_test_add_geometry() {
+  g_test_add_func("/geometry/bundled-layouts", keebie_test_geometry_bundled_layouts);
+}
@@ -0,0 +1,175 @@
+#include <stddef.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "../handwriting.h"
+#include "test.h"
+
+#define KEEBIE_TEST_HANDWRITING_PERF_CHARACTERS 50
+#define KEEBIE_TEST_HANDWRITING_PERF_STROKES 4
+#define KEEBIE_TEST_HANDWRITING_PERF_POINTS 48
+
+static const char keebie_test_handwriting_source[] =
+  "# Comments and blank lines are skipped.\n"
+  "\n"
+  "一\t10,50 90,50\n"
+  "二\t25,30 75,30\t10,70 90,70\n"
+  "丨\t50,10 50,90\n";
+
+typedef struct {
+  guint n_results;
+  gchar* best;
+  guint n_strokes;
+} KeebieHandwritingTest;
+
+static void keebie_test_handwriting_func(const char* const* characters, guint n_characters, guint n_strokes, gpointer data) {
+  KeebieHandwritingTest* self = reinterpret_cast<KeebieHandwritingTest*>(data);
+  self->n_results++;
+  g_free(self->best);
+  self->best = n_characters > 0 ? g_strdup(characters[0]) : nullptr;
+  self->n_strokes = n_strokes;
+}
+
+// Results come back on the main context once the recognizer's thread is done.
+static void keebie_test_handwriting_wait(KeebieHandwritingTest* self) {
+  guint n_results = self->n_results;
+  while (self->n_results == n_results) {
+    g_main_context_iteration(nullptr, TRUE);
+  }
+}
+
+static GBytes* keebie_test_handwriting_build() {
+  g_autoptr(KeebieHandwritingBuilder) builder = keebie_handwriting_builder_new("ja-JP");
+  g_autoptr(GError) error = nullptr;
+  g_assert_true(keebie_handwriting_builder_add_source(builder, keebie_test_handwriting_source, strlen(keebie_test_handwriting_source), &error));
+  g_assert_no_error(error);
+  return keebie_handwriting_builder_end(builder);
+}
+
+static KeebieHandwriting* keebie_test_handwriting_load(GBytes* bytes, GError** error) {
+  g_autofree gchar* path = keebie_test_write_file(bytes);
+  KeebieHandwriting* handwriting = keebie_handwriting_new_from_file(path, error);
+  g_unlink(path);
+  return handwriting;
+}
+
+static void keebie_test_handwriting_round_trip() {
+  g_autoptr(GBytes) bytes = keebie_test_handwriting_build();
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(KeebieHandwriting) handwriting = keebie_test_handwriting_load(bytes, &error);
+  g_assert_no_error(error);
+  g_assert_nonnull(handwriting);
+  g_assert_cmpstr(keebie_handwriting_get_locale(handwriting), ==, "ja-JP");
+  g_assert_cmpuint(keebie_handwriting_get_n_characters(handwriting), ==, 3);
+
+  KeebieHandwritingTest self = {};
+  g_autoptr(KeebieHandwritingRecognizer) recognizer = keebie_handwriting_recognizer_new(3, keebie_test_handwriting_func, &self);
+  keebie_handwriting_recognizer_set_handwriting(recognizer, handwriting);
+  keebie_test_handwriting_wait(&self);
+  g_assert_null(self.best);
+
+  // Written a little off from the templates, in units of the box.
+  const float top[] = { 0.12f, 0.52f, 0.5f, 0.5f, 0.88f, 0.48f };
+  g_assert_true(keebie_handwriting_recognizer_add_stroke(recognizer, top, 3));
+  keebie_test_handwriting_wait(&self);
+  g_assert_cmpstr(self.best, ==, "一");
+  g_assert_cmpuint(self.n_strokes, ==, 1);
+
+  // Two strokes only match 二, though the first sits lower than its template's.
+  const float bottom[] = { 0.12f, 0.72f, 0.88f, 0.68f };
+  g_assert_true(keebie_handwriting_recognizer_add_stroke(recognizer, bottom, 2));
+  keebie_test_handwriting_wait(&self);
+  g_assert_cmpstr(self.best, ==, "二");
+  g_assert_cmpuint(self.n_strokes, ==, 2);
+
+  g_assert_true(keebie_handwriting_recognizer_undo_stroke(recognizer));
+  keebie_test_handwriting_wait(&self);
+  g_assert_cmpstr(self.best, ==, "一");
+  g_assert_cmpuint(keebie_handwriting_recognizer_get_n_strokes(recognizer), ==, 1);
+
+  keebie_handwriting_recognizer_clear(recognizer);
+  keebie_test_handwriting_wait(&self);
+  g_assert_null(self.best);
+  g_assert_false(keebie_handwriting_recognizer_undo_stroke(recognizer));
+  g_free(self.best);
+}
+
+static void keebie_test_handwriting_corrupt() {
+  g_autoptr(GBytes) bytes = keebie_test_handwriting_build();
+  gsize size = g_bytes_get_size(bytes);
+  const KeebieHandwritingHeader* header = reinterpret_cast<const KeebieHandwritingHeader*>(g_bytes_get_data(bytes, nullptr));
+  gsize last = header->characters_offset + (header->n_characters - 1) * sizeof (KeebieHandwritingCharacter);
+
+  GBytes* corrupt[] = {
+    g_bytes_new_from_bytes(bytes, 0, sizeof (KeebieHandwritingHeader) - 1),
+    g_bytes_new_from_bytes(bytes, 0, size - 1),
+    keebie_test_corrupt(bytes, offsetof(KeebieHandwritingHeader, magic), 0),
+    keebie_test_corrupt(bytes, offsetof(KeebieHandwritingHeader, version), KEEBIE_HANDWRITING_VERSION + 1),
+    keebie_test_corrupt(bytes, offsetof(KeebieHandwritingHeader, n_strokes), G_MAXUINT32),
+    keebie_test_corrupt(bytes, last + offsetof(KeebieHandwritingCharacter, first_stroke), header->n_strokes),
+    keebie_test_corrupt(bytes, last + offsetof(KeebieHandwritingCharacter, text_offset), header->strings_size),
+    keebie_test_corrupt(bytes, last + offsetof(KeebieHandwritingCharacter, n_strokes), 0),
+    // Out of order by stroke count.
+    keebie_test_corrupt(bytes, header->characters_offset + offsetof(KeebieHandwritingCharacter, n_strokes), 2),
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS(corrupt); i++) {
+    g_autoptr(GError) error = nullptr;
+    g_autoptr(KeebieHandwriting) handwriting = keebie_test_handwriting_load(corrupt[i], &error);
+    g_assert_null(handwriting);
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+    g_bytes_unref(corrupt[i]);
+  }
+}
+
+static void keebie_test_handwriting_perf() {
+  g_autofree gchar* path = g_build_filename(KEEBIE_TEST_SOURCE_DIR, "assets", "handwriting", "ja-JP.txt", nullptr);
+  g_autoptr(GError) error = nullptr;
+  g_autofree gchar* source = nullptr;
+  gsize length = 0;
+  g_assert_true(g_file_get_contents(path, &source, &length, &error));
+  g_assert_no_error(error);
+
+  g_autoptr(KeebieHandwritingBuilder) builder = keebie_handwriting_builder_new("ja-JP");
+  g_assert_true(keebie_handwriting_builder_add_source(builder, source, length, &error));
+  g_assert_no_error(error);
+  g_autoptr(GBytes) bytes = keebie_handwriting_builder_end(builder);
+  g_autoptr(KeebieHandwriting) handwriting = keebie_test_handwriting_load(bytes, &error);
+  g_assert_no_error(error);
+
+  KeebieHandwritingTest self = {};
+  g_autoptr(KeebieHandwritingRecognizer) recognizer = keebie_handwriting_recognizer_new(5, keebie_test_handwriting_func, &self);
+  keebie_handwriting_recognizer_set_handwriting(recognizer, handwriting);
+  keebie_test_handwriting_wait(&self);
+
+  // Strokes as densely sampled as a finger's, slanting a little differently
+  // each time.
+  float points[KEEBIE_TEST_HANDWRITING_PERF_POINTS * 2];
+  guint n_strokes = 0;
+  g_test_timer_start();
+  for (guint i = 0; i < KEEBIE_TEST_HANDWRITING_PERF_CHARACTERS; i++) {
+    for (guint j = 0; j < KEEBIE_TEST_HANDWRITING_PERF_STROKES; j++) {
+      for (guint p = 0; p < KEEBIE_TEST_HANDWRITING_PERF_POINTS; p++) {
+        float t = static_cast<float>(p) / (KEEBIE_TEST_HANDWRITING_PERF_POINTS - 1);
+        points[p * 2] = 0.1f + 0.8f * t;
+        points[p * 2 + 1] = 0.2f + 0.2f * j + 0.1f * t * ((i + j) % 3);
+      }
+
+      g_assert_true(keebie_handwriting_recognizer_add_stroke(recognizer, points, KEEBIE_TEST_HANDWRITING_PERF_POINTS));
+      keebie_test_handwriting_wait(&self);
+      n_strokes++;
+    }
+
+    keebie_handwriting_recognizer_clear(recognizer);
+    keebie_test_handwriting_wait(&self);
+  }
+  keebie_test_check_time("stroke", n_strokes, 16e-3);
+  g_free(self.best);
+}
+
+void keebie_test_add_handwriting() {
+  g_test_add_func("/handwriting/round-trip", keebie_test_handwriting_round_trip);
+  g_test_add_func("/handwriting/corrupt", keebie_test_handwriting_corrupt);
+  if (g_test_perf()) {
+    g_test_add_func("/handwriting/perf", keebie_test_handwriting_perf);
+  }
+}
@@ -0,0 +1,115 @@
+#include <stddef.h>
+#include <glib/gstdio.h>
+#include "../layout.h"
+#include "test.h"
+
+static void keebie_test_layout_add_key(KeebieLayoutBuilder* builder, KeebieKeyType type, const char* name, const char* shifted_name, int32_t plane) {
+  KeebieLayoutKeyInfo info = {};
+  info.type = type;
+  info.name = name;
+  info.shifted_name = shifted_name;
+  info.plane = plane;
+  keebie_layout_builder_add_key(builder, &info);
+}
+
+static GBytes* keebie_test_layout_build() {
+  g_autoptr(KeebieLayoutBuilder) builder = keebie_layout_builder_new("ja-JP");
+
+  keebie_layout_builder_add_plane(builder, KEEBIE_PLANE_TYPE_KEYS);
+  keebie_layout_builder_set_content_plane(builder, KEEBIE_CONTENT_TYPE_TEXT, 0);
+  keebie_layout_builder_add_row(builder);
+  keebie_test_layout_add_key(builder, KEEBIE_KEY_TYPE_REGULAR, "あ", "ア", -1);
+  keebie_test_layout_add_key(builder, KEEBIE_KEY_TYPE_REGULAR, "か", nullptr, -1);
+  keebie_test_layout_add_key(builder, KEEBIE_KEY_TYPE_BACKSPACE, nullptr, nullptr, -1);
+  keebie_layout_builder_add_row(builder);
+  keebie_test_layout_add_key(builder, KEEBIE_KEY_TYPE_PLANE, "😀", nullptr, 1);
+  keebie_test_layout_add_key(builder, KEEBIE_KEY_TYPE_SPACE, nullptr, nullptr, -1);
+
+  keebie_layout_builder_add_plane(builder, KEEBIE_PLANE_TYPE_EMOJI);
+  keebie_layout_builder_add_row(builder);
+  keebie_test_layout_add_key(builder, KEEBIE_KEY_TYPE_PLANE, "あ", nullptr, 0);
+  g_assert_cmpuint(keebie_layout_builder_get_n_planes(builder), ==, 2);
+  return keebie_layout_builder_end(builder);
+}
+
+static void keebie_test_layout_round_trip() {
+  g_autoptr(GBytes) bytes = keebie_test_layout_build();
+  g_autofree gchar* path = keebie_test_write_file(bytes);
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(KeebieLayout) layout = keebie_layout_new_from_file(path, &error);
+  g_unlink(path);
+  g_assert_no_error(error);
+  g_assert_nonnull(layout);
+
+  g_assert_cmpstr(keebie_layout_get_locale(layout), ==, "ja-JP");
+  g_assert_cmpint(keebie_layout_get_content_plane(layout, KEEBIE_CONTENT_TYPE_TEXT), ==, 0);
+  g_assert_cmpint(keebie_layout_get_content_plane(layout, KEEBIE_CONTENT_TYPE_NUMBER), ==, -1);
+  g_assert_cmpuint(keebie_layout_get_n_planes(layout), ==, 2);
+  g_assert_cmpint(keebie_layout_get_plane_type(layout, 1), ==, KEEBIE_PLANE_TYPE_EMOJI);
+  g_assert_cmpuint(keebie_layout_get_n_rows(layout, 0), ==, 2);
+  g_assert_cmpuint(keebie_layout_get_n_keys(layout, 0, 0), ==, 3);
+  g_assert_cmpuint(keebie_layout_get_n_keys(layout, 0, 1), ==, 2);
+  g_assert_cmpuint(keebie_layout_get_n_keys(layout, 1, 0), ==, 1);
+
+  const KeebieKeyAction* action = keebie_layout_lookup(layout, 0, 0, 0);
+  g_assert_nonnull(action);
+  g_assert_cmpint(action->type, ==, KEEBIE_KEY_ACTION_COMMIT);
+  g_assert_cmpstr(keebie_layout_get_text(layout, action, FALSE), ==, "あ");
+  g_assert_cmpstr(keebie_layout_get_text(layout, action, TRUE), ==, "ア");
+
+  // Without a shifted name the key types the same either way.
+  action = keebie_layout_lookup(layout, 0, 0, 1);
+  g_assert_cmpstr(keebie_layout_get_text(layout, action, TRUE), ==, "か");
+
+  action = keebie_layout_lookup(layout, 0, 0, 2);
+  g_assert_cmpint(action->type, ==, KEEBIE_KEY_ACTION_DELETE);
+  g_assert_cmpuint(action->arg, ==, 1);
+
+  action = keebie_layout_lookup(layout, 0, 1, 0);
+  g_assert_cmpint(action->type, ==, KEEBIE_KEY_ACTION_PLANE);
+  g_assert_cmpuint(action->arg, ==, 1);
+  const KeebieLayoutKey* key = keebie_layout_lookup_key(layout, 0, 1, 0);
+  g_assert_cmpstr(keebie_layout_get_string(layout, key->name), ==, "😀");
+  g_assert_cmpint(key->plane, ==, 1);
+
+  action = keebie_layout_lookup(layout, 0, 1, 1);
+  g_assert_cmpstr(keebie_layout_get_text(layout, action, FALSE), ==, " ");
+
+  // Lookups past the end find nothing.
+  g_assert_null(keebie_layout_lookup(layout, 0, 1, 2));
+  g_assert_null(keebie_layout_lookup(layout, 0, 2, 0));
+  g_assert_null(keebie_layout_lookup(layout, 2, 0, 0));
+}
+
+static void keebie_test_layout_corrupt() {
+  g_autoptr(GBytes) bytes = keebie_test_layout_build();
+  gsize size = g_bytes_get_size(bytes);
+  const KeebieLayoutHeader* header = reinterpret_cast<const KeebieLayoutHeader*>(g_bytes_get_data(bytes, nullptr));
+
+  GBytes* corrupt[] = {
+    g_bytes_new_from_bytes(bytes, 0, sizeof (KeebieLayoutHeader) - 1),
+    g_bytes_new_from_bytes(bytes, 0, size - 1),
+    keebie_test_corrupt(bytes, offsetof(KeebieLayoutHeader, magic), 0),
+    keebie_test_corrupt(bytes, offsetof(KeebieLayoutHeader, version), KEEBIE_LAYOUT_VERSION + 1),
+    keebie_test_corrupt(bytes, offsetof(KeebieLayoutHeader, n_keys), G_MAXUINT32),
+    keebie_test_corrupt(bytes, offsetof(KeebieLayoutHeader, locale), header->strings_size),
+    keebie_test_corrupt(bytes, header->planes_offset + sizeof (KeebieLayoutPlane) + offsetof(KeebieLayoutPlane, n_rows), header->n_rows),
+    keebie_test_corrupt(bytes, header->planes_offset + offsetof(KeebieLayoutPlane, type), KEEBIE_N_PLANE_TYPES),
+    keebie_test_corrupt(bytes, header->rows_offset + offsetof(KeebieLayoutRow, first_key), header->n_keys + 1),
+    keebie_test_corrupt(bytes, header->actions_offset + offsetof(KeebieKeyAction, text), header->strings_size),
+    keebie_test_corrupt(bytes, header->keys_offset + offsetof(KeebieLayoutKey, name), header->strings_size),
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS(corrupt); i++) {
+    g_autoptr(GError) error = nullptr;
+    g_autoptr(KeebieLayout) layout = keebie_layout_new_from_bytes(corrupt[i], &error);
+    g_assert_null(layout);
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+    g_bytes_unref(corrupt[i]);
+  }
+}
+
+void keebie_test_add_layout() {
+  g_test_add_func("/layout/round-trip", keebie_test_layout_round_trip);
+  g_test_add_func("/layout/corrupt", keebie_test_layout_corrupt);
+}
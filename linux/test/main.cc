@@ -0,0 +1,19 @@
+#include "test.h"
+
+int main(int argc, char** argv) {
+  g_test_init(&argc, &argv, nullptr);
+
+  keebie_test_add_commit_queue();
+  keebie_test_add_converter();
+  keebie_test_add_dictionary();
+  keebie_test_add_emoji();
+  keebie_test_add_geometry();
+  keebie_test_add_handwriting();
+  keebie_test_add_layout();
+  keebie_test_add_surrounding();
+  keebie_test_add_swipe_decoder();
+  keebie_test_add_touch_model();
+  keebie_test_add_touch_tracker();
+  keebie_test_add_user_model();
+  return g_test_run();
+}
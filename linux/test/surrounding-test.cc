@@ -0,0 +1,186 @@
+#include <string.h>
+#include "../surrounding.h"
+#include "test.h"
+
+// Every kana and kanji is 3 bytes in UTF-8, emoji outside the BMP are 4.
+
+static void keebie_test_surrounding_delete_word() {
+  KeebieSurrounding surrounding = {};
+  uint32_t before;
+  uint32_t after;
+
+  // A change of script ends a Japanese word, the okurigana goes first.
+  keebie_surrounding_set(&surrounding, "今日は晴れ", 15, 15);
+  g_assert_true(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_WORD, 1, &before, &after));
+  g_assert_cmpuint(before, ==, 3);
+  g_assert_cmpuint(after, ==, 0);
+
+  g_assert_true(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_WORD, 2, &before, &after));
+  g_assert_cmpuint(before, ==, 6);
+
+  // The prolonged sound mark belongs to the katakana around it.
+  keebie_surrounding_set(&surrounding, "コーヒーを", 12, 12);
+  g_assert_true(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_WORD, 1, &before, &after));
+  g_assert_cmpuint(before, ==, 12);
+
+  // Spaces before the cursor go with the word, the count stops at the text's start.
+  keebie_surrounding_set(&surrounding, "日本 語  ", 12, 12);
+  g_assert_true(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_WORD, 1, &before, &after));
+  g_assert_cmpuint(before, ==, 5);
+  g_assert_true(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_WORD, 5, &before, &after));
+  g_assert_cmpuint(before, ==, 12);
+
+  keebie_surrounding_set(&surrounding, "日本", 0, 0);
+  g_assert_false(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_WORD, 1, &before, &after));
+  g_assert_cmpuint(before, ==, 0);
+
+  keebie_surrounding_clear(&surrounding);
+  g_assert_false(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_WORD, 1, &before, &after));
+}
+
+static void keebie_test_surrounding_delete_sentence() {
+  KeebieSurrounding surrounding = {};
+  uint32_t before;
+  uint32_t after;
+
+  keebie_surrounding_set(&surrounding, "今日は晴れ。明日も晴れ", 33, 33);
+  g_assert_true(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_SENTENCE, 1, &before, &after));
+  g_assert_cmpuint(before, ==, 15);
+  g_assert_cmpuint(after, ==, 0);
+
+  // A sentence owns its terminator, deleting right after one takes the whole sentence.
+  keebie_surrounding_set(&surrounding, "今日は晴れ。明日は雨？", 33, 33);
+  g_assert_true(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_SENTENCE, 1, &before, &after));
+  g_assert_cmpuint(before, ==, 15);
+
+  g_assert_true(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_SENTENCE, 2, &before, &after));
+  g_assert_cmpuint(before, ==, 33);
+
+  // Only what is before the cursor counts.
+  keebie_surrounding_set(&surrounding, "今日は晴れ。明日は雨？", 24, 24);
+  g_assert_true(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_SENTENCE, 1, &before, &after));
+  g_assert_cmpuint(before, ==, 6);
+
+  keebie_surrounding_clear(&surrounding);
+}
+
+static void keebie_test_surrounding_delete_selection() {
+  KeebieSurrounding surrounding = {};
+  uint32_t before;
+  uint32_t after;
+
+  // A selection goes first whatever the unit, on whichever side of the cursor it is.
+  keebie_surrounding_set(&surrounding, "日本語の入力", 9, 0);
+  g_assert_true(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_CHAR, 1, &before, &after));
+  g_assert_cmpuint(before, ==, 9);
+  g_assert_cmpuint(after, ==, 0);
+
+  keebie_surrounding_set(&surrounding, "日本語の入力", 12, 18);
+  g_assert_true(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_SENTENCE, 1, &before, &after));
+  g_assert_cmpuint(before, ==, 0);
+  g_assert_cmpuint(after, ==, 6);
+
+  g_assert_true(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_SELECTION, 1, &before, &after));
+  g_assert_cmpuint(after, ==, 6);
+
+  keebie_surrounding_set(&surrounding, "日本語の入力", 12, 12);
+  g_assert_false(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_SELECTION, 1, &before, &after));
+  g_assert_cmpuint(before, ==, 0);
+  g_assert_cmpuint(after, ==, 0);
+
+  keebie_surrounding_clear(&surrounding);
+}
+
+static void keebie_test_surrounding_char_range() {
+  KeebieSurrounding surrounding = {};
+  uint32_t before;
+  uint32_t after;
+
+  keebie_surrounding_set(&surrounding, "絵文字😀です", 13, 13);
+  keebie_surrounding_get_char_range(&surrounding, 2, 1, &before, &after);
+  g_assert_cmpuint(before, ==, 7);
+  g_assert_cmpuint(after, ==, 3);
+
+  // Counts past either end are clamped to the text.
+  keebie_surrounding_get_char_range(&surrounding, 10, 10, &before, &after);
+  g_assert_cmpuint(before, ==, 13);
+  g_assert_cmpuint(after, ==, 6);
+
+  // Selections play no part.
+  keebie_surrounding_set(&surrounding, "絵文字😀です", 9, 0);
+  keebie_surrounding_get_char_range(&surrounding, 1, 1, &before, &after);
+  g_assert_cmpuint(before, ==, 3);
+  g_assert_cmpuint(after, ==, 4);
+
+  keebie_surrounding_clear(&surrounding);
+  keebie_surrounding_get_char_range(&surrounding, 1, 1, &before, &after);
+  g_assert_cmpuint(before, ==, 0);
+  g_assert_cmpuint(after, ==, 0);
+}
+
+static void keebie_test_surrounding_utf16_offset() {
+  KeebieSurrounding surrounding = {};
+
+  keebie_surrounding_set(&surrounding, "漢字😀かな", 0, 0);
+  g_assert_cmpint(keebie_surrounding_get_utf16_offset(&surrounding, 0), ==, 0);
+  g_assert_cmpint(keebie_surrounding_get_utf16_offset(&surrounding, 6), ==, 2);
+
+  // Code points outside the BMP are a surrogate pair in Dart.
+  g_assert_cmpint(keebie_surrounding_get_utf16_offset(&surrounding, 10), ==, 4);
+  g_assert_cmpint(keebie_surrounding_get_utf16_offset(&surrounding, 16), ==, 6);
+  g_assert_cmpint(keebie_surrounding_get_utf16_offset(&surrounding, 100), ==, 6);
+
+  keebie_surrounding_clear(&surrounding);
+  g_assert_cmpint(keebie_surrounding_get_utf16_offset(&surrounding, 6), ==, 0);
+}
+
+static void keebie_test_surrounding_edit() {
+  KeebieSurrounding surrounding = {};
+
+  // A commit replaces the selection and leaves the cursor after it.
+  keebie_surrounding_set(&surrounding, "ひらがな", 9, 3);
+  keebie_surrounding_insert(&surrounding, "カタ");
+  g_assert_cmpstr(surrounding.text, ==, "ひカタな");
+  g_assert_cmpuint(surrounding.cursor, ==, 9);
+  g_assert_cmpuint(surrounding.anchor, ==, 9);
+
+  keebie_surrounding_insert(&surrounding, "😀");
+  g_assert_cmpstr(surrounding.text, ==, "ひカタ😀な");
+  g_assert_cmpuint(surrounding.cursor, ==, 13);
+
+  // A delete right after still resolves against the updated text.
+  uint32_t before;
+  uint32_t after;
+  g_assert_true(keebie_surrounding_get_delete_range(&surrounding, KEEBIE_DELETE_CHAR, 1, &before, &after));
+  g_assert_cmpuint(before, ==, 4);
+  keebie_surrounding_delete(&surrounding, before, after);
+  g_assert_cmpstr(surrounding.text, ==, "ひカタな");
+  g_assert_cmpuint(surrounding.cursor, ==, 9);
+
+  keebie_surrounding_set(&surrounding, "ひカタな", 6, 6);
+  keebie_surrounding_delete(&surrounding, 3, 3);
+  g_assert_cmpstr(surrounding.text, ==, "ひな");
+  g_assert_cmpuint(surrounding.cursor, ==, 3);
+  g_assert_cmpuint(surrounding.anchor, ==, 3);
+
+  // Deletes reaching past the text are clamped to it.
+  keebie_surrounding_delete(&surrounding, 100, 100);
+  g_assert_cmpstr(surrounding.text, ==, "");
+  g_assert_cmpuint(surrounding.cursor, ==, 0);
+
+  // Without text there is nothing to keep track of.
+  keebie_surrounding_clear(&surrounding);
+  keebie_surrounding_insert(&surrounding, "かな");
+  keebie_surrounding_delete(&surrounding, 3, 0);
+  g_assert_null(surrounding.text);
+  g_assert_cmpuint(surrounding.cursor, ==, 0);
+}
+
+void keebie_test_add_surrounding() {
+  g_test_add_func("/surrounding/delete-range/word", keebie_test_surrounding_delete_word);
+  g_test_add_func("/surrounding/delete-range/sentence", keebie_test_surrounding_delete_sentence);
+  g_test_add_func("/surrounding/delete-range/selection", keebie_test_surrounding_delete_selection);
+  g_test_add_func("/surrounding/char-range", keebie_test_surrounding_char_range);
+  g_test_add_func("/surrounding/utf16-offset", keebie_test_surrounding_utf16_offset);
+  g_test_add_func("/surrounding/edit", keebie_test_surrounding_edit);
+}
@@ -0,0 +1,168 @@
+#include <string.h>
+#include <glib/gstdio.h>
+#include "../swipe-decoder.h"
+#include "test.h"
+
+// About the size of a full dictionary of a language.
+#define KEEBIE_TEST_SWIPE_DECODER_PERF_WORDS 100000
+#define KEEBIE_TEST_SWIPE_DECODER_PERF_PATHS 200
+
+static const char* const keebie_test_swipe_decoder_rows[] = {
+  "qwertyuiop",
+  "asdfghjkl",
+  "zxcvbnm",
+  nullptr,
+};
+
+static const char keebie_test_swipe_decoder_words[] =
+  "hello\t500\n"
+  "help\t400\n"
+  "jello\t10\n"
+  "world\t300\n"
+  "word\t200\n"
+  "wood\t50\n";
+
+typedef struct {
+  guint n_results;
+  GPtrArray* words;
+  gboolean is_final;
+} KeebieSwipeDecoderTest;
+
+static void keebie_test_swipe_decoder_func(GPtrArray* words, gboolean is_final, gpointer data) {
+  KeebieSwipeDecoderTest* self = reinterpret_cast<KeebieSwipeDecoderTest*>(data);
+  self->n_results++;
+  g_clear_pointer(&self->words, g_ptr_array_unref);
+  self->words = g_ptr_array_ref(words);
+  self->is_final = is_final;
+}
+
+// Results come back on the main context once the decoder's thread is done,
+// or right away when there is nothing to decode.
+static void keebie_test_swipe_decoder_wait(KeebieSwipeDecoderTest* self, guint n_results) {
+  while (self->n_results < n_results) {
+    g_main_context_iteration(nullptr, TRUE);
+  }
+}
+
+static KeebieDictionary* keebie_test_swipe_decoder_load_dictionary(const char* list, gsize length) {
+  g_autoptr(KeebieDictionaryBuilder) builder = keebie_dictionary_builder_new("en-US");
+  g_autoptr(GError) error = nullptr;
+  g_assert_true(keebie_dictionary_builder_add_list(builder, list, length, &error));
+  g_assert_no_error(error);
+
+  g_autoptr(GBytes) bytes = keebie_dictionary_builder_end(builder);
+  g_autofree gchar* path = keebie_test_write_file(bytes);
+  KeebieDictionary* dictionary = keebie_dictionary_new_from_file(path, &error);
+  g_unlink(path);
+  g_assert_no_error(error);
+  return dictionary;
+}
+
+// The path a finger takes through the centers of the keys of word, with
+// points in between the way touch events come in.
+static GArray* keebie_test_swipe_decoder_trace(const KeebieGeometry* geometry, const char* word, float jitter) {
+  GArray* points = g_array_new(FALSE, FALSE, sizeof (float));
+  float last_x = 0;
+  float last_y = 0;
+  for (const char* p = word; *p != '\0'; p++) {
+    const KeebieKeyRect* rect = nullptr;
+    for (guint row = 0; rect == nullptr && keebie_test_swipe_decoder_rows[row] != nullptr; row++) {
+      const char* found = strchr(keebie_test_swipe_decoder_rows[row], *p);
+      for (guint i = 0; found != nullptr && i < geometry->n_keys; i++) {
+        if (geometry->keys[i].row == row && geometry->keys[i].key == static_cast<guint>(found - keebie_test_swipe_decoder_rows[row])) {
+          rect = &geometry->keys[i];
+          break;
+        }
+      }
+    }
+    g_assert_nonnull(rect);
+
+    float x = rect->x + rect->width / 2 + jitter;
+    float y = rect->y + rect->height / 2 - jitter;
+    guint n_steps = p == word ? 1 : 6;
+    for (guint i = 1; i <= n_steps; i++) {
+      float t = static_cast<float>(i) / n_steps;
+      float point[] = { p == word ? x : last_x + (x - last_x) * t, p == word ? y : last_y + (y - last_y) * t };
+      g_array_append_vals(points, point, 2);
+    }
+    last_x = x;
+    last_y = y;
+  }
+  return points;
+}
+
+static void keebie_test_swipe_decoder_decode() {
+  g_autoptr(KeebieDictionary) dictionary = keebie_test_swipe_decoder_load_dictionary(keebie_test_swipe_decoder_words, strlen(keebie_test_swipe_decoder_words));
+  g_autoptr(KeebieLayout) layout = keebie_test_new_layout("en-US", keebie_test_swipe_decoder_rows);
+  g_autoptr(KeebieGeometry) geometry = keebie_test_solve_geometry(layout, 0);
+
+  g_autoptr(KeebieSwipeDecoder) decoder = keebie_swipe_decoder_new();
+  keebie_swipe_decoder_set_keyboard(decoder, dictionary, layout, geometry, 0);
+  g_assert_true(keebie_swipe_decoder_has_key(decoder, 1, 5));
+  g_assert_false(keebie_swipe_decoder_has_key(decoder, 3, 0));
+
+  KeebieSwipeDecoderTest self = {};
+  const char* words[] = { "hello", "help", "world", "word" };
+  for (guint i = 0; i < G_N_ELEMENTS(words); i++) {
+    // A little off the centers, nobody hits them all.
+    g_autoptr(GArray) points = keebie_test_swipe_decoder_trace(geometry, words[i], 3.0f);
+    keebie_swipe_decoder_decode(decoder, reinterpret_cast<const float*>(points->data), points->len / 2, TRUE, 3, keebie_test_swipe_decoder_func, &self, nullptr);
+    keebie_test_swipe_decoder_wait(&self, i + 1);
+    g_assert_true(self.is_final);
+    g_assert_cmpuint(self.words->len, >, 0);
+    g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(self.words, 0)), ==, words[i]);
+  }
+
+  // Without a dictionary nothing is decoded, but the caller still hears back.
+  keebie_swipe_decoder_set_keyboard(decoder, nullptr, layout, geometry, 0);
+  g_assert_false(keebie_swipe_decoder_has_key(decoder, 1, 5));
+  const float points[] = { 10.0f, 10.0f, 60.0f, 10.0f };
+  keebie_swipe_decoder_decode(decoder, points, 2, TRUE, 3, keebie_test_swipe_decoder_func, &self, nullptr);
+  keebie_test_swipe_decoder_wait(&self, G_N_ELEMENTS(words) + 1);
+  g_assert_cmpuint(self.words->len, ==, 0);
+  g_ptr_array_unref(self.words);
+}
+
+static void keebie_test_swipe_decoder_perf() {
+  gsize length = 0;
+  g_autofree gchar* list = keebie_test_generate_word_list(KEEBIE_TEST_SWIPE_DECODER_PERF_WORDS, &length);
+  g_autoptr(KeebieDictionary) dictionary = keebie_test_swipe_decoder_load_dictionary(list, length);
+  g_autoptr(KeebieLayout) layout = keebie_test_new_layout("en-US", keebie_test_swipe_decoder_rows);
+  g_autoptr(KeebieGeometry) geometry = keebie_test_solve_geometry(layout, 0);
+
+  g_autoptr(KeebieSwipeDecoder) decoder = keebie_swipe_decoder_new();
+  KeebieSwipeDecoderTest self = {};
+
+  // Indexing happens once per keyboard and comes before the first decode.
+  const float start[] = { 10.0f, 10.0f };
+  g_test_timer_start();
+  keebie_swipe_decoder_set_keyboard(decoder, dictionary, layout, geometry, 0);
+  keebie_swipe_decoder_decode(decoder, start, 1, TRUE, 3, keebie_test_swipe_decoder_func, &self, nullptr);
+  keebie_test_swipe_decoder_wait(&self, 1);
+  keebie_test_check_time("indexing", 1, 1.0);
+
+  g_autoptr(GPtrArray) paths = g_ptr_array_new_with_free_func(reinterpret_cast<GDestroyNotify>(g_array_unref));
+  for (guint i = 0; i < KEEBIE_TEST_SWIPE_DECODER_PERF_PATHS; i++) {
+    gsize word_length = 0;
+    uint32_t frequency = 0;
+    const char* word = keebie_dictionary_get_word(dictionary, i * 499 % keebie_dictionary_get_n_words(dictionary), &word_length, &frequency);
+    g_autofree gchar* text = g_strndup(word, word_length);
+    g_ptr_array_add(paths, keebie_test_swipe_decoder_trace(geometry, text, 3.0f));
+  }
+
+  g_test_timer_start();
+  for (guint i = 0; i < paths->len; i++) {
+    GArray* points = reinterpret_cast<GArray*>(g_ptr_array_index(paths, i));
+    keebie_swipe_decoder_decode(decoder, reinterpret_cast<const float*>(points->data), points->len / 2, TRUE, 5, keebie_test_swipe_decoder_func, &self, nullptr);
+    keebie_test_swipe_decoder_wait(&self, i + 2);
+  }
+  keebie_test_check_time("decode", paths->len, 16e-3);
+  g_ptr_array_unref(self.words);
+}
+
+void keebie_test_add_swipe_decoder() {
+  g_test_add_func("/swipe-decoder/decode", keebie_test_swipe_decoder_decode);
+  if (g_test_perf()) {
+    g_test_add_func("/swipe-decoder/perf", keebie_test_swipe_decoder_perf);
+  }
+}
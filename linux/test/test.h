@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+#include "../geometry.h"
+#include "../layout.h"
+
+G_BEGIN_DECLS
+
+/**
+ * Adds the tests of one native module to the GLib test run, main registers
+ * every module's tests before running them.
+ */
+void keebie_test_add_commit_queue();
+void keebie_test_add_converter();
+void keebie_test_add_dictionary();
+void keebie_test_add_emoji();
+void keebie_test_add_geometry();
+void keebie_test_add_handwriting();
+void keebie_test_add_layout();
+void keebie_test_add_surrounding();
+void keebie_test_add_swipe_decoder();
+void keebie_test_add_touch_model();
+void keebie_test_add_touch_tracker();
+void keebie_test_add_user_model();
+
+/**
+ * Writes bytes to a new file in the temporary directory, for the formats
+ * which are only ever mapped from a file. The caller unlinks and frees it.
+ */
+gchar* keebie_test_write_file(GBytes* bytes);
+
+/**
+ * Returns a copy of bytes with the 32-bit record at offset set to value,
+ * which is how a corrupt blob is made from a valid one.
+ */
+GBytes* keebie_test_corrupt(GBytes* bytes, gsize offset, uint32_t value);
+
+/**
+ * Returns a word list of n_words made-up lowercase words in the format the
+ * dictionary compiler reads, frequencies falling off the way they do in
+ * real text. The same n_words always give the same list.
+ */
+gchar* keebie_test_generate_word_list(guint n_words, gsize* length);
+
+/**
+ * Reports the time since g_test_timer_start() divided by n_runs as a perf
+ * result, and fails if that is over bound seconds. Bounds are generous, they
+ * are there to catch a path going quadratic and not a few percent.
+ */
+void keebie_test_check_time(const char* what, guint n_runs, double bound);
+
+/**
+ * Returns a layout of a single plane, with a row of keys for each of rows
+ * up to the NULL. Every character of a row is a key typing it.
+ */
+KeebieLayout* keebie_test_new_layout(const char* locale, const char* const* rows);
+
+/**
+ * Solves the plane of the layout at the size the geometry fixture uses, a
+ * key is 25 wide there.
+ */
+KeebieGeometry* keebie_test_solve_geometry(KeebieLayout* layout, guint plane);
+
+G_END_DECLS
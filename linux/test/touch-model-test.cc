@@ -0,0 +1,149 @@
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include "../touch-model.h"
+#include "test.h"
+
+static const char* const keebie_test_touch_model_rows[] = {
+  "qwertyuiop",
+  "asdfghjkl",
+  "zxcvbnm",
+  nullptr,
+};
+
+typedef struct {
+  KeebieLayout* layout;
+  KeebieGeometry* geometry;
+  gchar* path;
+} KeebieTouchModelTest;
+
+static void keebie_test_touch_model_init(KeebieTouchModelTest* self) {
+  self->layout = keebie_test_new_layout("en-US", keebie_test_touch_model_rows);
+  self->geometry = keebie_test_solve_geometry(self->layout, 0);
+
+  // Where the offsets are saved, nothing is there to load yet.
+  g_autoptr(GError) error = nullptr;
+  gint fd = g_file_open_tmp("keebie-test-XXXXXX", &self->path, &error);
+  g_assert_no_error(error);
+  close(fd);
+  g_unlink(self->path);
+}
+
+static void keebie_test_touch_model_finish(KeebieTouchModelTest* self) {
+  g_unlink(self->path);
+  g_free(self->path);
+  keebie_geometry_unref(self->geometry);
+  keebie_layout_unref(self->layout);
+}
+
+static gint keebie_test_touch_model_find(KeebieTouchModelTest* self, guint row, guint key) {
+  gint found = -1;
+  for (guint i = 0; found < 0 && i < self->geometry->n_keys; i++) {
+    if (self->geometry->keys[i].row == row && self->geometry->keys[i].key == key) {
+      found = i;
+    }
+  }
+  g_assert_cmpint(found, >=, 0);
+  return found;
+}
+
+static gint keebie_test_touch_model_resolve(KeebieTouchModelTest* self, KeebieTouchModel* model, float x, float y, KeebieTouchPriorFunc prior, gpointer user_data) {
+  return keebie_touch_model_resolve(model, self->layout, self->geometry, 0, x, y, prior, user_data);
+}
+
+// Only the text in user_data is likely, everything else all but ruled out.
+static float keebie_test_touch_model_prior(const char* text, gpointer user_data) {
+  return g_strcmp0(text, reinterpret_cast<const char*>(user_data)) == 0 ? 0.0f : -1000.0f;
+}
+
+static void keebie_test_touch_model_centers() {
+  KeebieTouchModelTest self;
+  keebie_test_touch_model_init(&self);
+
+  KeebieTouchModel* model = keebie_touch_model_new(self.path);
+  for (guint i = 0; i < self.geometry->n_keys; i++) {
+    const KeebieKeyRect* rect = &self.geometry->keys[i];
+    g_assert_cmpint(keebie_test_touch_model_resolve(&self, model, rect->x + rect->width / 2, rect->y + rect->height / 2, nullptr, nullptr), ==, i);
+  }
+
+  // Touches outside the keys go to the closest one.
+  g_assert_cmpint(keebie_test_touch_model_resolve(&self, model, -10.0f, -10.0f, nullptr, nullptr), ==, keebie_test_touch_model_find(&self, 0, 0));
+
+  keebie_touch_model_free(model);
+  keebie_test_touch_model_finish(&self);
+}
+
+static void keebie_test_touch_model_prior() {
+  KeebieTouchModelTest self;
+  keebie_test_touch_model_init(&self);
+
+  const KeebieKeyRect* q = &self.geometry->keys[keebie_test_touch_model_find(&self, 0, 0)];
+  const KeebieKeyRect* w = &self.geometry->keys[keebie_test_touch_model_find(&self, 0, 1)];
+  float border = (q->x + q->width / 2 + w->x + w->width / 2) / 2;
+  float y = q->y + q->height / 2;
+
+  // Right between two keys the language decides.
+  KeebieTouchModel* model = keebie_touch_model_new(self.path);
+  g_assert_cmpint(keebie_test_touch_model_resolve(&self, model, border, y, keebie_test_touch_model_prior, const_cast<char*>("q")), ==, keebie_test_touch_model_find(&self, 0, 0));
+  keebie_touch_model_free(model);
+
+  model = keebie_touch_model_new(self.path);
+  g_assert_cmpint(keebie_test_touch_model_resolve(&self, model, border, y, keebie_test_touch_model_prior, const_cast<char*>("w")), ==, keebie_test_touch_model_find(&self, 0, 1));
+
+  // But however sure it is, it cannot pull a touch off the key it hit.
+  g_assert_cmpint(keebie_test_touch_model_resolve(&self, model, q->x + q->width / 2, y, keebie_test_touch_model_prior, const_cast<char*>("w")), ==, keebie_test_touch_model_find(&self, 0, 0));
+
+  keebie_touch_model_free(model);
+  keebie_test_touch_model_finish(&self);
+}
+
+static void keebie_test_touch_model_learn() {
+  KeebieTouchModelTest self;
+  keebie_test_touch_model_init(&self);
+
+  gint q_index = keebie_test_touch_model_find(&self, 0, 0);
+  gint w_index = keebie_test_touch_model_find(&self, 0, 1);
+  const KeebieKeyRect* q = &self.geometry->keys[q_index];
+  const KeebieKeyRect* w = &self.geometry->keys[w_index];
+  float q_center = q->x + q->width / 2;
+  float y = q->y + q->height / 2;
+
+  // A little past the middle towards w, which is where a fresh model puts it.
+  float x = q_center + (w->x + w->width / 2 - q_center) * 0.6f;
+  KeebieTouchModel* model = keebie_touch_model_new(self.path);
+  g_assert_cmpint(keebie_test_touch_model_resolve(&self, model, x, y, nullptr, nullptr), ==, w_index);
+  keebie_touch_model_free(model);
+
+  // Somebody who always hits q right of its center...
+  model = keebie_touch_model_new(self.path);
+  for (guint i = 0; i < 100; i++) {
+    g_assert_cmpint(keebie_test_touch_model_resolve(&self, model, q_center + q->width * 0.3f, y, nullptr, nullptr), ==, q_index);
+  }
+  g_assert_cmpint(keebie_test_touch_model_resolve(&self, model, x, y, nullptr, nullptr), ==, q_index);
+
+  // ...keeps that across restarts, the save is written before freeing returns.
+  keebie_touch_model_save(model);
+  keebie_touch_model_free(model);
+
+  g_autoptr(GKeyFile) file = g_key_file_new();
+  g_autoptr(GError) error = nullptr;
+  g_assert_true(g_key_file_load_from_file(file, self.path, G_KEY_FILE_NONE, &error));
+  g_assert_no_error(error);
+  gsize length = 0;
+  g_autofree gdouble* values = g_key_file_get_double_list(file, "en-US", "0.0.0", &length, &error);
+  g_assert_no_error(error);
+  g_assert_cmpuint(length, ==, 2);
+  g_assert_cmpfloat_with_epsilon(values[0], 0.3, 0.01);
+  g_assert_cmpfloat_with_epsilon(values[1], 0.0, 0.01);
+
+  model = keebie_touch_model_new(self.path);
+  g_assert_cmpint(keebie_test_touch_model_resolve(&self, model, x, y, nullptr, nullptr), ==, q_index);
+
+  keebie_touch_model_free(model);
+  keebie_test_touch_model_finish(&self);
+}
+
+void keebie_test_add_touch_model() {
+  g_test_add_func("/touch-model/centers", keebie_test_touch_model_centers);
+  g_test_add_func("/touch-model/prior", keebie_test_touch_model_prior);
+  g_test_add_func("/touch-model/learn", keebie_test_touch_model_learn);
+}
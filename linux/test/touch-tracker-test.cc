@@ -0,0 +1,162 @@
+#include "../touch-tracker.h"
+#include "test.h"
+
+// Touches are told apart by their sequence, any distinct pointer does.
+static const char keebie_test_touch_sequences[4] = {};
+
+typedef struct {
+  KeebieTouchTracker* tracker;
+
+  // What was typed, "a^" for a key typed after it lifted, "av" while still
+  // down and "a!v" for a held one, "release" when a held one lifted.
+  GString* log;
+} KeebieTouchTrackerTest;
+
+static void keebie_test_touch_tracker_commit(const KeebieTouchKey* key, gboolean is_held, gboolean is_down, gpointer data) {
+  KeebieTouchTrackerTest* self = reinterpret_cast<KeebieTouchTrackerTest*>(data);
+  if (self->log->len > 0) {
+    g_string_append_c(self->log, ' ');
+  }
+  g_string_append_printf(self->log, "%c%s%s", 'a' + key->key, is_held ? "!" : "", is_down ? "v" : "^");
+}
+
+static void keebie_test_touch_tracker_release(const KeebieTouchKey* key, gpointer data) {
+  KeebieTouchTrackerTest* self = reinterpret_cast<KeebieTouchTrackerTest*>(data);
+  g_string_append(self->log, self->log->len > 0 ? " release" : "release");
+}
+
+static void keebie_test_touch_tracker_init(KeebieTouchTrackerTest* self, guint rollover) {
+  self->tracker = keebie_touch_tracker_new(keebie_test_touch_tracker_commit, keebie_test_touch_tracker_release, self);
+  keebie_touch_tracker_set_rollover(self->tracker, rollover);
+  self->log = g_string_new(nullptr);
+}
+
+static void keebie_test_touch_tracker_finish(KeebieTouchTrackerTest* self) {
+  keebie_touch_tracker_free(self->tracker);
+  g_string_free(self->log, TRUE);
+}
+
+static void keebie_test_touch_tracker_begin(KeebieTouchTrackerTest* self, guint touch, guint32 time, gboolean is_held) {
+  KeebieTouchKey key = {};
+  key.key = touch;
+  keebie_touch_tracker_begin(self->tracker, &keebie_test_touch_sequences[touch], time, &key, is_held);
+}
+
+static void keebie_test_touch_tracker_end(KeebieTouchTrackerTest* self, guint touch) {
+  KeebieTouchKey key = {};
+  g_assert_true(keebie_touch_tracker_end(self->tracker, &keebie_test_touch_sequences[touch], FALSE, &key));
+  g_assert_cmpuint(key.key, ==, touch);
+}
+
+static void keebie_test_touch_tracker_overlapping_lifts() {
+  KeebieTouchTrackerTest self = {};
+  keebie_test_touch_tracker_init(&self, KEEBIE_TOUCH_TRACKER_DEFAULT_ROLLOVER);
+
+  keebie_test_touch_tracker_begin(&self, 0, 0, FALSE);
+  keebie_test_touch_tracker_begin(&self, 1, 10, FALSE);
+  keebie_test_touch_tracker_begin(&self, 2, 20, FALSE);
+
+  // The last touch lifting first waits on the ones which went down before it.
+  keebie_test_touch_tracker_end(&self, 2);
+  g_assert_cmpstr(self.log->str, ==, "");
+  g_assert_false(keebie_touch_tracker_has(self.tracker, &keebie_test_touch_sequences[2]));
+
+  keebie_test_touch_tracker_end(&self, 0);
+  g_assert_cmpstr(self.log->str, ==, "a^");
+
+  keebie_test_touch_tracker_end(&self, 1);
+  g_assert_cmpstr(self.log->str, ==, "a^ b^ c^");
+  g_assert_false(keebie_touch_tracker_is_down(self.tracker));
+
+  // Down order is by the time the device reported, not by event order.
+  keebie_test_touch_tracker_begin(&self, 0, 110, FALSE);
+  keebie_test_touch_tracker_begin(&self, 1, 100, FALSE);
+  keebie_test_touch_tracker_end(&self, 0);
+  keebie_test_touch_tracker_end(&self, 1);
+  g_assert_cmpstr(self.log->str, ==, "a^ b^ c^ b^ a^");
+
+  keebie_test_touch_tracker_finish(&self);
+}
+
+static void keebie_test_touch_tracker_rollover_timeout() {
+  KeebieTouchTrackerTest self = {};
+  keebie_test_touch_tracker_init(&self, 10);
+
+  keebie_test_touch_tracker_begin(&self, 0, 0, FALSE);
+  keebie_test_touch_tracker_begin(&self, 1, 10, FALSE);
+  keebie_test_touch_tracker_end(&self, 1);
+  g_assert_cmpstr(self.log->str, ==, "");
+
+  // Held past the rollover, the earlier touch is typed while still down.
+  while (self.log->len == 0) {
+    g_main_context_iteration(nullptr, TRUE);
+  }
+  g_assert_cmpstr(self.log->str, ==, "av b^");
+  g_assert_true(keebie_touch_tracker_is_committed(self.tracker, &keebie_test_touch_sequences[0]));
+
+  // Its lift types nothing more.
+  keebie_test_touch_tracker_end(&self, 0);
+  g_assert_cmpstr(self.log->str, ==, "av b^");
+  g_assert_false(keebie_touch_tracker_is_down(self.tracker));
+
+  keebie_test_touch_tracker_finish(&self);
+}
+
+static void keebie_test_touch_tracker_rollover_zero() {
+  KeebieTouchTrackerTest self = {};
+  keebie_test_touch_tracker_init(&self, 0);
+
+  // Without a rollover a lift types everything before it at once.
+  keebie_test_touch_tracker_begin(&self, 0, 0, FALSE);
+  keebie_test_touch_tracker_begin(&self, 1, 10, FALSE);
+  keebie_test_touch_tracker_begin(&self, 2, 20, FALSE);
+  keebie_test_touch_tracker_end(&self, 1);
+  g_assert_cmpstr(self.log->str, ==, "av b^");
+
+  keebie_test_touch_tracker_begin(&self, 3, 30, FALSE);
+  keebie_test_touch_tracker_end(&self, 3);
+  g_assert_cmpstr(self.log->str, ==, "av b^ cv d^");
+
+  keebie_test_touch_tracker_end(&self, 0);
+  keebie_test_touch_tracker_end(&self, 2);
+  g_assert_cmpstr(self.log->str, ==, "av b^ cv d^");
+  g_assert_false(keebie_touch_tracker_is_down(self.tracker));
+
+  keebie_test_touch_tracker_finish(&self);
+}
+
+static void keebie_test_touch_tracker_held() {
+  KeebieTouchTrackerTest self = {};
+  keebie_test_touch_tracker_init(&self, KEEBIE_TOUCH_TRACKER_DEFAULT_ROLLOVER);
+
+  // One touch still down and one waiting on it go out before the held key.
+  keebie_test_touch_tracker_begin(&self, 0, 0, FALSE);
+  keebie_test_touch_tracker_begin(&self, 1, 10, FALSE);
+  keebie_test_touch_tracker_end(&self, 1);
+  keebie_test_touch_tracker_begin(&self, 2, 20, TRUE);
+  g_assert_cmpstr(self.log->str, ==, "av b^ c!v");
+
+  // A key lifting while the held one repeats is not held back by it.
+  keebie_test_touch_tracker_begin(&self, 3, 30, FALSE);
+  keebie_test_touch_tracker_end(&self, 3);
+  g_assert_cmpstr(self.log->str, ==, "av b^ c!v d^");
+
+  keebie_test_touch_tracker_end(&self, 2);
+  g_assert_cmpstr(self.log->str, ==, "av b^ c!v d^ release");
+
+  keebie_test_touch_tracker_end(&self, 0);
+  g_assert_cmpstr(self.log->str, ==, "av b^ c!v d^ release");
+  g_assert_false(keebie_touch_tracker_is_down(self.tracker));
+
+  // Nothing is left waiting on a timeout.
+  g_assert_false(g_main_context_iteration(nullptr, FALSE));
+
+  keebie_test_touch_tracker_finish(&self);
+}
+
+void keebie_test_add_touch_tracker() {
+  g_test_add_func("/touch-tracker/overlapping-lifts", keebie_test_touch_tracker_overlapping_lifts);
+  g_test_add_func("/touch-tracker/rollover-timeout", keebie_test_touch_tracker_rollover_timeout);
+  g_test_add_func("/touch-tracker/rollover-zero", keebie_test_touch_tracker_rollover_zero);
+  g_test_add_func("/touch-tracker/held", keebie_test_touch_tracker_held);
+}
@@ -0,0 +1,146 @@
+#include <string.h>
+#include <glib/gstdio.h>
+#include "../user-model.h"
+#include "test.h"
+
+// Ten words a round, enough rounds to log more n-grams than going idle
+// compacts at.
+#define KEEBIE_TEST_USER_MODEL_ROUNDS 30
+
+typedef struct {
+  gchar* dir;
+} KeebieUserModelTest;
+
+static void keebie_test_user_model_init(KeebieUserModelTest* self) {
+  g_autoptr(GError) error = nullptr;
+  self->dir = g_dir_make_tmp("keebie-test-XXXXXX", &error);
+  g_assert_no_error(error);
+}
+
+static void keebie_test_user_model_finish(KeebieUserModelTest* self) {
+  g_autofree gchar* model_path = g_build_filename(self->dir, "user-model.kbm", nullptr);
+  g_autofree gchar* log_path = g_build_filename(self->dir, "user-model.log", nullptr);
+  g_unlink(model_path);
+  g_unlink(log_path);
+  g_rmdir(self->dir);
+  g_free(self->dir);
+}
+
+// Learning and loading happen on the model's worker, freeing waits for it.
+// The model is only mapped on the caller's thread once it was compacted, so
+// learn, compact and reopen to read it back without racing the worker.
+static KeebieUserModel* keebie_test_user_model_learn(KeebieUserModelTest* self, const char* text) {
+  KeebieUserModel* model = keebie_user_model_new(self->dir);
+  keebie_user_model_learn(model, text, strlen(text), 0);
+  keebie_user_model_free(model);
+
+  model = keebie_user_model_new(self->dir);
+  keebie_user_model_compact(model);
+  keebie_user_model_free(model);
+
+  return keebie_user_model_new(self->dir);
+}
+
+static void keebie_test_user_model_learn_and_predict() {
+  KeebieUserModelTest self;
+  keebie_test_user_model_init(&self);
+
+  g_autoptr(GString) text = g_string_new("The");
+  for (guint i = 0; i < KEEBIE_TEST_USER_MODEL_ROUNDS; i++) {
+    g_string_append(text, " cat sat on the mat and the cat ran the");
+  }
+  g_string_append(text, " end. ");
+
+  KeebieUserModel* model = keebie_test_user_model_learn(&self, text->str);
+
+  // The sentence start is learned lowercase, as the word it is.
+  g_assert_cmpuint(keebie_user_model_get_count(model, nullptr, "the"), ==, KEEBIE_TEST_USER_MODEL_ROUNDS * 3 + 1);
+  g_assert_cmpuint(keebie_user_model_get_count(model, nullptr, "The"), ==, 0);
+  g_assert_cmpuint(keebie_user_model_get_count(model, "the", "cat"), ==, KEEBIE_TEST_USER_MODEL_ROUNDS * 2);
+  g_assert_cmpuint(keebie_user_model_get_count(model, "cat", "sat"), ==, KEEBIE_TEST_USER_MODEL_ROUNDS);
+  g_assert_cmpuint(keebie_user_model_get_count(model, "cat", "dog"), ==, 0);
+
+  g_autoptr(GPtrArray) words = g_ptr_array_new_with_free_func(g_free);
+  g_assert_cmpuint(keebie_user_model_predict(model, "the", 2, words), ==, 2);
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(words, 0)), ==, "cat");
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(words, 1)), ==, "mat");
+
+  // Ties go by the word.
+  g_ptr_array_set_size(words, 0);
+  g_assert_cmpuint(keebie_user_model_predict(model, "cat", 5, words), ==, 2);
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(words, 0)), ==, "ran");
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(words, 1)), ==, "sat");
+
+  g_ptr_array_set_size(words, 0);
+  g_assert_cmpuint(keebie_user_model_predict(model, "dog", 5, words), ==, 0);
+  g_assert_cmpuint(keebie_user_model_predict(model, "", 5, words), ==, 0);
+
+  // "end" ends the text at a full stop, it follows the last "the".
+  g_assert_cmpuint(keebie_user_model_complete(model, "e", 5, words), ==, 1);
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(words, 0)), ==, "end");
+
+  g_ptr_array_set_size(words, 0);
+  g_assert_cmpuint(keebie_user_model_complete(model, "", 3, words), ==, 3);
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(words, 0)), ==, "the");
+  g_assert_cmpstr(reinterpret_cast<const char*>(g_ptr_array_index(words, 1)), ==, "cat");
+
+  g_ptr_array_set_size(words, 0);
+  g_assert_cmpuint(keebie_user_model_complete(model, "x", 3, words), ==, 0);
+
+  keebie_user_model_free(model);
+  keebie_test_user_model_finish(&self);
+}
+
+// A log line torn by a crash is dropped, the ones before it are replayed.
+static void keebie_test_user_model_torn_log() {
+  KeebieUserModelTest self;
+  keebie_test_user_model_init(&self);
+
+  g_autoptr(GString) log = g_string_new("# 0\n");
+  for (guint i = 0; i < 256; i++) {
+    g_string_append(log, "\tword\n");
+  }
+  g_string_append(log, "word\tlost");
+
+  g_autofree gchar* log_path = g_build_filename(self.dir, "user-model.log", nullptr);
+  g_autoptr(GError) error = nullptr;
+  g_assert_true(g_file_set_contents(log_path, log->str, log->len, &error));
+  g_assert_no_error(error);
+
+  KeebieUserModel* model = keebie_user_model_new(self.dir);
+  keebie_user_model_compact(model);
+  keebie_user_model_free(model);
+
+  model = keebie_user_model_new(self.dir);
+  g_assert_cmpuint(keebie_user_model_get_count(model, nullptr, "word"), ==, 256);
+  g_assert_cmpuint(keebie_user_model_get_count(model, nullptr, "lost"), ==, 0);
+  keebie_user_model_free(model);
+
+  keebie_test_user_model_finish(&self);
+}
+
+static void keebie_test_user_model_normalize_word() {
+  struct {
+    const char* word;
+    gboolean starts_sentence;
+    const char* expected;
+  } cases[] = {
+    { "Hello", TRUE, "hello" },
+    { "Hello", FALSE, "Hello" },
+    { "NASA", TRUE, "NASA" },
+    { "iPhone", TRUE, "iPhone" },
+    { "A", TRUE, "A" },
+    { "Élan", TRUE, "élan" },
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS(cases); i++) {
+    g_autofree gchar* word = keebie_user_model_normalize_word(cases[i].word, strlen(cases[i].word), cases[i].starts_sentence);
+    g_assert_cmpstr(word, ==, cases[i].expected);
+  }
+}
+
+void keebie_test_add_user_model() {
+  g_test_add_func("/user-model/learn-and-predict", keebie_test_user_model_learn_and_predict);
+  g_test_add_func("/user-model/torn-log", keebie_test_user_model_torn_log);
+  g_test_add_func("/user-model/normalize-word", keebie_test_user_model_normalize_word);
+}
@@ -0,0 +1,85 @@
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+
+gchar* keebie_test_write_file(GBytes* bytes) {
+  gchar* path = nullptr;
+  g_autoptr(GError) error = nullptr;
+  gint fd = g_file_open_tmp("keebie-test-XXXXXX", &path, &error);
+  g_assert_no_error(error);
+  close(fd);
+
+  gsize size = 0;
+  const gchar* data = reinterpret_cast<const gchar*>(g_bytes_get_data(bytes, &size));
+  g_file_set_contents(path, data, size, &error);
+  g_assert_no_error(error);
+  return path;
+}
+
+GBytes* keebie_test_corrupt(GBytes* bytes, gsize offset, uint32_t value) {
+  gsize size = 0;
+  const void* data = g_bytes_get_data(bytes, &size);
+  g_assert_cmpuint(offset + sizeof (value), <=, size);
+
+  guint8* copy = reinterpret_cast<guint8*>(g_memdup2(data, size));
+  memcpy(copy + offset, &value, sizeof (value));
+  return g_bytes_new_take(copy, size);
+}
+
+gchar* keebie_test_generate_word_list(guint n_words, gsize* length) {
+  g_autoptr(GRand) rand = g_rand_new_with_seed(n_words);
+  GString* list = g_string_new(nullptr);
+  for (guint i = 0; i < n_words; i++) {
+    gint n_letters = g_rand_int_range(rand, 2, 11);
+    for (gint j = 0; j < n_letters; j++) {
+      g_string_append_c(list, 'a' + g_rand_int_range(rand, 0, 26));
+    }
+    g_string_append_printf(list, "\t%u\n", 1000000 / (i + 1) + 1);
+  }
+
+  *length = list->len;
+  return g_string_free(list, FALSE);
+}
+
+void keebie_test_check_time(const char* what, guint n_runs, double bound) {
+  double elapsed = g_test_timer_elapsed() / n_runs;
+  g_test_minimized_result(elapsed, "%s: %.1f us", what, elapsed * 1e6);
+  g_assert_cmpfloat(elapsed, <, bound);
+}
+
+KeebieLayout* keebie_test_new_layout(const char* locale, const char* const* rows) {
+  g_autoptr(KeebieLayoutBuilder) builder = keebie_layout_builder_new(locale);
+  keebie_layout_builder_add_plane(builder, KEEBIE_PLANE_TYPE_KEYS);
+  keebie_layout_builder_set_content_plane(builder, KEEBIE_CONTENT_TYPE_TEXT, 0);
+  for (guint i = 0; rows[i] != nullptr; i++) {
+    keebie_layout_builder_add_row(builder);
+    for (const char* p = rows[i]; *p != '\0'; p = g_utf8_next_char(p)) {
+      g_autofree gchar* name = g_strndup(p, g_utf8_next_char(p) - p);
+      KeebieLayoutKeyInfo info = {};
+      info.type = KEEBIE_KEY_TYPE_REGULAR;
+      info.name = name;
+      info.plane = -1;
+      keebie_layout_builder_add_key(builder, &info);
+    }
+  }
+
+  g_autoptr(GBytes) bytes = keebie_layout_builder_end(builder);
+  g_autoptr(GError) error = nullptr;
+  KeebieLayout* layout = keebie_layout_new_from_bytes(bytes, &error);
+  g_assert_no_error(error);
+  return layout;
+}
+
+KeebieGeometry* keebie_test_solve_geometry(KeebieLayout* layout, guint plane) {
+  KeebieGeometryParams params = {};
+  params.plane = plane;
+  params.child_size = 14.0f;
+  params.padding = 1.0f;
+  params.monitor_width = 1920.0f;
+  params.monitor_height = 1080.0f;
+
+  KeebieGeometryCache* cache = keebie_geometry_cache_new();
+  KeebieGeometry* geometry = keebie_geometry_cache_get(cache, layout, &params);
+  keebie_geometry_cache_free(cache);
+  return geometry;
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <glib/gstdio.h>
+#include "../utils.h"
+#include "compiler.h"
+
+static GBytes* keebie_compiler_build(const KeebieCompiler* compiler, const char* locale, char** sources, GError** error, const char** failed) {
+  g_autoptr(GPtrArray) contents = g_ptr_array_new_with_free_func(g_free);
+  g_autoptr(GArray) lengths = g_array_new(FALSE, FALSE, sizeof (gsize));
+  for (guint i = 0; i < compiler->n_sources; i++) {
+    gchar* data = nullptr;
+    gsize length = 0;
+    if (!g_file_get_contents(sources[i], &data, &length, error)) {
+      *failed = sources[i];
+      return nullptr;
+    }
+    g_ptr_array_add(contents, data);
+    g_array_append_val(lengths, length);
+  }
+
+  if (compiler->compile != nullptr) {
+    *failed = sources[0];
+    return compiler->compile(reinterpret_cast<const gchar*>(g_ptr_array_index(contents, 0)), g_array_index(lengths, gsize, 0), error);
+  }
+
+  gpointer builder = compiler->builder_new(locale);
+  for (guint i = 0; i < compiler->n_sources; i++) {
+    if (!compiler->builder_add(builder, reinterpret_cast<const char*>(g_ptr_array_index(contents, i)), g_array_index(lengths, gsize, i), error)) {
+      compiler->builder_free(builder);
+      *failed = sources[i];
+      return nullptr;
+    }
+  }
+
+  GBytes* bytes = compiler->builder_end(builder);
+  compiler->builder_free(builder);
+  return bytes;
+}
+
+int keebie_compiler_main(const KeebieCompiler* compiler, int argc, char** argv) {
+  int n_args = (compiler->has_locale ? 1 : 0) + compiler->n_sources + 1;
+  if (argc != n_args + 1) {
+    fprintf(stderr, "Usage: %s %s\n", argv[0], compiler->usage);
+    return 1;
+  }
+
+  // The runner picks blobs by the layout's locale, catch typos here.
+  const char* locale = compiler->has_locale ? argv[1] : nullptr;
+  if (locale != nullptr && get_locale_name(locale) == nullptr) {
+    fprintf(stderr, "%s: unknown locale\n", locale);
+    return 1;
+  }
+
+  char** sources = &argv[compiler->has_locale ? 2 : 1];
+  const char* output = argv[argc - 1];
+
+  g_autoptr(GError) error = nullptr;
+  const char* failed = nullptr;
+  g_autoptr(GBytes) bytes = keebie_compiler_build(compiler, locale, sources, &error, &failed);
+  if (bytes == nullptr) {
+    fprintf(stderr, "%s: %s\n", failed, error->message);
+    return 1;
+  }
+
+  gsize size = 0;
+  const gchar* blob = reinterpret_cast<const gchar*>(g_bytes_get_data(bytes, &size));
+  if (!g_file_set_contents(output, blob, size, &error)) {
+    fprintf(stderr, "%s: %s\n", output, error->message);
+    return 1;
+  }
+
+  gpointer loaded = compiler->load(output, &error);
+  if (loaded == nullptr) {
+    fprintf(stderr, "%s: %s\n", output, error->message);
+    g_unlink(output);
+    return 1;
+  }
+  compiler->unref(loaded);
+  return 0;
+}
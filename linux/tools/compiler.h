@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef GBytes* (*KeebieCompilerCompileFunc)(const gchar* data, gssize length, GError** error);
+typedef gpointer (*KeebieCompilerNewFunc)(const char* locale);
+typedef gboolean (*KeebieCompilerAddFunc)(gpointer builder, const char* data, gsize length, GError** error);
+typedef GBytes* (*KeebieCompilerEndFunc)(gpointer builder);
+typedef gpointer (*KeebieCompilerLoadFunc)(const char* path, GError** error);
+
+/**
+ * What sets the build time compilers of the formats apart. Arguments are the
+ * locale if has_locale, then n_sources source files and then the output.
+ */
+typedef struct {
+  // Arguments after the program name, for the usage message.
+  const char* usage;
+  gboolean has_locale;
+  guint n_sources;
+
+  // Either compiles a single source on its own...
+  KeebieCompilerCompileFunc compile;
+
+  // ...or every source goes into a builder for the locale.
+  KeebieCompilerNewFunc builder_new;
+  KeebieCompilerAddFunc builder_add;
+  KeebieCompilerEndFunc builder_end;
+  GDestroyNotify builder_free;
+
+  // Loads the output back the way the runner does.
+  KeebieCompilerLoadFunc load;
+  GDestroyNotify unref;
+} KeebieCompiler;
+
+/**
+ * Runs a compiler on argv and returns the exit status. The output is loaded
+ * back once written and removed if it does not, so a broken blob fails the
+ * build instead of the runner.
+ */
+int keebie_compiler_main(const KeebieCompiler* compiler, int argc, char** argv);
+
+G_END_DECLS
@@ -0,0 +1,16 @@
+#include "../converter.h"
+#include "compiler.h"
+
+int main(int argc, char** argv) {
+  KeebieCompiler compiler = {};
+  compiler.usage = "<locale> <source.txt> <converter.kkc>";
+  compiler.has_locale = TRUE;
+  compiler.n_sources = 1;
+  compiler.builder_new = (KeebieCompilerNewFunc)keebie_converter_builder_new;
+  compiler.builder_add = (KeebieCompilerAddFunc)keebie_converter_builder_add_source;
+  compiler.builder_end = (KeebieCompilerEndFunc)keebie_converter_builder_end;
+  compiler.builder_free = (GDestroyNotify)keebie_converter_builder_free;
+  compiler.load = (KeebieCompilerLoadFunc)keebie_converter_new_from_file;
+  compiler.unref = (GDestroyNotify)keebie_converter_unref;
+  return keebie_compiler_main(&compiler, argc, argv);
+}
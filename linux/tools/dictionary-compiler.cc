@@ -0,0 +1,16 @@
+#include "../dictionary.h"
+#include "compiler.h"
+
+int main(int argc, char** argv) {
+  KeebieCompiler compiler = {};
+  compiler.usage = "<locale> <words.txt> <dictionary.kbd>";
+  compiler.has_locale = TRUE;
+  compiler.n_sources = 1;
+  compiler.builder_new = (KeebieCompilerNewFunc)keebie_dictionary_builder_new;
+  compiler.builder_add = (KeebieCompilerAddFunc)keebie_dictionary_builder_add_list;
+  compiler.builder_end = (KeebieCompilerEndFunc)keebie_dictionary_builder_end;
+  compiler.builder_free = (GDestroyNotify)keebie_dictionary_builder_free;
+  compiler.load = (KeebieCompilerLoadFunc)keebie_dictionary_new_from_file;
+  compiler.unref = (GDestroyNotify)keebie_dictionary_unref;
+  return keebie_compiler_main(&compiler, argc, argv);
+}
@@ -0,0 +1,18 @@
+#include "../emoji.h"
+#include "compiler.h"
+
+int main(int argc, char** argv) {
+  KeebieCompiler compiler = {};
+  compiler.usage = "<locale> <catalog.txt> <annotations.txt> <catalog.kem>";
+  compiler.has_locale = TRUE;
+  // The shared catalog decides the order, the annotations only add keywords
+  // and the odd locale specific symbol.
+  compiler.n_sources = 2;
+  compiler.builder_new = (KeebieCompilerNewFunc)keebie_emoji_builder_new;
+  compiler.builder_add = (KeebieCompilerAddFunc)keebie_emoji_builder_add_source;
+  compiler.builder_end = (KeebieCompilerEndFunc)keebie_emoji_builder_end;
+  compiler.builder_free = (GDestroyNotify)keebie_emoji_builder_free;
+  compiler.load = (KeebieCompilerLoadFunc)keebie_emoji_new_from_file;
+  compiler.unref = (GDestroyNotify)keebie_emoji_unref;
+  return keebie_compiler_main(&compiler, argc, argv);
+}
@@ -0,0 +1,13 @@
+#include "../layout-json.h"
+#include "../layout.h"
+#include "compiler.h"
+
+int main(int argc, char** argv) {
+  KeebieCompiler compiler = {};
+  compiler.usage = "<layout.json> <layout.kbl>";
+  compiler.n_sources = 1;
+  compiler.compile = keebie_layout_compile_json;
+  compiler.load = (KeebieCompilerLoadFunc)keebie_layout_new_from_file;
+  compiler.unref = (GDestroyNotify)keebie_layout_unref;
+  return keebie_compiler_main(&compiler, argc, argv);
+}
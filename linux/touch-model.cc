@@ -0,0 +1,256 @@
+#include <math.h>
+#include <string.h>
+#include "file-writer.h"
+#include "touch-model.h"
+
+// The spread of touches around a key's center relative to its size, a touch
+// on the center of a neighbour is then 3 units of score away.
+#define KEEBIE_TOUCH_MODEL_SIGMA 0.4f
+
+// How much the prior counts against the spatial score and the least it can
+// say, which bounds how far it can pull a touch from the key it landed on.
+#define KEEBIE_TOUCH_MODEL_PRIOR_WEIGHT 0.5f
+#define KEEBIE_TOUCH_MODEL_PRIOR_FLOOR -4.6f
+
+// Offsets follow the user's touches as a moving average, relative to the
+// key size and never further out than this.
+#define KEEBIE_TOUCH_MODEL_LEARNING_RATE 0.05f
+#define KEEBIE_TOUCH_MODEL_MAX_OFFSET 0.3f
+
+// Touches this far from the key they resolved to are outliers, not aim.
+#define KEEBIE_TOUCH_MODEL_LEARN_RADIUS 0.75f
+
+typedef struct {
+  float x;
+  float y;
+} KeebieTouchOffset;
+
+// The grid over one solved plane, each cell lists the keys close enough to
+// it to be meant by a touch inside it.
+typedef struct {
+  KeebieGeometry* geometry;
+  guint plane;
+  float cell_size;
+  guint n_columns;
+  guint n_rows;
+  uint32_t* cells;
+  GArray* entries;
+  KeebieTouchOffset** offsets;
+} KeebieTouchIndex;
+
+struct _KeebieTouchModel {
+  gchar* path;
+
+  // "locale/plane.row.key" to KeebieTouchOffset, the index points into it.
+  GHashTable* offsets;
+  gboolean is_dirty;
+  KeebieFileWriter* writer;
+
+  KeebieTouchIndex index;
+};
+
+static KeebieTouchOffset* keebie_touch_model_get_offset(KeebieTouchModel* self, const char* name) {
+  KeebieTouchOffset* offset = reinterpret_cast<KeebieTouchOffset*>(g_hash_table_lookup(self->offsets, name));
+  if (offset == nullptr) {
+    offset = g_new0(KeebieTouchOffset, 1);
+    g_hash_table_insert(self->offsets, g_strdup(name), offset);
+  }
+  return offset;
+}
+
+KeebieTouchModel* keebie_touch_model_new(const char* path) {
+  KeebieTouchModel* self = g_new0(KeebieTouchModel, 1);
+  self->path = g_strdup(path);
+  self->offsets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  self->writer = keebie_file_writer_new();
+
+  g_autoptr(GKeyFile) file = g_key_file_new();
+  g_autoptr(GError) error = nullptr;
+  if (!g_key_file_load_from_file(file, path, G_KEY_FILE_NONE, &error)) {
+    if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+      g_warning("Failed to load the touch model %s: %s", path, error->message);
+    }
+    return self;
+  }
+
+  g_auto(GStrv) groups = g_key_file_get_groups(file, nullptr);
+  for (guint i = 0; groups[i] != nullptr; i++) {
+    g_auto(GStrv) keys = g_key_file_get_keys(file, groups[i], nullptr, nullptr);
+    for (guint x = 0; keys != nullptr && keys[x] != nullptr; x++) {
+      gsize length = 0;
+      g_autofree gdouble* values = g_key_file_get_double_list(file, groups[i], keys[x], &length, nullptr);
+      if (values == nullptr || length != 2) {
+        continue;
+      }
+
+      g_autofree gchar* name = g_strdup_printf("%s/%s", groups[i], keys[x]);
+      KeebieTouchOffset* offset = keebie_touch_model_get_offset(self, name);
+      offset->x = CLAMP(values[0], -KEEBIE_TOUCH_MODEL_MAX_OFFSET, KEEBIE_TOUCH_MODEL_MAX_OFFSET);
+      offset->y = CLAMP(values[1], -KEEBIE_TOUCH_MODEL_MAX_OFFSET, KEEBIE_TOUCH_MODEL_MAX_OFFSET);
+    }
+  }
+  return self;
+}
+
+static void keebie_touch_index_clear(KeebieTouchIndex* index) {
+  g_clear_pointer(&index->geometry, keebie_geometry_unref);
+  g_clear_pointer(&index->cells, g_free);
+  g_clear_pointer(&index->entries, g_array_unref);
+  g_clear_pointer(&index->offsets, g_free);
+}
+
+void keebie_touch_model_free(KeebieTouchModel* self) {
+  keebie_file_writer_free(self->writer);
+  keebie_touch_index_clear(&self->index);
+  g_hash_table_unref(self->offsets);
+  g_free(self->path);
+  g_free(self);
+}
+
+static void keebie_touch_model_build_index(KeebieTouchModel* self, KeebieLayout* layout, KeebieGeometry* geometry, guint plane) {
+  KeebieTouchIndex* index = &self->index;
+  keebie_touch_index_clear(index);
+  index->geometry = keebie_geometry_ref(geometry);
+  index->plane = plane;
+
+  // Cells the size of the smallest key keep every list to a key's neighbours.
+  float cell_size = G_MAXFLOAT;
+  for (guint i = 0; i < geometry->n_keys; i++) {
+    cell_size = MIN(cell_size, MIN(geometry->keys[i].width, geometry->keys[i].height));
+  }
+  index->cell_size = geometry->n_keys > 0 && cell_size > 0.0f ? cell_size : 1.0f;
+  index->n_columns = MAX(static_cast<guint>(ceilf(geometry->width / index->cell_size)), 1);
+  index->n_rows = MAX(static_cast<guint>(ceilf(geometry->height / index->cell_size)), 1);
+
+  // A key is listed in every cell within a cell of its rect, counted first
+  // so the lists can share one array.
+  guint n_cells = index->n_columns * index->n_rows;
+  g_autofree guint* spans = g_new(guint, MAX(geometry->n_keys, 1) * 4);
+  index->cells = g_new0(uint32_t, n_cells + 1);
+  for (guint pass = 0; pass < 2; pass++) {
+    g_autofree uint32_t* fill = pass == 1 ? reinterpret_cast<uint32_t*>(g_memdup2(index->cells, n_cells * sizeof (uint32_t))) : nullptr;
+    if (pass == 1) {
+      index->entries = g_array_sized_new(FALSE, FALSE, sizeof (uint32_t), index->cells[n_cells]);
+      g_array_set_size(index->entries, index->cells[n_cells]);
+    }
+
+    for (guint i = 0; i < geometry->n_keys; i++) {
+      const KeebieKeyRect* rect = &geometry->keys[i];
+      if (pass == 0) {
+        spans[i * 4] = MIN(static_cast<guint>(MAX(floorf(rect->x / index->cell_size) - 1.0f, 0.0f)), index->n_columns - 1);
+        spans[i * 4 + 1] = MIN(static_cast<guint>(MAX(floorf((rect->x + rect->width) / index->cell_size) + 1.0f, 0.0f)), index->n_columns - 1);
+        spans[i * 4 + 2] = MIN(static_cast<guint>(MAX(floorf(rect->y / index->cell_size) - 1.0f, 0.0f)), index->n_rows - 1);
+        spans[i * 4 + 3] = MIN(static_cast<guint>(MAX(floorf((rect->y + rect->height) / index->cell_size) + 1.0f, 0.0f)), index->n_rows - 1);
+      }
+
+      for (guint row = spans[i * 4 + 2]; row <= spans[i * 4 + 3]; row++) {
+        for (guint column = spans[i * 4]; column <= spans[i * 4 + 1]; column++) {
+          guint cell = row * index->n_columns + column;
+          if (pass == 0) {
+            index->cells[cell + 1]++;
+          } else {
+            g_array_index(index->entries, uint32_t, fill[cell]++) = i;
+          }
+        }
+      }
+    }
+
+    for (guint cell = 0; pass == 0 && cell < n_cells; cell++) {
+      index->cells[cell + 1] += index->cells[cell];
+    }
+  }
+
+  const char* locale = keebie_layout_get_locale(layout);
+  index->offsets = g_new(KeebieTouchOffset*, MAX(geometry->n_keys, 1));
+  for (guint i = 0; i < geometry->n_keys; i++) {
+    g_autofree gchar* name = g_strdup_printf("%s/%u.%u.%u", locale, plane, geometry->keys[i].row, geometry->keys[i].key);
+    index->offsets[i] = keebie_touch_model_get_offset(self, name);
+  }
+}
+
+static float keebie_touch_model_score(const KeebieKeyRect* rect, const KeebieTouchOffset* offset, float x, float y) {
+  float dx = (x - (rect->x + rect->width * (0.5f + offset->x))) / (rect->width * KEEBIE_TOUCH_MODEL_SIGMA);
+  float dy = (y - (rect->y + rect->height * (0.5f + offset->y))) / (rect->height * KEEBIE_TOUCH_MODEL_SIGMA);
+  return -0.5f * (dx * dx + dy * dy);
+}
+
+gint keebie_touch_model_resolve(KeebieTouchModel* self, KeebieLayout* layout, KeebieGeometry* geometry, guint plane, float x, float y, KeebieTouchPriorFunc prior, gpointer user_data) {
+  KeebieTouchIndex* index = &self->index;
+  if (index->geometry != geometry || index->plane != plane) {
+    keebie_touch_model_build_index(self, layout, geometry, plane);
+  }
+
+  guint column = static_cast<guint>(CLAMP(floorf(x / index->cell_size), 0.0f, index->n_columns - 1.0f));
+  guint row = static_cast<guint>(CLAMP(floorf(y / index->cell_size), 0.0f, index->n_rows - 1.0f));
+  guint cell = row * index->n_columns + column;
+  const uint32_t* entries = reinterpret_cast<const uint32_t*>(index->entries->data);
+  guint start = index->cells[cell];
+  guint end = index->cells[cell + 1];
+
+  float best_spatial = -G_MAXFLOAT;
+  for (guint i = start; i < end; i++) {
+    best_spatial = MAX(best_spatial, keebie_touch_model_score(&geometry->keys[entries[i]], index->offsets[entries[i]], x, y));
+  }
+
+  // Only keys the prior could still carry past the closest one need it.
+  gint best = -1;
+  float best_score = -G_MAXFLOAT;
+  for (guint i = start; i < end; i++) {
+    float score = keebie_touch_model_score(&geometry->keys[entries[i]], index->offsets[entries[i]], x, y);
+    if (prior != nullptr && score >= best_spatial + KEEBIE_TOUCH_MODEL_PRIOR_WEIGHT * KEEBIE_TOUCH_MODEL_PRIOR_FLOOR) {
+      const KeebieKeyRect* rect = &geometry->keys[entries[i]];
+      const KeebieKeyAction* action = keebie_layout_lookup(layout, plane, rect->row, rect->key);
+      const char* text = action != nullptr && action->type == KEEBIE_KEY_ACTION_COMMIT ? keebie_layout_get_text(layout, action, FALSE) : nullptr;
+      score += KEEBIE_TOUCH_MODEL_PRIOR_WEIGHT * MAX(prior(text, user_data), KEEBIE_TOUCH_MODEL_PRIOR_FLOOR);
+    }
+
+    if (score > best_score) {
+      best_score = score;
+      best = entries[i];
+    }
+  }
+
+  if (best < 0) {
+    return -1;
+  }
+
+  const KeebieKeyRect* rect = &geometry->keys[best];
+  float aim_x = (x - rect->x) / rect->width - 0.5f;
+  float aim_y = (y - rect->y) / rect->height - 0.5f;
+  if (fabsf(aim_x) < KEEBIE_TOUCH_MODEL_LEARN_RADIUS && fabsf(aim_y) < KEEBIE_TOUCH_MODEL_LEARN_RADIUS) {
+    KeebieTouchOffset* offset = index->offsets[best];
+    offset->x = CLAMP(offset->x + (aim_x - offset->x) * KEEBIE_TOUCH_MODEL_LEARNING_RATE, -KEEBIE_TOUCH_MODEL_MAX_OFFSET, KEEBIE_TOUCH_MODEL_MAX_OFFSET);
+    offset->y = CLAMP(offset->y + (aim_y - offset->y) * KEEBIE_TOUCH_MODEL_LEARNING_RATE, -KEEBIE_TOUCH_MODEL_MAX_OFFSET, KEEBIE_TOUCH_MODEL_MAX_OFFSET);
+    self->is_dirty = TRUE;
+  }
+  return best;
+}
+
+void keebie_touch_model_save(KeebieTouchModel* self) {
+  if (!self->is_dirty) {
+    return;
+  }
+
+  g_autoptr(GKeyFile) file = g_key_file_new();
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  g_hash_table_iter_init(&iter, self->offsets);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    const char* name = reinterpret_cast<const char*>(key);
+    const KeebieTouchOffset* offset = reinterpret_cast<const KeebieTouchOffset*>(value);
+    const char* slash = strrchr(name, '/');
+    if (slash == nullptr || (offset->x == 0.0f && offset->y == 0.0f)) {
+      continue;
+    }
+
+    g_autofree gchar* group = g_strndup(name, slash - name);
+    gdouble values[2] = { offset->x, offset->y };
+    g_key_file_set_double_list(file, group, slash + 1, values, 2);
+  }
+
+  gsize length = 0;
+  gchar* contents = g_key_file_to_data(file, &length, nullptr);
+  keebie_file_writer_write(self->writer, self->path, contents, length);
+  self->is_dirty = FALSE;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glib.h>
+#include "geometry.h"
+#include "layout.h"
+
+G_BEGIN_DECLS
+
+/**
+ * Scores how likely committing text is at the cursor as a natural log, NULL
+ * text stands for keys which commit nothing.
+ */
+typedef float (*KeebieTouchPriorFunc)(const char* text, gpointer user_data);
+
+/**
+ * Resolves touches to the key they were meant for. Every key is a Gaussian
+ * target around its center, shifted by how this user tends to miss it, and
+ * the language's opinion on what comes next breaks the close calls. Keys
+ * are looked up through a grid over the plane, so a touch only ever scores
+ * its neighbourhood. Not thread safe, the application's lock guards it.
+ */
+typedef struct _KeebieTouchModel KeebieTouchModel;
+
+/**
+ * Loads the offsets learned so far from path, if there are any.
+ */
+KeebieTouchModel* keebie_touch_model_new(const char* path);
+void keebie_touch_model_free(KeebieTouchModel* self);
+
+/**
+ * Returns the index into geometry's keys of the key a touch at x, y within
+ * the plane most likely meant, -1 when the plane has no keys. The touch is
+ * learned as how the user hits that key.
+ */
+gint keebie_touch_model_resolve(KeebieTouchModel* self, KeebieLayout* layout, KeebieGeometry* geometry, guint plane, float x, float y, KeebieTouchPriorFunc prior, gpointer user_data);
+
+/**
+ * Has the learned offsets written out on a worker if they changed. Called
+ * whenever the keyboard goes idle.
+ */
+void keebie_touch_model_save(KeebieTouchModel* self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieTouchModel, keebie_touch_model_free);
+
+G_END_DECLS
@@ -0,0 +1,189 @@
+#include "touch-tracker.h"
+
+typedef struct {
+  gconstpointer sequence;
+  guint32 time;
+  KeebieTouchKey key;
+  gboolean is_down;
+  gboolean is_held;
+  gboolean is_committed;
+} KeebieTouch;
+
+struct _KeebieTouchTracker {
+  KeebieTouchCommitFunc commit;
+  KeebieTouchReleaseFunc release;
+  gpointer data;
+  guint rollover;
+
+  // Ordered by when they went down, a touch is dropped once it lifted and
+  // was typed.
+  GArray* touches;
+  guint timeout_id;
+};
+
+static gint keebie_touch_tracker_find(KeebieTouchTracker* self, gconstpointer sequence) {
+  // Lifted touches can wait on their turn with a sequence which was reused.
+  for (guint i = 0; i < self->touches->len; i++) {
+    const KeebieTouch* touch = &g_array_index(self->touches, KeebieTouch, i);
+    if (touch->is_down && touch->sequence == sequence) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static gboolean keebie_touch_tracker_timeout(gpointer data);
+
+/**
+ * Types the touches from the oldest on, those which lifted as well as any
+ * still down up to and including until, and drops the ones done with. A
+ * touch still down past until holds back every later one.
+ */
+static void keebie_touch_tracker_flush(KeebieTouchTracker* self, gint until) {
+  guint i = 0;
+  while (i < self->touches->len) {
+    KeebieTouch* touch = &g_array_index(self->touches, KeebieTouch, i);
+    if (!touch->is_committed) {
+      if (touch->is_down && static_cast<gint>(i) > until) {
+        break;
+      }
+
+      touch->is_committed = TRUE;
+      self->commit(&touch->key, FALSE, touch->is_down, self->data);
+    }
+
+    if (touch->is_down) {
+      i++;
+    } else {
+      g_array_remove_index(self->touches, i);
+      until--;
+    }
+  }
+
+  gboolean is_waiting = FALSE;
+  for (; i < self->touches->len && !is_waiting; i++) {
+    const KeebieTouch* touch = &g_array_index(self->touches, KeebieTouch, i);
+    is_waiting = !touch->is_down && !touch->is_committed;
+  }
+
+  if (is_waiting && self->timeout_id == 0) {
+    self->timeout_id = g_timeout_add(self->rollover, keebie_touch_tracker_timeout, self);
+  } else if (!is_waiting && self->timeout_id != 0) {
+    g_source_remove(self->timeout_id);
+    self->timeout_id = 0;
+  }
+}
+
+static gboolean keebie_touch_tracker_timeout(gpointer data) {
+  KeebieTouchTracker* self = reinterpret_cast<KeebieTouchTracker*>(data);
+  self->timeout_id = 0;
+
+  // Anything held down longer than that before a later key lifted was meant
+  // to come first.
+  gint until = -1;
+  for (guint i = 0; i < self->touches->len; i++) {
+    const KeebieTouch* touch = &g_array_index(self->touches, KeebieTouch, i);
+    if (!touch->is_down && !touch->is_committed) {
+      until = i;
+    }
+  }
+
+  keebie_touch_tracker_flush(self, until);
+  return G_SOURCE_REMOVE;
+}
+
+KeebieTouchTracker* keebie_touch_tracker_new(KeebieTouchCommitFunc commit, KeebieTouchReleaseFunc release, gpointer data) {
+  KeebieTouchTracker* self = g_new0(KeebieTouchTracker, 1);
+  self->commit = commit;
+  self->release = release;
+  self->data = data;
+  self->rollover = KEEBIE_TOUCH_TRACKER_DEFAULT_ROLLOVER;
+  self->touches = g_array_new(FALSE, TRUE, sizeof (KeebieTouch));
+  return self;
+}
+
+void keebie_touch_tracker_free(KeebieTouchTracker* self) {
+  if (self->timeout_id != 0) {
+    g_source_remove(self->timeout_id);
+  }
+
+  g_array_unref(self->touches);
+  g_free(self);
+}
+
+void keebie_touch_tracker_set_rollover(KeebieTouchTracker* self, guint rollover) {
+  self->rollover = rollover;
+}
+
+void keebie_touch_tracker_begin(KeebieTouchTracker* self, gconstpointer sequence, guint32 time, const KeebieTouchKey* key, gboolean is_held) {
+  // Events arrive in order, but the times are what the device reported.
+  guint index = self->touches->len;
+  while (index > 0 && g_array_index(self->touches, KeebieTouch, index - 1).time > time) {
+    index--;
+  }
+
+  KeebieTouch touch = {};
+  touch.sequence = sequence;
+  touch.time = time;
+  touch.key = *key;
+  touch.is_down = TRUE;
+  g_array_insert_val(self->touches, index, touch);
+
+  if (!is_held) {
+    return;
+  }
+
+  // A key typed on the way down comes after everything touched before it.
+  keebie_touch_tracker_flush(self, static_cast<gint>(index) - 1);
+  index = keebie_touch_tracker_find(self, sequence);
+
+  // Pressing a key stops whichever one was repeating.
+  for (guint i = 0; i < self->touches->len; i++) {
+    g_array_index(self->touches, KeebieTouch, i).is_held = FALSE;
+  }
+
+  KeebieTouch* held = &g_array_index(self->touches, KeebieTouch, index);
+  held->is_held = TRUE;
+  held->is_committed = TRUE;
+  self->commit(&held->key, TRUE, TRUE, self->data);
+}
+
+gboolean keebie_touch_tracker_has(KeebieTouchTracker* self, gconstpointer sequence) {
+  return keebie_touch_tracker_find(self, sequence) >= 0;
+}
+
+gboolean keebie_touch_tracker_is_committed(KeebieTouchTracker* self, gconstpointer sequence) {
+  gint index = keebie_touch_tracker_find(self, sequence);
+  return index >= 0 && g_array_index(self->touches, KeebieTouch, index).is_committed;
+}
+
+gboolean keebie_touch_tracker_is_down(KeebieTouchTracker* self) {
+  for (guint i = 0; i < self->touches->len; i++) {
+    if (g_array_index(self->touches, KeebieTouch, i).is_down) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+gboolean keebie_touch_tracker_end(KeebieTouchTracker* self, gconstpointer sequence, gboolean is_cancelled, KeebieTouchKey* key) {
+  gint index = keebie_touch_tracker_find(self, sequence);
+  if (index < 0) {
+    return FALSE;
+  }
+
+  KeebieTouch* touch = &g_array_index(self->touches, KeebieTouch, index);
+  *key = touch->key;
+  touch->is_down = FALSE;
+  if (is_cancelled) {
+    touch->is_committed = TRUE;
+  }
+
+  if (touch->is_held) {
+    touch->is_held = FALSE;
+    self->release(&touch->key, self->data);
+  }
+
+  keebie_touch_tracker_flush(self, self->rollover == 0 ? index : -1);
+  return TRUE;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+// About how long fast two-thumb typists keep one key down past the next.
+#define KEEBIE_TOUCH_TRACKER_DEFAULT_ROLLOVER 150
+
+typedef struct {
+  guint plane;
+  guint row;
+  guint key;
+} KeebieTouchKey;
+
+/**
+ * Types the key of a touch. Held is set when the key goes out as it is
+ * pressed and repeats until the touch lifts, down when the touch has not
+ * lifted yet.
+ */
+typedef void (*KeebieTouchCommitFunc)(const KeebieTouchKey* key, gboolean is_held, gboolean is_down, gpointer data);
+
+/**
+ * Stops the repeat of the last held key, its touch lifted.
+ */
+typedef void (*KeebieTouchReleaseFunc)(const KeebieTouchKey* key, gpointer data);
+
+/**
+ * Tracks every touch on the keyboard at once, each with the key it landed on,
+ * and types them in the order they went down however their lifts overlap.
+ */
+typedef struct _KeebieTouchTracker KeebieTouchTracker;
+
+KeebieTouchTracker* keebie_touch_tracker_new(KeebieTouchCommitFunc commit, KeebieTouchReleaseFunc release, gpointer data);
+void keebie_touch_tracker_free(KeebieTouchTracker* self);
+
+/**
+ * How long in milliseconds a touch which lifted waits for touches that went
+ * down before it and are still held, after that those are typed as well.
+ */
+void keebie_touch_tracker_set_rollover(KeebieTouchTracker* self, guint rollover);
+
+/**
+ * Starts tracking sequence, which went down at time on key. When is_held is
+ * set the key goes out right away, after every earlier touch, and repeats
+ * until it lifts, otherwise it is typed once it lifted.
+ */
+void keebie_touch_tracker_begin(KeebieTouchTracker* self, gconstpointer sequence, guint32 time, const KeebieTouchKey* key, gboolean is_held);
+
+/**
+ * Returns whether sequence is being tracked, its events are not for anyone
+ * else then.
+ */
+gboolean keebie_touch_tracker_has(KeebieTouchTracker* self, gconstpointer sequence);
+
+/**
+ * Returns whether the key of sequence went out already.
+ */
+gboolean keebie_touch_tracker_is_committed(KeebieTouchTracker* self, gconstpointer sequence);
+
+/**
+ * Returns whether any tracked touch is still down.
+ */
+gboolean keebie_touch_tracker_is_down(KeebieTouchTracker* self);
+
+/**
+ * Lifts sequence, or cancels it so its key is not typed unless it already
+ * was, and copies its key to key. Returns FALSE when the sequence was not
+ * tracked.
+ */
+gboolean keebie_touch_tracker_end(KeebieTouchTracker* self, gconstpointer sequence, gboolean is_cancelled, KeebieTouchKey* key);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieTouchTracker, keebie_touch_tracker_free);
+
+G_END_DECLS
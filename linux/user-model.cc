@@ -0,0 +1,816 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "blob.h"
+#include "surrounding.h"
+#include "user-model.h"
+
+// While typing, the log is folded into the model once this many n-grams or an
+// eighth of the model's size are in it, whichever is more, so compaction costs
+// stay linear as the model grows. Going idle folds it from a lower count.
+#define KEEBIE_USER_MODEL_COMPACT_THRESHOLD 4096
+#define KEEBIE_USER_MODEL_COMPACT_RATIO 8
+#define KEEBIE_USER_MODEL_IDLE_COMPACT_THRESHOLD 256
+
+// Bounds how many n-grams a prefix completion looks at.
+#define KEEBIE_USER_MODEL_MAX_SCAN 1024
+
+// Longer runs are URLs, hashes and the like rather than words.
+#define KEEBIE_USER_MODEL_MAX_WORD 48
+
+#define KEEBIE_USER_MODEL_SEPARATOR '\x1f'
+
+typedef enum {
+  KEEBIE_USER_MODEL_TASK_LOAD = 0,
+  KEEBIE_USER_MODEL_TASK_LEARN,
+  KEEBIE_USER_MODEL_TASK_COMPACT,
+} KeebieUserModelTaskType;
+
+typedef struct {
+  KeebieUserModelTaskType type;
+  gchar* text;
+  gsize length;
+  gsize offset;
+} KeebieUserModelTask;
+
+typedef struct {
+  GMappedFile* file;
+  guint8* data;
+  gsize size;
+  const KeebieUserModelHeader* header;
+  const KeebieUserModelNgram* ngrams;
+  const KeebieUserModelContext* contexts;
+  const uint32_t* followers;
+  const char* strings;
+} KeebieUserModelMap;
+
+typedef struct {
+  gchar* key;
+  gsize length;
+  uint32_t count;
+} KeebieUserModelEntry;
+
+typedef struct {
+  const char* word;
+  gsize length;
+  uint32_t count;
+} KeebieUserModelCandidate;
+
+struct _KeebieUserModel {
+  gchar* model_path;
+  gchar* log_path;
+  GThreadPool* worker;
+
+  // Guards map and pending. Only the worker changes either, so it reads
+  // them without taking the lock.
+  GMutex lock;
+  KeebieUserModelMap map;
+
+  // Everything logged since the last compaction, context -> word -> count.
+  GHashTable* pending;
+  guint n_logged;
+
+  // Pending unigrams the mapped model does not have, the only pending words a
+  // prefix completion has to look at besides the mapped run.
+  GHashTable* novel;
+
+  int log_fd;
+};
+
+static void keebie_user_model_unmap(KeebieUserModelMap* map) {
+  if (map->file != nullptr) {
+    g_mapped_file_unref(map->file);
+  }
+  *map = {};
+}
+
+static gboolean keebie_user_model_map_file(KeebieUserModelMap* map, const char* path) {
+  *map = {};
+
+  // Lookups are binary searches, readahead would only fault in pages no
+  // lookup ever needs.
+  g_autoptr(GError) error = nullptr;
+  map->file = keebie_blob_map(path, sizeof (KeebieUserModelHeader), MADV_RANDOM, &error);
+  if (map->file == nullptr) {
+    if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+      g_warning("%s, starting over", error->message);
+    }
+    return FALSE;
+  }
+
+  map->data = reinterpret_cast<guint8*>(g_mapped_file_get_contents(map->file));
+  map->size = g_mapped_file_get_length(map->file);
+
+  const KeebieUserModelHeader* header = reinterpret_cast<const KeebieUserModelHeader*>(map->data);
+  if (header->magic != KEEBIE_USER_MODEL_MAGIC || header->version != KEEBIE_USER_MODEL_VERSION
+      || header->size != map->size
+      || !keebie_blob_section_is_valid(map->size, sizeof (KeebieUserModelHeader), header->ngrams_offset, header->n_ngrams, sizeof (KeebieUserModelNgram))
+      || !keebie_blob_section_is_valid(map->size, sizeof (KeebieUserModelHeader), header->contexts_offset, header->n_contexts, sizeof (KeebieUserModelContext))
+      || !keebie_blob_section_is_valid(map->size, sizeof (KeebieUserModelHeader), header->followers_offset, header->n_followers, sizeof (uint32_t))
+      || !keebie_blob_section_is_valid(map->size, sizeof (KeebieUserModelHeader), header->strings_offset, header->strings_size, 1)) {
+    g_warning("%s is truncated, corrupt or of another version, starting over", path);
+    keebie_user_model_unmap(map);
+    return FALSE;
+  }
+
+  map->header = header;
+  map->ngrams = reinterpret_cast<const KeebieUserModelNgram*>(map->data + header->ngrams_offset);
+  map->contexts = reinterpret_cast<const KeebieUserModelContext*>(map->data + header->contexts_offset);
+  map->followers = reinterpret_cast<const uint32_t*>(map->data + header->followers_offset);
+  map->strings = reinterpret_cast<const char*>(map->data + header->strings_offset);
+  return TRUE;
+}
+
+static int keebie_user_model_compare(const char* a, gsize a_length, const char* b, gsize b_length) {
+  int result = memcmp(a, b, MIN(a_length, b_length));
+  if (result != 0) {
+    return result;
+  }
+  return a_length < b_length ? -1 : a_length > b_length ? 1 : 0;
+}
+
+// Keys pointing outside the strings read as empty, a corrupt model gives
+// wrong answers but never reads out of bounds.
+static const char* keebie_user_model_map_get_string(const KeebieUserModelMap* map, uint32_t offset, uint32_t* length) {
+  if (offset > map->header->strings_size || *length > map->header->strings_size - offset) {
+    *length = 0;
+    return "";
+  }
+  return map->strings + offset;
+}
+
+static const char* keebie_user_model_map_get_key(const KeebieUserModelMap* map, uint32_t index, uint32_t* length) {
+  const KeebieUserModelNgram* ngram = &map->ngrams[index];
+  *length = ngram->key_length;
+  return keebie_user_model_map_get_string(map, ngram->key_offset, length);
+}
+
+static guint keebie_user_model_map_lower_bound(const KeebieUserModelMap* map, const char* key, gsize length) {
+  if (map->header == nullptr) {
+    return 0;
+  }
+
+  guint low = 0;
+  guint high = map->header->n_ngrams;
+  while (low < high) {
+    guint middle = low + (high - low) / 2;
+    uint32_t middle_length;
+    const char* middle_key = keebie_user_model_map_get_key(map, middle, &middle_length);
+    if (keebie_user_model_compare(middle_key, middle_length, key, length) < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+static uint32_t keebie_user_model_map_get_count(const KeebieUserModelMap* map, const char* key, gsize length) {
+  guint index = keebie_user_model_map_lower_bound(map, key, length);
+  if (map->header == nullptr || index >= map->header->n_ngrams) {
+    return 0;
+  }
+
+  uint32_t found_length;
+  const char* found = keebie_user_model_map_get_key(map, index, &found_length);
+  return keebie_user_model_compare(found, found_length, key, length) == 0 ? map->ngrams[index].count : 0;
+}
+
+static const KeebieUserModelContext* keebie_user_model_map_get_context(const KeebieUserModelMap* map, const char* context) {
+  if (map->header == nullptr) {
+    return nullptr;
+  }
+
+  gsize length = strlen(context);
+  guint low = 0;
+  guint high = map->header->n_contexts;
+  while (low < high) {
+    guint middle = low + (high - low) / 2;
+    const KeebieUserModelContext* entry = &map->contexts[middle];
+    uint32_t entry_length = entry->key_length;
+    const char* entry_key = keebie_user_model_map_get_string(map, entry->key_offset, &entry_length);
+
+    int result = keebie_user_model_compare(entry_key, entry_length, context, length);
+    if (result == 0) {
+      if (entry->first_follower > map->header->n_followers || entry->n_followers > map->header->n_followers - entry->first_follower) {
+        return nullptr;
+      }
+      return entry;
+    }
+
+    if (result < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return nullptr;
+}
+
+static uint32_t keebie_user_model_add_count(uint32_t a, uint32_t b) {
+  return a > G_MAXUINT32 - b ? G_MAXUINT32 : a + b;
+}
+
+static uint32_t keebie_user_model_get_pending_locked(KeebieUserModel* self, const char* context, const char* word) {
+  GHashTable* words = reinterpret_cast<GHashTable*>(g_hash_table_lookup(self->pending, context));
+  return words != nullptr ? GPOINTER_TO_UINT(g_hash_table_lookup(words, word)) : 0;
+}
+
+static uint32_t keebie_user_model_get_count_locked(KeebieUserModel* self, const char* context, const char* word) {
+  g_autofree gchar* key = g_strdup_printf("%s%c%s", context, KEEBIE_USER_MODEL_SEPARATOR, word);
+  uint32_t count = keebie_user_model_map_get_count(&self->map, key, strlen(key));
+  return keebie_user_model_add_count(count, keebie_user_model_get_pending_locked(self, context, word));
+}
+
+static void keebie_user_model_add_pending_locked(KeebieUserModel* self, const char* context, const char* word) {
+  GHashTable* words = reinterpret_cast<GHashTable*>(g_hash_table_lookup(self->pending, context));
+  if (words == nullptr) {
+    words = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, nullptr);
+    g_hash_table_insert(self->pending, g_strdup(context), words);
+  }
+
+  uint32_t count = GPOINTER_TO_UINT(g_hash_table_lookup(words, word));
+  g_hash_table_replace(words, g_strdup(word), GUINT_TO_POINTER(keebie_user_model_add_count(count, 1)));
+
+  if (context[0] == '\0' && count == 0) {
+    g_autofree gchar* key = g_strdup_printf("%c%s", KEEBIE_USER_MODEL_SEPARATOR, word);
+    if (keebie_user_model_map_get_count(&self->map, key, strlen(key)) == 0) {
+      g_hash_table_add(self->novel, g_strdup(word));
+    }
+  }
+}
+
+static void keebie_user_model_add(KeebieUserModel* self, const char* context, const char* word) {
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+  keebie_user_model_add_pending_locked(self, "", word);
+  if (context != nullptr && context[0] != '\0') {
+    keebie_user_model_add_pending_locked(self, context, word);
+  }
+  self->n_logged++;
+}
+
+static gboolean keebie_user_model_write_all(int fd, const char* data, gsize length) {
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return FALSE;
+    }
+
+    data += written;
+    length -= written;
+  }
+  return TRUE;
+}
+
+static void keebie_user_model_write_log_header(KeebieUserModel* self) {
+  uint32_t generation = self->map.header != nullptr ? self->map.header->generation : 0;
+  g_autofree gchar* header = g_strdup_printf("# %u\n", generation);
+  if (!keebie_user_model_write_all(self->log_fd, header, strlen(header))) {
+    g_warning("Failed to write %s: %s", self->log_path, g_strerror(errno));
+  }
+}
+
+// A log line is "context<TAB>word", it is replayed the way it was learned.
+static void keebie_user_model_load(KeebieUserModel* self) {
+  g_autofree gchar* dir = g_path_get_dirname(self->log_path);
+  if (g_mkdir_with_parents(dir, 0700) < 0) {
+    g_warning("Failed to create %s: %s", dir, g_strerror(errno));
+    return;
+  }
+
+  self->log_fd = open(self->log_path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+  if (self->log_fd < 0) {
+    g_warning("Failed to open %s: %s", self->log_path, g_strerror(errno));
+    return;
+  }
+
+  g_autofree gchar* data = nullptr;
+  gsize length = 0;
+  if (!g_file_get_contents(self->log_path, &data, &length, nullptr)) {
+    length = 0;
+  }
+
+  // The log of a generation the model already holds was cut short by a crash
+  // right after compacting, replaying it would count everything twice.
+  uint32_t generation = self->map.header != nullptr ? self->map.header->generation : 0;
+  g_autofree gchar* header = g_strdup_printf("# %u\n", generation);
+  gsize valid = 0;
+  if (length >= strlen(header) && strncmp(data, header, strlen(header)) == 0) {
+    valid = strlen(header);
+
+    // Only whole lines count, the last one may have been torn by a crash.
+    const char* end = data + length;
+    for (const char* line = data + valid; line < end;) {
+      const char* newline = reinterpret_cast<const char*>(memchr(line, '\n', end - line));
+      if (newline == nullptr) {
+        break;
+      }
+
+      const char* tab = reinterpret_cast<const char*>(memchr(line, '\t', newline - line));
+      if (tab != nullptr && tab + 1 < newline) {
+        g_autofree gchar* context = g_strndup(line, tab - line);
+        g_autofree gchar* word = g_strndup(tab + 1, newline - tab - 1);
+        keebie_user_model_add(self, context, word);
+      }
+
+      line = newline + 1;
+      valid = line - data;
+    }
+  }
+
+  if (valid != length && ftruncate(self->log_fd, valid) < 0) {
+    g_warning("Failed to truncate %s: %s", self->log_path, g_strerror(errno));
+  }
+
+  if (valid == 0) {
+    keebie_user_model_write_log_header(self);
+  }
+}
+
+static void keebie_user_model_pending_to_entries(KeebieUserModel* self, GArray* entries) {
+  GHashTableIter context_iter;
+  gpointer context;
+  gpointer words;
+  g_hash_table_iter_init(&context_iter, self->pending);
+  while (g_hash_table_iter_next(&context_iter, &context, &words)) {
+    GHashTableIter word_iter;
+    gpointer word;
+    gpointer count;
+    g_hash_table_iter_init(&word_iter, reinterpret_cast<GHashTable*>(words));
+    while (g_hash_table_iter_next(&word_iter, &word, &count)) {
+      KeebieUserModelEntry entry;
+      entry.key = g_strdup_printf("%s%c%s", reinterpret_cast<const char*>(context), KEEBIE_USER_MODEL_SEPARATOR, reinterpret_cast<const char*>(word));
+      entry.length = strlen(entry.key);
+      entry.count = GPOINTER_TO_UINT(count);
+      g_array_append_val(entries, entry);
+    }
+  }
+}
+
+static gint keebie_user_model_compare_entries(gconstpointer a, gconstpointer b) {
+  const KeebieUserModelEntry* entry_a = reinterpret_cast<const KeebieUserModelEntry*>(a);
+  const KeebieUserModelEntry* entry_b = reinterpret_cast<const KeebieUserModelEntry*>(b);
+  return keebie_user_model_compare(entry_a->key, entry_a->length, entry_b->key, entry_b->length);
+}
+
+static gint keebie_user_model_compare_followers(gconstpointer a, gconstpointer b, gpointer data) {
+  const KeebieUserModelNgram* ngrams = reinterpret_cast<const KeebieUserModelNgram*>(data);
+  uint32_t index_a = *reinterpret_cast<const uint32_t*>(a);
+  uint32_t index_b = *reinterpret_cast<const uint32_t*>(b);
+  if (ngrams[index_a].count != ngrams[index_b].count) {
+    return ngrams[index_a].count > ngrams[index_b].count ? -1 : 1;
+  }
+  return index_a < index_b ? -1 : index_a > index_b ? 1 : 0;
+}
+
+static void keebie_user_model_append_ngram(GArray* ngrams, GByteArray* strings, const char* key, gsize length, uint32_t count) {
+  KeebieUserModelNgram ngram;
+  ngram.key_offset = strings->len;
+  ngram.key_length = length;
+  ngram.count = count;
+  g_byte_array_append(strings, reinterpret_cast<const guint8*>(key), length);
+  g_array_append_val(ngrams, ngram);
+}
+
+static gsize keebie_user_model_align(GByteArray* blob) {
+  static const guint8 zeroes[sizeof (uint32_t)] = {};
+  g_byte_array_append(blob, zeroes, (sizeof (uint32_t) - blob->len % sizeof (uint32_t)) % sizeof (uint32_t));
+  return blob->len;
+}
+
+// Merges the mapped model and what was learned since into a new model, the
+// merge keeps both in key order so nothing but the pending entries is sorted.
+static void keebie_user_model_compact_now(KeebieUserModel* self) {
+  if (self->n_logged == 0) {
+    return;
+  }
+
+  g_autoptr(GArray) entries = g_array_new(FALSE, FALSE, sizeof (KeebieUserModelEntry));
+  keebie_user_model_pending_to_entries(self, entries);
+  g_array_sort(entries, keebie_user_model_compare_entries);
+
+  g_autoptr(GArray) ngrams = g_array_new(FALSE, FALSE, sizeof (KeebieUserModelNgram));
+  g_autoptr(GByteArray) strings = g_byte_array_new();
+
+  const KeebieUserModelMap* map = &self->map;
+  guint n_mapped = map->header != nullptr ? map->header->n_ngrams : 0;
+  guint i = 0;
+  guint j = 0;
+  while (i < n_mapped || j < entries->len) {
+    uint32_t mapped_length = 0;
+    const char* mapped_key = i < n_mapped ? keebie_user_model_map_get_key(map, i, &mapped_length) : nullptr;
+    const KeebieUserModelEntry* entry = j < entries->len ? &g_array_index(entries, KeebieUserModelEntry, j) : nullptr;
+
+    int result = mapped_key == nullptr ? 1 : entry == nullptr ? -1 : keebie_user_model_compare(mapped_key, mapped_length, entry->key, entry->length);
+    if (result < 0) {
+      // Keys a corrupt model points outside its strings are dropped.
+      if (mapped_length > 0) {
+        keebie_user_model_append_ngram(ngrams, strings, mapped_key, mapped_length, map->ngrams[i].count);
+      }
+      i++;
+    } else if (result > 0) {
+      keebie_user_model_append_ngram(ngrams, strings, entry->key, entry->length, entry->count);
+      j++;
+    } else {
+      keebie_user_model_append_ngram(ngrams, strings, entry->key, entry->length, keebie_user_model_add_count(map->ngrams[i].count, entry->count));
+      i++;
+      j++;
+    }
+  }
+
+  for (guint k = 0; k < entries->len; k++) {
+    g_free(g_array_index(entries, KeebieUserModelEntry, k).key);
+  }
+
+  // A context's n-grams are contiguous, its followers are the same run by count.
+  g_autoptr(GArray) contexts = g_array_new(FALSE, FALSE, sizeof (KeebieUserModelContext));
+  g_autoptr(GArray) followers = g_array_sized_new(FALSE, FALSE, sizeof (uint32_t), ngrams->len);
+  for (guint start = 0; start < ngrams->len;) {
+    const KeebieUserModelNgram* first = &g_array_index(ngrams, KeebieUserModelNgram, start);
+    const char* key = reinterpret_cast<const char*>(strings->data) + first->key_offset;
+    const char* separator = reinterpret_cast<const char*>(memchr(key, KEEBIE_USER_MODEL_SEPARATOR, first->key_length));
+    gsize context_length = separator != nullptr ? separator - key : first->key_length;
+
+    guint end = start + 1;
+    while (end < ngrams->len) {
+      const KeebieUserModelNgram* ngram = &g_array_index(ngrams, KeebieUserModelNgram, end);
+      const char* other = reinterpret_cast<const char*>(strings->data) + ngram->key_offset;
+      if (ngram->key_length <= context_length || memcmp(other, key, context_length) != 0 || other[context_length] != KEEBIE_USER_MODEL_SEPARATOR) {
+        break;
+      }
+      end++;
+    }
+
+    KeebieUserModelContext context;
+    context.key_offset = first->key_offset;
+    context.key_length = context_length;
+    context.first_follower = followers->len;
+    context.n_followers = end - start;
+    g_array_append_val(contexts, context);
+
+    for (uint32_t index = start; index < end; index++) {
+      g_array_append_val(followers, index);
+    }
+    g_qsort_with_data(&g_array_index(followers, uint32_t, context.first_follower), context.n_followers, sizeof (uint32_t), keebie_user_model_compare_followers, ngrams->data);
+
+    start = end;
+  }
+
+  g_autoptr(GByteArray) blob = g_byte_array_new();
+  KeebieUserModelHeader header = {};
+  g_byte_array_append(blob, reinterpret_cast<const guint8*>(&header), sizeof (header));
+
+  header.magic = KEEBIE_USER_MODEL_MAGIC;
+  header.version = KEEBIE_USER_MODEL_VERSION;
+  header.generation = (map->header != nullptr ? map->header->generation : 0) + 1;
+
+  header.n_ngrams = ngrams->len;
+  header.ngrams_offset = keebie_user_model_align(blob);
+  g_byte_array_append(blob, reinterpret_cast<const guint8*>(ngrams->data), ngrams->len * sizeof (KeebieUserModelNgram));
+
+  header.n_contexts = contexts->len;
+  header.contexts_offset = keebie_user_model_align(blob);
+  g_byte_array_append(blob, reinterpret_cast<const guint8*>(contexts->data), contexts->len * sizeof (KeebieUserModelContext));
+
+  header.n_followers = followers->len;
+  header.followers_offset = keebie_user_model_align(blob);
+  g_byte_array_append(blob, reinterpret_cast<const guint8*>(followers->data), followers->len * sizeof (uint32_t));
+
+  header.strings_offset = blob->len;
+  header.strings_size = strings->len;
+  g_byte_array_append(blob, strings->data, strings->len);
+
+  header.size = blob->len;
+  memcpy(blob->data, &header, sizeof (header));
+
+  g_autoptr(GError) error = nullptr;
+  // What someone typed is nobody else's business, hence the mode.
+  if (!g_file_set_contents_full(self->model_path, reinterpret_cast<const gchar*>(blob->data), blob->len, G_FILE_SET_CONTENTS_CONSISTENT, 0600, &error)) {
+    g_warning("Failed to write %s: %s", self->model_path, error->message);
+    return;
+  }
+
+  KeebieUserModelMap new_map;
+  if (!keebie_user_model_map_file(&new_map, self->model_path)) {
+    return;
+  }
+
+  KeebieUserModelMap old_map;
+  {
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+    old_map = self->map;
+    self->map = new_map;
+    g_hash_table_remove_all(self->pending);
+    g_hash_table_remove_all(self->novel);
+    self->n_logged = 0;
+  }
+  keebie_user_model_unmap(&old_map);
+
+  // The new model's generation makes a log which survives a crash here stale.
+  if (self->log_fd >= 0) {
+    if (ftruncate(self->log_fd, 0) < 0) {
+      g_warning("Failed to truncate %s: %s", self->log_path, g_strerror(errno));
+    }
+    keebie_user_model_write_log_header(self);
+  }
+}
+
+gchar* keebie_user_model_normalize_word(const char* word, gsize length, gboolean starts_sentence) {
+  gchar* result = g_strndup(word, length);
+  gunichar first = g_utf8_get_char(result);
+  const char* rest = g_utf8_next_char(result);
+  if (!starts_sentence || !g_unichar_isupper(first) || *rest == '\0') {
+    return result;
+  }
+
+  for (const char* p = rest; *p != '\0'; p = g_utf8_next_char(p)) {
+    if (g_unichar_isupper(g_utf8_get_char(p))) {
+      return result;
+    }
+  }
+
+  gchar head[6];
+  gint head_length = g_unichar_to_utf8(g_unichar_tolower(first), head);
+  gchar* lower = g_strdup_printf("%.*s%s", head_length, head, rest);
+  g_free(result);
+  return lower;
+}
+
+static gboolean keebie_user_model_is_word(const char* word, gsize length) {
+  if (length > KEEBIE_USER_MODEL_MAX_WORD) {
+    return FALSE;
+  }
+
+  const char* end = word + length;
+  for (const char* p = word; p < end; p = g_utf8_next_char(p)) {
+    if (g_unichar_isalpha(g_utf8_get_char(p))) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+static void keebie_user_model_learn_text(KeebieUserModel* self, const char* text, gsize length, gsize offset) {
+  g_autoptr(GArray) split = keebie_surrounding_split_words(text, length);
+  g_autoptr(GString) log = g_string_new(nullptr);
+  g_autofree gchar* previous = nullptr;
+
+  for (guint i = 0; i < split->len; i++) {
+    const KeebieSurroundingWord* entry = &g_array_index(split, KeebieSurroundingWord, i);
+    if (!keebie_user_model_is_word(text + entry->start, entry->end - entry->start)) {
+      g_clear_pointer(&previous, g_free);
+      continue;
+    }
+
+    gchar* word = keebie_user_model_normalize_word(text + entry->start, entry->end - entry->start, entry->starts_sentence);
+    const char* context = entry->starts_sentence || previous == nullptr ? "" : previous;
+
+    // Words which were complete before this commit have been learned already.
+    if (entry->end >= offset && entry->end < length) {
+      keebie_user_model_add(self, context, word);
+      g_string_append_printf(log, "%s\t%s\n", context, word);
+    }
+
+    g_free(previous);
+    previous = word;
+  }
+
+  if (log->len > 0 && self->log_fd >= 0 && !keebie_user_model_write_all(self->log_fd, log->str, log->len)) {
+    g_warning("Failed to write %s: %s", self->log_path, g_strerror(errno));
+  }
+
+  guint n_mapped = self->map.header != nullptr ? self->map.header->n_ngrams : 0;
+  if (self->n_logged >= MAX(KEEBIE_USER_MODEL_COMPACT_THRESHOLD, n_mapped / KEEBIE_USER_MODEL_COMPACT_RATIO)) {
+    keebie_user_model_compact_now(self);
+  }
+}
+
+static void keebie_user_model_task_free(KeebieUserModelTask* task) {
+  g_free(task->text);
+  g_free(task);
+}
+
+static void keebie_user_model_run(gpointer data, gpointer user_data) {
+  KeebieUserModelTask* task = reinterpret_cast<KeebieUserModelTask*>(data);
+  KeebieUserModel* self = reinterpret_cast<KeebieUserModel*>(user_data);
+
+  switch (task->type) {
+    case KEEBIE_USER_MODEL_TASK_LOAD:
+      keebie_user_model_load(self);
+      break;
+    case KEEBIE_USER_MODEL_TASK_LEARN:
+      keebie_user_model_learn_text(self, task->text, task->length, task->offset);
+      break;
+    case KEEBIE_USER_MODEL_TASK_COMPACT:
+      if (self->n_logged >= KEEBIE_USER_MODEL_IDLE_COMPACT_THRESHOLD) {
+        keebie_user_model_compact_now(self);
+      }
+      break;
+  }
+
+  keebie_user_model_task_free(task);
+}
+
+static void keebie_user_model_push(KeebieUserModel* self, KeebieUserModelTaskType type, gchar* text, gsize length, gsize offset) {
+  KeebieUserModelTask* task = g_new0(KeebieUserModelTask, 1);
+  task->type = type;
+  task->text = text;
+  task->length = length;
+  task->offset = offset;
+
+  g_autoptr(GError) error = nullptr;
+  if (!g_thread_pool_push(self->worker, task, &error)) {
+    g_warning("Failed to queue user model work: %s", error->message);
+    keebie_user_model_task_free(task);
+  }
+}
+
+static void keebie_user_model_pending_free(gpointer data) {
+  g_hash_table_unref(reinterpret_cast<GHashTable*>(data));
+}
+
+KeebieUserModel* keebie_user_model_new(const char* dir) {
+  KeebieUserModel* self = g_new0(KeebieUserModel, 1);
+  self->model_path = g_build_filename(dir, "user-model.kbm", nullptr);
+  self->log_path = g_build_filename(dir, "user-model.log", nullptr);
+  self->log_fd = -1;
+  self->pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, keebie_user_model_pending_free);
+  self->novel = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, nullptr);
+  g_mutex_init(&self->lock);
+
+  keebie_user_model_map_file(&self->map, self->model_path);
+
+  // One thread, so tasks run in the order they were queued.
+  g_autoptr(GError) error = nullptr;
+  self->worker = g_thread_pool_new(keebie_user_model_run, self, 1, TRUE, &error);
+  if (self->worker == nullptr) {
+    g_warning("Failed to start the user model worker: %s", error->message);
+  } else {
+    keebie_user_model_push(self, KEEBIE_USER_MODEL_TASK_LOAD, nullptr, 0, 0);
+  }
+  return self;
+}
+
+void keebie_user_model_free(KeebieUserModel* self) {
+  if (self->worker != nullptr) {
+    g_thread_pool_free(self->worker, FALSE, TRUE);
+  }
+
+  if (self->log_fd >= 0) {
+    close(self->log_fd);
+  }
+
+  keebie_user_model_unmap(&self->map);
+  g_hash_table_unref(self->pending);
+  g_hash_table_unref(self->novel);
+  g_mutex_clear(&self->lock);
+  g_free(self->model_path);
+  g_free(self->log_path);
+  g_free(self);
+}
+
+void keebie_user_model_learn(KeebieUserModel* self, const char* text, gsize length, gsize offset) {
+  if (self->worker == nullptr || offset > length) {
+    return;
+  }
+
+  // Most commits are a single letter, those end no word and cost nothing.
+  const char* end = text + length;
+  for (const char* p = text + offset; p < end; p = g_utf8_next_char(p)) {
+    gunichar c = g_utf8_get_char(p);
+    if (!g_unichar_isalnum(c) && !g_unichar_ismark(c)) {
+      keebie_user_model_push(self, KEEBIE_USER_MODEL_TASK_LEARN, g_strndup(text, length), length, offset);
+      return;
+    }
+  }
+}
+
+void keebie_user_model_compact(KeebieUserModel* self) {
+  if (self->worker != nullptr) {
+    keebie_user_model_push(self, KEEBIE_USER_MODEL_TASK_COMPACT, nullptr, 0, 0);
+  }
+}
+
+uint32_t keebie_user_model_get_count(KeebieUserModel* self, const char* context, const char* word) {
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+  return keebie_user_model_get_count_locked(self, context != nullptr ? context : "", word);
+}
+
+static gint keebie_user_model_compare_candidates(gconstpointer a, gconstpointer b) {
+  const KeebieUserModelCandidate* candidate_a = reinterpret_cast<const KeebieUserModelCandidate*>(a);
+  const KeebieUserModelCandidate* candidate_b = reinterpret_cast<const KeebieUserModelCandidate*>(b);
+  if (candidate_a->count != candidate_b->count) {
+    return candidate_a->count > candidate_b->count ? -1 : 1;
+  }
+  return keebie_user_model_compare(candidate_a->word, candidate_a->length, candidate_b->word, candidate_b->length);
+}
+
+// Adds the words of pending matching prefix which are not candidates yet,
+// with their full counts, then appends the k best candidates.
+static guint keebie_user_model_finish_locked(KeebieUserModel* self, const char* context, const char* prefix, GHashTable* pending, GArray* candidates, GHashTable* seen, guint k, GPtrArray* words) {
+  if (pending != nullptr) {
+    gsize prefix_length = strlen(prefix);
+    GHashTableIter iter;
+    gpointer word;
+    gpointer count;
+    g_hash_table_iter_init(&iter, pending);
+    while (g_hash_table_iter_next(&iter, &word, &count)) {
+      const char* str = reinterpret_cast<const char*>(word);
+      if (strncmp(str, prefix, prefix_length) != 0 || g_hash_table_contains(seen, str)) {
+        continue;
+      }
+
+      KeebieUserModelCandidate candidate;
+      candidate.word = str;
+      candidate.length = strlen(str);
+      candidate.count = keebie_user_model_get_count_locked(self, context, str);
+      g_array_append_val(candidates, candidate);
+    }
+  }
+
+  g_array_sort(candidates, keebie_user_model_compare_candidates);
+
+  guint found = MIN(k, candidates->len);
+  for (guint i = 0; i < found; i++) {
+    const KeebieUserModelCandidate* candidate = &g_array_index(candidates, KeebieUserModelCandidate, i);
+    g_ptr_array_add(words, g_strndup(candidate->word, candidate->length));
+  }
+  return found;
+}
+
+static void keebie_user_model_add_mapped_candidate_locked(KeebieUserModel* self, const char* context, guint index, gsize context_length, GArray* candidates, GHashTable* seen) {
+  uint32_t key_length;
+  const char* key = keebie_user_model_map_get_key(&self->map, index, &key_length);
+  if (key_length <= context_length) {
+    return;
+  }
+
+  KeebieUserModelCandidate candidate;
+  candidate.word = key + context_length + 1;
+  candidate.length = key_length - context_length - 1;
+
+  g_autofree gchar* word = g_strndup(candidate.word, candidate.length);
+  candidate.count = keebie_user_model_add_count(self->map.ngrams[index].count, keebie_user_model_get_pending_locked(self, context, word));
+  g_array_append_val(candidates, candidate);
+  g_hash_table_add(seen, g_steal_pointer(&word));
+}
+
+guint keebie_user_model_predict(KeebieUserModel* self, const char* context, guint k, GPtrArray* words) {
+  if (context == nullptr || context[0] == '\0' || k == 0) {
+    return 0;
+  }
+
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+  g_autoptr(GArray) candidates = g_array_new(FALSE, FALSE, sizeof (KeebieUserModelCandidate));
+  g_autoptr(GHashTable) seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, nullptr);
+
+  // Only a pending word can overtake the mapped followers, so no more than k
+  // of them plus one per pending word can make it into the top k.
+  GHashTable* pending = reinterpret_cast<GHashTable*>(g_hash_table_lookup(self->pending, context));
+  guint n_pending = pending != nullptr ? g_hash_table_size(pending) : 0;
+
+  const KeebieUserModelContext* entry = keebie_user_model_map_get_context(&self->map, context);
+  if (entry != nullptr) {
+    guint n = MIN(entry->n_followers, k + n_pending);
+    for (guint i = 0; i < n; i++) {
+      uint32_t index = self->map.followers[entry->first_follower + i];
+      if (index < self->map.header->n_ngrams) {
+        keebie_user_model_add_mapped_candidate_locked(self, context, index, strlen(context), candidates, seen);
+      }
+    }
+  }
+  return keebie_user_model_finish_locked(self, context, "", pending, candidates, seen, k, words);
+}
+
+guint keebie_user_model_complete(KeebieUserModel* self, const char* prefix, guint k, GPtrArray* words) {
+  if (k == 0) {
+    return 0;
+  }
+
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->lock);
+  g_autoptr(GArray) candidates = g_array_new(FALSE, FALSE, sizeof (KeebieUserModelCandidate));
+  g_autoptr(GHashTable) seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, nullptr);
+
+  // Unigram keys are "\x1fword", the ones starting with prefix are one run.
+  g_autofree gchar* key = g_strdup_printf("%c%s", KEEBIE_USER_MODEL_SEPARATOR, prefix);
+  gsize key_length = strlen(key);
+  guint n_ngrams = self->map.header != nullptr ? self->map.header->n_ngrams : 0;
+  guint start = keebie_user_model_map_lower_bound(&self->map, key, key_length);
+  guint end = MIN(n_ngrams, start + KEEBIE_USER_MODEL_MAX_SCAN);
+  for (guint i = start; i < end; i++) {
+    uint32_t found_length;
+    const char* found = keebie_user_model_map_get_key(&self->map, i, &found_length);
+    if (found_length < key_length || memcmp(found, key, key_length) != 0) {
+      break;
+    }
+    keebie_user_model_add_mapped_candidate_locked(self, "", i, 0, candidates, seen);
+  }
+  return keebie_user_model_finish_locked(self, "", prefix, self->novel, candidates, seen, k, words);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+#define KEEBIE_USER_MODEL_MAGIC 0x4d55424bu /* "KBUM" */
+#define KEEBIE_USER_MODEL_VERSION 1
+
+/**
+ * The compacted model, a single blob of:
+ *
+ *   header | ngrams | contexts | followers | strings
+ *
+ * An n-gram is the key "context\x1fword" with how often word followed
+ * context, unigrams have an empty context. N-grams are sorted by key so
+ * exact counts and word prefixes are a binary search away, and as neither
+ * part holds a \x1f every context's n-grams are contiguous. Contexts point
+ * at their run of followers, n-gram indices by descending count, so
+ * predicting is reading the first k. Records are in host byte order, bump
+ * KEEBIE_USER_MODEL_VERSION on any change.
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;
+  uint32_t generation;
+  uint32_t n_ngrams;
+  uint32_t ngrams_offset;
+  uint32_t n_contexts;
+  uint32_t contexts_offset;
+  uint32_t n_followers;
+  uint32_t followers_offset;
+  uint32_t strings_offset;
+  uint32_t strings_size;
+} KeebieUserModelHeader;
+
+typedef struct {
+  uint32_t key_offset;
+  uint32_t key_length;
+  uint32_t count;
+} KeebieUserModelNgram;
+
+/**
+ * The context's key is the start of its first n-gram's key.
+ */
+typedef struct {
+  uint32_t key_offset;
+  uint32_t key_length;
+  uint32_t first_follower;
+  uint32_t n_followers;
+} KeebieUserModelContext;
+
+typedef struct _KeebieUserModel KeebieUserModel;
+
+/**
+ * Maps the compacted model in dir, if there is one, and replays the learning
+ * log on top of it in the background. Learning, logging and compaction all
+ * happen on a worker thread of the model's own.
+ */
+KeebieUserModel* keebie_user_model_new(const char* dir);
+
+/**
+ * Waits for queued learning to be logged before freeing.
+ */
+void keebie_user_model_free(KeebieUserModel* self);
+
+/**
+ * Learns the words of text which end at or after offset and are complete,
+ * followed by something that is not part of them. Text is everything before
+ * the cursor with the commit at offset, so words typed across several
+ * commits are seen whole. Returns right away, nothing is queued unless the
+ * commit ends a word.
+ */
+void keebie_user_model_learn(KeebieUserModel* self, const char* text, gsize length, gsize offset);
+
+/**
+ * Queues folding the log into a new compacted model, once enough was learned
+ * for rewriting it to be worth it. Called whenever the keyboard goes idle.
+ */
+void keebie_user_model_compact(KeebieUserModel* self);
+
+/**
+ * Returns the word the way the model keeps it, sentence starts are
+ * capitalized by convention rather than because the word is.
+ */
+gchar* keebie_user_model_normalize_word(const char* word, gsize length, gboolean starts_sentence);
+
+/**
+ * Returns how often word followed context, or was typed at all with a NULL
+ * context.
+ */
+uint32_t keebie_user_model_get_count(KeebieUserModel* self, const char* context, const char* word);
+
+/**
+ * Appends up to k words which most often followed context to words and
+ * returns how many were appended.
+ */
+guint keebie_user_model_predict(KeebieUserModel* self, const char* context, guint k, GPtrArray* words);
+
+/**
+ * Appends up to k typed words starting with prefix to words, most typed
+ * first, and returns how many were appended.
+ */
+guint keebie_user_model_complete(KeebieUserModel* self, const char* prefix, guint k, GPtrArray* words);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(KeebieUserModel, keebie_user_model_free);
+
+G_END_DECLS
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <errno.h>
 #include <fcntl.h>
 #include <string.h>
@@ -12,11 +13,12 @@
 struct LocaleMap {
   const char* code;
   const char* name;
+  const char* xkb_layout;
 };
 
 static const struct LocaleMap locale_map[] = {
-  { "en-US", "English (US)" },
-  { "ja-JP", "Japanese" }
+  { "en-US", "English (US)", "us" },
+  { "ja-JP", "Japanese", "jp" }
 };
 static const size_t locale_map_size = sizeof (locale_map) / sizeof (locale_map[0]);
 
@@ -30,6 +32,16 @@ const char* get_locale_name(const char* code) {
   return NULL;
 }
 
+const char* get_locale_xkb_layout(const char* code) {
+  for (size_t i = 0; i < locale_map_size; i++) {
+    const struct LocaleMap* entry = &locale_map[i];
+    if (strcmp(entry->code, code) == 0) {
+      return entry->xkb_layout;
+    }
+  }
+  return NULL;
+}
+
 static void randname(char* buf) {
 	struct timespec ts;
 	clock_gettime(CLOCK_REALTIME, &ts);
@@ -95,4 +107,47 @@ long get_time_ms() {
   struct timespec curr;
   clock_gettime(CLOCK_REALTIME, &curr);
   return curr.tv_sec * 1000 + curr.tv_nsec / 1000000;
-}
\ No newline at end of file
+}
+
+int create_sealed_memfd(const char* name, const void* data, size_t size) {
+  int fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0) {
+    // Kernels without memfd get an unlinked shm file, read-only to the receiver.
+    int rw_fd = -1;
+    int ro_fd = -1;
+    if (!allocate_shm_file_pair(size, &rw_fd, &ro_fd)) {
+      return -1;
+    }
+
+    void* dst = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, rw_fd, 0);
+    close(rw_fd);
+    if (dst == MAP_FAILED) {
+      close(ro_fd);
+      return -1;
+    }
+
+    memcpy(dst, data, size);
+    munmap(dst, size);
+    return ro_fd;
+  }
+
+  const char* ptr = data;
+  size_t left = size;
+  while (left > 0) {
+    ssize_t ret = write(fd, ptr, left);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      close(fd);
+      return -1;
+    }
+
+    ptr += ret;
+    left -= ret;
+  }
+
+  if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
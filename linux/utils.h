@@ -7,7 +7,14 @@ extern "C" {
 #endif
 
 const char* get_locale_name(const char* code);
+const char* get_locale_xkb_layout(const char* code);
 bool allocate_shm_file_pair(size_t size, int* rw_fd_ptr, int* ro_fd_ptr);
+
+/**
+ * Copies data into a memfd which is sealed against any further change, so it
+ * can be handed to the compositor as is. Returns -1 on failure.
+ */
+int create_sealed_memfd(const char* name, const void* data, size_t size);
 long get_time_ms();
 
 #if defined(__cplusplus)
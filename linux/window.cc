@@ -7,6 +7,8 @@
 #endif
 
 #include "flutter/generated_plugin_registrant.h"
+#include "handwriting.h"
+#include "touch-tracker.h"
 #include "window.h"
 #include "utils.h"
 
@@ -14,11 +16,64 @@ typedef struct _KeebieWindowPrivate {
   FlView* view;
 
   FlMethodChannel* method_channel;
+  FlEventChannel* im_channel;
+  gboolean is_im_listening;
+
+  // Which output the window is on and what it looked like when last sent.
+  FlEventChannel* monitor_channel;
+  gboolean is_monitor_listening;
+  GdkMonitor* monitor;
+  GdkRectangle monitor_geometry;
+  gint monitor_scale;
+  gint x;
+  gint y;
   gboolean is_keyboard;
+
+  // Where the Dart side last laid the plane out within the view, touches
+  // landing on it are resolved and typed here rather than waiting on
+  // Flutter's gesture arena.
+  KeebieTouchTracker* touch_tracker;
+  gboolean has_touch_surface;
+  KeebieGeometryParams touch_params;
+  gdouble touch_x;
+  gdouble touch_y;
+  gdouble touch_width;
+  gdouble touch_height;
+  gboolean touch_is_shifted;
+
+  // The touch which may be dragged across the letters, one at a time. It is
+  // only a swipe once it left its key, the points are within the plane.
+  gboolean has_swipe;
+  gconstpointer swipe_sequence;
+  gboolean swipe_is_shifted;
+  gdouble swipe_threshold;
+  GArray* swipe_points;
+  gboolean is_swiping;
+  guint swipe_taken_back;
+  guint swipe_serial;
+  gboolean is_swipe_decoding;
+
+  // Where the Dart side laid out the handwriting pad. Strokes written on it
+  // are recognized here while the view goes on drawing them.
+  KeebieHandwritingRecognizer* handwriting;
+  gboolean has_handwriting_surface;
+  gdouble handwriting_x;
+  gdouble handwriting_y;
+  gdouble handwriting_width;
+  gdouble handwriting_height;
+  gboolean has_stroke;
+  gconstpointer stroke_sequence;
+  GArray* stroke_points;
 } KeebieWindowPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE(KeebieWindow, keebie_window, GTK_TYPE_APPLICATION_WINDOW);
 
+// Candidates decoded for a swipe, the first one is typed once it ends.
+#define KEEBIE_WINDOW_SWIPE_CANDIDATES 4
+
+// Characters offered for what is written on the handwriting pad.
+#define KEEBIE_WINDOW_HANDWRITING_CANDIDATES 5
+
 enum {
   PROP_0,
   PROP_IS_KEYBOARD,
@@ -27,6 +82,248 @@ enum {
 
 static GParamSpec* obj_properties[N_PROPERTIES] = { nullptr };
 
+static const gchar* keebie_window_value_get_string(FlValue* map, const gchar* key) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return nullptr;
+  }
+  return fl_value_get_string(value);
+}
+
+static int64_t keebie_window_value_get_int(FlValue* map, const gchar* key, int64_t fallback) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_INT) {
+    return fallback;
+  }
+  return fl_value_get_int(value);
+}
+
+static gboolean keebie_window_value_get_bool(FlValue* map, const gchar* key) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_BOOL) {
+    return FALSE;
+  }
+  return fl_value_get_bool(value);
+}
+
+static gdouble keebie_window_value_get_double(FlValue* map, const gchar* key) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  if (value == nullptr) {
+    return 0;
+  }
+
+  switch (fl_value_get_type(value)) {
+    case FL_VALUE_TYPE_FLOAT:
+      return fl_value_get_float(value);
+    case FL_VALUE_TYPE_INT:
+      return fl_value_get_int(value);
+    default:
+      return 0;
+  }
+}
+
+static KeebieLayout* keebie_window_compile_layout(FlValue* value) {
+  if (fl_value_get_type(value) != FL_VALUE_TYPE_MAP) {
+    return nullptr;
+  }
+
+  FlValue* planes = fl_value_lookup_string(value, "planes");
+  if (planes == nullptr || fl_value_get_type(planes) != FL_VALUE_TYPE_LIST || fl_value_get_length(planes) == 0) {
+    return nullptr;
+  }
+
+  g_autoptr(KeebieLayoutBuilder) builder = keebie_layout_builder_new(keebie_window_value_get_string(value, "locale"));
+
+  FlValue* content_plane_map = fl_value_lookup_string(value, "contentPlaneMap");
+  if (content_plane_map != nullptr && fl_value_get_type(content_plane_map) == FL_VALUE_TYPE_MAP) {
+    for (size_t i = 0; i < fl_value_get_length(content_plane_map); i++) {
+      FlValue* type = fl_value_get_map_key(content_plane_map, i);
+      FlValue* plane = fl_value_get_map_value(content_plane_map, i);
+      if (fl_value_get_type(type) != FL_VALUE_TYPE_STRING || fl_value_get_type(plane) != FL_VALUE_TYPE_INT) continue;
+
+      int content_type = keebie_content_type_from_string(fl_value_get_string(type));
+      if (content_type >= 0) {
+        keebie_layout_builder_set_content_plane(builder, (KeebieContentType)content_type, fl_value_get_int(plane));
+      }
+    }
+  }
+
+  for (size_t i = 0; i < fl_value_get_length(planes); i++) {
+    FlValue* plane = fl_value_get_list_value(planes, i);
+    KeebiePlaneType type = KEEBIE_PLANE_TYPE_KEYS;
+    if (fl_value_get_type(plane) == FL_VALUE_TYPE_MAP) {
+      type = keebie_plane_type_from_string(keebie_window_value_get_string(plane, "type"));
+      plane = fl_value_lookup_string(plane, "rows");
+    }
+    keebie_layout_builder_add_plane(builder, type);
+
+    if (plane == nullptr || fl_value_get_type(plane) != FL_VALUE_TYPE_LIST) continue;
+
+    for (size_t x = 0; x < fl_value_get_length(plane); x++) {
+      FlValue* row = fl_value_get_list_value(plane, x);
+      keebie_layout_builder_add_row(builder);
+
+      if (fl_value_get_type(row) != FL_VALUE_TYPE_LIST) continue;
+
+      for (size_t y = 0; y < fl_value_get_length(row); y++) {
+        FlValue* key = fl_value_get_list_value(row, y);
+        if (fl_value_get_type(key) != FL_VALUE_TYPE_MAP) continue;
+
+        KeebieLayoutKeyInfo info = {};
+        info.type = keebie_key_type_from_string(keebie_window_value_get_string(key, "type"));
+        info.name = keebie_window_value_get_string(key, "name");
+        info.shifted_name = keebie_window_value_get_string(key, "shiftedName");
+        info.icon = keebie_window_value_get_int(key, "icon", 0);
+        info.icon_font = keebie_window_value_get_string(key, "iconFontFamily");
+        info.shifted_icon = keebie_window_value_get_int(key, "shiftedIcon", 0);
+        info.shifted_icon_font = keebie_window_value_get_string(key, "shiftedIconFontFamily");
+        info.plane = keebie_window_value_get_int(key, "plane", -1);
+
+        if (keebie_window_value_get_bool(key, "expands")) info.flags |= KEEBIE_KEY_FLAG_EXPANDS;
+        if (keebie_window_value_get_bool(key, "secondaryColors")) info.flags |= KEEBIE_KEY_FLAG_SECONDARY_COLORS;
+
+        FlValue* constraints_value = fl_value_lookup_string(key, "constraints");
+        if (constraints_value != nullptr && fl_value_get_type(constraints_value) == FL_VALUE_TYPE_LIST) {
+          for (size_t z = 0; z < fl_value_get_length(constraints_value); z++) {
+            FlValue* constraint = fl_value_get_list_value(constraints_value, z);
+            if (fl_value_get_type(constraint) == FL_VALUE_TYPE_STRING) {
+              info.constraints |= keebie_key_constraint_from_string(fl_value_get_string(constraint));
+            }
+          }
+        }
+
+        keebie_layout_builder_add_key(builder, &info);
+      }
+    }
+  }
+
+  g_autoptr(GBytes) bytes = keebie_layout_builder_end(builder);
+  return keebie_layout_new_from_bytes(bytes, nullptr);
+}
+
+static FlValue* keebie_window_im_state_to_value(const KeebieImState* state) {
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(value, "active", fl_value_new_bool(state->is_active));
+  fl_value_set_string_take(value, "contentType", fl_value_new_int(keebie_im_state_get_content_type(state)));
+  fl_value_set_string_take(value, "contentHint", fl_value_new_int(state->content_hint));
+  fl_value_set_string_take(value, "contentPurpose", fl_value_new_int(state->content_purpose));
+  fl_value_set_string_take(value, "textChangeCause", fl_value_new_int(state->text_change_cause));
+
+  const KeebieSurrounding* surrounding = &state->surrounding;
+  fl_value_set_string_take(value, "surroundingText", surrounding->text != nullptr ? fl_value_new_string(surrounding->text) : fl_value_new_null());
+  fl_value_set_string_take(value, "cursor", fl_value_new_int(keebie_surrounding_get_utf16_offset(surrounding, surrounding->cursor)));
+  fl_value_set_string_take(value, "anchor", fl_value_new_int(keebie_surrounding_get_utf16_offset(surrounding, surrounding->anchor)));
+  return value;
+}
+
+static FlValue* keebie_window_monitor_to_value(KeebieWindowPrivate* priv) {
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(value, "width", fl_value_new_int(priv->monitor_geometry.width));
+  fl_value_set_string_take(value, "height", fl_value_new_int(priv->monitor_geometry.height));
+  fl_value_set_string_take(value, "x", fl_value_new_int(priv->monitor_geometry.x));
+  fl_value_set_string_take(value, "y", fl_value_new_int(priv->monitor_geometry.y));
+  fl_value_set_string_take(value, "scale", fl_value_new_int(priv->monitor_scale));
+  return value;
+}
+
+/**
+ * Refreshes the cached monitor, which is looked up again only when resolve
+ * is set or the old one went away. Returns TRUE if anything changed.
+ */
+static gboolean keebie_window_update_monitor(KeebieWindow* self, gboolean resolve) {
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+  KeebieApplication* app = KEEBIE_APPLICATION(gtk_window_get_application(GTK_WINDOW(self)));
+
+  GdkWindow* win = gtk_widget_get_window(GTK_WIDGET(self));
+  if (app == nullptr || win == nullptr) {
+    return FALSE;
+  }
+
+  GdkRectangle geom;
+  gint scale;
+  if (resolve || priv->monitor == nullptr || !keebie_application_lookup_output(app, priv->monitor, &geom, &scale)) {
+    GdkMonitor* monitor = gdk_display_get_monitor_at_window(gtk_widget_get_display(GTK_WIDGET(self)), win);
+    if (monitor == nullptr || !keebie_application_lookup_output(app, monitor, &geom, &scale)) {
+      return FALSE;
+    }
+    priv->monitor = monitor;
+  }
+
+  if (gdk_rectangle_equal(&geom, &priv->monitor_geometry) && scale == priv->monitor_scale) {
+    return FALSE;
+  }
+
+  priv->monitor_geometry = geom;
+  priv->monitor_scale = scale;
+
+  if (priv->monitor_channel != nullptr && priv->is_monitor_listening) {
+    g_autoptr(FlValue) value = keebie_window_monitor_to_value(priv);
+    g_autoptr(GError) error = nullptr;
+    if (!fl_event_channel_send(priv->monitor_channel, value, nullptr, &error)) {
+      g_warning("Failed to send the monitor geometry: %s", error->message);
+    }
+  }
+  return TRUE;
+}
+
+static void keebie_window_update_margins(KeebieWindow* self) {
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+  GdkWindow* win = gtk_widget_get_window(GTK_WIDGET(self));
+
+  gint width;
+  gint height;
+  gtk_window_get_size(GTK_WINDOW(self), &width, &height);
+
+  int horiz = abs((priv->monitor_geometry.width - width) / 2);
+  if (GDK_IS_WAYLAND_WINDOW(win) && keebie_window_is_keyboard(self)) {
+    gtk_layer_set_margin(GTK_WINDOW(self), GTK_LAYER_SHELL_EDGE_LEFT, horiz);
+    gtk_layer_set_margin(GTK_WINDOW(self), GTK_LAYER_SHELL_EDGE_RIGHT, horiz);
+  }
+}
+
+static FlMethodErrorResponse* keebie_window_monitor_listen_cb(FlEventChannel* channel, FlValue* args, gpointer user_data) {
+  KeebieWindow* self = KEEBIE_WINDOW(user_data);
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+
+  priv->is_monitor_listening = TRUE;
+  if (priv->monitor != nullptr) {
+    g_autoptr(FlValue) value = keebie_window_monitor_to_value(priv);
+    fl_event_channel_send(priv->monitor_channel, value, nullptr, nullptr);
+  }
+  return nullptr;
+}
+
+static FlMethodErrorResponse* keebie_window_monitor_cancel_cb(FlEventChannel* channel, FlValue* args, gpointer user_data) {
+  KeebieWindow* self = KEEBIE_WINDOW(user_data);
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+
+  priv->is_monitor_listening = FALSE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* keebie_window_im_listen_cb(FlEventChannel* channel, FlValue* args, gpointer user_data) {
+  KeebieWindow* self = KEEBIE_WINDOW(user_data);
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+  KeebieApplication* app = KEEBIE_APPLICATION(gtk_window_get_application(GTK_WINDOW(self)));
+
+  priv->is_im_listening = TRUE;
+
+  // New listeners start from the current state, later ones only get changes.
+  KeebieImState state = {};
+  keebie_application_get_im_state(app, &state);
+  keebie_window_im_state_changed(self, &state);
+  keebie_im_state_clear(&state);
+  return nullptr;
+}
+
+static FlMethodErrorResponse* keebie_window_im_cancel_cb(FlEventChannel* channel, FlValue* args, gpointer user_data) {
+  KeebieWindow* self = KEEBIE_WINDOW(user_data);
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+
+  priv->is_im_listening = FALSE;
+  return nullptr;
+}
+
 static void keebie_window_method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call, gpointer user_data) {
   KeebieWindow* self = KEEBIE_WINDOW(user_data);
 
@@ -35,56 +332,27 @@ static void keebie_window_method_call_cb(FlMethodChannel* channel, FlMethodCall*
 
   if (g_strcmp0(method_name, "sendKey") == 0 && keebie_window_is_keyboard(self)) {
     FlValue* args = fl_method_call_get_args(method_call);
-    const gchar* arg_type = fl_value_get_string(fl_value_lookup(args, fl_value_new_string("type")));
-    const gchar* arg_name = fl_value_get_string(fl_value_lookup(args, fl_value_new_string("name")));
-    const gchar* arg_shifted_name = fl_value_get_string(fl_value_lookup(args, fl_value_new_string("shiftedName")));
-    gboolean arg_is_shifted = fl_value_get_bool(fl_value_lookup(args, fl_value_new_string("isShifted")));
+    int64_t arg_plane = keebie_window_value_get_int(args, "plane", -1);
+    int64_t arg_row_no = keebie_window_value_get_int(args, "rowNo", -1);
+    int64_t arg_key_no = keebie_window_value_get_int(args, "keyNo", -1);
+    gboolean arg_is_shifted = keebie_window_value_get_bool(args, "isShifted");
 
     KeebieApplication* app = KEEBIE_APPLICATION(gtk_window_get_application(GTK_WINDOW(self)));
     g_assert(app != nullptr);
 
-    if (g_strcmp0(arg_type, "backspace") == 0) {
-      keebie_application_delete_surrounding(app, 1, 0);
+    if (arg_plane >= 0 && arg_row_no >= 0 && arg_key_no >= 0 && keebie_application_activate_key(app, arg_plane, arg_row_no, arg_key_no, arg_is_shifted) >= 0) {
       response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_null()));
-    } else if (g_strcmp0(arg_type, "enter") == 0) {
-      keebie_application_send_key(app, KEY_ENTER);
-      response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_null()));
-    } else if (g_strcmp0(arg_type, "changeLang") == 0) {
-    } else if (g_strcmp0(arg_type, "space") == 0) {
-      keebie_application_commit_text(app, " ");
-      response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_null()));
-    } else if (g_strcmp0(arg_type, "regular") == 0) {
-      keebie_application_commit_text(app, arg_is_shifted && strlen(arg_shifted_name) > 0 ? arg_shifted_name : arg_name);
-      response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_null()));
-    }
-
-    if (response == nullptr) {
+    } else {
       response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
     }
   } else if (g_strcmp0(method_name, "isKeyboard") == 0) {
     response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(keebie_window_is_keyboard(self))));
   } else if (g_strcmp0(method_name, "getMonitorGeometry") == 0) {
-    GdkScreen* screen = gtk_widget_get_screen(GTK_WIDGET(self));
-    g_assert(screen != nullptr);
-
-    GdkWindow* win = gtk_widget_get_window(GTK_WIDGET(self));
-    g_assert(win != nullptr);
-
-    GdkDisplay* display = gdk_screen_get_display(screen);
-    g_assert(display != nullptr);
-
-    GdkMonitor* monitor = gdk_display_get_monitor_at_window(display, win);
-    g_assert(monitor != nullptr);
-
-    GdkRectangle geom;
-    gdk_monitor_get_geometry(monitor, &geom);
-
-    FlValue* value = fl_value_new_map();
-    fl_value_set_string_take(value, "width", fl_value_new_int(geom.width));
-    fl_value_set_string_take(value, "height", fl_value_new_int(geom.height));
-    fl_value_set_string_take(value, "x", fl_value_new_int(geom.x));
-    fl_value_set_string_take(value, "y", fl_value_new_int(geom.y));
-    response = FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+    KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+    if (priv->monitor == nullptr) {
+      keebie_window_update_monitor(self, TRUE);
+    }
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(keebie_window_monitor_to_value(priv)));
   } else if (g_strcmp0(method_name, "setExclusive") == 0) {
     gboolean is_keyboard = keebie_window_is_keyboard(self);
     bool enabled = fl_value_get_bool(fl_method_call_get_args(method_call));
@@ -105,7 +373,7 @@ static void keebie_window_method_call_cb(FlMethodChannel* channel, FlMethodCall*
     }
   } else if (g_strcmp0(method_name, "openWindow") == 0) {
     FlValue* args = fl_method_call_get_args(method_call);
-    gboolean arg_keyboard = fl_value_get_bool(fl_value_lookup(args, fl_value_new_string("keyboard")));
+    gboolean arg_keyboard = fl_value_get_bool(fl_value_lookup_string(args, "keyboard"));
 
     KeebieApplication* app = KEEBIE_APPLICATION(gtk_window_get_application(GTK_WINDOW(self)));
     g_assert(app != nullptr);
@@ -115,6 +383,77 @@ static void keebie_window_method_call_cb(FlMethodChannel* channel, FlMethodCall*
     gtk_widget_show_all(GTK_WIDGET(new_win));
     response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_null()));
   } else if (g_strcmp0(method_name, "announceLayout") == 0) {
+    KeebieApplication* app = KEEBIE_APPLICATION(gtk_window_get_application(GTK_WINDOW(self)));
+    g_assert(app != nullptr);
+
+    g_autoptr(KeebieLayout) layout = keebie_window_compile_layout(fl_method_call_get_args(method_call));
+    if (layout != nullptr) {
+      keebie_application_set_layout(app, layout);
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_null()));
+    } else {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new("invalidLayout", "Layout does not contain any planes", nullptr));
+    }
+  } else if (g_strcmp0(method_name, "announceTouchSurface") == 0) {
+    KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+    FlValue* args = fl_method_call_get_args(method_call);
+
+    // A null surface hands every touch back to the view.
+    priv->has_touch_surface = args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+      && keebie_window_value_get_int(args, "plane", -1) >= 0;
+    if (priv->has_touch_surface) {
+      priv->touch_params.plane = keebie_window_value_get_int(args, "plane", 0);
+      priv->touch_params.constraints = keebie_window_value_get_int(args, "constraints", 0);
+      priv->touch_params.child_size = keebie_window_value_get_double(args, "childSize");
+      priv->touch_params.padding = keebie_window_value_get_double(args, "padding");
+      priv->touch_params.monitor_width = keebie_window_value_get_double(args, "monitorWidth");
+      priv->touch_params.monitor_height = keebie_window_value_get_double(args, "monitorHeight");
+      priv->touch_x = keebie_window_value_get_double(args, "x");
+      priv->touch_y = keebie_window_value_get_double(args, "y");
+      priv->touch_width = keebie_window_value_get_double(args, "width");
+      priv->touch_height = keebie_window_value_get_double(args, "height");
+      priv->touch_is_shifted = keebie_window_value_get_bool(args, "isShifted");
+    }
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_null()));
+  } else if (g_strcmp0(method_name, "announceHandwritingSurface") == 0 && keebie_window_is_keyboard(self)) {
+    KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+    KeebieApplication* app = KEEBIE_APPLICATION(gtk_window_get_application(GTK_WINDOW(self)));
+    g_assert(app != nullptr);
+    FlValue* args = fl_method_call_get_args(method_call);
+
+    // Templates are only loaded once a pad shows, a null one lets go of them.
+    g_autoptr(KeebieHandwriting) handwriting = nullptr;
+    priv->has_handwriting_surface = args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP;
+    if (priv->has_handwriting_surface) {
+      priv->handwriting_x = keebie_window_value_get_double(args, "x");
+      priv->handwriting_y = keebie_window_value_get_double(args, "y");
+      priv->handwriting_width = keebie_window_value_get_double(args, "width");
+      priv->handwriting_height = keebie_window_value_get_double(args, "height");
+      handwriting = keebie_application_get_handwriting(app);
+    } else {
+      priv->has_stroke = FALSE;
+    }
+
+    keebie_handwriting_recognizer_set_handwriting(priv->handwriting, handwriting);
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(handwriting != nullptr)));
+  } else if (g_strcmp0(method_name, "acceptHandwriting") == 0 && keebie_window_is_keyboard(self)) {
+    KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+    KeebieApplication* app = KEEBIE_APPLICATION(gtk_window_get_application(GTK_WINDOW(self)));
+    g_assert(app != nullptr);
+    FlValue* args = fl_method_call_get_args(method_call);
+
+    if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_STRING && keebie_application_commit_text(app, fl_value_get_string(args))) {
+      keebie_handwriting_recognizer_clear(priv->handwriting);
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_null()));
+    } else {
+      response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+    }
+  } else if (g_strcmp0(method_name, "undoHandwritingStroke") == 0 && keebie_window_is_keyboard(self)) {
+    KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+    gboolean result = keebie_handwriting_recognizer_undo_stroke(priv->handwriting);
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_bool(result)));
+  } else if (g_strcmp0(method_name, "clearHandwriting") == 0 && keebie_window_is_keyboard(self)) {
+    KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+    keebie_handwriting_recognizer_clear(priv->handwriting);
     response = FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_null()));
   } else if (g_strcmp0(method_name, "announceSettingsChange") == 0) {
     KeebieApplication* app = KEEBIE_APPLICATION(gtk_window_get_application(GTK_WINDOW(self)));
@@ -139,6 +478,412 @@ static void keebie_window_method_call_cb(FlMethodChannel* channel, FlMethodCall*
     g_warning("Failed to send response: %s", error->message);
 }
 
+/**
+ * Tells the Dart side to draw a touched key as pressed or not, and whether it
+ * was just typed so a one-shot shift can be let go of.
+ */
+static void keebie_window_send_key_feedback(KeebieWindow* self, const KeebieTouchKey* key, gboolean is_pressed, gboolean is_committed) {
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+  if (priv->method_channel == nullptr) {
+    return;
+  }
+
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "plane", fl_value_new_int(key->plane));
+  fl_value_set_string_take(args, "rowNo", fl_value_new_int(key->row));
+  fl_value_set_string_take(args, "keyNo", fl_value_new_int(key->key));
+  fl_value_set_string_take(args, "isPressed", fl_value_new_bool(is_pressed));
+  fl_value_set_string_take(args, "isCommitted", fl_value_new_bool(is_committed));
+  fl_method_channel_invoke_method(priv->method_channel, "onKeyFeedback", args, nullptr, nullptr, nullptr);
+}
+
+static void keebie_window_touch_commit(const KeebieTouchKey* key, gboolean is_held, gboolean is_down, gpointer data) {
+  KeebieWindow* self = KEEBIE_WINDOW(data);
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+  KeebieApplication* app = KEEBIE_APPLICATION(gtk_window_get_application(GTK_WINDOW(self)));
+  if (app == nullptr) {
+    return;
+  }
+
+  if (is_held) {
+    keebie_application_press_key(app, key->plane, key->row, key->key, priv->touch_is_shifted);
+  } else {
+    keebie_application_activate_key(app, key->plane, key->row, key->key, priv->touch_is_shifted);
+  }
+
+  // Shift only lasts one key, whether or not the Dart side re-announced yet.
+  priv->touch_is_shifted = FALSE;
+  keebie_window_send_key_feedback(self, key, is_down, TRUE);
+}
+
+static void keebie_window_touch_release(const KeebieTouchKey* key, gpointer data) {
+  KeebieApplication* app = KEEBIE_APPLICATION(gtk_window_get_application(GTK_WINDOW(data)));
+  if (app != nullptr) {
+    keebie_application_release_key(app, key->plane, key->row, key->key);
+  }
+}
+
+typedef struct {
+  KeebieWindow* self;
+  guint serial;
+  guint taken_back;
+  gboolean is_shifted;
+} KeebieWindowSwipe;
+
+static void keebie_window_swipe_free(gpointer data) {
+  KeebieWindowSwipe* swipe = reinterpret_cast<KeebieWindowSwipe*>(data);
+  g_object_unref(swipe->self);
+  g_free(swipe);
+}
+
+static void keebie_window_decode_swipe(KeebieWindow* self, gboolean is_final);
+
+static void keebie_window_swipe_decoded(GPtrArray* words, gboolean is_final, gpointer data) {
+  KeebieWindowSwipe* swipe = reinterpret_cast<KeebieWindowSwipe*>(data);
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(swipe->self));
+  KeebieApplication* app = KEEBIE_APPLICATION(gtk_window_get_application(GTK_WINDOW(swipe->self)));
+
+  // Words of a swipe which already ended have nothing left to show.
+  gboolean is_current = swipe->serial == priv->swipe_serial;
+  if (is_current && !is_final) {
+    priv->is_swipe_decoding = FALSE;
+  } else if (!is_final) {
+    return;
+  }
+
+  if (is_final && words->len > 0 && app != nullptr) {
+    keebie_application_commit_swipe(app, reinterpret_cast<const char*>(g_ptr_array_index(words, 0)), swipe->taken_back, swipe->is_shifted);
+  }
+
+  if (priv->method_channel != nullptr) {
+    g_autoptr(FlValue) list = fl_value_new_list();
+    for (guint i = 0; i < words->len; i++) {
+      fl_value_append_take(list, fl_value_new_string(reinterpret_cast<const char*>(g_ptr_array_index(words, i))));
+    }
+
+    g_autoptr(FlValue) args = fl_value_new_map();
+    fl_value_set_string(args, "words", list);
+    fl_value_set_string_take(args, "isFinal", fl_value_new_bool(is_final));
+    fl_method_channel_invoke_method(priv->method_channel, "onSwipeCandidates", args, nullptr, nullptr, nullptr);
+  }
+
+  // The finger kept moving while the last points were decoded.
+  if (is_current && !is_final && priv->is_swiping) {
+    keebie_window_decode_swipe(swipe->self, FALSE);
+  }
+}
+
+static void keebie_window_decode_swipe(KeebieWindow* self, gboolean is_final) {
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+  KeebieApplication* app = KEEBIE_APPLICATION(gtk_window_get_application(GTK_WINDOW(self)));
+  if (app == nullptr || priv->swipe_points == nullptr) {
+    return;
+  }
+
+  KeebieWindowSwipe* swipe = g_new0(KeebieWindowSwipe, 1);
+  swipe->self = KEEBIE_WINDOW(g_object_ref(self));
+  swipe->serial = priv->swipe_serial;
+  swipe->taken_back = priv->swipe_taken_back;
+  swipe->is_shifted = priv->swipe_is_shifted;
+
+  if (!keebie_application_decode_swipe(app, &priv->touch_params, reinterpret_cast<const float*>(priv->swipe_points->data),
+      priv->swipe_points->len / 2, is_final, KEEBIE_WINDOW_SWIPE_CANDIDATES, keebie_window_swipe_decoded, swipe, keebie_window_swipe_free)) {
+    keebie_window_swipe_free(swipe);
+    return;
+  }
+  priv->is_swipe_decoding = !is_final;
+}
+
+static void keebie_window_swipe_append(KeebieWindowPrivate* priv, gdouble x, gdouble y) {
+  float point[] = { static_cast<float>(x), static_cast<float>(y) };
+  g_array_append_vals(priv->swipe_points, point, 2);
+}
+
+/**
+ * Follows a touch which may be a swipe to x, y within the view. Once it
+ * leaves its key it is taken from the tracker, along with the key it typed
+ * if it did.
+ */
+static void keebie_window_swipe_move(KeebieWindow* self, gdouble x, gdouble y) {
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+  x -= priv->touch_x;
+  y -= priv->touch_y;
+  keebie_window_swipe_append(priv, x, y);
+
+  if (!priv->is_swiping) {
+    const float* start = reinterpret_cast<const float*>(priv->swipe_points->data);
+    if (hypot(x - start[0], y - start[1]) < priv->swipe_threshold) {
+      return;
+    }
+
+    priv->is_swiping = TRUE;
+    priv->swipe_taken_back = keebie_touch_tracker_is_committed(priv->touch_tracker, priv->swipe_sequence) ? 1 : 0;
+
+    KeebieTouchKey key;
+    if (keebie_touch_tracker_end(priv->touch_tracker, priv->swipe_sequence, TRUE, &key)) {
+      keebie_window_send_key_feedback(self, &key, FALSE, FALSE);
+    }
+  }
+
+  if (!priv->is_swipe_decoding) {
+    keebie_window_decode_swipe(self, FALSE);
+  }
+}
+
+/**
+ * Lets go of the touch which may be a swipe, decoding it for good when it
+ * was one and was not cancelled.
+ */
+static void keebie_window_swipe_end(KeebieWindow* self, gboolean is_cancelled) {
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+  if (priv->is_swiping && !is_cancelled) {
+    keebie_window_decode_swipe(self, TRUE);
+  } else if (priv->is_swiping && priv->method_channel != nullptr) {
+    g_autoptr(FlValue) args = fl_value_new_map();
+    fl_value_set_string_take(args, "words", fl_value_new_list());
+    fl_value_set_string_take(args, "isFinal", fl_value_new_bool(TRUE));
+    fl_method_channel_invoke_method(priv->method_channel, "onSwipeCandidates", args, nullptr, nullptr, nullptr);
+  }
+
+  priv->has_swipe = FALSE;
+  priv->is_swiping = FALSE;
+  priv->is_swipe_decoding = FALSE;
+  priv->swipe_serial++;
+  g_array_set_size(priv->swipe_points, 0);
+}
+
+static void keebie_window_handwriting_recognized(const char* const* characters, guint n_characters, guint n_strokes, gpointer data) {
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(KEEBIE_WINDOW(data)));
+  if (priv->method_channel == nullptr) {
+    return;
+  }
+
+  g_autoptr(FlValue) list = fl_value_new_list();
+  for (guint i = 0; i < n_characters; i++) {
+    fl_value_append_take(list, fl_value_new_string(characters[i]));
+  }
+
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string(args, "characters", list);
+  fl_value_set_string_take(args, "strokes", fl_value_new_int(n_strokes));
+  fl_method_channel_invoke_method(priv->method_channel, "onHandwritingCandidates", args, nullptr, nullptr, nullptr);
+}
+
+/**
+ * Adds x, y within the view to the stroke being written, in units of the
+ * square centered in the pad the character is written in.
+ */
+static void keebie_window_stroke_append(KeebieWindowPrivate* priv, gdouble x, gdouble y) {
+  gdouble side = MIN(priv->handwriting_width, priv->handwriting_height);
+  float point[] = {
+    static_cast<float>((x - priv->handwriting_x - (priv->handwriting_width - side) / 2) / side),
+    static_cast<float>((y - priv->handwriting_y - (priv->handwriting_height - side) / 2) / side),
+  };
+  g_array_append_vals(priv->stroke_points, point, 2);
+}
+
+/**
+ * Starts a stroke for a touch going down at x, y within the view when it
+ * lands on the handwriting pad. The view still gets the touch to draw it.
+ */
+static void keebie_window_stroke_begin(KeebieWindow* self, gconstpointer sequence, gdouble x, gdouble y) {
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+  if (!priv->has_handwriting_surface || priv->has_stroke || priv->handwriting_width <= 0 || priv->handwriting_height <= 0
+      || x < priv->handwriting_x || y < priv->handwriting_y
+      || x >= priv->handwriting_x + priv->handwriting_width || y >= priv->handwriting_y + priv->handwriting_height) {
+    return;
+  }
+
+  priv->has_stroke = TRUE;
+  priv->stroke_sequence = sequence;
+  g_array_set_size(priv->stroke_points, 0);
+  keebie_window_stroke_append(priv, x, y);
+}
+
+static void keebie_window_stroke_end(KeebieWindow* self, gboolean is_cancelled) {
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+  if (!is_cancelled) {
+    keebie_handwriting_recognizer_add_stroke(priv->handwriting, reinterpret_cast<const float*>(priv->stroke_points->data), priv->stroke_points->len / 2);
+  }
+
+  priv->has_stroke = FALSE;
+  g_array_set_size(priv->stroke_points, 0);
+}
+
+/**
+ * Resolves a touch going down at x, y within the view to the key it was
+ * meant for and starts tracking it. Returns FALSE when the touch is left to
+ * the view.
+ */
+static gboolean keebie_window_touch_begin(KeebieWindow* self, gconstpointer sequence, guint32 time, gdouble x, gdouble y) {
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+  KeebieApplication* app = KEEBIE_APPLICATION(gtk_window_get_application(GTK_WINDOW(self)));
+  if (app == nullptr || !priv->has_touch_surface) {
+    return FALSE;
+  }
+
+  x -= priv->touch_x;
+  y -= priv->touch_y;
+  if (x < 0 || y < 0 || x >= priv->touch_width || y >= priv->touch_height) {
+    return FALSE;
+  }
+
+  gint index = keebie_application_resolve_touch(app, &priv->touch_params, x, y);
+  g_autoptr(KeebieGeometry) geometry = index >= 0 ? keebie_application_get_geometry(app, &priv->touch_params) : nullptr;
+  if (geometry == nullptr || static_cast<guint>(index) >= geometry->n_keys) {
+    return FALSE;
+  }
+
+  // Plane, shift and language keys change state the Dart side owns, those
+  // still go through it.
+  const KeebieKeyRect* rect = &geometry->keys[index];
+  int type = keebie_application_get_action_type(app, priv->touch_params.plane, rect->row, rect->key);
+  if (type != KEEBIE_KEY_ACTION_COMMIT && type != KEEBIE_KEY_ACTION_KEYCODE && type != KEEBIE_KEY_ACTION_DELETE) {
+    return FALSE;
+  }
+
+  KeebieTouchKey key = {};
+  key.plane = priv->touch_params.plane;
+  key.row = rect->row;
+  key.key = rect->key;
+  keebie_window_send_key_feedback(self, &key, TRUE, FALSE);
+
+  // Shift is let go of as the key types, the swipe would lose it otherwise.
+  if (!priv->has_swipe && type == KEEBIE_KEY_ACTION_COMMIT && keebie_application_can_swipe(app, &priv->touch_params, rect->row, rect->key)) {
+    priv->has_swipe = TRUE;
+    priv->swipe_sequence = sequence;
+    priv->swipe_is_shifted = priv->touch_is_shifted;
+    priv->swipe_threshold = rect->width;
+    keebie_window_swipe_append(priv, x, y);
+  }
+
+  keebie_touch_tracker_set_rollover(priv->touch_tracker, keebie_application_get_rollover(app));
+  keebie_touch_tracker_begin(priv->touch_tracker, sequence, time, &key,
+    type != KEEBIE_KEY_ACTION_COMMIT || keebie_application_get_commit_on_press(app));
+  return TRUE;
+}
+
+/**
+ * Handles touches and primary button presses on a keyboard window's keys.
+ * Returns TRUE when the event was taken, and with it every later event of
+ * the same sequence.
+ */
+static gboolean keebie_window_filter_event(GdkEvent* event) {
+  gconstpointer sequence = nullptr;
+  switch (event->type) {
+    case GDK_TOUCH_BEGIN:
+    case GDK_TOUCH_UPDATE:
+    case GDK_TOUCH_END:
+    case GDK_TOUCH_CANCEL:
+      sequence = event->touch.sequence;
+      break;
+    case GDK_BUTTON_PRESS:
+    case GDK_2BUTTON_PRESS:
+    case GDK_3BUTTON_PRESS:
+    case GDK_BUTTON_RELEASE:
+      if (event->button.button != GDK_BUTTON_PRIMARY) {
+        return FALSE;
+      }
+      break;
+    case GDK_MOTION_NOTIFY:
+      break;
+    default:
+      return FALSE;
+  }
+
+  GdkWindow* win = event->any.window;
+  GdkWindow* toplevel = win != nullptr ? gdk_window_get_toplevel(win) : nullptr;
+  gpointer widget = nullptr;
+  if (toplevel != nullptr) {
+    gdk_window_get_user_data(toplevel, &widget);
+  }
+
+  if (widget == nullptr || !KEEBIE_IS_WINDOW(widget) || !keebie_window_is_keyboard(KEEBIE_WINDOW(widget))) {
+    return FALSE;
+  }
+
+  KeebieWindow* self = KEEBIE_WINDOW(widget);
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+  if (priv->touch_tracker == nullptr || priv->view == nullptr) {
+    return FALSE;
+  }
+
+  // Pointer events emulated for a touch belong to that touch.
+  if (event->type != GDK_TOUCH_BEGIN && event->type != GDK_TOUCH_UPDATE && event->type != GDK_TOUCH_END
+      && event->type != GDK_TOUCH_CANCEL && gdk_event_get_pointer_emulated(event)) {
+    return keebie_touch_tracker_is_down(priv->touch_tracker) || priv->has_swipe;
+  }
+
+  // Events are at the top-level window's coordinates, made relative to the view.
+  gdouble x = 0;
+  gdouble y = 0;
+  gdk_event_get_coords(event, &x, &y);
+  for (; win != toplevel; win = gdk_window_get_parent(win)) {
+    gdk_window_coords_to_parent(win, x, y, &x, &y);
+  }
+
+  GtkAllocation allocation;
+  gtk_widget_get_allocation(GTK_WIDGET(priv->view), &allocation);
+  x -= allocation.x;
+  y -= allocation.y;
+
+  gboolean is_swipe = priv->has_swipe && priv->swipe_sequence == sequence;
+  gboolean is_stroke = priv->has_stroke && priv->stroke_sequence == sequence;
+  switch (event->type) {
+    case GDK_TOUCH_BEGIN:
+    case GDK_BUTTON_PRESS:
+      if (keebie_window_touch_begin(self, sequence, gdk_event_get_time(event), x, y)) {
+        return TRUE;
+      }
+
+      keebie_window_stroke_begin(self, sequence, x, y);
+      return FALSE;
+    case GDK_TOUCH_UPDATE:
+    case GDK_MOTION_NOTIFY:
+      if (is_stroke) {
+        keebie_window_stroke_append(priv, x, y);
+      }
+
+      if (is_swipe) {
+        keebie_window_swipe_move(self, x, y);
+        return TRUE;
+      }
+      return keebie_touch_tracker_has(priv->touch_tracker, sequence);
+    case GDK_TOUCH_END:
+    case GDK_TOUCH_CANCEL:
+    case GDK_BUTTON_RELEASE: {
+      if (is_swipe) {
+        keebie_window_swipe_end(self, event->type == GDK_TOUCH_CANCEL);
+      }
+
+      if (is_stroke) {
+        keebie_window_stroke_end(self, event->type == GDK_TOUCH_CANCEL);
+      }
+
+      // A swipe took its touch from the tracker as it left the key.
+      KeebieTouchKey key;
+      if (!keebie_touch_tracker_end(priv->touch_tracker, sequence, event->type == GDK_TOUCH_CANCEL, &key)) {
+        return is_swipe;
+      }
+
+      keebie_window_send_key_feedback(self, &key, FALSE, FALSE);
+      return TRUE;
+    }
+    default:
+      return keebie_touch_tracker_has(priv->touch_tracker, sequence);
+  }
+}
+
+/**
+ * Sees every event before GTK does, so touches on the keys are handled in
+ * the order they happened, each on its own, before the view gets to them.
+ */
+static void keebie_window_event_handler(GdkEvent* event, gpointer data) {
+  if (!keebie_window_filter_event(event)) {
+    gtk_main_do_event(event);
+  }
+}
+
 static gboolean keebie_window_draw(GtkWidget* widget, cairo_t* cr) {
   GTK_WIDGET_CLASS(keebie_window_parent_class)->draw(widget, cr);
 
@@ -158,34 +903,17 @@ gboolean keebie_window_configure_event(GtkWidget* widget, GdkEventConfigure* eve
   gboolean result = GTK_WIDGET_CLASS(keebie_window_parent_class)->configure_event(widget, event);
 
   KeebieWindow* self = KEEBIE_WINDOW(widget);
-  KeebieApplication* app = KEEBIE_APPLICATION(gtk_window_get_application(GTK_WINDOW(self)));
-  g_assert(app != nullptr);
-
-  GdkScreen* screen = gtk_widget_get_screen(GTK_WIDGET(self));
-  g_assert(screen != nullptr);
-
-  GdkWindow* win = gtk_widget_get_window(widget);
-  gboolean is_keyboard = keebie_window_is_keyboard(self);
-
-  GdkDisplay* display = gdk_screen_get_display(screen);
-  g_assert(display != nullptr);
-
-  GdkMonitor* monitor = gdk_display_get_monitor_at_window(display, win);
-  g_assert(monitor != nullptr);
-
-  GdkRectangle geom;
-  gdk_monitor_get_geometry(monitor, &geom);
-
-  gint width;
-  gint height;
-  gtk_window_get_size(GTK_WINDOW(self), &width, &height);
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
 
-  int horiz = abs((geom.width - width) / 2);
-  if (GDK_IS_WAYLAND_WINDOW(win) && is_keyboard) {
-    gtk_layer_set_margin(GTK_WINDOW(self), GTK_LAYER_SHELL_EDGE_LEFT, horiz);
-    gtk_layer_set_margin(GTK_WINDOW(self), GTK_LAYER_SHELL_EDGE_RIGHT, horiz);
+  // Only a move can put the window on another output, a resize cannot.
+  gboolean moved = priv->monitor == nullptr || event->x != priv->x || event->y != priv->y;
+  priv->x = event->x;
+  priv->y = event->y;
+  if (moved) {
+    keebie_window_update_monitor(self, TRUE);
   }
 
+  keebie_window_update_margins(self);
   return result;
 }
 
@@ -232,7 +960,29 @@ static void keebie_window_realize(GtkWidget* widget) {
   priv->method_channel = fl_method_channel_new(messenger, "keebie", FL_METHOD_CODEC(fl_standard_method_codec_new()));
   fl_method_channel_set_method_call_handler(priv->method_channel, keebie_window_method_call_cb, self, nullptr);
 
+  priv->im_channel = fl_event_channel_new(messenger, "keebie/input_method", FL_METHOD_CODEC(fl_standard_method_codec_new()));
+  fl_event_channel_set_stream_handlers(priv->im_channel, keebie_window_im_listen_cb, keebie_window_im_cancel_cb, self, nullptr);
+
+  priv->monitor_channel = fl_event_channel_new(messenger, "keebie/monitor", FL_METHOD_CODEC(fl_standard_method_codec_new()));
+  fl_event_channel_set_stream_handlers(priv->monitor_channel, keebie_window_monitor_listen_cb, keebie_window_monitor_cancel_cb, self, nullptr);
+
   fl_register_plugins(FL_PLUGIN_REGISTRY(priv->view));
+
+  if (is_keyboard) {
+    gtk_widget_add_events(widget, GDK_TOUCH_MASK | GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK | GDK_BUTTON1_MOTION_MASK);
+    priv->touch_tracker = keebie_touch_tracker_new(keebie_window_touch_commit, keebie_window_touch_release, self);
+    priv->swipe_points = g_array_new(FALSE, FALSE, sizeof (float));
+    priv->handwriting = keebie_handwriting_recognizer_new(KEEBIE_WINDOW_HANDWRITING_CANDIDATES, keebie_window_handwriting_recognized, self);
+    priv->stroke_points = g_array_new(FALSE, FALSE, sizeof (float));
+
+    // GTK only lets gestures see one touch at a time, and only after the
+    // view had its turn with it, so touches are taken straight from GDK.
+    static gboolean is_event_handler_set = FALSE;
+    if (!is_event_handler_set) {
+      gdk_event_handler_set(keebie_window_event_handler, nullptr, nullptr);
+      is_event_handler_set = TRUE;
+    }
+  }
 }
 
 static void keebie_window_constructed(GObject* obj) {
@@ -250,7 +1000,15 @@ static void keebie_window_dispose(GObject* obj) {
   KeebieWindow* self = KEEBIE_WINDOW(obj);
   KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
 
+  // Nothing is recognized for the window once it is gone.
+  g_clear_pointer(&priv->handwriting, keebie_handwriting_recognizer_free);
   g_clear_object(&priv->method_channel);
+  g_clear_object(&priv->im_channel);
+  g_clear_object(&priv->monitor_channel);
+  g_clear_pointer(&priv->touch_tracker, keebie_touch_tracker_free);
+  g_clear_pointer(&priv->swipe_points, g_array_unref);
+  g_clear_pointer(&priv->stroke_points, g_array_unref);
+  priv->monitor = nullptr;
   g_clear_object(&priv->view);
 
   G_OBJECT_CLASS(keebie_window_parent_class)->dispose(obj);
@@ -311,6 +1069,42 @@ static void keebie_window_class_init(KeebieWindowClass* klass) {
 
 static void keebie_window_init(KeebieWindow* self) {}
 
+void keebie_window_layout_changed(KeebieWindow* self, const gchar* name) {
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+  if (priv->method_channel == nullptr) {
+    return;
+  }
+
+  g_autoptr(FlValue) args = fl_value_new_string(name);
+  fl_method_channel_invoke_method(priv->method_channel, "onLayoutChanged", args, nullptr, nullptr, nullptr);
+}
+
+void keebie_window_output_changed(KeebieWindow* self, GdkMonitor* monitor) {
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+
+  // Only the window's own output matters, or any one while it has none.
+  if (priv->monitor != nullptr && monitor != priv->monitor) {
+    return;
+  }
+
+  if (keebie_window_update_monitor(self, priv->monitor == nullptr)) {
+    keebie_window_update_margins(self);
+  }
+}
+
+void keebie_window_im_state_changed(KeebieWindow* self, const KeebieImState* state) {
+  KeebieWindowPrivate* priv = reinterpret_cast<KeebieWindowPrivate*>(keebie_window_get_instance_private(self));
+  if (priv->im_channel == nullptr || !priv->is_im_listening) {
+    return;
+  }
+
+  g_autoptr(FlValue) value = keebie_window_im_state_to_value(state);
+  g_autoptr(GError) error = nullptr;
+  if (!fl_event_channel_send(priv->im_channel, value, nullptr, &error)) {
+    g_warning("Failed to send the input-method state: %s", error->message);
+  }
+}
+
 KeebieWindow* keebie_window_new(KeebieApplication* application, gboolean is_keyboard) {
   return KEEBIE_WINDOW(g_object_new(keebie_window_get_type(),
     "application", application,
@@ -18,4 +18,21 @@ struct _KeebieWindowClass {
 KeebieWindow* keebie_window_new(KeebieApplication* application, gboolean is_keyboard);
 gboolean keebie_window_is_keyboard(KeebieWindow* self);
 
+/**
+ * Tells the Dart side the named layout was recompiled so it can reload it.
+ */
+void keebie_window_layout_changed(KeebieWindow* self, const gchar* name);
+
+/**
+ * Called when an output was added, removed or changed, pushes the window's
+ * monitor geometry to the keebie/monitor event channel if it was affected.
+ */
+void keebie_window_output_changed(KeebieWindow* self, GdkMonitor* monitor);
+
+/**
+ * Pushes the input-method state to listeners of the keebie/input_method
+ * event channel, called on the main thread after every done which changed it.
+ */
+void keebie_window_im_state_changed(KeebieWindow* self, const KeebieImState* state);
+
 G_END_DECLS
\ No newline at end of file
@@ -0,0 +1,45 @@
+import 'dart:convert';
+import 'dart:io';
+
+import 'package:flutter/material.dart';
+import 'package:flutter_test/flutter_test.dart';
+
+import 'package:keebie/logic/keyboard.dart';
+
+// The runner solves the same rects in linux/geometry.cc once it has the
+// layout, linux/test/geometry-test.cc checks it against this fixture as well.
+void main() {
+  final cases = json.decode(File('test/fixtures/geometry.json').readAsStringSync()) as List<dynamic>;
+
+  for (final data in cases.cast<Map<String, dynamic>>()) {
+    test('${data['layout']} plane ${data['plane']} ${data['constraints']}', () {
+      final layout = KeyboardLayout.fromJson(File('assets/keyboards/${data['layout']}.json').readAsStringSync());
+      final planeNo = data['plane'] as int;
+      expect(KeyboardKey.padding.left, data['padding']);
+
+      final geometry = KeyboardGeometry.solve(layout.getPlane(planeNo),
+        planeNo: planeNo,
+        childSize: data['childSize'],
+        monitorGeometry: Rect.fromLTWH(0, 0, data['monitorWidth'], data['monitorHeight']),
+        constraints: (data['constraints'] as List<dynamic>)
+          .map((value) => KeyboardKeyConstraint.values.firstWhere((e) => e.name == value)).toList(),
+      );
+
+      expect(geometry.size.width, closeTo(data['width'], 0.01));
+      expect(geometry.size.height, closeTo(data['height'], 0.01));
+
+      final keys = data['keys'] as List<dynamic>;
+      expect(geometry.keys.length, keys.length);
+      for (var i = 0; i < keys.length; i++) {
+        final key = keys[i] as Map<String, dynamic>;
+        final rect = geometry.keys[i];
+        expect(rect.rowNo, key['row']);
+        expect(rect.keyNo, key['key']);
+        expect(rect.rect.left, closeTo(key['x'], 0.01));
+        expect(rect.rect.top, closeTo(key['y'], 0.01));
+        expect(rect.rect.width, closeTo(key['width'], 0.01));
+        expect(rect.rect.height, closeTo(key['height'], 0.01));
+      }
+    });
+  }
+}